@@ -0,0 +1,814 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <memory>
+
+#include "gltf_importer.h"
+#include "gltf_json.h"
+#include "core/job_system.h"
+#include "core/mapped_file.h"
+
+using engine::gltf::JsonDocument;
+using engine::gltf::JsonType;
+using engine::gltf::NO_INDEX;
+
+namespace
+{
+    const uint32_t GLB_MAGIC = 0x46546C67;
+    const uint32_t GLB_CHUNK_JSON = 0x4E4F534A;
+    const uint32_t GLB_CHUNK_BIN = 0x004E4942;
+    const uint32_t MODE_TRIANGLES = 4;
+
+    enum ComponentType : uint32_t
+    {
+        Byte = 5120,
+        UnsignedByte = 5121,
+        Short = 5122,
+        UnsignedShort = 5123,
+        UnsignedInt = 5125,
+        Float = 5126
+    };
+
+    struct BufferRange
+    {
+        const uint8_t* data = nullptr;
+        size_t size = 0;
+        uint32_t stride = 0;
+    };
+
+    /**
+     * @brief Accessor resolved to a pointer into its buffer. Accessors without
+     * a buffer view read as zeros, before the sparse values are applied.
+     */
+    struct Accessor
+    {
+        const uint8_t* data = nullptr;
+        uint32_t count = 0;
+        uint32_t componentType = 0;
+        uint32_t componentCount = 0;
+        uint32_t stride = 0;
+        bool isNormalized = false;
+
+        uint32_t sparseCount = 0;
+        const uint8_t* sparseIndices = nullptr;
+        uint32_t sparseIndexType = 0;
+        const uint8_t* sparseValues = nullptr;
+    };
+
+    struct Primitive
+    {
+        uint32_t position = NO_INDEX;
+        uint32_t normal = NO_INDEX;
+        uint32_t uv = NO_INDEX;
+        uint32_t indices = NO_INDEX;
+    };
+
+    uint32_t getComponentSize(uint32_t componentType)
+    {
+        switch (componentType)
+        {
+        case Byte:
+        case UnsignedByte:
+            return 1;
+        case Short:
+        case UnsignedShort:
+            return 2;
+        case UnsignedInt:
+        case Float:
+            return 4;
+        default:
+            return 0;
+        }
+    }
+
+    uint32_t getComponentCount(std::string_view type)
+    {
+        if (type == "SCALAR")
+            return 1;
+        if (type == "VEC2")
+            return 2;
+        if (type == "VEC3")
+            return 3;
+        if (type == "VEC4" || type == "MAT2")
+            return 4;
+        if (type == "MAT3")
+            return 9;
+        if (type == "MAT4")
+            return 16;
+        return 0;
+    }
+
+    inline uint32_t readIndex(const uint8_t* data, uint32_t componentType)
+    {
+        switch (componentType)
+        {
+        case UnsignedByte:
+            return *data;
+        case UnsignedShort:
+        {
+            uint16_t value;
+            std::memcpy(&value, data, sizeof(value));
+            return value;
+        }
+        default:
+        {
+            uint32_t value;
+            std::memcpy(&value, data, sizeof(value));
+            return value;
+        }
+        }
+    }
+
+    // Reads count elements of components values of type T, one loop per type
+    // so the conversion isn't switched on per component
+    template <typename T>
+    void decodeElements(const uint8_t* data,
+        uint32_t stride,
+        uint32_t count,
+        uint32_t components,
+        float scale,
+        bool isSigned,
+        float* out,
+        uint32_t outStride)
+    {
+        for (uint32_t i = 0; i < count; i++)
+        {
+            T values[4];
+            std::memcpy(values, data + static_cast<size_t>(i) * stride, components * sizeof(T));
+            float* element = out + static_cast<size_t>(i) * outStride;
+            for (uint32_t c = 0; c < components; c++)
+            {
+                const float value = static_cast<float>(values[c]) * scale;
+                // Normalized signed integers map both -MAX and -MAX - 1 to -1
+                element[c] = isSigned ? std::max(value, -1.0f) : value;
+            }
+        }
+    }
+
+    void decodeElements(const Accessor& accessor,
+        const uint8_t* data,
+        uint32_t stride,
+        uint32_t count,
+        uint32_t components,
+        float* out,
+        uint32_t outStride)
+    {
+        const bool n = accessor.isNormalized;
+        switch (accessor.componentType)
+        {
+        case Byte:
+            decodeElements<int8_t>(data, stride, count, components, n ? 1.0f / 127.0f : 1.0f, n, out, outStride);
+            break;
+        case UnsignedByte:
+            decodeElements<uint8_t>(data, stride, count, components, n ? 1.0f / 255.0f : 1.0f, false, out, outStride);
+            break;
+        case Short:
+            decodeElements<int16_t>(data, stride, count, components, n ? 1.0f / 32767.0f : 1.0f, n, out, outStride);
+            break;
+        case UnsignedShort:
+            decodeElements<uint16_t>(data, stride, count, components, n ? 1.0f / 65535.0f : 1.0f, false, out, outStride);
+            break;
+        case UnsignedInt:
+            decodeElements<uint32_t>(data, stride, count, components, 1.0f, false, out, outStride);
+            break;
+        case Float:
+            decodeElements<float>(data, stride, count, components, 1.0f, false, out, outStride);
+            break;
+        }
+    }
+
+    /**
+     * @brief Decodes an accessor into interleaved floats (Eg: a member of MeshVertex)
+     *
+     * @param components Number of floats written per element, extra accessor components are dropped
+     * @param out First float of the first element
+     * @param outStride Distance between elements in floats
+     */
+    void decodeAccessor(const Accessor& accessor, uint32_t components, float* out, uint32_t outStride)
+    {
+        components = std::min(components, accessor.componentCount);
+        if (accessor.data)
+            decodeElements(accessor, accessor.data, accessor.stride, accessor.count, components, out, outStride);
+        else
+        {
+            for (uint32_t i = 0; i < accessor.count; i++)
+                std::fill(out + static_cast<size_t>(i) * outStride, out + static_cast<size_t>(i) * outStride + components, 0.0f);
+        }
+
+        // Sparse values are tightly packed and replace the elements at their indices
+        const uint32_t indexSize = getComponentSize(accessor.sparseIndexType);
+        const uint32_t elementSize = getComponentSize(accessor.componentType) * accessor.componentCount;
+        for (uint32_t i = 0; i < accessor.sparseCount; i++)
+        {
+            const uint32_t index = readIndex(accessor.sparseIndices + static_cast<size_t>(i) * indexSize, accessor.sparseIndexType);
+            if (index < accessor.count)
+            {
+                decodeElements(accessor,
+                    accessor.sparseValues + static_cast<size_t>(i) * elementSize,
+                    elementSize,
+                    1,
+                    components,
+                    out + static_cast<size_t>(index) * outStride,
+                    outStride);
+            }
+        }
+    }
+
+    template <typename T>
+    uint32_t decodeIndices(const uint8_t* data, uint32_t stride, std::vector<uint32_t>& out)
+    {
+        // Tracks the largest index instead of branching on every one
+        uint32_t maxIndex = 0;
+        for (size_t i = 0; i < out.size(); i++)
+        {
+            T index;
+            std::memcpy(&index, data + i * stride, sizeof(T));
+            out[i] = index;
+            maxIndex = std::max<uint32_t>(maxIndex, index);
+        }
+        return maxIndex;
+    }
+
+    // Returns false if an index is out of range of the vertices
+    bool decodeIndices(const Accessor& accessor, std::vector<uint32_t>& out, uint32_t vertexCount)
+    {
+        if (out.empty())
+            return true;
+
+        uint32_t maxIndex = 0;
+        switch (accessor.componentType)
+        {
+        case UnsignedByte:
+            maxIndex = decodeIndices<uint8_t>(accessor.data, accessor.stride, out);
+            break;
+        case UnsignedShort:
+            maxIndex = decodeIndices<uint16_t>(accessor.data, accessor.stride, out);
+            break;
+        default:
+            maxIndex = decodeIndices<uint32_t>(accessor.data, accessor.stride, out);
+            break;
+        }
+        return maxIndex < vertexCount;
+    }
+
+    bool decodeBase64(std::string_view text, std::vector<uint8_t>& out)
+    {
+        auto decodeChar = [](char c) -> int
+        {
+            if (c >= 'A' && c <= 'Z')
+                return c - 'A';
+            if (c >= 'a' && c <= 'z')
+                return c - 'a' + 26;
+            if (c >= '0' && c <= '9')
+                return c - '0' + 52;
+            if (c == '+')
+                return 62;
+            if (c == '/')
+                return 63;
+            return -1;
+        };
+
+        out.clear();
+        out.reserve(text.size() / 4 * 3);
+        uint32_t bits = 0;
+        int bitCount = 0;
+        for (char c : text)
+        {
+            if (c == '=')
+                break;
+            int value = decodeChar(c);
+            if (value < 0)
+                return false;
+            bits = (bits << 6) | static_cast<uint32_t>(value);
+            bitCount += 6;
+            if (bitCount >= 8)
+            {
+                bitCount -= 8;
+                out.push_back(static_cast<uint8_t>(bits >> bitCount));
+            }
+        }
+        return true;
+    }
+
+    // Relative URIs may have percent escapes (Eg: "my%20mesh.bin")
+    std::string decodeUri(std::string_view uri)
+    {
+        std::string path;
+        path.reserve(uri.size());
+        for (size_t i = 0; i < uri.size(); i++)
+        {
+            if (uri[i] == '%' && i + 2 < uri.size())
+            {
+                path.push_back(static_cast<char>(std::strtol(std::string(uri.substr(i + 1, 2)).c_str(), nullptr, 16)));
+                i += 2;
+            }
+            else
+                path.push_back(uri[i]);
+        }
+        return path;
+    }
+
+    // Decomposes a column major matrix without shear into the node's TRS
+    void decomposeMatrix(const float m[16], engine::gltf::GltfNode& node)
+    {
+        for (int c = 0; c < 3; c++)
+        {
+            node.translation[c] = m[12 + c];
+            node.scale[c] = std::sqrt(m[c * 4] * m[c * 4] + m[c * 4 + 1] * m[c * 4 + 1] + m[c * 4 + 2] * m[c * 4 + 2]);
+        }
+
+        // A mirroring matrix has a negative determinant, the flip goes into the x scale
+        const float det = m[0] * (m[5] * m[10] - m[9] * m[6])
+            - m[4] * (m[1] * m[10] - m[9] * m[2])
+            + m[8] * (m[1] * m[6] - m[5] * m[2]);
+        if (det < 0.0f)
+            node.scale[0] = -node.scale[0];
+
+        float r[3][3];
+        for (int c = 0; c < 3; c++)
+        {
+            for (int row = 0; row < 3; row++)
+                r[row][c] = node.scale[c] != 0.0f ? m[c * 4 + row] / node.scale[c] : 0.0f;
+        }
+
+        float* q = node.rotation;
+        const float trace = r[0][0] + r[1][1] + r[2][2];
+        if (trace > 0.0f)
+        {
+            float s = std::sqrt(trace + 1.0f) * 2.0f;
+            q[3] = 0.25f * s;
+            q[0] = (r[2][1] - r[1][2]) / s;
+            q[1] = (r[0][2] - r[2][0]) / s;
+            q[2] = (r[1][0] - r[0][1]) / s;
+        }
+        else if (r[0][0] > r[1][1] && r[0][0] > r[2][2])
+        {
+            float s = std::sqrt(1.0f + r[0][0] - r[1][1] - r[2][2]) * 2.0f;
+            q[3] = (r[2][1] - r[1][2]) / s;
+            q[0] = 0.25f * s;
+            q[1] = (r[0][1] + r[1][0]) / s;
+            q[2] = (r[0][2] + r[2][0]) / s;
+        }
+        else if (r[1][1] > r[2][2])
+        {
+            float s = std::sqrt(1.0f + r[1][1] - r[0][0] - r[2][2]) * 2.0f;
+            q[3] = (r[0][2] - r[2][0]) / s;
+            q[0] = (r[0][1] + r[1][0]) / s;
+            q[1] = 0.25f * s;
+            q[2] = (r[1][2] + r[2][1]) / s;
+        }
+        else
+        {
+            float s = std::sqrt(1.0f + r[2][2] - r[0][0] - r[1][1]) * 2.0f;
+            q[3] = (r[1][0] - r[0][1]) / s;
+            q[0] = (r[0][2] + r[2][0]) / s;
+            q[1] = (r[1][2] + r[2][1]) / s;
+            q[2] = 0.25f * s;
+        }
+    }
+
+    class Importer
+    {
+    private:
+        std::string m_path;
+        std::string m_directory;
+        engine::MappedFile m_file;
+        JsonDocument m_json;
+        uint32_t m_root = JsonDocument::INVALID_TOKEN;
+        BufferRange m_glbBinary;
+
+        // Storage of the buffers, which are either mapped files or decoded data URIs
+        std::vector<std::unique_ptr<engine::MappedFile>> m_bufferFiles;
+        std::vector<std::vector<uint8_t>> m_bufferData;
+        std::vector<BufferRange> m_buffers;
+        std::vector<BufferRange> m_views;
+        std::vector<Accessor> m_accessors;
+        std::vector<Primitive> m_primitives;
+
+        bool fail(const std::string& message)
+        {
+            std::cerr << "glTF file " << m_path << ": " << message << std::endl;
+            return false;
+        }
+
+        inline uint32_t getIndex(uint32_t object, std::string_view key) const
+        {
+            const double value = m_json.getNumber(object, key, -1.0);
+            return value >= 0.0 ? static_cast<uint32_t>(value) : NO_INDEX;
+        }
+
+        bool loadJson();
+        bool loadBuffers();
+        bool loadViews();
+        bool loadAccessors();
+        bool loadMeshes(engine::gltf::GltfScene& scene);
+        bool loadNodes(engine::gltf::GltfScene& scene);
+        bool decodePrimitive(const Primitive& primitive, engine::MeshData& mesh) const;
+
+    public:
+        explicit Importer(const std::string& path) : m_path{path}
+        {
+            size_t separator = path.find_last_of("/\\");
+            m_directory = separator != std::string::npos ? path.substr(0, separator + 1) : std::string();
+        }
+
+        bool import(engine::gltf::GltfScene& scene, engine::JobSystem* jobSystem);
+    };
+
+    bool Importer::loadJson()
+    {
+        if (!m_file.open(m_path))
+            return fail("can't be opened");
+
+        const uint8_t* data = static_cast<const uint8_t*>(m_file.data());
+        const size_t size = m_file.size();
+        uint32_t magic = 0;
+        if (size >= sizeof(magic))
+            std::memcpy(&magic, data, sizeof(magic));
+        if (magic != GLB_MAGIC)
+            return m_json.parse(reinterpret_cast<const char*>(data), size) ? true : fail("invalid JSON");
+
+        // GLB: 12 byte header, then chunks of { length, type, data } with the JSON first
+        uint32_t header[3];
+        if (size < sizeof(header))
+            return fail("truncated GLB header");
+        std::memcpy(header, data, sizeof(header));
+        if (header[1] != 2)
+            return fail("unsupported GLB version");
+
+        const size_t length = std::min<size_t>(header[2], size);
+        bool hasJson = false;
+        for (size_t offset = sizeof(header); offset + 8 <= length;)
+        {
+            uint32_t chunk[2];
+            std::memcpy(chunk, data + offset, sizeof(chunk));
+            offset += sizeof(chunk);
+            if (chunk[0] > length - offset)
+                return fail("truncated GLB chunk");
+
+            if (chunk[1] == GLB_CHUNK_JSON && !hasJson)
+            {
+                if (!m_json.parse(reinterpret_cast<const char*>(data + offset), chunk[0]))
+                    return fail("invalid JSON chunk");
+                hasJson = true;
+            }
+            else if (chunk[1] == GLB_CHUNK_BIN && !m_glbBinary.data)
+            {
+                m_glbBinary.data = data + offset;
+                m_glbBinary.size = chunk[0];
+            }
+            // Chunks are 4 byte aligned
+            offset += (static_cast<size_t>(chunk[0]) + 3) & ~static_cast<size_t>(3);
+        }
+        return hasJson ? true : fail("missing JSON chunk");
+    }
+
+    bool Importer::loadBuffers()
+    {
+        for (uint32_t buffer : m_json.getElements(m_json.find(m_root, "buffers")))
+        {
+            const size_t byteLength = static_cast<size_t>(m_json.getNumber(buffer, "byteLength", 0.0));
+            const std::string_view uri = m_json.getString(buffer, "uri");
+            BufferRange range;
+
+            if (uri.empty())
+            {
+                // Only the first buffer of a GLB may refer to the binary chunk
+                if (!m_buffers.empty() || !m_glbBinary.data)
+                    return fail("buffer without uri");
+                range = m_glbBinary;
+            }
+            else if (uri.substr(0, 5) == "data:")
+            {
+                const size_t dataStart = uri.find(";base64,");
+                m_bufferData.emplace_back();
+                if (dataStart == std::string_view::npos || !decodeBase64(uri.substr(dataStart + 8), m_bufferData.back()))
+                    return fail("invalid data uri");
+                range.data = m_bufferData.back().data();
+                range.size = m_bufferData.back().size();
+            }
+            else
+            {
+                const std::string bufferPath = m_directory + decodeUri(uri);
+                m_bufferFiles.push_back(std::make_unique<engine::MappedFile>());
+                if (!m_bufferFiles.back()->open(bufferPath))
+                    return fail("can't open buffer " + bufferPath);
+                range.data = static_cast<const uint8_t*>(m_bufferFiles.back()->data());
+                range.size = m_bufferFiles.back()->size();
+            }
+
+            if (range.size < byteLength)
+                return fail("buffer is smaller than its byteLength");
+            range.size = byteLength;
+            m_buffers.push_back(range);
+        }
+        return true;
+    }
+
+    bool Importer::loadViews()
+    {
+        for (uint32_t view : m_json.getElements(m_json.find(m_root, "bufferViews")))
+        {
+            const uint32_t buffer = getIndex(view, "buffer");
+            const size_t offset = static_cast<size_t>(m_json.getNumber(view, "byteOffset", 0.0));
+            const size_t length = static_cast<size_t>(m_json.getNumber(view, "byteLength", 0.0));
+            if (buffer >= m_buffers.size() || offset > m_buffers[buffer].size || length > m_buffers[buffer].size - offset)
+                return fail("buffer view out of range");
+
+            BufferRange range;
+            range.data = m_buffers[buffer].data + offset;
+            range.size = length;
+            range.stride = static_cast<uint32_t>(m_json.getNumber(view, "byteStride", 0.0));
+            m_views.push_back(range);
+        }
+        return true;
+    }
+
+    bool Importer::loadAccessors()
+    {
+        // Checks that count elements of elementSize bytes, stride apart, fit in the view
+        auto fits = [this](uint32_t view, size_t offset, uint32_t count, uint32_t stride, uint32_t elementSize)
+        {
+            if (view >= m_views.size() || count == 0)
+                return view < m_views.size();
+            const size_t size = m_views[view].size;
+            const size_t span = static_cast<size_t>(stride) * (count - 1) + elementSize;
+            return offset <= size && span <= size - offset;
+        };
+
+        for (uint32_t accessorToken : m_json.getElements(m_json.find(m_root, "accessors")))
+        {
+            Accessor accessor;
+            accessor.count = static_cast<uint32_t>(m_json.getNumber(accessorToken, "count", 0.0));
+            accessor.componentType = static_cast<uint32_t>(m_json.getNumber(accessorToken, "componentType", 0.0));
+            accessor.componentCount = getComponentCount(m_json.getString(accessorToken, "type"));
+            accessor.isNormalized = m_json.getBool(m_json.find(accessorToken, "normalized"));
+            const uint32_t componentSize = getComponentSize(accessor.componentType);
+            const uint32_t elementSize = componentSize * accessor.componentCount;
+            // Matrices have padded columns, which isn't needed for mesh data
+            if (elementSize == 0 || accessor.componentCount > 4)
+                return fail("unsupported accessor type");
+
+            const uint32_t view = getIndex(accessorToken, "bufferView");
+            if (view != NO_INDEX)
+            {
+                const size_t offset = static_cast<size_t>(m_json.getNumber(accessorToken, "byteOffset", 0.0));
+                accessor.stride = view < m_views.size() && m_views[view].stride != 0 ? m_views[view].stride : elementSize;
+                if (!fits(view, offset, accessor.count, accessor.stride, elementSize))
+                    return fail("accessor out of range");
+                accessor.data = m_views[view].data + offset;
+            }
+
+            const uint32_t sparse = m_json.find(accessorToken, "sparse");
+            if (sparse != JsonDocument::INVALID_TOKEN)
+            {
+                const uint32_t indices = m_json.find(sparse, "indices");
+                const uint32_t values = m_json.find(sparse, "values");
+                accessor.sparseCount = static_cast<uint32_t>(m_json.getNumber(sparse, "count", 0.0));
+                accessor.sparseIndexType = static_cast<uint32_t>(m_json.getNumber(indices, "componentType", 0.0));
+                const uint32_t indexSize = getComponentSize(accessor.sparseIndexType);
+                const uint32_t indexView = getIndex(indices, "bufferView");
+                const uint32_t valueView = getIndex(values, "bufferView");
+                const size_t indexOffset = static_cast<size_t>(m_json.getNumber(indices, "byteOffset", 0.0));
+                const size_t valueOffset = static_cast<size_t>(m_json.getNumber(values, "byteOffset", 0.0));
+                if (indexSize == 0 || accessor.sparseIndexType == Byte || accessor.sparseIndexType == Short
+                    || !fits(indexView, indexOffset, accessor.sparseCount, indexSize, indexSize)
+                    || !fits(valueView, valueOffset, accessor.sparseCount, elementSize, elementSize))
+                    return fail("sparse accessor out of range");
+                accessor.sparseIndices = m_views[indexView].data + indexOffset;
+                accessor.sparseValues = m_views[valueView].data + valueOffset;
+            }
+            m_accessors.push_back(accessor);
+        }
+        return true;
+    }
+
+    bool Importer::loadMeshes(engine::gltf::GltfScene& scene)
+    {
+        uint32_t skippedCount = 0;
+        for (uint32_t meshToken : m_json.getElements(m_json.find(m_root, "meshes")))
+        {
+            engine::gltf::GltfMesh mesh;
+            mesh.name = std::string(m_json.getString(meshToken, "name"));
+            mesh.firstPrimitive = static_cast<uint32_t>(m_primitives.size());
+
+            for (uint32_t primitiveToken : m_json.getElements(m_json.find(meshToken, "primitives")))
+            {
+                const uint32_t attributes = m_json.find(primitiveToken, "attributes");
+                Primitive primitive;
+                primitive.position = getIndex(attributes, "POSITION");
+                primitive.normal = getIndex(attributes, "NORMAL");
+                primitive.uv = getIndex(attributes, "TEXCOORD_0");
+                primitive.indices = getIndex(primitiveToken, "indices");
+                if (getIndex(primitiveToken, "mode") != NO_INDEX && getIndex(primitiveToken, "mode") != MODE_TRIANGLES)
+                {
+                    skippedCount++;
+                    continue;
+                }
+
+                const uint32_t accessorCount = static_cast<uint32_t>(m_accessors.size());
+                if (primitive.position >= accessorCount
+                    || (primitive.normal != NO_INDEX && primitive.normal >= accessorCount)
+                    || (primitive.uv != NO_INDEX && primitive.uv >= accessorCount)
+                    || (primitive.indices != NO_INDEX && primitive.indices >= accessorCount))
+                    return fail("primitive refers to a missing accessor");
+                m_primitives.push_back(primitive);
+            }
+
+            mesh.primitiveCount = static_cast<uint32_t>(m_primitives.size()) - mesh.firstPrimitive;
+            scene.meshes.push_back(std::move(mesh));
+        }
+
+        if (skippedCount > 0)
+            std::cout << "glTF file " << m_path << ": skipped " << skippedCount << " primitives which aren't triangle lists" << std::endl;
+        return true;
+    }
+
+    bool Importer::loadNodes(engine::gltf::GltfScene& scene)
+    {
+        const std::vector<uint32_t> nodeTokens = m_json.getElements(m_json.find(m_root, "nodes"));
+        const uint32_t nodeCount = static_cast<uint32_t>(nodeTokens.size());
+        std::vector<uint32_t> parents(nodeCount, NO_INDEX);
+        for (uint32_t i = 0; i < nodeCount; i++)
+        {
+            for (uint32_t child : m_json.getElements(m_json.find(nodeTokens[i], "children")))
+            {
+                const uint32_t childIndex = static_cast<uint32_t>(m_json.getNumber(child, 0.0));
+                if (childIndex >= nodeCount || parents[childIndex] != NO_INDEX || childIndex == i)
+                    return fail("node hierarchy isn't a tree");
+                parents[childIndex] = i;
+            }
+        }
+
+        // Roots of the default scene, or every root if the file has no scenes
+        std::vector<uint32_t> order;
+        const std::vector<uint32_t> scenes = m_json.getElements(m_json.find(m_root, "scenes"));
+        if (!scenes.empty())
+        {
+            uint32_t defaultScene = getIndex(m_root, "scene");
+            if (defaultScene >= scenes.size())
+                defaultScene = 0;
+            for (uint32_t root : m_json.getElements(m_json.find(scenes[defaultScene], "nodes")))
+            {
+                const uint32_t rootIndex = static_cast<uint32_t>(m_json.getNumber(root, 0.0));
+                if (rootIndex < nodeCount && parents[rootIndex] == NO_INDEX)
+                    order.push_back(rootIndex);
+            }
+        }
+        else
+        {
+            for (uint32_t i = 0; i < nodeCount; i++)
+            {
+                if (parents[i] == NO_INDEX)
+                    order.push_back(i);
+            }
+        }
+
+        // Breadth first, so parents come before their children
+        std::vector<uint32_t> newIndices(nodeCount, NO_INDEX);
+        for (size_t i = 0; i < order.size(); i++)
+        {
+            // A scene may list the same root twice
+            const uint32_t nodeIndex = order[i];
+            if (newIndices[nodeIndex] != NO_INDEX)
+                continue;
+            const uint32_t node = nodeTokens[nodeIndex];
+            newIndices[nodeIndex] = static_cast<uint32_t>(scene.nodes.size());
+
+            engine::gltf::GltfNode result;
+            result.name = std::string(m_json.getString(node, "name"));
+            result.parent = parents[nodeIndex] != NO_INDEX ? newIndices[parents[nodeIndex]] : NO_INDEX;
+            result.mesh = getIndex(node, "mesh");
+            if (result.mesh != NO_INDEX && result.mesh >= scene.meshes.size())
+                return fail("node refers to a missing mesh");
+
+            const uint32_t matrix = m_json.find(node, "matrix");
+            if (m_json.isType(matrix, JsonType::Array) && m_json.getToken(matrix).size == 16)
+            {
+                float m[16];
+                uint32_t element = m_json.getFirstChild(matrix);
+                for (int k = 0; k < 16; k++, element = m_json.getNext(element))
+                    m[k] = static_cast<float>(m_json.getNumber(element, 0.0));
+                decomposeMatrix(m, result);
+            }
+            else
+            {
+                auto readFloats = [this, node](std::string_view key, float* values, uint32_t count)
+                {
+                    const uint32_t array = m_json.find(node, key);
+                    if (!m_json.isType(array, JsonType::Array) || m_json.getToken(array).size != count)
+                        return;
+                    uint32_t element = m_json.getFirstChild(array);
+                    for (uint32_t k = 0; k < count; k++, element = m_json.getNext(element))
+                        values[k] = static_cast<float>(m_json.getNumber(element, values[k]));
+                };
+                readFloats("translation", result.translation, 3);
+                readFloats("rotation", result.rotation, 4);
+                readFloats("scale", result.scale, 3);
+            }
+            scene.nodes.push_back(std::move(result));
+
+            for (uint32_t child : m_json.getElements(m_json.find(node, "children")))
+                order.push_back(static_cast<uint32_t>(m_json.getNumber(child, 0.0)));
+        }
+        return true;
+    }
+
+    bool Importer::decodePrimitive(const Primitive& primitive, engine::MeshData& mesh) const
+    {
+        const Accessor& positions = m_accessors[primitive.position];
+        const uint32_t vertexCount = positions.count;
+        const uint32_t floatStride = sizeof(engine::MeshVertex) / sizeof(float);
+        mesh.vertices.resize(vertexCount);
+        if (vertexCount == 0)
+            return true;
+
+        decodeAccessor(positions, 3, mesh.vertices[0].position, floatStride);
+        if (primitive.normal != NO_INDEX)
+        {
+            if (m_accessors[primitive.normal].count != vertexCount)
+                return false;
+            decodeAccessor(m_accessors[primitive.normal], 3, mesh.vertices[0].normal, floatStride);
+        }
+        if (primitive.uv != NO_INDEX)
+        {
+            if (m_accessors[primitive.uv].count != vertexCount)
+                return false;
+            decodeAccessor(m_accessors[primitive.uv], 2, mesh.vertices[0].uv, floatStride);
+        }
+
+        if (primitive.indices != NO_INDEX)
+        {
+            const Accessor& indices = m_accessors[primitive.indices];
+            if (indices.componentCount != 1 || indices.sparseCount != 0 || !indices.data
+                || indices.componentType == Byte || indices.componentType == Short || indices.componentType == Float)
+                return false;
+
+            mesh.indices.resize(indices.count - indices.count % 3);
+            if (!decodeIndices(indices, mesh.indices, vertexCount))
+                return false;
+        }
+        else
+        {
+            mesh.indices.resize(vertexCount - vertexCount % 3);
+            for (uint32_t i = 0; i < mesh.indices.size(); i++)
+                mesh.indices[i] = i;
+        }
+
+        if (primitive.normal == NO_INDEX)
+            engine::computeNormals(mesh);
+        return true;
+    }
+
+    bool Importer::import(engine::gltf::GltfScene& scene, engine::JobSystem* jobSystem)
+    {
+        scene = engine::gltf::GltfScene();
+        if (!loadJson())
+            return false;
+
+        m_root = m_json.getRoot();
+        if (!m_json.isType(m_root, JsonType::Object))
+            return fail("root isn't an object");
+        const std::string_view version = m_json.getString(m_json.find(m_root, "asset"), "version");
+        if (version.substr(0, 2) != "2.")
+            return fail("unsupported glTF version");
+
+        if (!loadBuffers() || !loadViews() || !loadAccessors() || !loadMeshes(scene) || !loadNodes(scene))
+            return false;
+
+        // Primitives only read the mapped buffers and write their own mesh
+        const uint32_t primitiveCount = static_cast<uint32_t>(m_primitives.size());
+        scene.primitives.resize(primitiveCount);
+        std::vector<uint8_t> isDecoded(primitiveCount, 0);
+        auto decode = [&](uint32_t begin, uint32_t end)
+        {
+            for (uint32_t i = begin; i < end; i++)
+                isDecoded[i] = decodePrimitive(m_primitives[i], scene.primitives[i]) ? 1 : 0;
+        };
+        if (jobSystem)
+            jobSystem->parallelFor(primitiveCount, 1, decode);
+        else
+            decode(0, primitiveCount);
+
+        for (const engine::gltf::GltfMesh& mesh : scene.meshes)
+        {
+            for (uint32_t i = mesh.firstPrimitive; i < mesh.firstPrimitive + mesh.primitiveCount; i++)
+            {
+                if (!isDecoded[i])
+                    return fail("mesh " + mesh.name + " has invalid indices or attributes");
+                scene.primitives[i].name = mesh.name;
+            }
+        }
+        return true;
+    }
+}
+
+bool engine::gltf::importGltf(const std::string& path, GltfScene& scene, JobSystem* jobSystem)
+{
+    Importer importer(path);
+    if (importer.import(scene, jobSystem))
+        return true;
+    scene = GltfScene();
+    return false;
+}
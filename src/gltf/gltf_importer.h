@@ -0,0 +1,84 @@
+#ifndef GLTF_IMPORTER_H
+#define GLTF_IMPORTER_H
+
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "core/mesh.h"
+
+namespace engine
+{
+    class JobSystem;
+
+    namespace gltf
+    {
+        static const uint32_t NO_INDEX = std::numeric_limits<uint32_t>::max();
+
+        /**
+         * @brief A glTF mesh, made of one or more primitives
+         *
+         * @param firstPrimitive Index of the first primitive in GltfScene::primitives
+         */
+        struct GltfMesh
+        {
+            std::string name;
+            uint32_t firstPrimitive = 0;
+            uint32_t primitiveCount = 0;
+        };
+
+        /**
+         * @brief A node of the imported hierarchy. Matrices of the source are
+         * decomposed, so every node has a local TRS.
+         *
+         * @param parent Index of the parent node, NO_INDEX for roots
+         * @param mesh Index of the mesh in GltfScene::meshes, NO_INDEX if none
+         * @param rotation Quaternion, xyzw
+         */
+        struct GltfNode
+        {
+            std::string name;
+            uint32_t parent = NO_INDEX;
+            uint32_t mesh = NO_INDEX;
+            float translation[3] = { 0.0f, 0.0f, 0.0f };
+            float rotation[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+            float scale[3] = { 1.0f, 1.0f, 1.0f };
+        };
+
+        /**
+         * @brief Result of an import
+         *
+         * @param primitives Triangle primitives converted to the engine vertex layout
+         * @param nodes Nodes of the default scene, parents before children
+         * (Eg: ready to be added to an engine::Scene in order)
+         */
+        struct GltfScene
+        {
+            std::vector<MeshData> primitives;
+            std::vector<GltfMesh> meshes;
+            std::vector<GltfNode> nodes;
+        };
+
+        /**
+         * @brief Imports the meshes and node hierarchy of a glTF 2.0 file
+         * (.gltf with external or data URI buffers, or .glb).
+         *
+         * The file and external buffers are memory mapped, and the JSON is
+         * tokenized in place instead of being loaded into a tree. Accessors,
+         * including normalized integer and sparse ones, are decoded straight
+         * from the mapped buffers into the engine vertex layout, with the
+         * primitives decoded in parallel. Only triangle lists are imported,
+         * and materials, skins and animations are ignored.
+         *
+         * @param path Path of the .gltf or .glb file
+         * @param scene Receives the imported data, replaced
+         * @param jobSystem Job system the primitives are decoded on, nullptr
+         * decodes them on the calling thread
+         * @return false if the file or a buffer can't be read, or the file is invalid
+         */
+        bool importGltf(const std::string& path, GltfScene& scene, JobSystem* jobSystem = nullptr);
+    }
+}
+
+#endif
@@ -0,0 +1,199 @@
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#include "gltf_json.h"
+
+namespace
+{
+    struct OpenContainer
+    {
+        uint32_t token;
+        // Objects alternate between keys and values
+        bool isExpectingKey;
+    };
+
+    inline bool isWhitespace(char c)
+    {
+        return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+    }
+
+    inline bool isDelimiter(char c)
+    {
+        return isWhitespace(c) || c == ',' || c == ':' || c == ']' || c == '}';
+    }
+}
+
+bool engine::gltf::JsonDocument::parse(const char* text, size_t length)
+{
+    m_text = text;
+    m_tokens.clear();
+    if (length >= std::numeric_limits<uint32_t>::max())
+        return false;
+
+    std::vector<OpenContainer> stack;
+    // Adds a value to the innermost container, returns false if a key was expected instead
+    auto addValue = [&](JsonType type, uint32_t start, uint32_t end) -> bool
+    {
+        if (!stack.empty())
+        {
+            OpenContainer& parent = stack.back();
+            JsonToken& parentToken = m_tokens[parent.token];
+            if (parentToken.type == JsonType::Array)
+                parentToken.size++;
+            else if (parent.isExpectingKey)
+            {
+                if (type != JsonType::String)
+                    return false;
+                parentToken.size++;
+                parent.isExpectingKey = false;
+            }
+        }
+        else if (!m_tokens.empty())
+            return false;
+
+        JsonToken token;
+        token.type = type;
+        token.start = start;
+        token.end = end;
+        token.next = static_cast<uint32_t>(m_tokens.size()) + 1;
+        m_tokens.push_back(token);
+        return true;
+    };
+
+    for (uint32_t i = 0; i < length; i++)
+    {
+        const char c = text[i];
+        if (isWhitespace(c) || c == ':')
+            continue;
+
+        if (c == '{' || c == '[')
+        {
+            const JsonType type = c == '{' ? JsonType::Object : JsonType::Array;
+            if (!addValue(type, i, i))
+                return false;
+            stack.push_back(OpenContainer{ static_cast<uint32_t>(m_tokens.size()) - 1, type == JsonType::Object });
+        }
+        else if (c == '}' || c == ']')
+        {
+            const JsonType type = c == '}' ? JsonType::Object : JsonType::Array;
+            if (stack.empty() || m_tokens[stack.back().token].type != type)
+                return false;
+            JsonToken& token = m_tokens[stack.back().token];
+            token.end = i + 1;
+            token.next = static_cast<uint32_t>(m_tokens.size());
+            stack.pop_back();
+        }
+        else if (c == ',')
+        {
+            if (stack.empty())
+                return false;
+            stack.back().isExpectingKey = m_tokens[stack.back().token].type == JsonType::Object;
+        }
+        else if (c == '"')
+        {
+            uint32_t end = i + 1;
+            while (end < length && text[end] != '"')
+                end += text[end] == '\\' ? 2 : 1;
+            if (end >= length || !addValue(JsonType::String, i + 1, end))
+                return false;
+            i = end;
+        }
+        else
+        {
+            if (!(c == '-' || (c >= '0' && c <= '9') || c == 't' || c == 'f' || c == 'n'))
+                return false;
+            uint32_t end = i + 1;
+            while (end < length && !isDelimiter(text[end]))
+                end++;
+            if (!addValue(JsonType::Primitive, i, end))
+                return false;
+            i = end - 1;
+        }
+    }
+    return stack.empty() && !m_tokens.empty();
+}
+
+uint32_t engine::gltf::JsonDocument::find(uint32_t object, std::string_view key) const
+{
+    if (!isType(object, JsonType::Object))
+        return INVALID_TOKEN;
+
+    uint32_t member = getFirstChild(object);
+    for (uint32_t i = 0; i < m_tokens[object].size; i++)
+    {
+        if (getString(member) == key)
+            return member + 1;
+        member = m_tokens[member + 1].next;
+    }
+    return INVALID_TOKEN;
+}
+
+uint32_t engine::gltf::JsonDocument::at(uint32_t array, uint32_t index) const
+{
+    if (!isType(array, JsonType::Array) || index >= m_tokens[array].size)
+        return INVALID_TOKEN;
+
+    uint32_t element = getFirstChild(array);
+    for (uint32_t i = 0; i < index; i++)
+        element = m_tokens[element].next;
+    return element;
+}
+
+std::vector<uint32_t> engine::gltf::JsonDocument::getElements(uint32_t array) const
+{
+    std::vector<uint32_t> elements;
+    if (!isType(array, JsonType::Array))
+        return elements;
+
+    elements.reserve(m_tokens[array].size);
+    uint32_t element = getFirstChild(array);
+    for (uint32_t i = 0; i < m_tokens[array].size; i++)
+    {
+        elements.push_back(element);
+        element = m_tokens[element].next;
+    }
+    return elements;
+}
+
+std::string_view engine::gltf::JsonDocument::getString(uint32_t token) const
+{
+    if (!isType(token, JsonType::String))
+        return std::string_view();
+    return std::string_view(m_text + m_tokens[token].start, m_tokens[token].end - m_tokens[token].start);
+}
+
+double engine::gltf::JsonDocument::getNumber(uint32_t token, double defaultValue) const
+{
+    if (!isType(token, JsonType::Primitive))
+        return defaultValue;
+
+    // The text isn't null terminated, so the number is copied out first
+    char buffer[64];
+    const JsonToken& t = m_tokens[token];
+    const size_t length = std::min<size_t>(t.end - t.start, sizeof(buffer) - 1);
+    std::memcpy(buffer, m_text + t.start, length);
+    buffer[length] = '\0';
+
+    char* end;
+    double value = std::strtod(buffer, &end);
+    return end != buffer ? value : defaultValue;
+}
+
+bool engine::gltf::JsonDocument::getBool(uint32_t token, bool defaultValue) const
+{
+    if (!isType(token, JsonType::Primitive))
+        return defaultValue;
+    const char c = m_text[m_tokens[token].start];
+    return c == 't' ? true : (c == 'f' ? false : defaultValue);
+}
+
+double engine::gltf::JsonDocument::getNumber(uint32_t object, std::string_view key, double defaultValue) const
+{
+    return getNumber(find(object, key), defaultValue);
+}
+
+std::string_view engine::gltf::JsonDocument::getString(uint32_t object, std::string_view key) const
+{
+    return getString(find(object, key));
+}
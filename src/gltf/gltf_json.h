@@ -0,0 +1,115 @@
+#ifndef GLTF_JSON_H
+#define GLTF_JSON_H
+
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace engine
+{
+    namespace gltf
+    {
+        enum class JsonType : uint8_t
+        {
+            Object = 0,
+            Array,
+            String,
+            // Number, true, false or null
+            Primitive
+        };
+
+        /**
+         * @brief A value of the document. Tokens only refer to ranges of the
+         * source text, nothing is copied or converted until it is read.
+         *
+         * @param start Offset of the first character, past the quote for strings
+         * @param end Offset past the last character, before the quote for strings
+         * @param size Number of members of objects and elements of arrays
+         * @param next Index of the token following this value and all of its children
+         */
+        struct JsonToken
+        {
+            JsonType type = JsonType::Primitive;
+            uint32_t start = 0;
+            uint32_t end = 0;
+            uint32_t size = 0;
+            uint32_t next = 0;
+        };
+
+        /**
+         * @brief Flat JSON tokenizer. parse() makes one pass over the text and
+         * stores a token per value, in document order, so a value's children
+         * follow it and next skips over them. Object members are stored as
+         * a string token for the key followed by the value.
+         *
+         * This keeps memory to 20 bytes per value instead of a tree of nodes
+         * and strings, and the text has to outlive the document (Eg: a
+         * mapped file). Escapes in strings are not decoded.
+         */
+        class JsonDocument
+        {
+        public:
+            static const uint32_t INVALID_TOKEN = std::numeric_limits<uint32_t>::max();
+
+        private:
+            const char* m_text = nullptr;
+            std::vector<JsonToken> m_tokens;
+
+        public:
+            /**
+             * @brief Tokenizes the text
+             *
+             * @param text JSON text, doesn't have to be null terminated
+             * @param length Length of the text in bytes
+             * @return false if the text isn't valid JSON
+             */
+            bool parse(const char* text, size_t length);
+
+            // Value of a member of an object, INVALID_TOKEN if missing
+            uint32_t find(uint32_t object, std::string_view key) const;
+            // Element of an array, INVALID_TOKEN if out of range. Linear in the index.
+            uint32_t at(uint32_t array, uint32_t index) const;
+            // Elements of an array, for indexing them in constant time
+            std::vector<uint32_t> getElements(uint32_t array) const;
+
+            // First child of an object or array, continue with getNext()
+            inline uint32_t getFirstChild(uint32_t token) const
+            {
+                return token + 1;
+            }
+
+            inline uint32_t getNext(uint32_t token) const
+            {
+                return m_tokens[token].next;
+            }
+
+            std::string_view getString(uint32_t token) const;
+            double getNumber(uint32_t token, double defaultValue = 0.0) const;
+            bool getBool(uint32_t token, bool defaultValue = false) const;
+
+            // Shortcuts which return defaultValue if the member is missing
+            double getNumber(uint32_t object, std::string_view key, double defaultValue) const;
+            std::string_view getString(uint32_t object, std::string_view key) const;
+
+            inline const JsonToken& getToken(uint32_t token) const
+            {
+                return m_tokens[token];
+            }
+
+            inline bool isType(uint32_t token, JsonType type) const
+            {
+                return token < m_tokens.size() && m_tokens[token].type == type;
+            }
+
+            // The root value is the first token
+            inline uint32_t getRoot() const
+            {
+                return m_tokens.empty() ? INVALID_TOKEN : 0;
+            }
+        };
+    }
+}
+
+#endif
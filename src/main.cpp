@@ -1,5 +1,8 @@
 #include <iostream>
 #include <string>
+#include <cstring>
+#include <cstdlib>
+#include <vector>
 
 #include <main.h>
 #include <vulkan_renderer.h>
@@ -10,12 +13,130 @@ using engine::vulkan::VulkanRenderer;
 
 int main(int argc, char **argv)
 {
+  // --headless renders offscreen without a window or display.
+  // --frames <n> stops after n frames (Defaults to 1000 in headless mode).
+  // --no-validation disables the validation layers (Eg: not installed on CI).
+  // --gpu-trace <file> writes the GPU timings of the last frames as a Chrome trace.
+  // --cpu-trace <file> writes the CPU zones of the last frames on exit (F12 writes one any time).
+  // --pipeline-benchmark prints the mesh pipeline creation time with an empty and with the loaded
+  //   pipeline cache. Eg: "--headless --frames 1 --pipeline-benchmark", twice, so that the second run
+  //   starts from the cache file the first one saved.
+  // --frames-in-flight <n> frames recorded while the GPU renders the previous ones (Defaults to 2).
+  //   The frame timings printed on exit show how much CPU recording overlaps GPU work.
+  // --frame-benchmark renders headless with 1, 2 and 3 frames in flight, one run each with the
+  //   other options, and prints a table of the frame time percentiles of the runs.
+  //   Eg: "--frame-benchmark --no-validation --scene s.mesh --instances 100000 --frames 2000".
+  // --scene <file.mesh> draws the meshes of a file written by MeshConverter.
+  // --instances <n> number of instances of the scene meshes, laid out on a grid (Defaults to 1).
+  // --draw-path <cpu|gpu|meshlets> culls the instances on the CPU and records a draw per visible one,
+  //   culls them in a compute pass and draws them indirectly (Defaults to gpu if supported), or
+  //   culls the meshlets of the visible instances too (with task shaders if the GPU has mesh shaders).
+  //   Eg: compare the frame timings of "--headless --scene s.mesh --instances 1000000 --draw-path cpu"
+  //   and "... --draw-path gpu", from 10000 to 1000000 instances. For a scene converted with
+  //   MeshConverter --meshlets, "... --draw-path meshlets" also prints the culled triangles per frame.
+  // --threads <n> threads recording the draws, including the render thread (Defaults to one per hardware thread).
+  //   Eg: "--headless --scene s.mesh --instances 100000 --draw-path cpu --threads 1", then 2, 4... up to
+  //   the core count, shows how the CPU recording time scales. EngineBenchmark "recording" sweeps the
+  //   same slicing without a GPU.
+  bool headless = false;
+  bool enableValidation = true;
+  uint32_t maxFrames = 0;
+  std::string gpuTraceFile;
+  std::string cpuTraceFile;
+  uint32_t framesInFlight = 2;
+  std::string sceneFile;
+  uint32_t instanceCount = 1;
+  uint32_t threadCount = 0;
+  bool pipelineBenchmark = false;
+  bool frameBenchmark = false;
+  engine::vulkan::DrawPath drawPath = engine::vulkan::DrawPath::GpuCulled;
+  for (int i = 1; i < argc; i++)
+  {
+    if (strcmp(argv[i], "--headless") == 0)
+      headless = true;
+    else if (strcmp(argv[i], "--no-validation") == 0)
+      enableValidation = false;
+    else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+      maxFrames = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+    else if (strcmp(argv[i], "--gpu-trace") == 0 && i + 1 < argc)
+      gpuTraceFile = argv[++i];
+    else if (strcmp(argv[i], "--cpu-trace") == 0 && i + 1 < argc)
+      cpuTraceFile = argv[++i];
+    else if (strcmp(argv[i], "--frame-benchmark") == 0)
+      frameBenchmark = true;
+    else if (strcmp(argv[i], "--pipeline-benchmark") == 0)
+      pipelineBenchmark = true;
+    else if (strcmp(argv[i], "--frames-in-flight") == 0 && i + 1 < argc)
+      framesInFlight = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+    else if (strcmp(argv[i], "--scene") == 0 && i + 1 < argc)
+      sceneFile = argv[++i];
+    else if (strcmp(argv[i], "--instances") == 0 && i + 1 < argc)
+      instanceCount = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+    else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+      threadCount = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+    else if (strcmp(argv[i], "--draw-path") == 0 && i + 1 < argc)
+    {
+      const char *path = argv[++i];
+      if (strcmp(path, "cpu") == 0)
+        drawPath = engine::vulkan::DrawPath::Cpu;
+      else if (strcmp(path, "meshlets") == 0)
+        drawPath = engine::vulkan::DrawPath::Meshlets;
+      else
+        drawPath = engine::vulkan::DrawPath::GpuCulled;
+    }
+  }
+  if (frameBenchmark)
+    headless = true;
+  if (headless && maxFrames == 0)
+    maxFrames = 1000;
+
   const int VERSION[3] = {APP_VERSION_MAJOR, APP_VERSION_MINOR, APP_VERSION_PATCH};
-  Window window(APP_NAME);
-  VulkanRenderer renderer(window, APP_NAME, VERSION, true);
-  renderer.run();
+  auto render = [&](uint32_t framesInFlight, engine::vulkan::FrameTimeSummary &summary)
+  {
+    Window window(APP_NAME, 1280, 720, headless);
+    VulkanRenderer renderer(window, APP_NAME, VERSION, enableValidation, framesInFlight, threadCount);
+    renderer.setMaxFrames(maxFrames);
+    renderer.setGpuTraceFile(gpuTraceFile);
+    renderer.setDrawPath(drawPath);
+    renderer.setPipelineBenchmarkEnabled(pipelineBenchmark);
+    if (!sceneFile.empty())
+      renderer.setSceneFile(sceneFile, instanceCount);
+    if (!cpuTraceFile.empty())
+      renderer.setCpuTraceFile(cpuTraceFile);
+    const bool isRun = renderer.run();
+    summary = renderer.getFrameTimeSummary();
+    return isRun;
+  };
+
+  if (frameBenchmark)
+  {
+    std::vector<engine::vulkan::FrameTimeSummary> summaries;
+    for (uint32_t count = 1; count <= 3; count++)
+    {
+      engine::vulkan::FrameTimeSummary summary;
+      if (!render(count, summary))
+        return 1;
+      summaries.push_back(summary);
+    }
+
+    std::cout << std::endl
+              << "Frames in flight | frames | average ms | p50 ms | p90 ms | p99 ms | max ms" << std::endl;
+    for (const engine::vulkan::FrameTimeSummary &summary : summaries)
+    {
+      std::cout << summary.framesInFlight << " | " << summary.frameCount << " | " << summary.averageMs << " | "
+                << summary.p50Ms << " | " << summary.p90Ms << " | " << summary.p99Ms << " | " << summary.maxMs
+                << std::endl;
+    }
+    return 0;
+  }
+
+  engine::vulkan::FrameTimeSummary summary;
+  render(framesInFlight, summary);
 
-  std::cout << "Press any key to continue..." << std::endl;
-  std::cin.get();
+  if (!headless)
+  {
+    std::cout << "Press any key to continue..." << std::endl;
+    std::cin.get();
+  }
   return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,62 @@
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+#include "chrome_trace.h"
+
+static void writeJsonString(std::ofstream& file, const std::string& str)
+{
+    file << '"';
+    for (char c : str)
+    {
+        if (c == '"' || c == '\\')
+            file << '\\' << c;
+        else if (static_cast<unsigned char>(c) < 0x20)
+            file << ' ';
+        else
+            file << c;
+    }
+    file << '"';
+}
+
+bool engine::writeChromeTrace(const std::string& path,
+    const std::vector<TraceEvent>& events,
+    const std::vector<std::string>& threadNames)
+{
+    std::ofstream file(path, std::ios::trunc);
+    if (!file.is_open())
+    {
+        std::cerr << "Failed to write trace file: " << path << std::endl;
+        return false;
+    }
+
+    file << std::fixed << std::setprecision(3);
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+    bool isFirst = true;
+    for (uint32_t t = 0; t < threadNames.size(); t++)
+    {
+        file << (isFirst ? "\n" : ",\n");
+        file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << t << ",\"args\":{\"name\":";
+        writeJsonString(file, threadNames[t]);
+        file << "}}";
+        isFirst = false;
+    }
+
+    for (const TraceEvent& e : events)
+    {
+        file << (isFirst ? "\n" : ",\n");
+        file << "{\"name\":";
+        writeJsonString(file, e.name);
+        file << ",\"cat\":";
+        writeJsonString(file, e.category);
+        file << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << e.threadId
+             << ",\"ts\":" << e.startUs
+             << ",\"dur\":" << e.durationUs
+             << ",\"args\":{\"frame\":" << e.frameNumber << "}}";
+        isFirst = false;
+    }
+
+    file << "\n]}\n";
+    return true;
+}
@@ -0,0 +1,45 @@
+#ifndef CHROME_TRACE_H
+#define CHROME_TRACE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace engine
+{
+    /**
+     * @brief A complete ("X") event of the Chrome trace event format, which is
+     * opened by chrome://tracing and https://ui.perfetto.dev
+     *
+     * @param name Name of the zone
+     * @param category Comma separated categories (Eg: "gpu")
+     * @param threadId Track the event is drawn on
+     * @param startUs Start time in microseconds
+     * @param durationUs Duration in microseconds
+     * @param frameNumber Stored as an argument of the event
+     */
+    struct TraceEvent
+    {
+        std::string name;
+        std::string category;
+        uint32_t threadId = 0;
+        double startUs = 0.0;
+        double durationUs = 0.0;
+        uint64_t frameNumber = 0;
+    };
+
+    /**
+     * @brief Writes events as a Chrome trace JSON file
+     *
+     * @param path Path of the JSON file
+     * @param events Events to write, in any order
+     * @param threadNames Optional names of the tracks, indexed by threadId
+     * @return true if the file was written
+     * @return false if the file couldn't be opened
+     */
+    bool writeChromeTrace(const std::string& path,
+        const std::vector<TraceEvent>& events,
+        const std::vector<std::string>& threadNames = {});
+}
+
+#endif
@@ -0,0 +1,455 @@
+#include <algorithm>
+#include <cmath>
+
+#include "culling.h"
+#include "simd.h"
+
+engine::Frustum engine::Frustum::fromMatrix(const float viewProjection[16])
+{
+    // Rows of the column major matrix
+    auto row = [&](int r, int c)
+    {
+        return viewProjection[c * 4 + r];
+    };
+
+    Frustum frustum;
+    for (int c = 0; c < 4; c++)
+    {
+        frustum.planes[Left][c] = row(3, c) + row(0, c);
+        frustum.planes[Right][c] = row(3, c) - row(0, c);
+        frustum.planes[Bottom][c] = row(3, c) + row(1, c);
+        frustum.planes[Top][c] = row(3, c) - row(1, c);
+        // Vulkan clip space depth is [0, w]
+        frustum.planes[Near][c] = row(2, c);
+        frustum.planes[Far][c] = row(3, c) - row(2, c);
+    }
+
+    // Normalized planes give distances, which the radius and extents are compared to
+    for (int p = 0; p < Count; p++)
+    {
+        float* plane = frustum.planes[p];
+        float length = std::sqrt(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+        if (length > 0.0f)
+        {
+            for (int c = 0; c < 4; c++)
+                plane[c] /= length;
+        }
+    }
+    return frustum;
+}
+
+uint32_t engine::SphereBounds::add(float x, float y, float z, float r)
+{
+    centerX.push_back(x);
+    centerY.push_back(y);
+    centerZ.push_back(z);
+    radius.push_back(r);
+    return size() - 1;
+}
+
+void engine::SphereBounds::set(uint32_t index, float x, float y, float z, float r)
+{
+    centerX[index] = x;
+    centerY[index] = y;
+    centerZ[index] = z;
+    radius[index] = r;
+}
+
+void engine::SphereBounds::reserve(uint32_t count)
+{
+    centerX.reserve(count);
+    centerY.reserve(count);
+    centerZ.reserve(count);
+    radius.reserve(count);
+}
+
+void engine::SphereBounds::clear()
+{
+    centerX.clear();
+    centerY.clear();
+    centerZ.clear();
+    radius.clear();
+}
+
+uint32_t engine::AabbBounds::add(const float min[3], const float max[3])
+{
+    centerX.push_back(0.0f);
+    centerY.push_back(0.0f);
+    centerZ.push_back(0.0f);
+    extentX.push_back(0.0f);
+    extentY.push_back(0.0f);
+    extentZ.push_back(0.0f);
+    set(size() - 1, min, max);
+    return size() - 1;
+}
+
+void engine::AabbBounds::set(uint32_t index, const float min[3], const float max[3])
+{
+    centerX[index] = (min[0] + max[0]) * 0.5f;
+    centerY[index] = (min[1] + max[1]) * 0.5f;
+    centerZ[index] = (min[2] + max[2]) * 0.5f;
+    extentX[index] = (max[0] - min[0]) * 0.5f;
+    extentY[index] = (max[1] - min[1]) * 0.5f;
+    extentZ[index] = (max[2] - min[2]) * 0.5f;
+}
+
+void engine::AabbBounds::reserve(uint32_t count)
+{
+    centerX.reserve(count);
+    centerY.reserve(count);
+    centerZ.reserve(count);
+    extentX.reserve(count);
+    extentY.reserve(count);
+    extentZ.reserve(count);
+}
+
+void engine::AabbBounds::clear()
+{
+    centerX.clear();
+    centerY.clear();
+    centerZ.clear();
+    extentX.clear();
+    extentY.clear();
+    extentZ.clear();
+}
+
+engine::CullingPath engine::getBestCullingPath()
+{
+#if defined(ENGINE_SIMD_AVX2)
+    return CullingPath::Avx2;
+#elif defined(ENGINE_SIMD_SSE2)
+    return CullingPath::Sse;
+#else
+    return CullingPath::Scalar;
+#endif
+}
+
+// Kernels test objects [i, end) and append the visible indices to out. Each
+// returns the number of indices written. The SIMD kernels stop at the last
+// full group of 4 or 8 objects and leave the rest to a narrower kernel.
+
+namespace
+{
+    using engine::Frustum;
+
+    // Sphere is visible if its center is less than radius behind every plane
+    inline bool isSphereVisible(const Frustum& f, float x, float y, float z, float r)
+    {
+        bool visible = true;
+        for (int p = 0; p < Frustum::Count; p++)
+            visible &= f.planes[p][0] * x + f.planes[p][1] * y + f.planes[p][2] * z + f.planes[p][3] >= -r;
+        return visible;
+    }
+
+    // Box is visible if its center is less than its extent projected on the
+    // plane normal behind every plane
+    inline bool isAabbVisible(const Frustum& f, float x, float y, float z, float ex, float ey, float ez)
+    {
+        bool visible = true;
+        for (int p = 0; p < Frustum::Count; p++)
+        {
+            const float* n = f.planes[p];
+            float r = std::fabs(n[0]) * ex + std::fabs(n[1]) * ey + std::fabs(n[2]) * ez;
+            visible &= n[0] * x + n[1] * y + n[2] * z + n[3] >= -r;
+        }
+        return visible;
+    }
+
+    uint32_t cullSpheresScalar(const Frustum& f, const engine::SphereBounds& b, uint32_t& i, uint32_t end, uint32_t* out)
+    {
+        uint32_t count = 0;
+        for (; i < end; i++)
+        {
+            // Branchless write, the index is overwritten if the sphere isn't visible
+            out[count] = i;
+            count += isSphereVisible(f, b.centerX[i], b.centerY[i], b.centerZ[i], b.radius[i]) ? 1 : 0;
+        }
+        return count;
+    }
+
+    uint32_t cullAabbsScalar(const Frustum& f, const engine::AabbBounds& b, uint32_t& i, uint32_t end, uint32_t* out)
+    {
+        uint32_t count = 0;
+        for (; i < end; i++)
+        {
+            out[count] = i;
+            count += isAabbVisible(f, b.centerX[i], b.centerY[i], b.centerZ[i], b.extentX[i], b.extentY[i], b.extentZ[i]) ? 1 : 0;
+        }
+        return count;
+    }
+
+    // Writes the indices of the set bits of mask, offset by base
+    inline uint32_t writeVisible(uint32_t mask, uint32_t base, uint32_t* out)
+    {
+        uint32_t count = 0;
+        while (mask)
+        {
+            out[count++] = base + engine::countTrailingZeros(mask);
+            mask &= mask - 1;
+        }
+        return count;
+    }
+
+#if defined(ENGINE_SIMD_SSE2)
+    uint32_t cullSpheresSse(const Frustum& f, const engine::SphereBounds& b, uint32_t& i, uint32_t end, uint32_t* out)
+    {
+        __m128 planes[Frustum::Count][4];
+        for (int p = 0; p < Frustum::Count; p++)
+            for (int c = 0; c < 4; c++)
+                planes[p][c] = _mm_set1_ps(f.planes[p][c]);
+
+        uint32_t count = 0;
+        uint32_t j = i;
+        for (; j + 4 <= end; j += 4)
+        {
+            __m128 x = _mm_loadu_ps(&b.centerX[j]);
+            __m128 y = _mm_loadu_ps(&b.centerY[j]);
+            __m128 z = _mm_loadu_ps(&b.centerZ[j]);
+            __m128 negR = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&b.radius[j]));
+
+            __m128 visible = _mm_castsi128_ps(_mm_set1_epi32(-1));
+            for (int p = 0; p < Frustum::Count; p++)
+            {
+                __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planes[p][0], x), _mm_mul_ps(planes[p][1], y)),
+                    _mm_add_ps(_mm_mul_ps(planes[p][2], z), planes[p][3]));
+                visible = _mm_and_ps(visible, _mm_cmpge_ps(d, negR));
+            }
+            count += writeVisible(static_cast<uint32_t>(_mm_movemask_ps(visible)), j, out + count);
+        }
+        i = j;
+        return count;
+    }
+
+    uint32_t cullAabbsSse(const Frustum& f, const engine::AabbBounds& b, uint32_t& i, uint32_t end, uint32_t* out)
+    {
+        __m128 planes[Frustum::Count][4];
+        __m128 absNormals[Frustum::Count][3];
+        for (int p = 0; p < Frustum::Count; p++)
+        {
+            for (int c = 0; c < 4; c++)
+                planes[p][c] = _mm_set1_ps(f.planes[p][c]);
+            for (int c = 0; c < 3; c++)
+                absNormals[p][c] = _mm_set1_ps(std::fabs(f.planes[p][c]));
+        }
+
+        uint32_t count = 0;
+        uint32_t j = i;
+        for (; j + 4 <= end; j += 4)
+        {
+            __m128 x = _mm_loadu_ps(&b.centerX[j]);
+            __m128 y = _mm_loadu_ps(&b.centerY[j]);
+            __m128 z = _mm_loadu_ps(&b.centerZ[j]);
+            __m128 ex = _mm_loadu_ps(&b.extentX[j]);
+            __m128 ey = _mm_loadu_ps(&b.extentY[j]);
+            __m128 ez = _mm_loadu_ps(&b.extentZ[j]);
+
+            __m128 visible = _mm_castsi128_ps(_mm_set1_epi32(-1));
+            for (int p = 0; p < Frustum::Count; p++)
+            {
+                __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planes[p][0], x), _mm_mul_ps(planes[p][1], y)),
+                    _mm_add_ps(_mm_mul_ps(planes[p][2], z), planes[p][3]));
+                __m128 r = _mm_add_ps(_mm_add_ps(_mm_mul_ps(absNormals[p][0], ex), _mm_mul_ps(absNormals[p][1], ey)),
+                    _mm_mul_ps(absNormals[p][2], ez));
+                visible = _mm_and_ps(visible, _mm_cmpge_ps(_mm_add_ps(d, r), _mm_setzero_ps()));
+            }
+            count += writeVisible(static_cast<uint32_t>(_mm_movemask_ps(visible)), j, out + count);
+        }
+        i = j;
+        return count;
+    }
+#endif
+
+#if defined(ENGINE_SIMD_AVX2)
+    uint32_t cullSpheresAvx2(const Frustum& f, const engine::SphereBounds& b, uint32_t& i, uint32_t end, uint32_t* out)
+    {
+        __m256 planes[Frustum::Count][4];
+        for (int p = 0; p < Frustum::Count; p++)
+            for (int c = 0; c < 4; c++)
+                planes[p][c] = _mm256_set1_ps(f.planes[p][c]);
+
+        uint32_t count = 0;
+        uint32_t j = i;
+        for (; j + 8 <= end; j += 8)
+        {
+            __m256 x = _mm256_loadu_ps(&b.centerX[j]);
+            __m256 y = _mm256_loadu_ps(&b.centerY[j]);
+            __m256 z = _mm256_loadu_ps(&b.centerZ[j]);
+            __m256 negR = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(&b.radius[j]));
+
+            __m256 visible = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+            for (int p = 0; p < Frustum::Count; p++)
+            {
+                __m256 d = _mm256_fmadd_ps(planes[p][0], x,
+                    _mm256_fmadd_ps(planes[p][1], y, _mm256_fmadd_ps(planes[p][2], z, planes[p][3])));
+                visible = _mm256_and_ps(visible, _mm256_cmp_ps(d, negR, _CMP_GE_OQ));
+            }
+            count += writeVisible(static_cast<uint32_t>(_mm256_movemask_ps(visible)), j, out + count);
+        }
+        i = j;
+        return count;
+    }
+
+    uint32_t cullAabbsAvx2(const Frustum& f, const engine::AabbBounds& b, uint32_t& i, uint32_t end, uint32_t* out)
+    {
+        __m256 planes[Frustum::Count][4];
+        __m256 absNormals[Frustum::Count][3];
+        for (int p = 0; p < Frustum::Count; p++)
+        {
+            for (int c = 0; c < 4; c++)
+                planes[p][c] = _mm256_set1_ps(f.planes[p][c]);
+            for (int c = 0; c < 3; c++)
+                absNormals[p][c] = _mm256_set1_ps(std::fabs(f.planes[p][c]));
+        }
+
+        uint32_t count = 0;
+        uint32_t j = i;
+        for (; j + 8 <= end; j += 8)
+        {
+            __m256 x = _mm256_loadu_ps(&b.centerX[j]);
+            __m256 y = _mm256_loadu_ps(&b.centerY[j]);
+            __m256 z = _mm256_loadu_ps(&b.centerZ[j]);
+            __m256 ex = _mm256_loadu_ps(&b.extentX[j]);
+            __m256 ey = _mm256_loadu_ps(&b.extentY[j]);
+            __m256 ez = _mm256_loadu_ps(&b.extentZ[j]);
+
+            __m256 visible = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+            for (int p = 0; p < Frustum::Count; p++)
+            {
+                // Distance plus projected extent, which has to be positive
+                __m256 r = _mm256_fmadd_ps(absNormals[p][0], ex,
+                    _mm256_fmadd_ps(absNormals[p][1], ey, _mm256_mul_ps(absNormals[p][2], ez)));
+                __m256 d = _mm256_fmadd_ps(planes[p][0], x,
+                    _mm256_fmadd_ps(planes[p][1], y, _mm256_fmadd_ps(planes[p][2], z, _mm256_add_ps(planes[p][3], r))));
+                visible = _mm256_and_ps(visible, _mm256_cmp_ps(d, _mm256_setzero_ps(), _CMP_GE_OQ));
+            }
+            count += writeVisible(static_cast<uint32_t>(_mm256_movemask_ps(visible)), j, out + count);
+        }
+        i = j;
+        return count;
+    }
+#endif
+
+    template <typename Bounds, typename ScalarFunc, typename SseFunc, typename Avx2Func>
+    uint32_t cull(const Frustum& frustum,
+        const Bounds& bounds,
+        std::vector<uint32_t>& visible,
+        uint32_t first,
+        uint32_t count,
+        engine::CullingPath path,
+        ScalarFunc scalar,
+        SseFunc sse,
+        Avx2Func avx2)
+    {
+        first = std::min(first, bounds.size());
+        const uint32_t end = first + std::min(count, bounds.size() - first);
+        if (path == engine::CullingPath::Best)
+            path = engine::getBestCullingPath();
+
+        // Sized for everything visible, shrunk to the visible count at the end
+        visible.resize(end - first);
+        uint32_t* out = visible.data();
+        uint32_t visibleCount = 0;
+        uint32_t i = first;
+        if (path == engine::CullingPath::Avx2)
+            visibleCount += avx2(frustum, bounds, i, end, out + visibleCount);
+        if (path == engine::CullingPath::Avx2 || path == engine::CullingPath::Sse)
+            visibleCount += sse(frustum, bounds, i, end, out + visibleCount);
+        visibleCount += scalar(frustum, bounds, i, end, out + visibleCount);
+
+        visible.resize(visibleCount);
+        return visibleCount;
+    }
+
+    // Stands in for the kernels which weren't compiled in
+    template <typename Bounds>
+    uint32_t skipKernel(const Frustum&, const Bounds&, uint32_t&, uint32_t, uint32_t*)
+    {
+        return 0;
+    }
+}
+
+uint32_t engine::cullSpheres(const Frustum& frustum,
+    const SphereBounds& bounds,
+    std::vector<uint32_t>& visible,
+    uint32_t first,
+    uint32_t count,
+    CullingPath path)
+{
+    return cull(frustum, bounds, visible, first, count, path,
+        cullSpheresScalar,
+#if defined(ENGINE_SIMD_SSE2)
+        cullSpheresSse,
+#else
+        skipKernel<SphereBounds>,
+#endif
+#if defined(ENGINE_SIMD_AVX2)
+        cullSpheresAvx2);
+#else
+        skipKernel<SphereBounds>);
+#endif
+}
+
+uint32_t engine::cullAabbs(const Frustum& frustum,
+    const AabbBounds& bounds,
+    std::vector<uint32_t>& visible,
+    uint32_t first,
+    uint32_t count,
+    CullingPath path)
+{
+    return cull(frustum, bounds, visible, first, count, path,
+        cullAabbsScalar,
+#if defined(ENGINE_SIMD_SSE2)
+        cullAabbsSse,
+#else
+        skipKernel<AabbBounds>,
+#endif
+#if defined(ENGINE_SIMD_AVX2)
+        cullAabbsAvx2);
+#else
+        skipKernel<AabbBounds>);
+#endif
+}
+
+uint32_t engine::writeIndirectDraws(const Frustum& frustum,
+    const SphereBounds& bounds,
+    const uint32_t* meshIndices,
+    const std::vector<MeshRange>& meshes,
+    bool isCompacted,
+    std::vector<IndirectDraw>& draws,
+    CullingPath path)
+{
+    std::vector<uint32_t> visible;
+    const uint32_t visibleCount = cullSpheres(frustum, bounds, visible, 0, UINT32_MAX, path);
+
+    auto getDraw = [&](uint32_t instance, uint32_t instanceCount)
+    {
+        const MeshRange& mesh = meshes[meshIndices[instance]];
+        IndirectDraw draw;
+        draw.indexCount = mesh.indexCount;
+        draw.instanceCount = instanceCount;
+        draw.firstIndex = mesh.firstIndex;
+        draw.vertexOffset = mesh.vertexOffset;
+        draw.firstInstance = instance;
+        return draw;
+    };
+
+    draws.clear();
+    if (isCompacted)
+    {
+        draws.reserve(visibleCount);
+        for (uint32_t instance : visible)
+            draws.push_back(getDraw(instance, 1));
+        return visibleCount;
+    }
+
+    // Visible indices are ascending, so one pass over them marks the visible draws
+    draws.reserve(bounds.size());
+    uint32_t next = 0;
+    for (uint32_t instance = 0; instance < bounds.size(); instance++)
+    {
+        const bool isVisible = next < visibleCount && visible[next] == instance;
+        next += isVisible ? 1 : 0;
+        draws.push_back(getDraw(instance, isVisible ? 1 : 0));
+    }
+    return visibleCount;
+}
@@ -0,0 +1,173 @@
+#ifndef CULLING_H
+#define CULLING_H
+
+#include <cstdint>
+#include <vector>
+
+namespace engine
+{
+    /**
+     * @brief Six planes pointing inside the frustum, stored as (x, y, z, w)
+     * with normalized xyz. A point p is inside if dot(xyz, p) + w >= 0 for
+     * every plane.
+     */
+    struct Frustum
+    {
+        enum Plane
+        {
+            Left = 0,
+            Right,
+            Bottom,
+            Top,
+            Near,
+            Far,
+            Count
+        };
+
+        float planes[Count][4];
+
+        /**
+         * @brief Extracts the planes of a view projection matrix
+         *
+         * @param viewProjection Column major matrix (Eg: projection * view)
+         * with Vulkan clip space, depth in [0, 1]
+         * @return Frustum of the matrix
+         */
+        static Frustum fromMatrix(const float viewProjection[16]);
+    };
+
+    /**
+     * @brief Bounding spheres stored as separate arrays (structure of arrays)
+     * so the culling kernels load 4 or 8 objects per instruction
+     */
+    struct SphereBounds
+    {
+        std::vector<float> centerX;
+        std::vector<float> centerY;
+        std::vector<float> centerZ;
+        std::vector<float> radius;
+
+        // Returns the index of the sphere
+        uint32_t add(float x, float y, float z, float r);
+        void set(uint32_t index, float x, float y, float z, float r);
+        void reserve(uint32_t count);
+        void clear();
+
+        inline uint32_t size() const
+        {
+            return static_cast<uint32_t>(radius.size());
+        }
+    };
+
+    /**
+     * @brief Axis aligned boxes stored as center and half extents, in separate
+     * arrays. The center and extent form is what the plane test needs.
+     */
+    struct AabbBounds
+    {
+        std::vector<float> centerX;
+        std::vector<float> centerY;
+        std::vector<float> centerZ;
+        std::vector<float> extentX;
+        std::vector<float> extentY;
+        std::vector<float> extentZ;
+
+        // Returns the index of the box given its min and max corners
+        uint32_t add(const float min[3], const float max[3]);
+        void set(uint32_t index, const float min[3], const float max[3]);
+        void reserve(uint32_t count);
+        void clear();
+
+        inline uint32_t size() const
+        {
+            return static_cast<uint32_t>(centerX.size());
+        }
+    };
+
+    /**
+     * @brief Instruction set used by the culling kernels. Best picks the widest
+     * one the build was compiled for, the others exist to compare the paths.
+     */
+    enum class CullingPath
+    {
+        Best = 0,
+        Scalar,
+        Sse,
+        Avx2
+    };
+
+    // Returns the path Best resolves to
+    CullingPath getBestCullingPath();
+
+    /**
+     * @brief Tests the spheres [first, first + count) against the frustum and
+     * writes the indices of the visible ones, in ascending order. Objects
+     * touching a plane are visible.
+     *
+     * @param frustum Frustum to test against
+     * @param bounds Spheres to test
+     * @param visible Receives the indices of the visible spheres, replaced
+     * @param first First sphere to test, lets jobs cull ranges of the same bounds
+     * @param count Number of spheres to test, clamped to the size of bounds
+     * @param path Instruction set to use. Paths which weren't compiled in fall back to narrower ones.
+     * @return number of visible spheres
+     */
+    uint32_t cullSpheres(const Frustum& frustum,
+        const SphereBounds& bounds,
+        std::vector<uint32_t>& visible,
+        uint32_t first = 0,
+        uint32_t count = UINT32_MAX,
+        CullingPath path = CullingPath::Best);
+
+    // Same as cullSpheres() for boxes
+    uint32_t cullAabbs(const Frustum& frustum,
+        const AabbBounds& bounds,
+        std::vector<uint32_t>& visible,
+        uint32_t first = 0,
+        uint32_t count = UINT32_MAX,
+        CullingPath path = CullingPath::Best);
+
+    // Index range of a mesh in the shared index and vertex buffers
+    struct MeshRange
+    {
+        uint32_t indexCount = 0;
+        uint32_t firstIndex = 0;
+        int32_t vertexOffset = 0;
+    };
+
+    // Indexed indirect draw, laid out like VkDrawIndexedIndirectCommand
+    struct IndirectDraw
+    {
+        uint32_t indexCount = 0;
+        uint32_t instanceCount = 0;
+        uint32_t firstIndex = 0;
+        int32_t vertexOffset = 0;
+        uint32_t firstInstance = 0;
+    };
+
+    /**
+     * @brief CPU version of cull_instances.comp, the contract the GPU culling
+     * pass is tested against. Each visible sphere gets a draw of its mesh with
+     * one instance, whose firstInstance is the sphere index.
+     *
+     * @param frustum Frustum to test against
+     * @param bounds Spheres of the instances
+     * @param meshIndices Index in meshes of each instance, bounds.size() of them
+     * @param meshes Index ranges of the meshes
+     * @param isCompacted If true the visible draws are packed at the start in
+     * ascending instance order (the GPU writes them in any order). Otherwise
+     * every instance gets a draw at its own index, culled ones with no instances.
+     * @param draws Receives the draws, replaced
+     * @param path Instruction set of the culling kernel
+     * @return number of visible instances, the draw count of compacted draws
+     */
+    uint32_t writeIndirectDraws(const Frustum& frustum,
+        const SphereBounds& bounds,
+        const uint32_t* meshIndices,
+        const std::vector<MeshRange>& meshes,
+        bool isCompacted,
+        std::vector<IndirectDraw>& draws,
+        CullingPath path = CullingPath::Best);
+}
+
+#endif
@@ -0,0 +1,219 @@
+#ifndef HANDLE_POOL_H
+#define HANDLE_POOL_H
+
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+namespace engine
+{
+    /**
+     * @brief Typed reference to an object of a HandlePool. The index selects
+     * a slot of the pool and the generation tells which object living in that
+     * slot the handle was created for, so handles of removed objects are
+     * detected even after their slot is reused. The tag type only keeps
+     * handles of different pools from being mixed up.
+     */
+    template <typename Tag>
+    struct Handle
+    {
+        static const uint32_t INVALID_INDEX = std::numeric_limits<uint32_t>::max();
+
+        uint32_t index = INVALID_INDEX;
+        // Generations start at 1, so a default constructed handle is never valid
+        uint32_t generation = 0;
+
+        inline bool isValid() const
+        {
+            return generation != 0;
+        }
+
+        inline bool operator==(const Handle& other) const
+        {
+            return index == other.index && generation == other.generation;
+        }
+
+        inline bool operator!=(const Handle& other) const
+        {
+            return !(*this == other);
+        }
+    };
+
+    /**
+     * @brief Stores objects contiguously and hands out generational handles
+     * to them. Lookups go through a sparse slot array to the dense object
+     * array, both O(1). Removing swaps the last object into the hole, so the
+     * live objects always stay packed for iteration and object addresses are
+     * only stable until the next create or remove. Not thread safe.
+     */
+    template <typename T, typename Tag = T>
+    class HandlePool
+    {
+    public:
+        using HandleType = Handle<Tag>;
+
+    private:
+        struct Slot
+        {
+            // Index in the dense arrays while the slot is used, next free slot otherwise
+            uint32_t index = 0;
+            uint32_t generation = 1;
+        };
+
+        static const uint32_t END_OF_LIST = std::numeric_limits<uint32_t>::max();
+
+        std::vector<T> m_objects;
+        // Slot of each dense object, used to fix up the slot of the moved object on removal
+        std::vector<uint32_t> m_objectSlots;
+        std::vector<Slot> m_slots;
+        uint32_t m_freeSlot = END_OF_LIST;
+
+        inline const Slot* getSlot(HandleType handle) const
+        {
+            if (handle.index >= m_slots.size())
+                return nullptr;
+            const Slot& slot = m_slots[handle.index];
+            return slot.generation == handle.generation ? &slot : nullptr;
+        }
+
+    public:
+        HandlePool() = default;
+
+        // Generation a slot gets when its object is removed. Skips 0 on wrap
+        // around, it marks invalid handles.
+        static inline uint32_t getNextGeneration(uint32_t generation)
+        {
+            return generation == std::numeric_limits<uint32_t>::max() ? 1 : generation + 1;
+        }
+
+        void reserve(uint32_t capacity)
+        {
+            m_objects.reserve(capacity);
+            m_objectSlots.reserve(capacity);
+            m_slots.reserve(capacity);
+        }
+
+        HandleType create(T object)
+        {
+            uint32_t slotIndex = m_freeSlot;
+            if (slotIndex != END_OF_LIST)
+                m_freeSlot = m_slots[slotIndex].index;
+            else
+            {
+                slotIndex = static_cast<uint32_t>(m_slots.size());
+                m_slots.push_back(Slot());
+            }
+
+            Slot& slot = m_slots[slotIndex];
+            slot.index = static_cast<uint32_t>(m_objects.size());
+            m_objects.push_back(std::move(object));
+            m_objectSlots.push_back(slotIndex);
+
+            HandleType handle;
+            handle.index = slotIndex;
+            handle.generation = slot.generation;
+            return handle;
+        }
+
+        /**
+         * @brief Removes the object of the handle. Every handle to it becomes stale.
+         *
+         * @param handle Handle of the object
+         * @param removed Receives the removed object if not nullptr, so that
+         * its resources can be released
+         * @return false if the handle is stale
+         */
+        bool remove(HandleType handle, T* removed = nullptr)
+        {
+            if (!getSlot(handle))
+                return false;
+
+            Slot& slot = m_slots[handle.index];
+            const uint32_t index = slot.index;
+            const uint32_t last = static_cast<uint32_t>(m_objects.size()) - 1;
+            if (removed)
+                *removed = std::move(m_objects[index]);
+            if (index != last)
+            {
+                m_objects[index] = std::move(m_objects[last]);
+                m_objectSlots[index] = m_objectSlots[last];
+                m_slots[m_objectSlots[index]].index = index;
+            }
+            m_objects.pop_back();
+            m_objectSlots.pop_back();
+
+            slot.generation = getNextGeneration(slot.generation);
+            slot.index = m_freeSlot;
+            m_freeSlot = handle.index;
+            return true;
+        }
+
+        inline bool isValid(HandleType handle) const
+        {
+            return getSlot(handle) != nullptr;
+        }
+
+        // Returns nullptr if the handle is stale
+        inline T* get(HandleType handle)
+        {
+            const Slot* slot = getSlot(handle);
+            return slot ? &m_objects[slot->index] : nullptr;
+        }
+
+        inline const T* get(HandleType handle) const
+        {
+            const Slot* slot = getSlot(handle);
+            return slot ? &m_objects[slot->index] : nullptr;
+        }
+
+        // Handle of the object at a dense index (Eg: while iterating)
+        inline HandleType getHandle(uint32_t denseIndex) const
+        {
+            HandleType handle;
+            handle.index = m_objectSlots[denseIndex];
+            handle.generation = m_slots[handle.index].generation;
+            return handle;
+        }
+
+        inline uint32_t size() const
+        {
+            return static_cast<uint32_t>(m_objects.size());
+        }
+
+        inline bool empty() const
+        {
+            return m_objects.empty();
+        }
+
+        // Live objects are stored contiguously in [begin, end)
+        inline typename std::vector<T>::iterator begin()
+        {
+            return m_objects.begin();
+        }
+
+        inline typename std::vector<T>::iterator end()
+        {
+            return m_objects.end();
+        }
+
+        inline typename std::vector<T>::const_iterator begin() const
+        {
+            return m_objects.begin();
+        }
+
+        inline typename std::vector<T>::const_iterator end() const
+        {
+            return m_objects.end();
+        }
+
+        // Removes every object. Handles handed out so far become stale.
+        void clear()
+        {
+            while (!empty())
+                remove(getHandle(size() - 1));
+        }
+    };
+}
+
+#endif
@@ -0,0 +1,219 @@
+#include "job_system.h"
+
+// Job system and queue the current thread belongs to. Threads which don't
+// belong to a job system push their jobs round robin into the worker queues.
+static thread_local const engine::JobSystem* t_jobSystem = nullptr;
+static thread_local uint32_t t_queueIndex = 0;
+
+uint32_t engine::JobSystem::getCurrentQueue()
+{
+    if (t_jobSystem == this)
+        return t_queueIndex;
+    return m_nextQueue.fetch_add(1, std::memory_order_relaxed) % getThreadCount();
+}
+
+void engine::JobSystem::push(Job&& job)
+{
+    // Counted before it's published, otherwise a thief can take the job and
+    // decrement the count first, which wraps it around
+    m_queuedJobs.fetch_add(1, std::memory_order_release);
+
+    WorkerQueue& queue = *m_queues[getCurrentQueue()];
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.jobs.push_back(std::move(job));
+    }
+
+    {
+        // Taking the lock makes sure a worker about to sleep sees the new job
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+    }
+    m_wakeCondition.notify_one();
+}
+
+bool engine::JobSystem::pop(uint32_t queueIndex, Job& job)
+{
+    // Owner takes the newest job, it's the most likely to still be in cache
+    WorkerQueue& queue = *m_queues[queueIndex];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.jobs.empty())
+        return false;
+
+    job = std::move(queue.jobs.back());
+    queue.jobs.pop_back();
+    return true;
+}
+
+bool engine::JobSystem::steal(uint32_t queueIndex, Job& job)
+{
+    // Thieves take the oldest job, which is usually the biggest piece of work
+    WorkerQueue& queue = *m_queues[queueIndex];
+    std::unique_lock<std::mutex> lock(queue.mutex, std::try_to_lock);
+    if (!lock.owns_lock() || queue.jobs.empty())
+        return false;
+
+    job = std::move(queue.jobs.front());
+    queue.jobs.pop_front();
+    return true;
+}
+
+bool engine::JobSystem::runNextJob(uint32_t queueIndex)
+{
+    if (m_queuedJobs.load(std::memory_order_acquire) == 0)
+        return false;
+
+    Job job;
+    bool hasJob = pop(queueIndex, job);
+
+    const uint32_t queueCount = getThreadCount();
+    for (uint32_t i = 1; !hasJob && i < queueCount; i++)
+        hasJob = steal((queueIndex + i) % queueCount, job);
+
+    if (!hasJob)
+        return false;
+
+    m_queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+    execute(job);
+    return true;
+}
+
+void engine::JobSystem::execute(Job& job)
+{
+    job.func();
+
+    JobCounter* counter = job.counter;
+    if (!counter)
+        return;
+
+    // Not the last job of the group, nothing else to do
+    uint32_t count = counter->m_count.load(std::memory_order_relaxed);
+    while (count > 1)
+    {
+        if (counter->m_count.compare_exchange_weak(count, count - 1, std::memory_order_acq_rel))
+            return;
+    }
+
+    // Possibly the last job. The final decrement happens under the counter's
+    // lock so that wait() can't return (and the counter be destroyed) before
+    // the continuations have been taken.
+    std::vector<std::pair<JobFunc, JobCounter*>> continuations;
+    {
+        std::lock_guard<std::mutex> lock(counter->m_mutex);
+        if (counter->m_count.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            continuations.swap(counter->m_continuations);
+    }
+
+    // Queue the jobs which depended on the group
+    for (auto& c : continuations)
+        push(Job{std::move(c.first), c.second});
+}
+
+void engine::JobSystem::workerLoop(uint32_t queueIndex)
+{
+    t_jobSystem = this;
+    t_queueIndex = queueIndex;
+
+    while (true)
+    {
+        if (runNextJob(queueIndex))
+            continue;
+
+        std::unique_lock<std::mutex> lock(m_sleepMutex);
+        m_wakeCondition.wait(lock, [this]()
+                             { return m_isStopping || m_queuedJobs.load(std::memory_order_acquire) > 0; });
+        if (m_isStopping)
+            return;
+    }
+}
+
+engine::JobSystem::JobSystem(uint32_t threadCount)
+{
+    if (threadCount == 0)
+        threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+
+    for (uint32_t i = 0; i < threadCount; i++)
+        m_queues.push_back(std::make_unique<WorkerQueue>());
+
+    t_jobSystem = this;
+    t_queueIndex = 0;
+
+    for (uint32_t i = 1; i < threadCount; i++)
+        m_workers.emplace_back(&JobSystem::workerLoop, this, i);
+}
+
+engine::JobSystem::~JobSystem()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+        m_isStopping = true;
+    }
+    m_wakeCondition.notify_all();
+    for (std::thread& t : m_workers)
+        t.join();
+
+    if (t_jobSystem == this)
+        t_jobSystem = nullptr;
+}
+
+void engine::JobSystem::run(JobFunc func, JobCounter* counter)
+{
+    if (counter)
+        counter->m_count.fetch_add(1, std::memory_order_relaxed);
+    push(Job{std::move(func), counter});
+}
+
+void engine::JobSystem::runAfter(JobCounter& dependency, JobFunc func, JobCounter* counter)
+{
+    if (counter)
+        counter->m_count.fetch_add(1, std::memory_order_relaxed);
+
+    {
+        // The last job of the dependency takes the continuations under the same
+        // lock, so the job is either stored before that or queued right here
+        std::lock_guard<std::mutex> lock(dependency.m_mutex);
+        if (!dependency.isDone())
+        {
+            dependency.m_continuations.emplace_back(std::move(func), counter);
+            return;
+        }
+    }
+
+    push(Job{std::move(func), counter});
+}
+
+void engine::JobSystem::parallelFor(uint32_t count,
+    uint32_t batchSize,
+    const std::function<void(uint32_t begin, uint32_t end)>& func)
+{
+    if (count == 0)
+        return;
+
+    if (batchSize == 0)
+        batchSize = std::max((count + getThreadCount() - 1) / getThreadCount(), 1u);
+
+    // The calling thread takes the first batch itself
+    JobCounter counter;
+    for (uint32_t begin = batchSize; begin < count; begin += batchSize)
+    {
+        uint32_t end = std::min(begin + batchSize, count);
+        run([&func, begin, end]()
+            { func(begin, end); },
+            &counter);
+    }
+
+    func(0, std::min(batchSize, count));
+    wait(counter);
+}
+
+void engine::JobSystem::wait(JobCounter& counter)
+{
+    const uint32_t queueIndex = getCurrentQueue();
+    while (!counter.isDone())
+    {
+        if (!runNextJob(queueIndex))
+            std::this_thread::yield();
+    }
+
+    // Wait for the job which finished the counter to release it
+    std::lock_guard<std::mutex> lock(counter.m_mutex);
+}
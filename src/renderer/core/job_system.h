@@ -0,0 +1,141 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <vector>
+
+namespace engine
+{
+    using JobFunc = std::function<void()>;
+
+    /**
+     * @brief Counts the unfinished jobs of a group. Jobs which are given the
+     * counter increment it when they are queued and decrement it when they
+     * finish. Jobs can be queued to run once a counter reaches zero, which is
+     * how dependencies between job groups are expressed. A counter must be
+     * waited on with JobSystem::wait() before it's destroyed or reused.
+     */
+    class JobCounter
+    {
+    private:
+        std::atomic<uint32_t> m_count{0};
+        std::mutex m_mutex;
+        // Jobs waiting for this counter to reach zero
+        std::vector<std::pair<JobFunc, JobCounter*>> m_continuations;
+
+        friend class JobSystem;
+
+    public:
+        JobCounter() = default;
+        JobCounter(const JobCounter&) = delete;
+        JobCounter& operator=(const JobCounter&) = delete;
+
+        inline bool isDone() const
+        {
+            return m_count.load(std::memory_order_acquire) == 0;
+        }
+    };
+
+    /**
+     * @brief Work stealing job scheduler. Every worker thread (and the thread
+     * which created the job system) owns a deque of jobs. Workers take new jobs
+     * from the back of their own deque and steal from the front of the others
+     * when they run out. Waiting on a counter runs jobs instead of blocking.
+     */
+    class JobSystem
+    {
+    private:
+        struct Job
+        {
+            JobFunc func;
+            JobCounter* counter = nullptr;
+        };
+
+        struct WorkerQueue
+        {
+            std::mutex mutex;
+            std::deque<Job> jobs;
+        };
+
+        // Index 0 belongs to the thread which created the job system
+        std::vector<std::unique_ptr<WorkerQueue>> m_queues;
+        std::vector<std::thread> m_workers;
+
+        // Wakes sleeping workers when jobs are queued
+        std::mutex m_sleepMutex;
+        std::condition_variable m_wakeCondition;
+        std::atomic<uint32_t> m_queuedJobs{0};
+        std::atomic<uint32_t> m_nextQueue{0};
+        bool m_isStopping = false;
+
+        uint32_t getCurrentQueue();
+        void push(Job&& job);
+        bool pop(uint32_t queueIndex, Job& job);
+        bool steal(uint32_t queueIndex, Job& job);
+        bool runNextJob(uint32_t queueIndex);
+        void execute(Job& job);
+        void workerLoop(uint32_t queueIndex);
+
+    public:
+        /**
+         * @brief Starts the worker threads
+         *
+         * @param threadCount Number of threads running jobs, including the
+         * calling thread. 0 uses one thread per core.
+         */
+        JobSystem(uint32_t threadCount = 0);
+        ~JobSystem();
+
+        JobSystem(const JobSystem&) = delete;
+        JobSystem& operator=(const JobSystem&) = delete;
+
+        /**
+         * @brief Queues a job
+         *
+         * @param func Function to run
+         * @param counter Optional counter incremented now and decremented once the job finished
+         */
+        void run(JobFunc func, JobCounter* counter = nullptr);
+
+        /**
+         * @brief Queues a job once all jobs of the dependency counter finished
+         *
+         * @param dependency Counter which has to reach zero before the job runs
+         * @param func Function to run
+         * @param counter Optional counter incremented now and decremented once the job finished
+         */
+        void runAfter(JobCounter& dependency, JobFunc func, JobCounter* counter = nullptr);
+
+        /**
+         * @brief Splits [0, count) in batches and runs them as jobs. Waits
+         * (running jobs meanwhile) until every batch is done.
+         *
+         * @param count Number of items
+         * @param batchSize Number of items per job, 0 picks one batch per thread
+         * @param func Function called with each batch range [begin, end)
+         */
+        void parallelFor(uint32_t count,
+            uint32_t batchSize,
+            const std::function<void(uint32_t begin, uint32_t end)>& func);
+
+        /**
+         * @brief Runs queued jobs on the calling thread until the counter
+         * reaches zero, so the waiting thread helps instead of sleeping
+         */
+        void wait(JobCounter& counter);
+
+        inline uint32_t getThreadCount() const
+        {
+            return static_cast<uint32_t>(m_queues.size());
+        }
+    };
+}
+
+#endif
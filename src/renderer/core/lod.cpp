@@ -0,0 +1,606 @@
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#include "lod.h"
+#include "simd.h"
+
+namespace
+{
+    using engine::MeshVertex;
+
+    static const uint32_t INVALID_INDEX = UINT32_MAX;
+
+    /**
+     * @brief Sum of the plane quadrics of triangles, weighted by their area.
+     * evaluate() gives the weighted sum of squared distances of a point to
+     * the planes, divided by weight it is their mean.
+     */
+    struct Quadric
+    {
+        double a00 = 0.0, a11 = 0.0, a22 = 0.0, a01 = 0.0, a02 = 0.0, a12 = 0.0;
+        double b0 = 0.0, b1 = 0.0, b2 = 0.0;
+        double c = 0.0;
+        double weight = 0.0;
+
+        // Plane dot(n, p) + d = 0 with a unit normal n
+        void addPlane(double nx, double ny, double nz, double d, double w)
+        {
+            a00 += w * nx * nx;
+            a11 += w * ny * ny;
+            a22 += w * nz * nz;
+            a01 += w * nx * ny;
+            a02 += w * nx * nz;
+            a12 += w * ny * nz;
+            b0 += w * nx * d;
+            b1 += w * ny * d;
+            b2 += w * nz * d;
+            c += w * d * d;
+            weight += w;
+        }
+
+        void add(const Quadric& q)
+        {
+            a00 += q.a00;
+            a11 += q.a11;
+            a22 += q.a22;
+            a01 += q.a01;
+            a02 += q.a02;
+            a12 += q.a12;
+            b0 += q.b0;
+            b1 += q.b1;
+            b2 += q.b2;
+            c += q.c;
+            weight += q.weight;
+        }
+
+        double evaluate(const float p[3]) const
+        {
+            const double x = p[0], y = p[1], z = p[2];
+            return a00 * x * x + a11 * y * y + a22 * z * z
+                + 2.0 * (a01 * x * y + a02 * x * z + a12 * y * z)
+                + 2.0 * (b0 * x + b1 * y + b2 * z)
+                + c;
+        }
+    };
+
+    // Mean squared distance of the merged planes of a and b to position p
+    inline float collapseCost(const Quadric& a, const Quadric& b, const float p[3])
+    {
+        const double weight = a.weight + b.weight;
+        if (weight <= 0.0)
+            return 0.0f;
+        const double error = (a.evaluate(p) + b.evaluate(p)) / weight;
+        return static_cast<float>(std::max(error, 0.0));
+    }
+
+    // Unnormalized normal, its length is twice the triangle area
+    inline void triangleNormal(const float* a, const float* b, const float* c, double n[3])
+    {
+        const double e1[3] = { double(b[0]) - a[0], double(b[1]) - a[1], double(b[2]) - a[2] };
+        const double e2[3] = { double(c[0]) - a[0], double(c[1]) - a[1], double(c[2]) - a[2] };
+        n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+        n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+        n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+    }
+
+    struct Collapse
+    {
+        uint32_t from;
+        uint32_t to;
+        float cost;
+    };
+
+    /**
+     * @brief Welds vertices by position. Each vertex maps to the lowest
+     * index vertex with the same position, which stands for the position in
+     * the simplification. Returns the number of used vertices (wedges) of
+     * each position through wedgeCounts.
+     */
+    void weldPositions(const std::vector<MeshVertex>& vertices,
+        const uint32_t* indices,
+        size_t indexCount,
+        std::vector<uint32_t>& positions,
+        std::vector<uint32_t>& wedgeCounts)
+    {
+        const uint32_t vertexCount = static_cast<uint32_t>(vertices.size());
+        std::vector<uint32_t> order(vertexCount);
+        for (uint32_t i = 0; i < vertexCount; i++)
+            order[i] = i;
+        auto less = [&vertices](uint32_t a, uint32_t b)
+        {
+            const float* pa = vertices[a].position;
+            const float* pb = vertices[b].position;
+            if (pa[0] != pb[0])
+                return pa[0] < pb[0];
+            if (pa[1] != pb[1])
+                return pa[1] < pb[1];
+            if (pa[2] != pb[2])
+                return pa[2] < pb[2];
+            return a < b;
+        };
+        std::sort(order.begin(), order.end(), less);
+
+        positions.resize(vertexCount);
+        for (uint32_t i = 0; i < vertexCount;)
+        {
+            uint32_t end = i + 1;
+            const float* p = vertices[order[i]].position;
+            while (end < vertexCount
+                && vertices[order[end]].position[0] == p[0]
+                && vertices[order[end]].position[1] == p[1]
+                && vertices[order[end]].position[2] == p[2])
+                end++;
+            for (uint32_t j = i; j < end; j++)
+                positions[order[j]] = order[i];
+            i = end;
+        }
+
+        // Unused vertices with the same position don't make a seam
+        std::vector<uint8_t> isUsed(vertexCount, 0);
+        for (size_t i = 0; i < indexCount; i++)
+            isUsed[indices[i]] = 1;
+        wedgeCounts.assign(vertexCount, 0);
+        for (uint32_t v = 0; v < vertexCount; v++)
+            wedgeCounts[positions[v]] += isUsed[v];
+    }
+
+    // Triangles of each position, in CSR form
+    void buildAdjacency(const std::vector<uint32_t>& indices,
+        const std::vector<uint32_t>& positions,
+        std::vector<uint32_t>& offsets,
+        std::vector<uint32_t>& triangles)
+    {
+        offsets.assign(positions.size() + 1, 0);
+        for (uint32_t index : indices)
+            offsets[positions[index] + 1]++;
+        for (size_t i = 1; i < offsets.size(); i++)
+            offsets[i] += offsets[i - 1];
+        triangles.resize(indices.size());
+        std::vector<uint32_t> cursor(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < indices.size(); i++)
+            triangles[cursor[positions[indices[i]]]++] = static_cast<uint32_t>(i / 3);
+    }
+}
+
+float engine::simplifyMesh(const std::vector<MeshVertex>& vertices,
+    const uint32_t* indices,
+    size_t indexCount,
+    size_t targetIndexCount,
+    float targetError,
+    std::vector<uint32_t>& result)
+{
+    std::vector<uint32_t> positions;
+    std::vector<uint32_t> wedgeCounts;
+    weldPositions(vertices, indices, indexCount, positions, wedgeCounts);
+    const uint32_t vertexCount = static_cast<uint32_t>(vertices.size());
+    auto positionOf = [&](uint32_t vertex)
+    {
+        return vertices[positions[vertex]].position;
+    };
+
+    // Triangles which are already degenerate after welding are dropped
+    result.clear();
+    result.reserve(indexCount);
+    for (size_t i = 0; i + 2 < indexCount; i += 3)
+    {
+        const uint32_t a = positions[indices[i]], b = positions[indices[i + 1]], c = positions[indices[i + 2]];
+        if (a != b && b != c && a != c)
+            result.insert(result.end(), indices + i, indices + i + 3);
+    }
+
+    std::vector<Quadric> quadrics(vertexCount);
+    for (size_t i = 0; i < result.size(); i += 3)
+    {
+        const float* p0 = positionOf(result[i]);
+        double n[3];
+        triangleNormal(p0, positionOf(result[i + 1]), positionOf(result[i + 2]), n);
+        const double length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        if (length == 0.0)
+            continue;
+        for (int c = 0; c < 3; c++)
+            n[c] /= length;
+        const double d = -(n[0] * p0[0] + n[1] * p0[1] + n[2] * p0[2]);
+        const double area = length * 0.5;
+        for (int k = 0; k < 3; k++)
+            quadrics[positions[result[i + k]]].addPlane(n[0], n[1], n[2], d, area);
+    }
+
+    std::vector<uint32_t> offsets;
+    std::vector<uint32_t> adjacency;
+    buildAdjacency(result, positions, offsets, adjacency);
+
+    // Seam positions have several wedges, border positions an edge without
+    // its opposite. Moving either would tear the surface or its attributes.
+    std::vector<uint8_t> isLocked(vertexCount, 0);
+    for (uint32_t v = 0; v < vertexCount; v++)
+        isLocked[v] = wedgeCounts[v] > 1 ? 1 : 0;
+    for (size_t t = 0; t < result.size() / 3; t++)
+    {
+        for (int e = 0; e < 3; e++)
+        {
+            const uint32_t a = positions[result[t * 3 + e]];
+            const uint32_t b = positions[result[t * 3 + (e + 1) % 3]];
+            bool hasOpposite = false;
+            for (uint32_t k = offsets[b]; k < offsets[b + 1] && !hasOpposite; k++)
+            {
+                const uint32_t* triangle = &result[adjacency[k] * 3];
+                for (int f = 0; f < 3; f++)
+                    hasOpposite |= positions[triangle[f]] == b && positions[triangle[(f + 1) % 3]] == a;
+            }
+            if (!hasOpposite)
+                isLocked[a] = isLocked[b] = 1;
+        }
+    }
+
+    // Passes collapse the cheapest edges which don't share a vertex, then
+    // rebuild the triangles, until the target or error limit is reached
+    const float maxCost = targetError < std::sqrt(FLT_MAX) ? targetError * targetError : FLT_MAX;
+    float resultCost = 0.0f;
+    std::vector<Collapse> collapses;
+    std::vector<uint8_t> isTouched(vertexCount, 0);
+    // Collapsed positions and wedges map to the ones they moved to
+    std::vector<uint32_t> targets(vertexCount);
+    std::vector<uint32_t> wedgeTargets(vertexCount);
+    for (uint32_t v = 0; v < vertexCount; v++)
+        targets[v] = wedgeTargets[v] = v;
+    for (bool isFirstPass = true; result.size() > targetIndexCount; isFirstPass = false)
+    {
+        if (!isFirstPass)
+            buildAdjacency(result, positions, offsets, adjacency);
+
+        // One candidate per edge, in its cheaper direction
+        collapses.clear();
+        for (size_t i = 0; i < result.size(); i++)
+        {
+            const uint32_t a = positions[result[i]];
+            const uint32_t b = positions[result[i - i % 3 + (i % 3 + 1) % 3]];
+            if (a > b || (isLocked[a] && isLocked[b]))
+                continue;
+            const float costAb = isLocked[a] ? FLT_MAX : collapseCost(quadrics[a], quadrics[b], positionOf(b));
+            const float costBa = isLocked[b] ? FLT_MAX : collapseCost(quadrics[a], quadrics[b], positionOf(a));
+            collapses.push_back(costAb <= costBa ? Collapse{ a, b, costAb } : Collapse{ b, a, costBa });
+        }
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse& x, const Collapse& y)
+            {
+                return x.cost < y.cost;
+            });
+
+        // A collapse removes two triangles of a closed surface
+        const size_t removeTriangles = (result.size() - targetIndexCount + 2) / 3;
+        const size_t maxCollapses = std::max<size_t>((removeTriangles + 1) / 2, 1);
+        std::fill(isTouched.begin(), isTouched.end(), 0);
+        size_t collapseCount = 0;
+        for (const Collapse& collapse : collapses)
+        {
+            if (collapseCount >= maxCollapses || collapse.cost > maxCost)
+                break;
+            if (isTouched[collapse.from] || isTouched[collapse.to])
+                continue;
+
+            // The kept triangles take the wedge of the target on the collapsed
+            // edge, both triangles of the edge have to agree on it
+            uint32_t fromWedge = INVALID_INDEX;
+            uint32_t toWedge = INVALID_INDEX;
+            bool isValid = true;
+            for (uint32_t k = offsets[collapse.from]; k < offsets[collapse.from + 1] && isValid; k++)
+            {
+                const uint32_t* triangle = &result[adjacency[k] * 3];
+                uint32_t corners[3];
+                int fromCorner = 0;
+                bool hasTarget = false;
+                for (int c = 0; c < 3; c++)
+                {
+                    corners[c] = targets[positions[triangle[c]]];
+                    if (corners[c] == collapse.from)
+                    {
+                        fromWedge = triangle[c];
+                        fromCorner = c;
+                    }
+                    if (corners[c] == collapse.to)
+                    {
+                        isValid = toWedge == INVALID_INDEX || toWedge == triangle[c];
+                        toWedge = triangle[c];
+                        hasTarget = true;
+                    }
+                }
+                if (hasTarget)
+                    continue;
+
+                // Triangles which stay must keep facing the same side. Corners
+                // collapsed earlier in this pass are already at their target,
+                // and the triangles those collapses removed are skipped.
+                double before[3], after[3];
+                const float* p[3] = { positionOf(corners[0]), positionOf(corners[1]), positionOf(corners[2]) };
+                if (corners[0] == corners[1] || corners[1] == corners[2] || corners[0] == corners[2])
+                    continue;
+                triangleNormal(p[0], p[1], p[2], before);
+                p[fromCorner] = positionOf(collapse.to);
+                triangleNormal(p[0], p[1], p[2], after);
+                isValid = before[0] * after[0] + before[1] * after[1] + before[2] * after[2] > 0.0;
+            }
+            if (!isValid || fromWedge == INVALID_INDEX || toWedge == INVALID_INDEX)
+                continue;
+
+            isTouched[collapse.from] = isTouched[collapse.to] = 1;
+            quadrics[collapse.to].add(quadrics[collapse.from]);
+            targets[collapse.from] = collapse.to;
+            wedgeTargets[fromWedge] = toWedge;
+            resultCost = std::max(resultCost, collapse.cost);
+            collapseCount++;
+        }
+        if (collapseCount == 0)
+            break;
+
+        // Collapsed edges leave degenerate triangles behind
+        size_t writeIndex = 0;
+        for (size_t i = 0; i < result.size(); i += 3)
+        {
+            const uint32_t a = wedgeTargets[result[i]], b = wedgeTargets[result[i + 1]], c = wedgeTargets[result[i + 2]];
+            if (positions[a] == positions[b] || positions[b] == positions[c] || positions[a] == positions[c])
+                continue;
+            result[writeIndex++] = a;
+            result[writeIndex++] = b;
+            result[writeIndex++] = c;
+        }
+        result.resize(writeIndex);
+    }
+
+    return std::sqrt(resultCost);
+}
+
+void engine::buildLods(const MeshData& mesh, std::vector<MeshLod>& lods, float reduction, uint32_t minTriangles)
+{
+    lods.clear();
+    const std::vector<uint32_t>* previous = &mesh.indices;
+    float error = 0.0f;
+    while (lods.size() + 1 < MAX_LOD_COUNT)
+    {
+        const size_t targetTriangles = static_cast<size_t>(previous->size() / 3 * reduction);
+        if (targetTriangles < minTriangles)
+            break;
+
+        MeshLod lod;
+        const float levelError = simplifyMesh(mesh.vertices,
+            previous->data(),
+            previous->size(),
+            targetTriangles * 3,
+            FLT_MAX,
+            lod.indices);
+        // Less than a tenth gone means the rest is locked, the next levels would repeat this one
+        if (lod.indices.size() * 10 > previous->size() * 9)
+            break;
+
+        error += levelError;
+        lod.error = error;
+        lods.push_back(std::move(lod));
+        previous = &lods.back().indices;
+    }
+}
+
+uint32_t engine::LodInstances::add(const Vec3& center, float r, const float* levelErrors, uint32_t levelCount, float scale)
+{
+    centerX.push_back(center.x);
+    centerY.push_back(center.y);
+    centerZ.push_back(center.z);
+    radius.push_back(r);
+    levelCount = std::min(levelCount, MAX_LOD_COUNT);
+    for (uint32_t level = 1; level < MAX_LOD_COUNT; level++)
+        errors[level - 1].push_back(level < levelCount ? levelErrors[level] * scale : FLT_MAX);
+    lods.push_back(0);
+    return size() - 1;
+}
+
+void engine::LodInstances::setBounds(uint32_t index, const Vec3& center, float r)
+{
+    centerX[index] = center.x;
+    centerY[index] = center.y;
+    centerZ[index] = center.z;
+    radius[index] = r;
+}
+
+void engine::LodInstances::reserve(uint32_t count)
+{
+    centerX.reserve(count);
+    centerY.reserve(count);
+    centerZ.reserve(count);
+    radius.reserve(count);
+    for (std::vector<float>& levelErrors : errors)
+        levelErrors.reserve(count);
+    lods.reserve(count);
+}
+
+void engine::LodInstances::clear()
+{
+    centerX.clear();
+    centerY.clear();
+    centerZ.clear();
+    radius.clear();
+    for (std::vector<float>& levelErrors : errors)
+        levelErrors.clear();
+    lods.clear();
+}
+
+// Kernels select for indices [i, count) and return the number of changed
+// levels. Like the culling kernels, the SIMD ones stop at the last full
+// group of 4 or 8 and leave the rest to a narrower kernel.
+
+namespace
+{
+    using engine::LodInstances;
+    using engine::MAX_LOD_COUNT;
+
+    // Settings turned into the error thresholds per unit of distance
+    struct LodThresholds
+    {
+        float cameraX;
+        float cameraY;
+        float cameraZ;
+        // Errors below distance * coarseScale allow a coarser level
+        float coarseScale;
+        // Errors above distance * fineScale force a finer level
+        float fineScale;
+    };
+
+    uint32_t selectLodsScalar(const LodThresholds& t, LodInstances& in, const uint32_t* indices, uint32_t& i, uint32_t count)
+    {
+        uint32_t changed = 0;
+        for (; i < count; i++)
+        {
+            const uint32_t index = indices[i];
+            const float dx = in.centerX[index] - t.cameraX;
+            const float dy = in.centerY[index] - t.cameraY;
+            const float dz = in.centerZ[index] - t.cameraZ;
+            const float distance = std::max(std::sqrt(dx * dx + dy * dy + dz * dz) - in.radius[index], 0.0f);
+            const float coarse = distance * t.coarseScale;
+            const float fine = distance * t.fineScale;
+
+            // Errors grow with the level, so the counts are the coarsest levels within each threshold
+            uint32_t coarsest = 0;
+            uint32_t finest = 0;
+            for (uint32_t level = 0; level < MAX_LOD_COUNT - 1; level++)
+            {
+                coarsest += in.errors[level][index] <= coarse ? 1 : 0;
+                finest += in.errors[level][index] <= fine ? 1 : 0;
+            }
+            const uint32_t previous = in.lods[index];
+            const uint32_t lod = std::min(std::max(previous, coarsest), finest);
+            changed += lod != previous ? 1 : 0;
+            in.lods[index] = lod;
+        }
+        return changed;
+    }
+
+#if defined(ENGINE_SIMD_SSE2)
+    uint32_t selectLodsSse(const LodThresholds& t, LodInstances& in, const uint32_t* indices, uint32_t& i, uint32_t count)
+    {
+        const __m128 cameraX = _mm_set1_ps(t.cameraX);
+        const __m128 cameraY = _mm_set1_ps(t.cameraY);
+        const __m128 cameraZ = _mm_set1_ps(t.cameraZ);
+        const __m128 coarseScale = _mm_set1_ps(t.coarseScale);
+        const __m128 fineScale = _mm_set1_ps(t.fineScale);
+        const __m128 one = _mm_set1_ps(1.0f);
+
+        // SSE2 has no gather, the lanes are loaded one by one
+        auto gather = [indices](const std::vector<float>& values, uint32_t j)
+        {
+            return _mm_setr_ps(values[indices[j]], values[indices[j + 1]], values[indices[j + 2]], values[indices[j + 3]]);
+        };
+
+        uint32_t changed = 0;
+        uint32_t j = i;
+        for (; j + 4 <= count; j += 4)
+        {
+            __m128 dx = _mm_sub_ps(gather(in.centerX, j), cameraX);
+            __m128 dy = _mm_sub_ps(gather(in.centerY, j), cameraY);
+            __m128 dz = _mm_sub_ps(gather(in.centerZ, j), cameraZ);
+            __m128 distance = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz)));
+            distance = _mm_max_ps(_mm_sub_ps(distance, gather(in.radius, j)), _mm_setzero_ps());
+            const __m128 coarse = _mm_mul_ps(distance, coarseScale);
+            const __m128 fine = _mm_mul_ps(distance, fineScale);
+
+            __m128 coarsest = _mm_setzero_ps();
+            __m128 finest = _mm_setzero_ps();
+            for (uint32_t level = 0; level < MAX_LOD_COUNT - 1; level++)
+            {
+                const __m128 error = gather(in.errors[level], j);
+                coarsest = _mm_add_ps(coarsest, _mm_and_ps(_mm_cmple_ps(error, coarse), one));
+                finest = _mm_add_ps(finest, _mm_and_ps(_mm_cmple_ps(error, fine), one));
+            }
+            // Levels are small integers, exact as floats
+            const __m128 previous = _mm_cvtepi32_ps(_mm_setr_epi32(static_cast<int>(in.lods[indices[j]]),
+                static_cast<int>(in.lods[indices[j + 1]]),
+                static_cast<int>(in.lods[indices[j + 2]]),
+                static_cast<int>(in.lods[indices[j + 3]])));
+            const __m128 lod = _mm_min_ps(_mm_max_ps(previous, coarsest), finest);
+            changed += engine::countBits(static_cast<uint32_t>(_mm_movemask_ps(_mm_cmpneq_ps(lod, previous))));
+
+            alignas(16) int32_t lods[4];
+            _mm_store_si128(reinterpret_cast<__m128i*>(lods), _mm_cvttps_epi32(lod));
+            for (uint32_t k = 0; k < 4; k++)
+                in.lods[indices[j + k]] = static_cast<uint32_t>(lods[k]);
+        }
+        i = j;
+        return changed;
+    }
+#endif
+
+#if defined(ENGINE_SIMD_AVX2)
+    uint32_t selectLodsAvx2(const LodThresholds& t, LodInstances& in, const uint32_t* indices, uint32_t& i, uint32_t count)
+    {
+        const __m256 cameraX = _mm256_set1_ps(t.cameraX);
+        const __m256 cameraY = _mm256_set1_ps(t.cameraY);
+        const __m256 cameraZ = _mm256_set1_ps(t.cameraZ);
+        const __m256 coarseScale = _mm256_set1_ps(t.coarseScale);
+        const __m256 fineScale = _mm256_set1_ps(t.fineScale);
+        const __m256 one = _mm256_set1_ps(1.0f);
+
+        uint32_t changed = 0;
+        uint32_t j = i;
+        for (; j + 8 <= count; j += 8)
+        {
+            const __m256i index = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(indices + j));
+            __m256 dx = _mm256_sub_ps(_mm256_i32gather_ps(in.centerX.data(), index, 4), cameraX);
+            __m256 dy = _mm256_sub_ps(_mm256_i32gather_ps(in.centerY.data(), index, 4), cameraY);
+            __m256 dz = _mm256_sub_ps(_mm256_i32gather_ps(in.centerZ.data(), index, 4), cameraZ);
+            __m256 distance = _mm256_sqrt_ps(_mm256_fmadd_ps(dx, dx, _mm256_fmadd_ps(dy, dy, _mm256_mul_ps(dz, dz))));
+            distance = _mm256_max_ps(_mm256_sub_ps(distance, _mm256_i32gather_ps(in.radius.data(), index, 4)),
+                _mm256_setzero_ps());
+            const __m256 coarse = _mm256_mul_ps(distance, coarseScale);
+            const __m256 fine = _mm256_mul_ps(distance, fineScale);
+
+            __m256 coarsest = _mm256_setzero_ps();
+            __m256 finest = _mm256_setzero_ps();
+            for (uint32_t level = 0; level < MAX_LOD_COUNT - 1; level++)
+            {
+                const __m256 error = _mm256_i32gather_ps(in.errors[level].data(), index, 4);
+                coarsest = _mm256_add_ps(coarsest, _mm256_and_ps(_mm256_cmp_ps(error, coarse, _CMP_LE_OQ), one));
+                finest = _mm256_add_ps(finest, _mm256_and_ps(_mm256_cmp_ps(error, fine, _CMP_LE_OQ), one));
+            }
+            const __m256 previous = _mm256_cvtepi32_ps(_mm256_i32gather_epi32(reinterpret_cast<const int*>(in.lods.data()), index, 4));
+            const __m256 lod = _mm256_min_ps(_mm256_max_ps(previous, coarsest), finest);
+            changed += engine::countBits(static_cast<uint32_t>(_mm256_movemask_ps(_mm256_cmp_ps(lod, previous, _CMP_NEQ_OQ))));
+
+            // No scatter before AVX-512, the levels are stored one by one
+            alignas(32) int32_t lods[8];
+            _mm256_store_si256(reinterpret_cast<__m256i*>(lods), _mm256_cvttps_epi32(lod));
+            for (uint32_t k = 0; k < 8; k++)
+                in.lods[indices[j + k]] = static_cast<uint32_t>(lods[k]);
+        }
+        i = j;
+        return changed;
+    }
+#endif
+}
+
+uint32_t engine::selectLods(const LodSettings& settings,
+    LodInstances& instances,
+    const uint32_t* indices,
+    uint32_t count,
+    CullingPath path)
+{
+    if (path == CullingPath::Best)
+        path = getBestCullingPath();
+
+    // Largest world space error per unit of distance which projects to maxPixelError
+    const float errorScale = settings.maxPixelError / std::max(settings.pixelsPerUnit, FLT_MIN);
+    LodThresholds thresholds;
+    thresholds.cameraX = settings.cameraPosition.x;
+    thresholds.cameraY = settings.cameraPosition.y;
+    thresholds.cameraZ = settings.cameraPosition.z;
+    thresholds.coarseScale = errorScale * std::max(1.0f - settings.hysteresis, 0.0f);
+    thresholds.fineScale = errorScale * (1.0f + settings.hysteresis);
+
+    uint32_t changed = 0;
+    uint32_t i = 0;
+#if defined(ENGINE_SIMD_AVX2)
+    if (path == CullingPath::Avx2)
+        changed += selectLodsAvx2(thresholds, instances, indices, i, count);
+#endif
+#if defined(ENGINE_SIMD_SSE2)
+    if (path == CullingPath::Avx2 || path == CullingPath::Sse)
+        changed += selectLodsSse(thresholds, instances, indices, i, count);
+#endif
+    changed += selectLodsScalar(thresholds, instances, indices, i, count);
+    return changed;
+}
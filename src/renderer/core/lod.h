@@ -0,0 +1,158 @@
+#ifndef LOD_H
+#define LOD_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "math.h"
+#include "culling.h"
+#include "mesh.h"
+
+namespace engine
+{
+    // Levels of a mesh including the full detail one, which is level 0
+    static const uint32_t MAX_LOD_COUNT = 8;
+
+    /**
+     * @brief Simplifies a triangle list by collapsing edges in the order of
+     * their quadric error (Garland and Heckbert 1997). Only the indices
+     * change, the remaining triangles keep using the original vertices, so
+     * all levels of a mesh share its vertex buffer.
+     *
+     * Vertices are welded by position, so split normals and uvs don't stop
+     * collapses. Vertices on open borders, on uv or normal seams and the ones
+     * whose collapse would flip a triangle are kept in place.
+     *
+     * @param vertices Vertices the indices refer to
+     * @param indices Triangle list to simplify
+     * @param indexCount Number of indices
+     * @param targetIndexCount Stops once the result has at most this many indices
+     * @param targetError Stops before a collapse moves the surface further than
+     * this, in mesh space units
+     * @param result Receives the simplified triangle list, replaced
+     * @return error of the result, the root mean square distance to the
+     * planes of the triangles merged into its vertices
+     */
+    float simplifyMesh(const std::vector<MeshVertex>& vertices,
+        const uint32_t* indices,
+        size_t indexCount,
+        size_t targetIndexCount,
+        float targetError,
+        std::vector<uint32_t>& result);
+
+    /**
+     * @brief Simplified level of a mesh
+     *
+     * @param indices Triangle list over the vertices of the full detail mesh
+     * @param error Mesh space error of the level against the full detail mesh
+     */
+    struct MeshLod
+    {
+        std::vector<uint32_t> indices;
+        float error = 0.0f;
+    };
+
+    /**
+     * @brief Builds a chain of simplified levels, each one simplified from
+     * the previous one. Errors add up along the chain, so they stay an upper
+     * bound of the distance to the full detail mesh. Stops early when a mesh
+     * can't be reduced further (Eg: everything is on a border or a seam).
+     *
+     * @param mesh Full detail mesh, level 0
+     * @param lods Receives levels 1 and up, at most MAX_LOD_COUNT - 1, replaced
+     * @param reduction Triangle count of a level relative to the previous one
+     * @param minTriangles No levels are built below this triangle count
+     */
+    void buildLods(const MeshData& mesh,
+        std::vector<MeshLod>& lods,
+        float reduction = 0.5f,
+        uint32_t minTriangles = 64);
+
+    /**
+     * @brief Instances taking part in LOD selection, stored as separate arrays
+     * like SphereBounds so the selection kernels load 4 or 8 at once
+     *
+     * @param errors World space error of levels 1 to MAX_LOD_COUNT - 1, the
+     * levels an instance doesn't have are FLT_MAX and never selected
+     * @param lods Selected level of each instance, the hysteresis keeps it
+     * unless the error moved far enough from the threshold
+     */
+    struct LodInstances
+    {
+        std::vector<float> centerX;
+        std::vector<float> centerY;
+        std::vector<float> centerZ;
+        std::vector<float> radius;
+        std::vector<float> errors[MAX_LOD_COUNT - 1];
+        std::vector<uint32_t> lods;
+
+        /**
+         * @brief Adds an instance at level 0
+         *
+         * @param center World space bounding sphere center
+         * @param r World space bounding sphere radius
+         * @param levelErrors Mesh space error of each level starting at level 0 (Eg: MeshFileLod::error)
+         * @param levelCount Number of levels of the mesh, clamped to MAX_LOD_COUNT
+         * @param scale Largest scale of the instance transform, turns the errors into world space
+         * @return index of the instance
+         */
+        uint32_t add(const Vec3& center, float r, const float* levelErrors, uint32_t levelCount, float scale = 1.0f);
+        // Moves an instance, its levels and selected level are kept
+        void setBounds(uint32_t index, const Vec3& center, float r);
+        void reserve(uint32_t count);
+        void clear();
+
+        inline uint32_t size() const
+        {
+            return static_cast<uint32_t>(radius.size());
+        }
+    };
+
+    /**
+     * @brief Camera and thresholds of a LOD selection
+     *
+     * @param cameraPosition World space camera position
+     * @param pixelsPerUnit Pixels covered by one world unit at distance 1
+     * (Eg: getPixelsPerUnit() of the projection)
+     * @param maxPixelError Largest projected error the selected levels may have, in pixels
+     * @param hysteresis Relative band around maxPixelError in which instances
+     * keep their level, so the ones sitting at a switch distance don't pop
+     * back and forth every frame
+     */
+    struct LodSettings
+    {
+        Vec3 cameraPosition;
+        float pixelsPerUnit = 1.0f;
+        float maxPixelError = 1.0f;
+        float hysteresis = 0.25f;
+    };
+
+    // Pixels per world unit at distance 1 of a perspective projection
+    inline float getPixelsPerUnit(float fovY, float viewportHeight)
+    {
+        return viewportHeight / (2.0f * std::tan(fovY * 0.5f));
+    }
+
+    /**
+     * @brief Selects the coarsest level of each instance whose error, projected
+     * from the point of its bounding sphere closest to the camera, stays
+     * below maxPixelError. An instance changes level only once the projected
+     * error leaves the hysteresis band: it gets coarser below
+     * maxPixelError * (1 - hysteresis) and finer above maxPixelError * (1 + hysteresis).
+     *
+     * @param settings Camera and thresholds
+     * @param instances Instances to update, their selected levels are overwritten
+     * @param indices Instances to select for (Eg: the visible list of cullSpheres())
+     * @param count Number of indices
+     * @param path Instruction set to use, like the culling kernels
+     * @return number of instances whose level changed
+     */
+    uint32_t selectLods(const LodSettings& settings,
+        LodInstances& instances,
+        const uint32_t* indices,
+        uint32_t count,
+        CullingPath path = CullingPath::Best);
+}
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+
+namespace engine
+{
+    /**
+     * @brief Read only memory mapping of a whole file. Pages are loaded by the
+     * OS on first access, so opening is cheap and nothing is copied into the
+     * process until the data is read. Move only.
+     */
+    class MappedFile
+    {
+    private:
+        const void* m_data = nullptr;
+        size_t m_size = 0;
+#ifdef _WIN32
+        void* m_file = nullptr;
+        void* m_mapping = nullptr;
+#endif
+
+    public:
+        MappedFile() = default;
+        ~MappedFile();
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+        MappedFile(MappedFile&& other) noexcept;
+        MappedFile& operator=(MappedFile&& other) noexcept;
+
+        /**
+         * @brief Maps the file, closing the previous one
+         *
+         * @param path Path of the file
+         * @return false if the file can't be opened or is empty
+         */
+        bool open(const std::string& path);
+        void close();
+
+        inline const void* data() const
+        {
+            return m_data;
+        }
+
+        inline size_t size() const
+        {
+            return m_size;
+        }
+
+        inline bool isOpen() const
+        {
+            return m_data != nullptr;
+        }
+    };
+}
+
+#endif
@@ -0,0 +1,246 @@
+#include "math.h"
+
+namespace
+{
+    using engine::Mat4;
+    using engine::Vec3;
+    using engine::Vec4;
+
+#if defined(ENGINE_SIMD_SSE2)
+    inline __m128 load(const Vec4& v)
+    {
+        return _mm_load_ps(&v.x);
+    }
+
+    inline void store(Vec4& v, __m128 value)
+    {
+        _mm_store_ps(&v.x, value);
+    }
+
+    // m * v, with v given as 4 lanes
+    inline __m128 multiply(const Mat4& m, __m128 v)
+    {
+        __m128 x = _mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 0, 0, 0));
+        __m128 y = _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1));
+        __m128 z = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2));
+        __m128 w = _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3));
+        return _mm_add_ps(_mm_add_ps(_mm_mul_ps(load(m.columns[0]), x), _mm_mul_ps(load(m.columns[1]), y)),
+            _mm_add_ps(_mm_mul_ps(load(m.columns[2]), z), _mm_mul_ps(load(m.columns[3]), w)));
+    }
+
+    // Columns are computed before any is stored, so out may alias a or b
+    inline void multiply(const Mat4& a, const Mat4& b, Mat4& out)
+    {
+        __m128 c0 = multiply(a, load(b.columns[0]));
+        __m128 c1 = multiply(a, load(b.columns[1]));
+        __m128 c2 = multiply(a, load(b.columns[2]));
+        __m128 c3 = multiply(a, load(b.columns[3]));
+        store(out.columns[0], c0);
+        store(out.columns[1], c1);
+        store(out.columns[2], c2);
+        store(out.columns[3], c3);
+    }
+
+    // Keeps the padding lane of Vec3 at 0
+    inline __m128 maskXyz(__m128 v)
+    {
+        return _mm_and_ps(v, _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1)));
+    }
+#else
+    inline Vec4 multiply(const Mat4& m, const Vec4& v)
+    {
+        return m.columns[0] * v.x + m.columns[1] * v.y + m.columns[2] * v.z + m.columns[3] * v.w;
+    }
+
+    inline void multiply(const Mat4& a, const Mat4& b, Mat4& out)
+    {
+        Mat4 result(multiply(a, b.columns[0]),
+            multiply(a, b.columns[1]),
+            multiply(a, b.columns[2]),
+            multiply(a, b.columns[3]));
+        out = result;
+    }
+#endif
+}
+
+engine::Quat engine::Quat::fromAxisAngle(const Vec3& axis, float angle)
+{
+    float s = std::sin(angle * 0.5f);
+    return Quat(axis.x * s, axis.y * s, axis.z * s, std::cos(angle * 0.5f));
+}
+
+engine::Quat engine::Quat::operator*(const Quat& q) const
+{
+    return Quat(w * q.x + x * q.w + y * q.z - z * q.y,
+        w * q.y - x * q.z + y * q.w + z * q.x,
+        w * q.z + x * q.y - y * q.x + z * q.w,
+        w * q.w - x * q.x - y * q.y - z * q.z);
+}
+
+engine::Vec3 engine::Quat::rotate(const Vec3& v) const
+{
+    // v + 2w(u x v) + 2u x (u x v), with u the vector part
+    Vec3 u(x, y, z);
+    Vec3 t = cross(u, v) * 2.0f;
+    return v + t * w + cross(u, t);
+}
+
+engine::Mat4 engine::Mat4::identity()
+{
+    return Mat4(Vec4(1.0f, 0.0f, 0.0f, 0.0f),
+        Vec4(0.0f, 1.0f, 0.0f, 0.0f),
+        Vec4(0.0f, 0.0f, 1.0f, 0.0f),
+        Vec4(0.0f, 0.0f, 0.0f, 1.0f));
+}
+
+engine::Mat4 engine::Mat4::translation(const Vec3& t)
+{
+    Mat4 m = identity();
+    m.columns[3] = Vec4(t, 1.0f);
+    return m;
+}
+
+engine::Mat4 engine::Mat4::scale(const Vec3& s)
+{
+    return Mat4(Vec4(s.x, 0.0f, 0.0f, 0.0f),
+        Vec4(0.0f, s.y, 0.0f, 0.0f),
+        Vec4(0.0f, 0.0f, s.z, 0.0f),
+        Vec4(0.0f, 0.0f, 0.0f, 1.0f));
+}
+
+engine::Mat4 engine::Mat4::rotation(const Quat& q)
+{
+    return fromTrs(Vec3(), q, Vec3(1.0f, 1.0f, 1.0f));
+}
+
+engine::Mat4 engine::Mat4::fromTrs(const Vec3& t, const Quat& r, const Vec3& s)
+{
+    const float xx = r.x * r.x, yy = r.y * r.y, zz = r.z * r.z;
+    const float xy = r.x * r.y, xz = r.x * r.z, yz = r.y * r.z;
+    const float wx = r.w * r.x, wy = r.w * r.y, wz = r.w * r.z;
+
+    return Mat4(Vec4(1.0f - 2.0f * (yy + zz), 2.0f * (xy + wz), 2.0f * (xz - wy), 0.0f) * s.x,
+        Vec4(2.0f * (xy - wz), 1.0f - 2.0f * (xx + zz), 2.0f * (yz + wx), 0.0f) * s.y,
+        Vec4(2.0f * (xz + wy), 2.0f * (yz - wx), 1.0f - 2.0f * (xx + yy), 0.0f) * s.z,
+        Vec4(t, 1.0f));
+}
+
+engine::Mat4 engine::Mat4::perspective(float fovY, float aspect, float zNear, float zFar)
+{
+    const float f = 1.0f / std::tan(fovY * 0.5f);
+    Mat4 m;
+    m.columns[0] = Vec4(f / aspect, 0.0f, 0.0f, 0.0f);
+    // Vulkan clip space y points down
+    m.columns[1] = Vec4(0.0f, -f, 0.0f, 0.0f);
+    m.columns[2] = Vec4(0.0f, 0.0f, zFar / (zNear - zFar), -1.0f);
+    m.columns[3] = Vec4(0.0f, 0.0f, zNear * zFar / (zNear - zFar), 0.0f);
+    return m;
+}
+
+engine::Mat4 engine::Mat4::lookAt(const Vec3& eye, const Vec3& target, const Vec3& up)
+{
+    // Camera looks down -z
+    Vec3 f = normalize(target - eye);
+    Vec3 s = normalize(cross(f, up));
+    Vec3 u = cross(s, f);
+
+    return Mat4(Vec4(s.x, u.x, -f.x, 0.0f),
+        Vec4(s.y, u.y, -f.y, 0.0f),
+        Vec4(s.z, u.z, -f.z, 0.0f),
+        Vec4(-dot(s, eye), -dot(u, eye), dot(f, eye), 1.0f));
+}
+
+engine::Mat4 engine::Mat4::operator*(const Mat4& m) const
+{
+    Mat4 result;
+    multiply(*this, m, result);
+    return result;
+}
+
+engine::Vec4 engine::Mat4::operator*(const Vec4& v) const
+{
+#if defined(ENGINE_SIMD_SSE2)
+    Vec4 result;
+    store(result, multiply(*this, load(v)));
+    return result;
+#else
+    return multiply(*this, v);
+#endif
+}
+
+engine::Vec3 engine::Mat4::transformPoint(const Vec3& p) const
+{
+    return (*this * Vec4(p, 1.0f)).xyz();
+}
+
+engine::Vec3 engine::Mat4::transformVector(const Vec3& v) const
+{
+    return (*this * Vec4(v, 0.0f)).xyz();
+}
+
+engine::Mat4 engine::Mat4::transposed() const
+{
+    const Vec4* c = columns;
+    return Mat4(Vec4(c[0].x, c[1].x, c[2].x, c[3].x),
+        Vec4(c[0].y, c[1].y, c[2].y, c[3].y),
+        Vec4(c[0].z, c[1].z, c[2].z, c[3].z),
+        Vec4(c[0].w, c[1].w, c[2].w, c[3].w));
+}
+
+engine::Mat4 engine::Mat4::inverseAffine() const
+{
+    // The upper 3x3 is R * S, its inverse is S^-1 * R^T, whose rows are the
+    // columns divided by their squared length (the squared scale of the axis)
+    Vec4 rows[3];
+    for (int c = 0; c < 3; c++)
+    {
+        const Vec3 axis = columns[c].xyz();
+        const float scale2 = dot(axis, axis);
+        rows[c] = Vec4(scale2 > 0.0f ? axis * (1.0f / scale2) : axis, 0.0f);
+    }
+    Mat4 inverse = Mat4(rows[0], rows[1], rows[2], Vec4(0.0f, 0.0f, 0.0f, 1.0f)).transposed();
+
+    const Vec3 t = inverse.transformVector(columns[3].xyz());
+    inverse.columns[3] = Vec4(-t, 1.0f);
+    return inverse;
+}
+
+void engine::transformPoints(const Mat4& m, const Vec3* points, Vec3* out, size_t count)
+{
+#if defined(ENGINE_SIMD_SSE2)
+    const __m128 c0 = load(m.columns[0]);
+    const __m128 c1 = load(m.columns[1]);
+    const __m128 c2 = load(m.columns[2]);
+    const __m128 c3 = load(m.columns[3]);
+    for (size_t i = 0; i < count; i++)
+    {
+        __m128 p = _mm_load_ps(&points[i].x);
+        __m128 x = _mm_shuffle_ps(p, p, _MM_SHUFFLE(0, 0, 0, 0));
+        __m128 y = _mm_shuffle_ps(p, p, _MM_SHUFFLE(1, 1, 1, 1));
+        __m128 z = _mm_shuffle_ps(p, p, _MM_SHUFFLE(2, 2, 2, 2));
+        __m128 r = _mm_add_ps(_mm_add_ps(_mm_mul_ps(c0, x), _mm_mul_ps(c1, y)), _mm_add_ps(_mm_mul_ps(c2, z), c3));
+        _mm_store_ps(&out[i].x, maskXyz(r));
+    }
+#else
+    for (size_t i = 0; i < count; i++)
+        out[i] = m.transformPoint(points[i]);
+#endif
+}
+
+void engine::multiplyMatrices(const Mat4* a, const Mat4* b, Mat4* out, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+        multiply(a[i], b[i], out[i]);
+}
+
+void engine::multiplyMatrices(const Mat4& parent, const Mat4* local, Mat4* out, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+        multiply(parent, local[i], out[i]);
+}
+
+void engine::composeTrs(const Vec3* translations, const Quat* rotations, const Vec3* scales, Mat4* out, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+        out[i] = Mat4::fromTrs(translations[i], rotations[i], scales[i]);
+}
@@ -0,0 +1,201 @@
+#ifndef MATH_H
+#define MATH_H
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+#include "simd.h"
+
+namespace engine
+{
+    /**
+     * @brief 3 component vector padded to 16 bytes, so it loads into one SSE
+     * register. The padding lane is kept at 0 for points and directions alike.
+     */
+    struct alignas(16) Vec3
+    {
+        float x = 0.0f;
+        float y = 0.0f;
+        float z = 0.0f;
+        float pad = 0.0f;
+
+        Vec3() = default;
+        Vec3(float x, float y, float z) : x{x}, y{y}, z{z} {}
+
+        inline Vec3 operator+(const Vec3& v) const
+        {
+            return Vec3(x + v.x, y + v.y, z + v.z);
+        }
+
+        inline Vec3 operator-(const Vec3& v) const
+        {
+            return Vec3(x - v.x, y - v.y, z - v.z);
+        }
+
+        inline Vec3 operator*(float s) const
+        {
+            return Vec3(x * s, y * s, z * s);
+        }
+
+        inline Vec3 operator*(const Vec3& v) const
+        {
+            return Vec3(x * v.x, y * v.y, z * v.z);
+        }
+
+        inline Vec3 operator-() const
+        {
+            return Vec3(-x, -y, -z);
+        }
+    };
+
+    struct alignas(16) Vec4
+    {
+        float x = 0.0f;
+        float y = 0.0f;
+        float z = 0.0f;
+        float w = 0.0f;
+
+        Vec4() = default;
+        Vec4(float x, float y, float z, float w) : x{x}, y{y}, z{z}, w{w} {}
+        Vec4(const Vec3& v, float w) : x{v.x}, y{v.y}, z{v.z}, w{w} {}
+
+        inline Vec4 operator+(const Vec4& v) const
+        {
+            return Vec4(x + v.x, y + v.y, z + v.z, w + v.w);
+        }
+
+        inline Vec4 operator-(const Vec4& v) const
+        {
+            return Vec4(x - v.x, y - v.y, z - v.z, w - v.w);
+        }
+
+        inline Vec4 operator*(float s) const
+        {
+            return Vec4(x * s, y * s, z * s, w * s);
+        }
+
+        inline Vec3 xyz() const
+        {
+            return Vec3(x, y, z);
+        }
+    };
+
+    // Unit quaternion rotation, w is the real part
+    struct alignas(16) Quat
+    {
+        float x = 0.0f;
+        float y = 0.0f;
+        float z = 0.0f;
+        float w = 1.0f;
+
+        Quat() = default;
+        Quat(float x, float y, float z, float w) : x{x}, y{y}, z{z}, w{w} {}
+
+        // Rotation of angle radians around a unit axis
+        static Quat fromAxisAngle(const Vec3& axis, float angle);
+        // Applies q first, then this rotation
+        Quat operator*(const Quat& q) const;
+        Vec3 rotate(const Vec3& v) const;
+    };
+
+    /**
+     * @brief Column major 4x4 matrix, the layout GLSL and Frustum::fromMatrix()
+     * expect. Vectors are columns, so a * b applies b first.
+     */
+    struct alignas(16) Mat4
+    {
+        Vec4 columns[4];
+
+        Mat4() = default;
+        Mat4(const Vec4& c0, const Vec4& c1, const Vec4& c2, const Vec4& c3) : columns{c0, c1, c2, c3} {}
+
+        static Mat4 identity();
+        static Mat4 translation(const Vec3& t);
+        static Mat4 scale(const Vec3& s);
+        static Mat4 rotation(const Quat& q);
+        // Same as translation(t) * rotation(r) * scale(s), without the multiplies
+        static Mat4 fromTrs(const Vec3& t, const Quat& r, const Vec3& s);
+        /**
+         * @brief Right handed perspective projection for Vulkan clip space
+         * (depth in [0, 1], y pointing down)
+         *
+         * @param fovY Vertical field of view in radians
+         * @param aspect Width divided by height
+         * @param zNear Distance of the near plane
+         * @param zFar Distance of the far plane
+         */
+        static Mat4 perspective(float fovY, float aspect, float zNear, float zFar);
+        // View matrix of a camera at eye looking at target
+        static Mat4 lookAt(const Vec3& eye, const Vec3& target, const Vec3& up);
+
+        Mat4 operator*(const Mat4& m) const;
+        Vec4 operator*(const Vec4& v) const;
+
+        // Transforms a point, w = 1
+        Vec3 transformPoint(const Vec3& p) const;
+        // Transforms a direction, w = 0
+        Vec3 transformVector(const Vec3& v) const;
+
+        Mat4 transposed() const;
+        // Inverse of a matrix made of rotation, translation and non zero scale
+        Mat4 inverseAffine() const;
+
+        inline const float* data() const
+        {
+            return &columns[0].x;
+        }
+
+        inline float* data()
+        {
+            return &columns[0].x;
+        }
+    };
+
+    inline float dot(const Vec3& a, const Vec3& b)
+    {
+        return a.x * b.x + a.y * b.y + a.z * b.z;
+    }
+
+    inline float dot(const Vec4& a, const Vec4& b)
+    {
+        return a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w;
+    }
+
+    inline Vec3 cross(const Vec3& a, const Vec3& b)
+    {
+        return Vec3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+    }
+
+    inline float length(const Vec3& v)
+    {
+        return std::sqrt(dot(v, v));
+    }
+
+    // Returns v unchanged if it has no length
+    inline Vec3 normalize(const Vec3& v)
+    {
+        float len = length(v);
+        return len > 0.0f ? v * (1.0f / len) : v;
+    }
+
+    inline Quat normalize(const Quat& q)
+    {
+        float len = std::sqrt(q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w);
+        return len > 0.0f ? Quat(q.x / len, q.y / len, q.z / len, q.w / len) : Quat();
+    }
+
+    // Batched operations over arrays. Inputs and outputs may not overlap
+    // unless noted. They run the SSE paths when compiled in.
+
+    // out[i] = m * (points[i], 1)
+    void transformPoints(const Mat4& m, const Vec3* points, Vec3* out, size_t count);
+    // out[i] = a[i] * b[i], out may be a or b
+    void multiplyMatrices(const Mat4* a, const Mat4* b, Mat4* out, size_t count);
+    // out[i] = parent * local[i], out may be local (Eg: one level of a transform hierarchy)
+    void multiplyMatrices(const Mat4& parent, const Mat4* local, Mat4* out, size_t count);
+    // out[i] = fromTrs(translations[i], rotations[i], scales[i])
+    void composeTrs(const Vec3* translations, const Quat* rotations, const Vec3* scales, Mat4* out, size_t count);
+}
+
+#endif
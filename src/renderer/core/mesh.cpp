@@ -0,0 +1,141 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#include "mesh.h"
+
+void engine::computeNormals(MeshData& mesh, bool onlyMissing)
+{
+    // The cross product of two edges is the face normal scaled by twice the area
+    std::vector<float> computed(mesh.vertices.size() * 3, 0.0f);
+    for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+    {
+        const float* a = mesh.vertices[mesh.indices[i]].position;
+        const float* b = mesh.vertices[mesh.indices[i + 1]].position;
+        const float* c = mesh.vertices[mesh.indices[i + 2]].position;
+        float e1[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+        float e2[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+        float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+        for (int v = 0; v < 3; v++)
+        {
+            for (int k = 0; k < 3; k++)
+                computed[mesh.indices[i + v] * 3 + k] += n[k];
+        }
+    }
+
+    for (size_t v = 0; v < mesh.vertices.size(); v++)
+    {
+        float* normal = mesh.vertices[v].normal;
+        if (onlyMissing && (normal[0] != 0.0f || normal[1] != 0.0f || normal[2] != 0.0f))
+            continue;
+        const float* n = &computed[v * 3];
+        float len = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        if (len > 0.0f)
+        {
+            for (int k = 0; k < 3; k++)
+                normal[k] = n[k] / len;
+        }
+    }
+}
+
+uint16_t engine::quantizeHalf(float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    const uint32_t sign = (bits >> 16) & 0x8000;
+    const uint32_t magnitude = bits & 0x7FFFFFFF;
+
+    // NaN keeps a quiet NaN, too large values become infinity
+    if (magnitude > 0x7F800000)
+        return static_cast<uint16_t>(sign | 0x7E00);
+    if (magnitude >= 0x47800000)
+        return static_cast<uint16_t>(sign | 0x7C00);
+
+    // Too small for a normal half, denormals are produced by the float
+    // addition, which rounds to nearest even
+    if (magnitude < 0x38800000)
+    {
+        float absolute;
+        std::memcpy(&absolute, &magnitude, sizeof(absolute));
+        absolute += 0.5f;
+        uint32_t denormal;
+        std::memcpy(&denormal, &absolute, sizeof(denormal));
+        return static_cast<uint16_t>(sign | (denormal - 0x3F000000));
+    }
+
+    // Rebias the exponent and round the 13 dropped mantissa bits to nearest even
+    const uint32_t rounded = magnitude + 0xC8000FFF + ((magnitude >> 13) & 1);
+    return static_cast<uint16_t>(sign | (rounded >> 13));
+}
+
+float engine::dequantizeHalf(uint16_t value)
+{
+    const uint32_t sign = static_cast<uint32_t>(value & 0x8000) << 16;
+    const uint32_t exponent = (value >> 10) & 0x1F;
+    const uint32_t mantissa = value & 0x3FF;
+
+    float result;
+    if (exponent == 0)
+        result = std::ldexp(static_cast<float>(mantissa), -24);
+    else if (exponent == 31)
+        result = mantissa ? std::numeric_limits<float>::quiet_NaN() : std::numeric_limits<float>::infinity();
+    else
+        result = std::ldexp(static_cast<float>(mantissa | 0x400), static_cast<int>(exponent) - 25);
+
+    uint32_t bits;
+    std::memcpy(&bits, &result, sizeof(bits));
+    bits |= sign;
+    std::memcpy(&result, &bits, sizeof(result));
+    return result;
+}
+
+void engine::encodeOctahedral(const float normal[3], int16_t encoded[2])
+{
+    const float l1 = std::fabs(normal[0]) + std::fabs(normal[1]) + std::fabs(normal[2]);
+    float x = l1 > 0.0f ? normal[0] / l1 : 0.0f;
+    float y = l1 > 0.0f ? normal[1] / l1 : 0.0f;
+
+    // The lower hemisphere is folded over the diagonals
+    if (normal[2] < 0.0f)
+    {
+        const float foldedX = (1.0f - std::fabs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+        const float foldedY = (1.0f - std::fabs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+        x = foldedX;
+        y = foldedY;
+    }
+
+    encoded[0] = static_cast<int16_t>(std::lround(std::clamp(x, -1.0f, 1.0f) * 32767.0f));
+    encoded[1] = static_cast<int16_t>(std::lround(std::clamp(y, -1.0f, 1.0f) * 32767.0f));
+}
+
+void engine::decodeOctahedral(const int16_t encoded[2], float normal[3])
+{
+    float x = std::max(encoded[0] / 32767.0f, -1.0f);
+    float y = std::max(encoded[1] / 32767.0f, -1.0f);
+    const float z = 1.0f - std::fabs(x) - std::fabs(y);
+    if (z < 0.0f)
+    {
+        const float foldedX = (1.0f - std::fabs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+        const float foldedY = (1.0f - std::fabs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+        x = foldedX;
+        y = foldedY;
+    }
+
+    const float length = std::sqrt(x * x + y * y + z * z);
+    normal[0] = x / length;
+    normal[1] = y / length;
+    normal[2] = z / length;
+}
+
+engine::QuantizedVertex engine::quantizeVertex(const MeshVertex& vertex)
+{
+    QuantizedVertex quantized;
+    for (int k = 0; k < 3; k++)
+        quantized.position[k] = quantizeHalf(vertex.position[k]);
+    quantized.position[3] = quantizeHalf(1.0f);
+    encodeOctahedral(vertex.normal, quantized.normal);
+    quantized.uv[0] = quantizeHalf(vertex.uv[0]);
+    quantized.uv[1] = quantizeHalf(vertex.uv[1]);
+    return quantized;
+}
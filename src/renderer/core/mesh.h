@@ -0,0 +1,65 @@
+#ifndef MESH_H
+#define MESH_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace engine
+{
+    /**
+     * @brief Vertex layout shared by the mesh assets and the vertex shaders.
+     * 32 bytes, so two vertices fit a 64 byte cache line.
+     */
+    struct MeshVertex
+    {
+        float position[3] = { 0.0f, 0.0f, 0.0f };
+        float normal[3] = { 0.0f, 0.0f, 0.0f };
+        float uv[2] = { 0.0f, 0.0f };
+    };
+
+    /**
+     * @brief Compact vertex layout, 16 bytes instead of 32. Positions and uvs
+     * are half floats, which keeps about 3 significant digits, so positions
+     * should be in mesh space. Normals are octahedral encoded in two snorm16.
+     */
+    struct QuantizedVertex
+    {
+        // xyz and a w of 1.0
+        uint16_t position[4] = { 0, 0, 0, 0 };
+        int16_t normal[2] = { 0, 0 };
+        uint16_t uv[2] = { 0, 0 };
+    };
+
+    // Rounds to the nearest half float, values out of range become infinity
+    uint16_t quantizeHalf(float value);
+    float dequantizeHalf(uint16_t value);
+
+    /**
+     * @brief Maps a unit vector onto the octahedron unfolded into a square
+     * (Cigolle et al. 2014), stored as two snorm16
+     */
+    void encodeOctahedral(const float normal[3], int16_t encoded[2]);
+    void decodeOctahedral(const int16_t encoded[2], float normal[3]);
+
+    QuantizedVertex quantizeVertex(const MeshVertex& vertex);
+
+    // Indexed triangle list of one mesh, as loaded from a source asset
+    struct MeshData
+    {
+        std::string name;
+        std::vector<MeshVertex> vertices;
+        std::vector<uint32_t> indices;
+    };
+
+    /**
+     * @brief Computes area weighted vertex normals from the triangles
+     *
+     * @param mesh Mesh to update
+     * @param onlyMissing Only replaces normals which are zero (Eg: the source
+     * had normals for some vertices only)
+     */
+    void computeNormals(MeshData& mesh, bool onlyMissing = false);
+}
+
+#endif
@@ -0,0 +1,296 @@
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+
+#include "mesh_file.h"
+
+static uint64_t alignOffset(uint64_t offset)
+{
+    const uint64_t alignment = engine::MESH_FILE_ALIGNMENT;
+    return (offset + alignment - 1) & ~(alignment - 1);
+}
+
+// Sphere around the center of the bounding box, which is close enough for culling
+static void computeBounds(const engine::MeshData& mesh, engine::MeshFileEntry& entry)
+{
+    if (mesh.vertices.empty())
+        return;
+
+    float min[3], max[3];
+    for (int c = 0; c < 3; c++)
+        min[c] = max[c] = mesh.vertices[0].position[c];
+    for (const engine::MeshVertex& vertex : mesh.vertices)
+    {
+        for (int c = 0; c < 3; c++)
+        {
+            min[c] = std::min(min[c], vertex.position[c]);
+            max[c] = std::max(max[c], vertex.position[c]);
+        }
+    }
+
+    for (int c = 0; c < 3; c++)
+        entry.boundsCenter[c] = (min[c] + max[c]) * 0.5f;
+
+    float radius2 = 0.0f;
+    for (const engine::MeshVertex& vertex : mesh.vertices)
+    {
+        float dx = vertex.position[0] - entry.boundsCenter[0];
+        float dy = vertex.position[1] - entry.boundsCenter[1];
+        float dz = vertex.position[2] - entry.boundsCenter[2];
+        radius2 = std::max(radius2, dx * dx + dy * dy + dz * dz);
+    }
+    entry.boundsRadius = std::sqrt(radius2);
+}
+
+uint32_t engine::getVertexStride(MeshVertexFormat format)
+{
+    return format == MeshVertexFormat::Quantized ? sizeof(QuantizedVertex) : sizeof(MeshVertex);
+}
+
+bool engine::writeMeshFile(const std::string& path,
+    const std::vector<MeshData>& meshes,
+    MeshVertexFormat vertexFormat,
+    const std::vector<MeshletData>* meshlets,
+    const std::vector<std::vector<MeshLod>>* lods)
+{
+    MeshFileHeader header;
+    header.meshCount = static_cast<uint32_t>(meshes.size());
+    header.vertexFormat = vertexFormat;
+    header.vertexStride = getVertexStride(vertexFormat);
+
+    if (meshlets && meshlets->size() != meshes.size())
+    {
+        std::cerr << "Mesh file " << path << " needs the meshlets of every mesh" << std::endl;
+        return false;
+    }
+    if (lods && lods->size() != meshes.size())
+    {
+        std::cerr << "Mesh file " << path << " needs the levels of every mesh" << std::endl;
+        return false;
+    }
+
+    std::vector<MeshFileEntry> entries(meshes.size());
+    for (size_t i = 0; i < meshes.size(); i++)
+    {
+        entries[i].firstVertex = static_cast<uint32_t>(header.vertexCount);
+        entries[i].vertexCount = static_cast<uint32_t>(meshes[i].vertices.size());
+        entries[i].firstIndex = static_cast<uint32_t>(header.indexCount);
+        entries[i].indexCount = static_cast<uint32_t>(meshes[i].indices.size());
+        computeBounds(meshes[i], entries[i]);
+        if (meshlets)
+        {
+            entries[i].firstMeshlet = static_cast<uint32_t>(header.meshletCount);
+            entries[i].meshletCount = static_cast<uint32_t>((*meshlets)[i].meshlets.size());
+            header.meshletCount += (*meshlets)[i].meshlets.size();
+            header.meshletVertexCount += (*meshlets)[i].vertices.size();
+        }
+        if (lods && !(*lods)[i].empty())
+        {
+            entries[i].firstLod = static_cast<uint32_t>(header.lodCount);
+            entries[i].lodCount = static_cast<uint32_t>(std::min<size_t>((*lods)[i].size() + 1, MAX_LOD_COUNT));
+            header.lodCount += entries[i].lodCount;
+        }
+        header.vertexCount += meshes[i].vertices.size();
+        header.indexCount += meshes[i].indices.size();
+    }
+
+    // Level 0 is the mesh itself, the simplified levels follow every full detail mesh
+    std::vector<MeshFileLod> fileLods;
+    fileLods.reserve(header.lodCount);
+    for (size_t i = 0; i < meshes.size(); i++)
+    {
+        for (uint32_t level = 0; level < entries[i].lodCount; level++)
+        {
+            MeshFileLod lod;
+            lod.firstIndex = entries[i].firstIndex;
+            lod.indexCount = entries[i].indexCount;
+            if (level > 0)
+            {
+                const MeshLod& source = (*lods)[i][level - 1];
+                lod.firstIndex = static_cast<uint32_t>(header.indexCount + header.lodIndexCount);
+                lod.indexCount = static_cast<uint32_t>(source.indices.size());
+                lod.error = source.error;
+                header.lodIndexCount += source.indices.size();
+            }
+            fileLods.push_back(lod);
+        }
+    }
+
+    header.tocOffset = alignOffset(sizeof(MeshFileHeader));
+    header.vertexOffset = alignOffset(header.tocOffset + entries.size() * sizeof(MeshFileEntry));
+    header.indexOffset = alignOffset(header.vertexOffset + header.vertexCount * header.vertexStride);
+    uint64_t end = header.indexOffset + (header.indexCount + header.lodIndexCount) * sizeof(uint32_t);
+    if (header.meshletCount > 0)
+    {
+        header.meshletOffset = alignOffset(end);
+        header.meshletVertexOffset = alignOffset(header.meshletOffset + header.meshletCount * sizeof(Meshlet));
+        header.meshletTriangleOffset = alignOffset(header.meshletVertexOffset + header.meshletVertexCount * sizeof(uint32_t));
+        end = header.meshletTriangleOffset + header.indexCount / 3 * sizeof(uint32_t);
+    }
+    if (header.lodCount > 0)
+        header.lodOffset = alignOffset(end);
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open())
+    {
+        std::cerr << "Failed to open mesh file " << path << std::endl;
+        return false;
+    }
+
+    uint64_t position = 0;
+    auto write = [&](uint64_t offset, const void* data, uint64_t size)
+    {
+        static const char PADDING[MESH_FILE_ALIGNMENT] = {};
+        file.write(PADDING, static_cast<std::streamsize>(offset - position));
+        file.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+        position = offset + size;
+    };
+
+    write(0, &header, sizeof(header));
+    write(header.tocOffset, entries.data(), entries.size() * sizeof(MeshFileEntry));
+    write(header.vertexOffset, nullptr, 0);
+    std::vector<QuantizedVertex> quantized;
+    for (const MeshData& mesh : meshes)
+    {
+        if (vertexFormat == MeshVertexFormat::Quantized)
+        {
+            quantized.resize(mesh.vertices.size());
+            for (size_t i = 0; i < mesh.vertices.size(); i++)
+                quantized[i] = quantizeVertex(mesh.vertices[i]);
+            write(position, quantized.data(), quantized.size() * sizeof(QuantizedVertex));
+        }
+        else
+            write(position, mesh.vertices.data(), mesh.vertices.size() * sizeof(MeshVertex));
+    }
+    write(header.indexOffset, nullptr, 0);
+    for (const MeshData& mesh : meshes)
+        write(position, mesh.indices.data(), mesh.indices.size() * sizeof(uint32_t));
+    for (size_t i = 0; i < meshes.size(); i++)
+    {
+        for (uint32_t level = 1; level < entries[i].lodCount; level++)
+        {
+            const std::vector<uint32_t>& indices = (*lods)[i][level - 1].indices;
+            write(position, indices.data(), indices.size() * sizeof(uint32_t));
+        }
+    }
+    if (header.meshletCount > 0)
+    {
+        // Meshlet offsets become file wide, their vertices stay relative to the mesh
+        write(header.meshletOffset, nullptr, 0);
+        std::vector<Meshlet> fileMeshlets;
+        uint32_t firstMeshletVertex = 0;
+        for (size_t i = 0; i < meshes.size(); i++)
+        {
+            fileMeshlets = (*meshlets)[i].meshlets;
+            for (Meshlet& meshlet : fileMeshlets)
+            {
+                meshlet.vertexOffset += firstMeshletVertex;
+                meshlet.triangleOffset += entries[i].firstIndex / 3;
+            }
+            write(position, fileMeshlets.data(), fileMeshlets.size() * sizeof(Meshlet));
+            firstMeshletVertex += static_cast<uint32_t>((*meshlets)[i].vertices.size());
+        }
+        write(header.meshletVertexOffset, nullptr, 0);
+        for (const MeshletData& data : *meshlets)
+            write(position, data.vertices.data(), data.vertices.size() * sizeof(uint32_t));
+        write(header.meshletTriangleOffset, nullptr, 0);
+        for (const MeshletData& data : *meshlets)
+            write(position, data.triangles.data(), data.triangles.size() * sizeof(uint32_t));
+    }
+    if (header.lodCount > 0)
+        write(header.lodOffset, fileLods.data(), fileLods.size() * sizeof(MeshFileLod));
+
+    if (!file.good())
+    {
+        std::cerr << "Failed to write mesh file " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool engine::MeshFile::open(const std::string& path)
+{
+    close();
+    if (!m_file.open(path))
+    {
+        std::cerr << "Failed to map mesh file " << path << std::endl;
+        return false;
+    }
+
+    const uint64_t size = m_file.size();
+    const MeshFileHeader* header = static_cast<const MeshFileHeader*>(m_file.data());
+    auto fits = [size](uint64_t offset, uint64_t count, uint64_t stride)
+    {
+        return offset % MESH_FILE_ALIGNMENT == 0 && offset <= size && count <= (size - offset) / stride;
+    };
+
+    bool isValid = size >= sizeof(MeshFileHeader)
+        && header->magic == MESH_FILE_MAGIC
+        && header->version == MESH_FILE_VERSION
+        && (header->vertexFormat == MeshVertexFormat::Float || header->vertexFormat == MeshVertexFormat::Quantized)
+        && header->vertexStride == engine::getVertexStride(header->vertexFormat)
+        && fits(header->tocOffset, header->meshCount, sizeof(MeshFileEntry))
+        && fits(header->vertexOffset, header->vertexCount, header->vertexStride)
+        && fits(header->indexOffset, header->indexCount + header->lodIndexCount, sizeof(uint32_t))
+        && (header->meshletCount == 0
+            || (fits(header->meshletOffset, header->meshletCount, sizeof(Meshlet))
+                && fits(header->meshletVertexOffset, header->meshletVertexCount, sizeof(uint32_t))
+                && fits(header->meshletTriangleOffset, header->indexCount / 3, sizeof(uint32_t))))
+        && (header->lodCount == 0 || fits(header->lodOffset, header->lodCount, sizeof(MeshFileLod)));
+    if (!isValid)
+    {
+        std::cerr << "Mesh file " << path << " is invalid or of another version" << std::endl;
+        m_file.close();
+        return false;
+    }
+
+    // Ranges of the entries are checked once here, so users can trust them
+    m_header = header;
+    const MeshFileEntry* entries = getMeshes();
+    for (uint32_t i = 0; i < header->meshCount; i++)
+    {
+        const MeshFileEntry& entry = entries[i];
+        if (static_cast<uint64_t>(entry.firstVertex) + entry.vertexCount > header->vertexCount
+            || static_cast<uint64_t>(entry.firstIndex) + entry.indexCount > header->indexCount
+            || static_cast<uint64_t>(entry.firstMeshlet) + entry.meshletCount > header->meshletCount
+            || static_cast<uint64_t>(entry.firstLod) + entry.lodCount > header->lodCount
+            || entry.lodCount > MAX_LOD_COUNT)
+        {
+            std::cerr << "Mesh file " << path << " has a mesh out of range" << std::endl;
+            close();
+            return false;
+        }
+    }
+    const Meshlet* meshlets = getMeshlets();
+    for (uint64_t i = 0; i < header->meshletCount; i++)
+    {
+        const Meshlet& meshlet = meshlets[i];
+        if (static_cast<uint64_t>(meshlet.vertexOffset) + meshlet.vertexCount > header->meshletVertexCount
+            || static_cast<uint64_t>(meshlet.triangleOffset) + meshlet.triangleCount > header->indexCount / 3
+            || meshlet.vertexCount > MAX_MESHLET_VERTICES
+            || meshlet.triangleCount > MAX_MESHLET_TRIANGLES)
+        {
+            std::cerr << "Mesh file " << path << " has a meshlet out of range" << std::endl;
+            close();
+            return false;
+        }
+    }
+    const MeshFileLod* lods = getLods();
+    for (uint64_t i = 0; i < header->lodCount; i++)
+    {
+        if (static_cast<uint64_t>(lods[i].firstIndex) + lods[i].indexCount > header->indexCount + header->lodIndexCount)
+        {
+            std::cerr << "Mesh file " << path << " has a level out of range" << std::endl;
+            close();
+            return false;
+        }
+    }
+    return true;
+}
+
+void engine::MeshFile::close()
+{
+    m_header = nullptr;
+    m_file.close();
+}
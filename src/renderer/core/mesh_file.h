@@ -0,0 +1,257 @@
+#ifndef MESH_FILE_H
+#define MESH_FILE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "mesh.h"
+#include "meshlet.h"
+#include "lod.h"
+#include "mapped_file.h"
+
+namespace engine
+{
+    // "VEMS" in a little endian file
+    static const uint32_t MESH_FILE_MAGIC = 0x534D4556;
+    static const uint32_t MESH_FILE_VERSION = 4;
+    // Alignment of the table of contents and the vertex and index blobs in the file
+    static const uint32_t MESH_FILE_ALIGNMENT = 64;
+
+    enum class MeshVertexFormat : uint32_t
+    {
+        // MeshVertex
+        Float = 0,
+        // QuantizedVertex
+        Quantized
+    };
+
+    /**
+     * @brief Header at the start of a mesh file. The file is little endian,
+     * offsets are in bytes from the start of the file.
+     *
+     * @param vertexStride Size of a vertex of vertexFormat
+     * @param tocOffset Offset of the meshCount MeshFileEntry
+     * @param vertexOffset Offset of the vertices of every mesh, packed
+     * @param indexOffset Offset of the uint32_t indices of every mesh, packed,
+     * followed by the lodIndexCount indices of their simplified levels
+     * @param meshletOffset Offset of the Meshlet of every mesh, 0 if the file has no meshlets
+     * @param meshletVertexOffset Offset of the uint32_t meshlet vertex lists of every mesh
+     * @param meshletTriangleOffset Offset of the packed meshlet local triangles,
+     * one uint32_t per triangle of the full detail meshes
+     * @param lodOffset Offset of the MeshFileLod of every mesh, 0 if the file has no levels
+     */
+    struct MeshFileHeader
+    {
+        uint32_t magic = MESH_FILE_MAGIC;
+        uint32_t version = MESH_FILE_VERSION;
+        uint32_t meshCount = 0;
+        uint32_t vertexStride = sizeof(MeshVertex);
+        MeshVertexFormat vertexFormat = MeshVertexFormat::Float;
+        uint32_t reserved = 0;
+        uint64_t tocOffset = 0;
+        uint64_t vertexOffset = 0;
+        uint64_t vertexCount = 0;
+        uint64_t indexOffset = 0;
+        uint64_t indexCount = 0;
+        uint64_t meshletOffset = 0;
+        uint64_t meshletCount = 0;
+        uint64_t meshletVertexOffset = 0;
+        uint64_t meshletVertexCount = 0;
+        uint64_t meshletTriangleOffset = 0;
+        uint64_t lodOffset = 0;
+        uint64_t lodCount = 0;
+        uint64_t lodIndexCount = 0;
+    };
+
+    /**
+     * @brief Level of detail of a mesh. Levels are index ranges over the
+     * vertices of the mesh, level 0 is the mesh itself.
+     *
+     * @param firstIndex First index of the level in the file, the simplified
+     * levels come after every full detail mesh in the index blob
+     * @param error Mesh space distance the level may be off the full detail mesh
+     */
+    struct MeshFileLod
+    {
+        uint32_t firstIndex = 0;
+        uint32_t indexCount = 0;
+        float error = 0.0f;
+        uint32_t reserved = 0;
+    };
+
+    /**
+     * @brief Table of contents entry of one mesh. Indices are relative to the
+     * first vertex of the mesh, which matches the vertexOffset of an indexed draw.
+     * So are the meshlet vertices, while the offsets inside the meshlets are
+     * file wide (Eg: triangleOffset * 3 is the meshlet's first index in the file).
+     *
+     * @param boundsCenter Center of the bounding sphere, in mesh space
+     * @param lodCount Number of levels including level 0, at most
+     * MAX_LOD_COUNT, 0 if the mesh has no simplified levels
+     */
+    struct MeshFileEntry
+    {
+        uint32_t firstVertex = 0;
+        uint32_t vertexCount = 0;
+        uint32_t firstIndex = 0;
+        uint32_t indexCount = 0;
+        float boundsCenter[3] = { 0.0f, 0.0f, 0.0f };
+        float boundsRadius = 0.0f;
+        uint32_t firstMeshlet = 0;
+        uint32_t meshletCount = 0;
+        uint32_t firstLod = 0;
+        uint32_t lodCount = 0;
+    };
+
+    /**
+     * @brief Writes meshes as a mesh file
+     *
+     * @param path Path of the file
+     * @param meshes Meshes to pack
+     * @param vertexFormat Layout the vertices are stored in
+     * @param meshlets Optional, meshlets buildMeshlets() made of each of the meshes
+     * @param lods Optional, simplified levels buildLods() made of each of the meshes
+     * @return false if the file couldn't be written
+     */
+    bool writeMeshFile(const std::string& path,
+        const std::vector<MeshData>& meshes,
+        MeshVertexFormat vertexFormat = MeshVertexFormat::Float,
+        const std::vector<MeshletData>* meshlets = nullptr,
+        const std::vector<std::vector<MeshLod>>* lods = nullptr);
+
+    // Size of a vertex of the format
+    uint32_t getVertexStride(MeshVertexFormat format);
+
+    /**
+     * @brief Mesh file opened through a memory mapping. The accessors point
+     * straight into the mapping, so loading does no parsing and no copies, and
+     * the vertex and index ranges can be handed to the upload as they are.
+     * Pointers stay valid until close().
+     */
+    class MeshFile
+    {
+    private:
+        MappedFile m_file;
+        const MeshFileHeader* m_header = nullptr;
+
+        inline const uint8_t* bytes() const
+        {
+            return static_cast<const uint8_t*>(m_file.data());
+        }
+
+    public:
+        MeshFile() = default;
+        MeshFile(const MeshFile&) = delete;
+        MeshFile& operator=(const MeshFile&) = delete;
+
+        /**
+         * @brief Maps the file and checks the header
+         *
+         * @param path Path of the mesh file
+         * @return false if the file can't be mapped, is of another version or
+         * its ranges don't fit in the file
+         */
+        bool open(const std::string& path);
+        void close();
+
+        inline uint32_t getMeshCount() const
+        {
+            return m_header ? m_header->meshCount : 0;
+        }
+
+        inline const MeshFileEntry* getMeshes() const
+        {
+            return m_header ? reinterpret_cast<const MeshFileEntry*>(bytes() + m_header->tocOffset) : nullptr;
+        }
+
+        inline MeshVertexFormat getVertexFormat() const
+        {
+            return m_header ? m_header->vertexFormat : MeshVertexFormat::Float;
+        }
+
+        inline uint32_t getVertexStride() const
+        {
+            return m_header ? m_header->vertexStride : 0;
+        }
+
+        // Vertices of every mesh in the file's vertex format
+        inline const void* getVertexData() const
+        {
+            return m_header ? bytes() + m_header->vertexOffset : nullptr;
+        }
+
+        // nullptr unless the vertices are stored as MeshVertex
+        inline const MeshVertex* getVertices() const
+        {
+            return getVertexFormat() == MeshVertexFormat::Float ? static_cast<const MeshVertex*>(getVertexData()) : nullptr;
+        }
+
+        inline uint64_t getVertexCount() const
+        {
+            return m_header ? m_header->vertexCount : 0;
+        }
+
+        // Indices of the full detail meshes, followed by the ones of their levels
+        inline const uint32_t* getIndices() const
+        {
+            return m_header ? reinterpret_cast<const uint32_t*>(bytes() + m_header->indexOffset) : nullptr;
+        }
+
+        // Indices of the full detail meshes only
+        inline uint64_t getIndexCount() const
+        {
+            return m_header ? m_header->indexCount : 0;
+        }
+
+        inline uint64_t getLodIndexCount() const
+        {
+            return m_header ? m_header->lodIndexCount : 0;
+        }
+
+        // Levels of every mesh, nullptr if the file has none
+        inline const MeshFileLod* getLods() const
+        {
+            return getLodCount() > 0 ? reinterpret_cast<const MeshFileLod*>(bytes() + m_header->lodOffset) : nullptr;
+        }
+
+        inline uint64_t getLodCount() const
+        {
+            return m_header ? m_header->lodCount : 0;
+        }
+
+        // Meshlets of every mesh, nullptr if the file has none
+        inline const Meshlet* getMeshlets() const
+        {
+            return getMeshletCount() > 0 ? reinterpret_cast<const Meshlet*>(bytes() + m_header->meshletOffset) : nullptr;
+        }
+
+        inline uint64_t getMeshletCount() const
+        {
+            return m_header ? m_header->meshletCount : 0;
+        }
+
+        inline const uint32_t* getMeshletVertices() const
+        {
+            return getMeshletCount() > 0 ? reinterpret_cast<const uint32_t*>(bytes() + m_header->meshletVertexOffset) : nullptr;
+        }
+
+        inline uint64_t getMeshletVertexCount() const
+        {
+            return m_header ? m_header->meshletVertexCount : 0;
+        }
+
+        // Packed local triangles, getIndexCount() / 3 of them if the file has meshlets
+        inline const uint32_t* getMeshletTriangles() const
+        {
+            return getMeshletCount() > 0 ? reinterpret_cast<const uint32_t*>(bytes() + m_header->meshletTriangleOffset) : nullptr;
+        }
+
+        inline bool isOpen() const
+        {
+            return m_header != nullptr;
+        }
+    };
+}
+
+#endif
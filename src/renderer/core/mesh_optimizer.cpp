@@ -0,0 +1,311 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "mesh_optimizer.h"
+
+static const uint32_t INVALID_VERTEX = std::numeric_limits<uint32_t>::max();
+
+namespace
+{
+    /**
+     * @brief FIFO cache simulation with insertion timestamps. A vertex is
+     * cached while fewer than cacheSize vertices were inserted after it, so
+     * there is no queue to shift and bumping the time clears the cache.
+     */
+    struct FifoCache
+    {
+        std::vector<uint32_t> timestamps;
+        uint32_t time;
+        uint32_t size;
+
+        FifoCache(uint32_t vertexCount, uint32_t cacheSize)
+            : timestamps(vertexCount, 0), time{cacheSize + 1}, size{cacheSize}
+        {
+        }
+
+        // Returns true on a miss
+        inline bool access(uint32_t vertex)
+        {
+            if (time - timestamps[vertex] <= size)
+                return false;
+            timestamps[vertex] = time++;
+            return true;
+        }
+
+        inline void clear()
+        {
+            time += size + 1;
+        }
+    };
+
+    struct Cluster
+    {
+        uint32_t firstTriangle;
+        uint32_t triangleCount;
+        float sortKey;
+    };
+}
+
+engine::VertexCacheStats engine::analyzeVertexCache(const uint32_t* indices,
+    size_t indexCount,
+    uint32_t vertexCount,
+    uint32_t cacheSize)
+{
+    VertexCacheStats stats;
+    if (indexCount < 3 || vertexCount == 0)
+        return stats;
+
+    FifoCache cache(vertexCount, cacheSize);
+    for (size_t i = 0; i < indexCount; i++)
+        stats.misses += cache.access(indices[i]) ? 1 : 0;
+
+    stats.acmr = static_cast<float>(stats.misses) / static_cast<float>(indexCount / 3);
+    stats.atvr = static_cast<float>(stats.misses) / static_cast<float>(vertexCount);
+    return stats;
+}
+
+void engine::optimizeVertexCache(std::vector<uint32_t>& indices,
+    uint32_t vertexCount,
+    uint32_t cacheSize,
+    std::vector<uint32_t>* clusters)
+{
+    const size_t triangleCount = indices.size() / 3;
+    if (clusters)
+        clusters->clear();
+    if (triangleCount == 0)
+        return;
+
+    // Triangles around each vertex, and how many of them are left to emit
+    std::vector<uint32_t> liveCounts(vertexCount, 0);
+    for (size_t i = 0; i < triangleCount * 3; i++)
+        liveCounts[indices[i]]++;
+    std::vector<uint32_t> offsets(vertexCount + 1, 0);
+    for (uint32_t v = 0; v < vertexCount; v++)
+        offsets[v + 1] = offsets[v] + liveCounts[v];
+    std::vector<uint32_t> adjacency(offsets[vertexCount]);
+    {
+        std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < triangleCount * 3; i++)
+            adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+    }
+
+    std::vector<uint32_t> timestamps(vertexCount, 0);
+    uint32_t time = cacheSize + 1;
+    std::vector<uint8_t> isEmitted(triangleCount, 0);
+    std::vector<uint32_t> deadEnds;
+    std::vector<uint32_t> candidates;
+    std::vector<uint32_t> result;
+    result.reserve(triangleCount * 3);
+    uint32_t cursor = 0;
+
+    // Recently used vertices with triangles left, then the first one in index order
+    auto skipDeadEnd = [&]() -> uint32_t
+    {
+        while (!deadEnds.empty())
+        {
+            uint32_t vertex = deadEnds.back();
+            deadEnds.pop_back();
+            if (liveCounts[vertex] > 0)
+                return vertex;
+        }
+        for (; cursor < vertexCount; cursor++)
+        {
+            if (liveCounts[cursor] > 0)
+                return cursor;
+        }
+        return INVALID_VERTEX;
+    };
+
+    uint32_t fan = skipDeadEnd();
+    bool isRestart = true;
+    while (fan != INVALID_VERTEX)
+    {
+        if (isRestart && clusters)
+            clusters->push_back(static_cast<uint32_t>(result.size() / 3));
+
+        candidates.clear();
+        for (uint32_t a = offsets[fan]; a < offsets[fan + 1]; a++)
+        {
+            const uint32_t triangle = adjacency[a];
+            if (isEmitted[triangle])
+                continue;
+            isEmitted[triangle] = 1;
+
+            for (uint32_t k = 0; k < 3; k++)
+            {
+                const uint32_t vertex = indices[triangle * 3 + k];
+                result.push_back(vertex);
+                deadEnds.push_back(vertex);
+                candidates.push_back(vertex);
+                liveCounts[vertex]--;
+                if (time - timestamps[vertex] > cacheSize)
+                    timestamps[vertex] = time++;
+            }
+        }
+
+        // Prefer the oldest vertex which stays in the cache while its remaining
+        // triangles are emitted, vertices which would fall out score 0
+        uint32_t next = INVALID_VERTEX;
+        int64_t bestPriority = -1;
+        for (uint32_t vertex : candidates)
+        {
+            if (liveCounts[vertex] == 0)
+                continue;
+            int64_t priority = 0;
+            const uint32_t age = time - timestamps[vertex];
+            if (age + 2 * liveCounts[vertex] <= cacheSize)
+                priority = age;
+            if (priority > bestPriority)
+            {
+                bestPriority = priority;
+                next = vertex;
+            }
+        }
+
+        isRestart = next == INVALID_VERTEX;
+        fan = isRestart ? skipDeadEnd() : next;
+    }
+
+    indices.swap(result);
+}
+
+void engine::optimizeOverdraw(std::vector<uint32_t>& indices,
+    const std::vector<MeshVertex>& vertices,
+    const std::vector<uint32_t>& clusters,
+    uint32_t cacheSize,
+    float threshold)
+{
+    const uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+    const uint32_t vertexCount = static_cast<uint32_t>(vertices.size());
+    if (triangleCount == 0)
+        return;
+
+    std::vector<uint32_t> hardStarts = clusters;
+    if (hardStarts.empty() || hardStarts[0] != 0)
+        hardStarts.insert(hardStarts.begin(), 0);
+    hardStarts.push_back(triangleCount);
+
+    // Splits each hard cluster wherever the part so far already reaches the
+    // cluster's miss ratio, the reordering then costs little cache efficiency
+    FifoCache cache(vertexCount, cacheSize);
+    auto accessTriangle = [&](uint32_t triangle)
+    {
+        uint32_t misses = 0;
+        for (uint32_t k = 0; k < 3; k++)
+            misses += cache.access(indices[triangle * 3 + k]) ? 1 : 0;
+        return misses;
+    };
+
+    std::vector<Cluster> softClusters;
+    for (size_t h = 0; h + 1 < hardStarts.size(); h++)
+    {
+        const uint32_t begin = hardStarts[h];
+        const uint32_t end = hardStarts[h + 1];
+        if (begin >= end)
+            continue;
+
+        cache.clear();
+        uint32_t clusterMisses = 0;
+        for (uint32_t t = begin; t < end; t++)
+            clusterMisses += accessTriangle(t);
+        const float limit = threshold * static_cast<float>(clusterMisses) / static_cast<float>(end - begin);
+
+        cache.clear();
+        uint32_t start = begin;
+        uint32_t misses = 0;
+        for (uint32_t t = begin; t < end; t++)
+        {
+            misses += accessTriangle(t);
+            if (t + 1 < end && static_cast<float>(misses) <= limit * static_cast<float>(t + 1 - start))
+            {
+                softClusters.push_back(Cluster{ start, t + 1 - start, 0.0f });
+                start = t + 1;
+                misses = 0;
+                cache.clear();
+            }
+        }
+        softClusters.push_back(Cluster{ start, end - start, 0.0f });
+    }
+
+    // Mesh centroid, weighted by triangle area like the cluster centroids
+    float meshCenter[3] = { 0.0f, 0.0f, 0.0f };
+    float meshArea = 0.0f;
+    std::vector<float> clusterData(softClusters.size() * 7, 0.0f);
+    for (size_t c = 0; c < softClusters.size(); c++)
+    {
+        // Area weighted centroid (xyz), area (w) and summed normal of the cluster
+        float* data = &clusterData[c * 7];
+        for (uint32_t t = softClusters[c].firstTriangle; t < softClusters[c].firstTriangle + softClusters[c].triangleCount; t++)
+        {
+            const float* a = vertices[indices[t * 3]].position;
+            const float* b = vertices[indices[t * 3 + 1]].position;
+            const float* p = vertices[indices[t * 3 + 2]].position;
+            const float e1[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+            const float e2[3] = { p[0] - a[0], p[1] - a[1], p[2] - a[2] };
+            const float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+            const float area = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            for (int k = 0; k < 3; k++)
+            {
+                data[k] += (a[k] + b[k] + p[k]) / 3.0f * area;
+                data[4 + k] += n[k];
+            }
+            data[3] += area;
+        }
+        for (int k = 0; k < 3; k++)
+            meshCenter[k] += data[k];
+        meshArea += data[3];
+    }
+    for (int k = 0; k < 3; k++)
+        meshCenter[k] = meshArea > 0.0f ? meshCenter[k] / meshArea : 0.0f;
+
+    // Clusters far out along their normal are likely in front of the rest
+    for (size_t c = 0; c < softClusters.size(); c++)
+    {
+        const float* data = &clusterData[c * 7];
+        const float normalLength = std::sqrt(data[4] * data[4] + data[5] * data[5] + data[6] * data[6]);
+        if (data[3] <= 0.0f || normalLength <= 0.0f)
+            continue;
+        float key = 0.0f;
+        for (int k = 0; k < 3; k++)
+            key += (data[k] / data[3] - meshCenter[k]) * data[4 + k] / normalLength;
+        softClusters[c].sortKey = key;
+    }
+    std::stable_sort(softClusters.begin(), softClusters.end(), [](const Cluster& a, const Cluster& b)
+        { return a.sortKey > b.sortKey; });
+
+    std::vector<uint32_t> result;
+    result.reserve(indices.size());
+    for (const Cluster& cluster : softClusters)
+    {
+        result.insert(result.end(),
+            indices.begin() + cluster.firstTriangle * 3,
+            indices.begin() + (cluster.firstTriangle + cluster.triangleCount) * 3);
+    }
+    indices.swap(result);
+}
+
+void engine::optimizeVertexFetch(MeshData& mesh)
+{
+    std::vector<uint32_t> remap(mesh.vertices.size(), INVALID_VERTEX);
+    std::vector<MeshVertex> vertices;
+    vertices.reserve(mesh.vertices.size());
+    for (uint32_t& index : mesh.indices)
+    {
+        if (remap[index] == INVALID_VERTEX)
+        {
+            remap[index] = static_cast<uint32_t>(vertices.size());
+            vertices.push_back(mesh.vertices[index]);
+        }
+        index = remap[index];
+    }
+    mesh.vertices.swap(vertices);
+}
+
+void engine::optimizeMesh(MeshData& mesh, uint32_t cacheSize, float overdrawThreshold)
+{
+    std::vector<uint32_t> clusters;
+    optimizeVertexCache(mesh.indices, static_cast<uint32_t>(mesh.vertices.size()), cacheSize, &clusters);
+    optimizeOverdraw(mesh.indices, mesh.vertices, clusters, cacheSize, overdrawThreshold);
+    optimizeVertexFetch(mesh);
+}
@@ -0,0 +1,98 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "mesh.h"
+
+namespace engine
+{
+    // Post transform cache size the optimizations assume, a typical FIFO size on current GPUs
+    static const uint32_t DEFAULT_VERTEX_CACHE_SIZE = 16;
+
+    /**
+     * @brief Result of running an index buffer through a FIFO vertex cache
+     *
+     * @param acmr Average cache miss ratio, vertex shader runs per triangle (0.5 is the ideal for large grids, 3 the worst)
+     * @param atvr Average transformed vertex ratio, vertex shader runs per vertex (1 is the ideal)
+     */
+    struct VertexCacheStats
+    {
+        uint32_t misses = 0;
+        float acmr = 0.0f;
+        float atvr = 0.0f;
+    };
+
+    /**
+     * @brief Simulates a FIFO post transform vertex cache over the triangles
+     *
+     * @param indices Triangle list
+     * @param indexCount Number of indices
+     * @param vertexCount Number of vertices the indices refer to
+     * @param cacheSize Number of entries of the simulated cache
+     * @return misses and the derived ratios
+     */
+    VertexCacheStats analyzeVertexCache(const uint32_t* indices,
+        size_t indexCount,
+        uint32_t vertexCount,
+        uint32_t cacheSize = DEFAULT_VERTEX_CACHE_SIZE);
+
+    /**
+     * @brief Reorders triangles for the post transform vertex cache with
+     * Tipsify (Sander et al. 2007). Triangles are emitted in fans around a
+     * vertex, and the next fan vertex is the one which is still in the cache
+     * and has the fewest triangles left. Linear in the triangle count.
+     *
+     * @param indices Triangle list, reordered in place
+     * @param vertexCount Number of vertices the indices refer to
+     * @param cacheSize Cache size to optimize for
+     * @param clusters Optional, receives the first triangle of every run
+     * which started at a dead end, where the cache effectively restarts
+     */
+    void optimizeVertexCache(std::vector<uint32_t>& indices,
+        uint32_t vertexCount,
+        uint32_t cacheSize = DEFAULT_VERTEX_CACHE_SIZE,
+        std::vector<uint32_t>* clusters = nullptr);
+
+    /**
+     * @brief Reorders clusters of triangles so that the ones facing out of the
+     * mesh are drawn first and occlude the rest, which cuts overdraw from any
+     * view direction. Clusters are split further as long as their cache miss
+     * ratio stays within threshold of the cache optimized order, so this
+     * trades at most that much vertex cache efficiency.
+     *
+     * @param indices Triangle list ordered by optimizeVertexCache(), reordered in place
+     * @param vertices Vertices the indices refer to
+     * @param clusters Cluster starts returned by optimizeVertexCache()
+     * @param cacheSize Cache size the indices were optimized for
+     * @param threshold Allowed cache miss ratio increase (Eg: 1.05 for 5%)
+     */
+    void optimizeOverdraw(std::vector<uint32_t>& indices,
+        const std::vector<MeshVertex>& vertices,
+        const std::vector<uint32_t>& clusters,
+        uint32_t cacheSize = DEFAULT_VERTEX_CACHE_SIZE,
+        float threshold = 1.05f);
+
+    /**
+     * @brief Reorders vertices in the order the indices first use them, so
+     * vertex fetches walk memory forward. Unused vertices are removed.
+     *
+     * @param mesh Mesh whose vertices are reordered and indices remapped
+     */
+    void optimizeVertexFetch(MeshData& mesh);
+
+    /**
+     * @brief Runs the vertex cache, overdraw and vertex fetch optimizations in order
+     *
+     * @param mesh Mesh to optimize in place
+     * @param cacheSize Cache size to optimize for
+     * @param overdrawThreshold Allowed cache miss ratio increase of the overdraw pass
+     */
+    void optimizeMesh(MeshData& mesh,
+        uint32_t cacheSize = DEFAULT_VERTEX_CACHE_SIZE,
+        float overdrawThreshold = 1.05f);
+}
+
+#endif
@@ -0,0 +1,300 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "meshlet.h"
+
+namespace
+{
+    using engine::Meshlet;
+    using engine::MeshVertex;
+
+    // Bounding sphere and normal cone of the meshlet's vertices and triangles
+    void computeBounds(const std::vector<MeshVertex>& vertices,
+        const std::vector<uint32_t>& indices,
+        const engine::MeshletData& data,
+        Meshlet& meshlet)
+    {
+        // Sphere around the center of the bounding box, like the mesh bounds
+        float min[3], max[3];
+        for (int c = 0; c < 3; c++)
+        {
+            min[c] = std::numeric_limits<float>::max();
+            max[c] = -std::numeric_limits<float>::max();
+        }
+        for (uint32_t i = 0; i < meshlet.vertexCount; i++)
+        {
+            const float* p = vertices[data.vertices[meshlet.vertexOffset + i]].position;
+            for (int c = 0; c < 3; c++)
+            {
+                min[c] = std::min(min[c], p[c]);
+                max[c] = std::max(max[c], p[c]);
+            }
+        }
+        for (int c = 0; c < 3; c++)
+            meshlet.center[c] = (min[c] + max[c]) * 0.5f;
+        float radius2 = 0.0f;
+        for (uint32_t i = 0; i < meshlet.vertexCount; i++)
+        {
+            const float* p = vertices[data.vertices[meshlet.vertexOffset + i]].position;
+            const float dx = p[0] - meshlet.center[0];
+            const float dy = p[1] - meshlet.center[1];
+            const float dz = p[2] - meshlet.center[2];
+            radius2 = std::max(radius2, dx * dx + dy * dy + dz * dz);
+        }
+        meshlet.radius = std::sqrt(radius2);
+
+        // Unit face normals, the axis is their average
+        float normals[engine::MAX_MESHLET_TRIANGLES * 3];
+        float* normal = normals;
+        float axis[3] = { 0.0f, 0.0f, 0.0f };
+        const uint32_t triangleCount = std::min(meshlet.triangleCount, engine::MAX_MESHLET_TRIANGLES);
+        for (uint32_t t = 0; t < triangleCount; t++)
+        {
+            const uint32_t* triangle = &indices[(meshlet.triangleOffset + t) * 3];
+            const float* a = vertices[triangle[0]].position;
+            const float* b = vertices[triangle[1]].position;
+            const float* p = vertices[triangle[2]].position;
+            const float e1[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+            const float e2[3] = { p[0] - a[0], p[1] - a[1], p[2] - a[2] };
+            const float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+            const float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            // Degenerate triangles are never rasterized, they don't limit the cone
+            if (length == 0.0f)
+                continue;
+            for (int c = 0; c < 3; c++)
+            {
+                normal[c] = n[c] / length;
+                axis[c] += normal[c];
+            }
+            normal += 3;
+        }
+
+        const float axisLength = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+        meshlet.coneCutoff = 1.0f;
+        if (axisLength == 0.0f)
+            return;
+        for (int c = 0; c < 3; c++)
+            meshlet.coneAxis[c] = axis[c] / axisLength;
+
+        float minDot = 1.0f;
+        for (const float* n = normals; n < normal; n += 3)
+            minDot = std::min(minDot, n[0] * meshlet.coneAxis[0] + n[1] * meshlet.coneAxis[1] + n[2] * meshlet.coneAxis[2]);
+
+        // Every triangle faces away from views within 90 degrees minus the
+        // cone's half angle of the axis. Cones close to a half sphere can't
+        // be culled from any view that matters, so they are left disabled.
+        if (minDot > 0.1f)
+            meshlet.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+    }
+}
+
+void engine::buildMeshlets(MeshData& mesh, MeshletData& meshlets, uint32_t maxVertices, uint32_t maxTriangles)
+{
+    maxVertices = std::max(3u, std::min(maxVertices, MAX_MESHLET_VERTICES));
+    maxTriangles = std::max(1u, std::min(maxTriangles, MAX_MESHLET_TRIANGLES));
+    meshlets.meshlets.clear();
+    meshlets.vertices.clear();
+    meshlets.triangles.clear();
+
+    const uint32_t triangleCount = static_cast<uint32_t>(mesh.indices.size() / 3);
+    const uint32_t vertexCount = static_cast<uint32_t>(mesh.vertices.size());
+    if (triangleCount == 0)
+        return;
+
+    // Triangles around each vertex
+    std::vector<uint32_t> offsets(vertexCount + 1, 0);
+    for (uint32_t i = 0; i < triangleCount * 3; i++)
+        offsets[mesh.indices[i] + 1]++;
+    for (uint32_t v = 0; v < vertexCount; v++)
+        offsets[v + 1] += offsets[v];
+    std::vector<uint32_t> adjacency(offsets[vertexCount]);
+    {
+        std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+        for (uint32_t i = 0; i < triangleCount * 3; i++)
+            adjacency[fill[mesh.indices[i]]++] = i / 3;
+    }
+
+    // Local index of each mesh vertex, valid while its owner is the current meshlet
+    std::vector<uint32_t> owners(vertexCount, std::numeric_limits<uint32_t>::max());
+    std::vector<uint8_t> localIndices(vertexCount, 0);
+    std::vector<uint8_t> isEmitted(triangleCount, 0);
+    std::vector<uint32_t> indices;
+    indices.reserve(mesh.indices.size());
+    meshlets.triangles.reserve(triangleCount);
+
+    Meshlet meshlet;
+    // Sum of the meshlet's triangle centroids, candidates close to it keep the meshlet round
+    float centroid[3] = { 0.0f, 0.0f, 0.0f };
+    uint32_t cursor = 0;
+    uint32_t triangle = 0;
+    auto countNewVertices = [&](uint32_t t)
+    {
+        const uint32_t* v = &mesh.indices[t * 3];
+        const uint32_t owner = static_cast<uint32_t>(meshlets.meshlets.size());
+        // Repeated vertices of a degenerate triangle are counted once
+        return (owners[v[0]] != owner ? 1u : 0u)
+            + (owners[v[1]] != owner && v[1] != v[0] ? 1u : 0u)
+            + (owners[v[2]] != owner && v[2] != v[0] && v[2] != v[1] ? 1u : 0u);
+    };
+    auto distance2 = [&](uint32_t t)
+    {
+        const uint32_t* v = &mesh.indices[t * 3];
+        float d2 = 0.0f;
+        for (int c = 0; c < 3; c++)
+        {
+            const float p = mesh.vertices[v[0]].position[c] + mesh.vertices[v[1]].position[c] + mesh.vertices[v[2]].position[c];
+            const float d = p / 3.0f - centroid[c] / static_cast<float>(meshlet.triangleCount);
+            d2 += d * d;
+        }
+        return d2;
+    };
+
+    // Picks the free triangle around vertex which adds the fewest vertices,
+    // closest to the meshlet on ties
+    uint32_t next = 0;
+    uint32_t bestNew = 0;
+    float bestDistance = 0.0f;
+    auto considerTriangles = [&](uint32_t vertex)
+    {
+        for (uint32_t a = offsets[vertex]; a < offsets[vertex + 1]; a++)
+        {
+            const uint32_t t = adjacency[a];
+            if (isEmitted[t])
+                continue;
+            const uint32_t newVertices = countNewVertices(t);
+            if (newVertices > bestNew)
+                continue;
+            const float d2 = distance2(t);
+            if (newVertices < bestNew || d2 < bestDistance)
+            {
+                next = t;
+                bestNew = newVertices;
+                bestDistance = d2;
+            }
+        }
+    };
+
+    for (uint32_t emitted = 0; emitted < triangleCount; emitted++)
+    {
+        // The meshlet grows over the surface around its last triangle, then
+        // around any of its vertices, instead of following the index order
+        next = std::numeric_limits<uint32_t>::max();
+        bestNew = 4;
+        if (meshlet.triangleCount > 0)
+        {
+            for (int k = 0; k < 3; k++)
+                considerTriangles(mesh.indices[triangle * 3 + k]);
+            for (uint32_t i = 0; i < meshlet.vertexCount && next == std::numeric_limits<uint32_t>::max(); i++)
+                considerTriangles(meshlets.vertices[meshlet.vertexOffset + i]);
+        }
+        // Dead end, continue with the first triangle left in index order
+        if (next == std::numeric_limits<uint32_t>::max())
+        {
+            while (isEmitted[cursor])
+                cursor++;
+            next = cursor;
+        }
+
+        // The next meshlet starts with the triangle which didn't fit, right next to this one
+        if (meshlet.vertexCount + countNewVertices(next) > maxVertices || meshlet.triangleCount == maxTriangles)
+        {
+            computeBounds(mesh.vertices, indices, meshlets, meshlet);
+            meshlets.meshlets.push_back(meshlet);
+            meshlet = Meshlet();
+            meshlet.vertexOffset = static_cast<uint32_t>(meshlets.vertices.size());
+            meshlet.triangleOffset = emitted;
+            centroid[0] = centroid[1] = centroid[2] = 0.0f;
+        }
+
+        triangle = next;
+        isEmitted[triangle] = 1;
+        const uint32_t owner = static_cast<uint32_t>(meshlets.meshlets.size());
+        uint32_t packed = 0;
+        for (int k = 0; k < 3; k++)
+        {
+            const uint32_t vertex = mesh.indices[triangle * 3 + k];
+            if (owners[vertex] != owner)
+            {
+                owners[vertex] = owner;
+                localIndices[vertex] = static_cast<uint8_t>(meshlet.vertexCount++);
+                meshlets.vertices.push_back(vertex);
+            }
+            packed |= static_cast<uint32_t>(localIndices[vertex]) << (k * 8);
+            indices.push_back(vertex);
+            for (int c = 0; c < 3; c++)
+                centroid[c] += mesh.vertices[vertex].position[c] / 3.0f;
+        }
+        meshlets.triangles.push_back(packed);
+        meshlet.triangleCount++;
+    }
+    computeBounds(mesh.vertices, indices, meshlets, meshlet);
+    meshlets.meshlets.push_back(meshlet);
+
+    mesh.indices.swap(indices);
+}
+
+uint32_t engine::cullMeshlets(const Frustum& frustum,
+    const Vec3& cameraPosition,
+    const Mat4& transform,
+    const Meshlet* meshlets,
+    uint32_t count,
+    std::vector<uint32_t>& visible,
+    MeshletCullStats* stats)
+{
+    // A world plane p tests mesh space points x as dot(p, M * x) = dot(M^T * p, x).
+    // Normalized again, the planes give mesh space distances for the mesh space radii.
+    float planes[Frustum::Count][4];
+    for (int p = 0; p < Frustum::Count; p++)
+    {
+        const Vec4 plane(frustum.planes[p][0], frustum.planes[p][1], frustum.planes[p][2], frustum.planes[p][3]);
+        for (int c = 0; c < 4; c++)
+            planes[p][c] = dot(transform.columns[c], plane);
+        const float length = std::sqrt(planes[p][0] * planes[p][0] + planes[p][1] * planes[p][1] + planes[p][2] * planes[p][2]);
+        if (length > 0.0f)
+        {
+            for (int c = 0; c < 4; c++)
+                planes[p][c] /= length;
+        }
+    }
+    // Whether a triangle faces the camera doesn't change under an affine
+    // transform, so the cones are tested against the camera in mesh space
+    const Vec3 camera = transform.inverseAffine().transformPoint(cameraPosition);
+
+    visible.resize(count);
+    uint32_t visibleCount = 0;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        const Meshlet& meshlet = meshlets[i];
+        const float* c = meshlet.center;
+        bool isInside = true;
+        for (int p = 0; p < Frustum::Count; p++)
+            isInside &= planes[p][0] * c[0] + planes[p][1] * c[1] + planes[p][2] * c[2] + planes[p][3] >= -meshlet.radius;
+
+        // Backfacing from every point of the sphere if the direction to it is
+        // within the cone of view directions all the triangles face away from
+        const float toCenter[3] = { c[0] - camera.x, c[1] - camera.y, c[2] - camera.z };
+        const float distance = std::sqrt(toCenter[0] * toCenter[0] + toCenter[1] * toCenter[1] + toCenter[2] * toCenter[2]);
+        const float* axis = meshlet.coneAxis;
+        const bool isBackfacing = toCenter[0] * axis[0] + toCenter[1] * axis[1] + toCenter[2] * axis[2]
+            >= meshlet.coneCutoff * distance + meshlet.radius;
+
+        if (stats && !isInside)
+        {
+            stats->frustumCulled++;
+            stats->frustumCulledTriangles += meshlet.triangleCount;
+        }
+        else if (stats && isBackfacing)
+        {
+            stats->backfaceCulled++;
+            stats->backfaceCulledTriangles += meshlet.triangleCount;
+        }
+
+        // Branchless write, the index is overwritten if the meshlet is culled
+        visible[visibleCount] = i;
+        visibleCount += isInside && !isBackfacing ? 1 : 0;
+    }
+
+    visible.resize(visibleCount);
+    return visibleCount;
+}
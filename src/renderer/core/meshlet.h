@@ -0,0 +1,111 @@
+#ifndef MESHLET_H
+#define MESHLET_H
+
+#include <cstdint>
+#include <vector>
+
+#include "math.h"
+#include "culling.h"
+#include "mesh.h"
+
+namespace engine
+{
+    // Meshlet limits, sized for mesh shader workgroups (Eg: 64 vertex and 126 primitive outputs on NVIDIA).
+    // Must match max_vertices and max_primitives of meshlet.mesh, mesh files are validated against them.
+    static const uint32_t MAX_MESHLET_VERTICES = 64;
+    static const uint32_t MAX_MESHLET_TRIANGLES = 124;
+
+    /**
+     * @brief Cluster of up to MAX_MESHLET_TRIANGLES triangles of a mesh with
+     * their bounding sphere and normal cone, matches the Meshlet struct of
+     * the meshlet shaders.
+     *
+     * Meshlets cover consecutive triangles of the mesh's index buffer, so a
+     * meshlet can be drawn either with its own vertex list and local
+     * triangles (mesh shaders) or as an index range (indexed draws).
+     *
+     * @param vertexOffset First entry of the meshlet in the meshlet vertex list
+     * @param triangleOffset First triangle of the meshlet in the mesh, which
+     * is also its first entry in the packed local triangles
+     * @param center Bounding sphere center, in mesh space
+     * @param coneAxis Average facing direction of the triangles
+     * @param coneCutoff Sine of the largest angle between the axis and a
+     * triangle normal, 1 if the triangles face too many directions to cull
+     */
+    struct Meshlet
+    {
+        uint32_t vertexOffset = 0;
+        uint32_t triangleOffset = 0;
+        uint32_t vertexCount = 0;
+        uint32_t triangleCount = 0;
+        float center[3] = { 0.0f, 0.0f, 0.0f };
+        float radius = 0.0f;
+        float coneAxis[3] = { 0.0f, 0.0f, 1.0f };
+        float coneCutoff = 1.0f;
+    };
+
+    /**
+     * @brief Meshlets of one mesh
+     *
+     * @param vertices Mesh vertex index of every meshlet vertex, meshlet after meshlet
+     * @param triangles One entry per triangle of the mesh, the three meshlet
+     * local vertex indices packed in bits 0-7, 8-15 and 16-23
+     */
+    struct MeshletData
+    {
+        std::vector<Meshlet> meshlets;
+        std::vector<uint32_t> vertices;
+        std::vector<uint32_t> triangles;
+    };
+
+    /**
+     * @brief Splits a mesh into meshlets. Each meshlet grows from a triangle
+     * over its neighbours, preferring the ones which add the fewest vertices,
+     * until the next one would exceed a limit. The mesh's triangles are
+     * reordered so that every meshlet is a consecutive range of them, which
+     * keeps the locality the vertex cache optimization produced.
+     *
+     * @param mesh Mesh to split, its indices are reordered
+     * @param meshlets Receives the meshlets, replaced
+     * @param maxVertices Vertex limit per meshlet, at most MAX_MESHLET_VERTICES
+     * @param maxTriangles Triangle limit per meshlet, at most MAX_MESHLET_TRIANGLES
+     */
+    void buildMeshlets(MeshData& mesh,
+        MeshletData& meshlets,
+        uint32_t maxVertices = MAX_MESHLET_VERTICES,
+        uint32_t maxTriangles = MAX_MESHLET_TRIANGLES);
+
+    // Triangles of the meshlets rejected by cullMeshlets(), by reason
+    struct MeshletCullStats
+    {
+        uint32_t frustumCulled = 0;
+        uint32_t backfaceCulled = 0;
+        uint64_t frustumCulledTriangles = 0;
+        uint64_t backfaceCulledTriangles = 0;
+    };
+
+    /**
+     * @brief Culls the meshlets of one mesh instance. Meshlets outside the
+     * frustum or whose triangles all face away from the camera are rejected.
+     * The tests run in mesh space against the frustum and camera moved into
+     * it, which keeps them exact for any affine transform.
+     *
+     * @param frustum World space frustum (Eg: Frustum::fromMatrix() of the view projection)
+     * @param cameraPosition World space camera position
+     * @param transform Mesh to world transform of the instance
+     * @param meshlets Meshlets of the mesh
+     * @param count Number of meshlets
+     * @param visible Receives the indices of the visible meshlets, replaced
+     * @param stats Optional, counts of the culled meshlets are added to it
+     * @return number of visible meshlets
+     */
+    uint32_t cullMeshlets(const Frustum& frustum,
+        const Vec3& cameraPosition,
+        const Mat4& transform,
+        const Meshlet* meshlets,
+        uint32_t count,
+        std::vector<uint32_t>& visible,
+        MeshletCullStats* stats = nullptr);
+}
+
+#endif
@@ -0,0 +1,216 @@
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <unordered_map>
+
+#include "obj_loader.h"
+
+namespace
+{
+    // Position, uv and normal indices of a face corner, -1 if missing
+    struct CornerKey
+    {
+        int64_t position;
+        int64_t uv;
+        int64_t normal;
+
+        inline bool operator==(const CornerKey& other) const
+        {
+            return position == other.position && uv == other.uv && normal == other.normal;
+        }
+    };
+
+    struct CornerKeyHash
+    {
+        inline size_t operator()(const CornerKey& key) const
+        {
+            uint64_t hash = static_cast<uint64_t>(key.position) * 0x9E3779B97F4A7C15ull;
+            hash ^= static_cast<uint64_t>(key.uv) * 0xC2B2AE3D27D4EB4Full + (hash << 6) + (hash >> 2);
+            hash ^= static_cast<uint64_t>(key.normal) * 0x165667B19E3779F9ull + (hash << 6) + (hash >> 2);
+            return static_cast<size_t>(hash);
+        }
+    };
+
+    struct ObjParser
+    {
+        std::vector<float> positions;
+        std::vector<float> uvs;
+        std::vector<float> normals;
+
+        engine::MeshData mesh;
+        bool hasMissingNormals = false;
+        std::unordered_map<CornerKey, uint32_t, CornerKeyHash> vertexIndices;
+        std::vector<uint32_t> polygon;
+
+        static inline bool isSpace(char c)
+        {
+            return c == ' ' || c == '\t' || c == '\r';
+        }
+
+        static inline const char* skipSpaces(const char* c)
+        {
+            while (isSpace(*c))
+                c++;
+            return c;
+        }
+
+        // Converts a 1 based or negative (relative to the end) index, returns -1 if it is out of range
+        static inline int64_t resolveIndex(long index, size_t count)
+        {
+            int64_t resolved = index < 0 ? static_cast<int64_t>(count) + index : index - 1;
+            return resolved >= 0 && resolved < static_cast<int64_t>(count) ? resolved : -1;
+        }
+
+        const char* parseFloats(const char* c, std::vector<float>& values, int count)
+        {
+            for (int i = 0; i < count; i++)
+            {
+                char* end;
+                values.push_back(std::strtof(c, &end));
+                c = end;
+            }
+            return c;
+        }
+
+        // Parses a "p/t/n", "p//n", "p/t" or "p" corner, returns false if an index is out of range
+        bool parseCorner(const char*& c)
+        {
+            char* end;
+            long p = std::strtol(c, &end, 10);
+            long t = 0;
+            long n = 0;
+            c = end;
+            if (*c == '/')
+            {
+                c++;
+                if (*c != '/')
+                {
+                    t = std::strtol(c, &end, 10);
+                    c = end;
+                }
+                if (*c == '/')
+                {
+                    n = std::strtol(c + 1, &end, 10);
+                    c = end;
+                }
+            }
+
+            int64_t position = resolveIndex(p, positions.size() / 3);
+            int64_t uv = t != 0 ? resolveIndex(t, uvs.size() / 2) : -1;
+            int64_t normal = n != 0 ? resolveIndex(n, normals.size() / 3) : -1;
+            if (position < 0 || (t != 0 && uv < 0) || (n != 0 && normal < 0))
+                return false;
+
+            const CornerKey key{ position, uv, normal };
+            auto it = vertexIndices.find(key);
+            if (it != vertexIndices.end())
+            {
+                polygon.push_back(it->second);
+                return true;
+            }
+
+            engine::MeshVertex vertex;
+            for (int i = 0; i < 3; i++)
+                vertex.position[i] = positions[position * 3 + i];
+            if (uv >= 0)
+            {
+                vertex.uv[0] = uvs[uv * 2];
+                // OBJ has v pointing up, Vulkan samples with v pointing down
+                vertex.uv[1] = 1.0f - uvs[uv * 2 + 1];
+            }
+            if (normal >= 0)
+            {
+                for (int i = 0; i < 3; i++)
+                    vertex.normal[i] = normals[normal * 3 + i];
+            }
+            else
+                hasMissingNormals = true;
+
+            const uint32_t index = static_cast<uint32_t>(mesh.vertices.size());
+            mesh.vertices.push_back(vertex);
+            vertexIndices.emplace(key, index);
+            polygon.push_back(index);
+            return true;
+        }
+
+        void finishMesh(std::vector<engine::MeshData>& meshes, const std::string& nextName)
+        {
+            if (!mesh.indices.empty())
+            {
+                if (hasMissingNormals)
+                    engine::computeNormals(mesh, true);
+                meshes.push_back(std::move(mesh));
+            }
+            mesh = engine::MeshData();
+            mesh.name = nextName;
+            hasMissingNormals = false;
+            vertexIndices.clear();
+        }
+    };
+}
+
+bool engine::loadObj(const std::string& path, std::vector<MeshData>& meshes)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open())
+    {
+        std::cerr << "Failed to open OBJ file " << path << std::endl;
+        return false;
+    }
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    const std::string text = buffer.str();
+
+    ObjParser parser;
+    uint32_t lineNumber = 0;
+    const char* c = text.c_str();
+    while (*c)
+    {
+        lineNumber++;
+        c = ObjParser::skipSpaces(c);
+        const char* lineEnd = c;
+        while (*lineEnd && *lineEnd != '\n')
+            lineEnd++;
+
+        if (c[0] == 'v' && ObjParser::isSpace(c[1]))
+            parser.parseFloats(c + 2, parser.positions, 3);
+        else if (c[0] == 'v' && c[1] == 't' && ObjParser::isSpace(c[2]))
+            parser.parseFloats(c + 3, parser.uvs, 2);
+        else if (c[0] == 'v' && c[1] == 'n' && ObjParser::isSpace(c[2]))
+            parser.parseFloats(c + 3, parser.normals, 3);
+        else if (c[0] == 'f' && ObjParser::isSpace(c[1]))
+        {
+            parser.polygon.clear();
+            const char* corner = ObjParser::skipSpaces(c + 2);
+            while (corner < lineEnd && *corner != '\n')
+            {
+                if (!parser.parseCorner(corner))
+                {
+                    std::cerr << "OBJ file " << path << " references a missing vertex on line " << lineNumber << std::endl;
+                    return false;
+                }
+                corner = ObjParser::skipSpaces(corner);
+            }
+            for (size_t i = 2; i < parser.polygon.size(); i++)
+            {
+                parser.mesh.indices.push_back(parser.polygon[0]);
+                parser.mesh.indices.push_back(parser.polygon[i - 1]);
+                parser.mesh.indices.push_back(parser.polygon[i]);
+            }
+        }
+        else if ((c[0] == 'o' || c[0] == 'g') && ObjParser::isSpace(c[1]))
+        {
+            const char* name = ObjParser::skipSpaces(c + 2);
+            const char* nameEnd = lineEnd;
+            while (nameEnd > name && ObjParser::isSpace(nameEnd[-1]))
+                nameEnd--;
+            parser.finishMesh(meshes, std::string(name, nameEnd));
+        }
+
+        c = *lineEnd ? lineEnd + 1 : lineEnd;
+    }
+
+    parser.finishMesh(meshes, std::string());
+    return true;
+}
@@ -0,0 +1,27 @@
+#ifndef OBJ_LOADER_H
+#define OBJ_LOADER_H
+
+#include <string>
+#include <vector>
+
+#include "mesh.h"
+
+namespace engine
+{
+    /**
+     * @brief Parses a Wavefront OBJ file into indexed meshes, one per object
+     * or group. Polygons are triangulated as fans and vertices sharing the
+     * same position, uv and normal indices are merged. Missing normals are
+     * computed from the faces. Materials are ignored.
+     *
+     * Meant for the offline converter, the runtime loads the packed mesh
+     * files written by writeMeshFile() instead.
+     *
+     * @param path Path of the OBJ file
+     * @param meshes Receives the meshes, appended
+     * @return false if the file can't be read or references missing vertices
+     */
+    bool loadObj(const std::string& path, std::vector<MeshData>& meshes);
+}
+
+#endif
@@ -0,0 +1,165 @@
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "profiler.h"
+#include "chrome_trace.h"
+
+namespace
+{
+    // Fields are atomics so that the exporting thread can read a slot while
+    // the owner overwrites it. Torn records are detected with the write index.
+    struct ZoneRecord
+    {
+        std::atomic<const char*> name{ nullptr };
+        std::atomic<uint64_t> start{ 0 };
+        std::atomic<uint64_t> end{ 0 };
+    };
+
+    struct ZoneRing
+    {
+        static const uint64_t CAPACITY = 1 << 15;
+
+        std::unique_ptr<ZoneRecord[]> records{ new ZoneRecord[CAPACITY] };
+        std::atomic<uint64_t> writeIndex{ 0 };
+        uint32_t threadId = 0;
+    };
+
+    struct FrameRecord
+    {
+        std::atomic<uint64_t> frameNumber{ 0 };
+        std::atomic<uint64_t> start{ 0 };
+    };
+
+    struct ProfilerState
+    {
+        static const uint64_t FRAME_CAPACITY = 1024;
+
+        std::mutex mutex;
+        // Rings outlive their threads so that their zones can still be exported
+        std::vector<std::shared_ptr<ZoneRing>> rings;
+        std::unique_ptr<FrameRecord[]> frames{ new FrameRecord[FRAME_CAPACITY] };
+        std::atomic<uint64_t> frameWriteIndex{ 0 };
+    };
+
+    ProfilerState& getState()
+    {
+        static ProfilerState state;
+        return state;
+    }
+
+    thread_local ZoneRing* t_ring = nullptr;
+
+    ZoneRing& getThreadRing()
+    {
+        if (!t_ring)
+        {
+            ProfilerState& state = getState();
+            std::lock_guard<std::mutex> lock(state.mutex);
+            state.rings.push_back(std::make_shared<ZoneRing>());
+            state.rings.back()->threadId = static_cast<uint32_t>(state.rings.size() - 1);
+            t_ring = state.rings.back().get();
+        }
+        return *t_ring;
+    }
+}
+
+void engine::Profiler::recordZone(const char* name, uint64_t startNs, uint64_t endNs)
+{
+    // Only the owning thread writes to its ring, so a relaxed load of the
+    // index is enough. The release store publishes the record to readers.
+    ZoneRing& ring = getThreadRing();
+    const uint64_t index = ring.writeIndex.load(std::memory_order_relaxed);
+    ZoneRecord& record = ring.records[index & (ZoneRing::CAPACITY - 1)];
+    record.name.store(name, std::memory_order_relaxed);
+    record.start.store(startNs, std::memory_order_relaxed);
+    record.end.store(endNs, std::memory_order_relaxed);
+    ring.writeIndex.store(index + 1, std::memory_order_release);
+}
+
+void engine::Profiler::markFrame(uint64_t frameNumber)
+{
+    ProfilerState& state = getState();
+    const uint64_t index = state.frameWriteIndex.load(std::memory_order_relaxed);
+    FrameRecord& record = state.frames[index & (ProfilerState::FRAME_CAPACITY - 1)];
+    record.frameNumber.store(frameNumber, std::memory_order_relaxed);
+    record.start.store(now(), std::memory_order_relaxed);
+    state.frameWriteIndex.store(index + 1, std::memory_order_release);
+}
+
+bool engine::Profiler::writeChromeTrace(const std::string& path, uint32_t frameCount)
+{
+    ProfilerState& state = getState();
+
+    // Start times of the exported frames, oldest first
+    std::vector<std::pair<uint64_t, uint64_t>> frames;
+    const uint64_t frameEnd = state.frameWriteIndex.load(std::memory_order_acquire);
+    const uint64_t frameBegin = frameEnd - std::min<uint64_t>({ frameEnd, frameCount, ProfilerState::FRAME_CAPACITY - 1 });
+    for (uint64_t i = frameBegin; i < frameEnd; i++)
+    {
+        const FrameRecord& record = state.frames[i & (ProfilerState::FRAME_CAPACITY - 1)];
+        frames.emplace_back(record.start.load(std::memory_order_relaxed),
+            record.frameNumber.load(std::memory_order_relaxed));
+    }
+    const uint64_t traceStart = frames.empty() ? 0 : frames.front().first;
+
+    std::vector<TraceEvent> events;
+    std::vector<std::string> threadNames;
+    {
+        std::lock_guard<std::mutex> lock(state.mutex);
+        for (const std::shared_ptr<ZoneRing>& ring : state.rings)
+        {
+            threadNames.push_back(ring->threadId == 0 ? "Main thread" : "Thread " + std::to_string(ring->threadId));
+
+            const uint64_t end = ring->writeIndex.load(std::memory_order_acquire);
+            const uint64_t begin = end > ZoneRing::CAPACITY ? end - ZoneRing::CAPACITY : 0;
+
+            // Events with the index of the record they were read from
+            std::vector<std::pair<uint64_t, TraceEvent>> ringEvents;
+            for (uint64_t i = begin; i < end; i++)
+            {
+                const ZoneRecord& record = ring->records[i & (ZoneRing::CAPACITY - 1)];
+                TraceEvent event;
+                const char* name = record.name.load(std::memory_order_relaxed);
+                uint64_t start = record.start.load(std::memory_order_relaxed);
+                uint64_t finish = record.end.load(std::memory_order_relaxed);
+                if (!name || start < traceStart)
+                    continue;
+
+                event.name = name;
+                event.category = "cpu";
+                event.threadId = ring->threadId;
+                event.startUs = static_cast<double>(start - traceStart) * 1e-3;
+                event.durationUs = static_cast<double>(finish - start) * 1e-3;
+
+                // Frame the zone started in
+                auto frame = std::upper_bound(frames.begin(),
+                    frames.end(),
+                    start,
+                    [](uint64_t t, const std::pair<uint64_t, uint64_t>& f)
+                    {
+                        return t < f.first;
+                    });
+                event.frameNumber = frame == frames.begin() ? 0 : std::prev(frame)->second;
+                ringEvents.emplace_back(i, event);
+            }
+
+            // Records the owner overwrote while they were read may be torn, drop
+            // them. The fence orders the record loads above before this load.
+            // The owner may be writing record endAfter, whose slot is the one of
+            // endAfter - CAPACITY, so that one isn't valid either.
+            std::atomic_thread_fence(std::memory_order_acquire);
+            const uint64_t endAfter = ring->writeIndex.load(std::memory_order_relaxed);
+            const uint64_t firstValid = endAfter + 1 > ZoneRing::CAPACITY ? endAfter + 1 - ZoneRing::CAPACITY : 0;
+            for (const std::pair<uint64_t, TraceEvent>& e : ringEvents)
+            {
+                if (e.first >= firstValid)
+                    events.push_back(e.second);
+            }
+        }
+    }
+
+    return engine::writeChromeTrace(path, events, threadNames);
+}
@@ -0,0 +1,79 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// Zones compile to nothing unless the build enables the profiler
+// (ENGINE_ENABLE_PROFILER CMake option)
+#ifdef ENGINE_PROFILER_ENABLED
+#define ENGINE_PROFILE_CONCAT_INNER(a, b) a##b
+#define ENGINE_PROFILE_CONCAT(a, b) ENGINE_PROFILE_CONCAT_INNER(a, b)
+// Times the rest of the scope. name must be a string literal.
+#define PROFILE_ZONE(name) engine::ProfileZone ENGINE_PROFILE_CONCAT(profileZone, __LINE__)(name)
+#define PROFILE_FRAME(frameNumber) engine::Profiler::markFrame(frameNumber)
+#else
+#define PROFILE_ZONE(name)
+#define PROFILE_FRAME(frameNumber)
+#endif
+
+namespace engine
+{
+    /**
+     * @brief CPU profiler. Every thread writes its zones into its own ring
+     * buffer without locks, only the thread registration (once per thread) and
+     * the trace export take a lock. The rings keep the last zones of each
+     * thread, older ones are overwritten.
+     */
+    class Profiler
+    {
+    public:
+        static inline uint64_t now()
+        {
+            return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count());
+        }
+
+        // Records a finished zone of the calling thread. name must outlive the profiler.
+        static void recordZone(const char* name, uint64_t startNs, uint64_t endNs);
+
+        // Marks the start of a frame. Frames are used to select what is exported.
+        static void markFrame(uint64_t frameNumber);
+
+        /**
+         * @brief Writes the zones of all threads during the last frames as a
+         * Chrome/Perfetto trace. Can be called at any time from any thread.
+         *
+         * @param path Path of the JSON file
+         * @param frameCount Number of most recent frames to export
+         * @return true if the file was written
+         */
+        static bool writeChromeTrace(const std::string& path, uint32_t frameCount = 60);
+    };
+
+    /**
+     * @brief Records the time between its construction and destruction. Use
+     * through PROFILE_ZONE() so it is removed when profiling is disabled.
+     */
+    class ProfileZone
+    {
+    private:
+        const char* m_name;
+        uint64_t m_start;
+
+    public:
+        explicit ProfileZone(const char* name)
+            : m_name{name}, m_start{Profiler::now()} {}
+
+        ~ProfileZone()
+        {
+            Profiler::recordZone(m_name, m_start, Profiler::now());
+        }
+
+        ProfileZone(const ProfileZone&) = delete;
+        ProfileZone& operator=(const ProfileZone&) = delete;
+    };
+}
+
+#endif
@@ -0,0 +1,501 @@
+#include <algorithm>
+#include <atomic>
+
+#include "scene.h"
+#include "job_system.h"
+
+// Nodes per job when a level is split across the job system
+static const uint32_t UPDATE_BATCH_SIZE = 4096;
+
+namespace
+{
+    // values[i] = old values[order[i]]
+    template <typename T>
+    void reorder(std::vector<T>& values, const std::vector<uint32_t>& order)
+    {
+        std::vector<T> sorted(values.size());
+        for (size_t i = 0; i < order.size(); i++)
+            sorted[i] = values[order[i]];
+        values.swap(sorted);
+    }
+}
+
+const engine::Scene::Slot* engine::Scene::getSlot(NodeHandle node) const
+{
+    if (node.index >= m_slots.size())
+        return nullptr;
+    const Slot& slot = m_slots[node.index];
+    return slot.generation == node.generation ? &slot : nullptr;
+}
+
+void engine::Scene::markDirty(uint32_t index)
+{
+    m_dirty[index] = 1;
+    m_firstDirtyLevel = std::min(m_firstDirtyLevel, m_depths[index]);
+}
+
+void engine::Scene::moveNode(uint32_t from, uint32_t to)
+{
+    m_nodeSlots[to] = m_nodeSlots[from];
+    m_parents[to] = m_parents[from];
+    m_depths[to] = m_depths[from];
+    m_translations[to] = m_translations[from];
+    m_rotations[to] = m_rotations[from];
+    m_scales[to] = m_scales[from];
+    m_localMatrices[to] = m_localMatrices[from];
+    m_worldMatrices[to] = m_worldMatrices[from];
+    m_localBounds[to] = m_localBounds[from];
+    m_worldBounds.set(to,
+        m_worldBounds.centerX[from],
+        m_worldBounds.centerY[from],
+        m_worldBounds.centerZ[from],
+        m_worldBounds.radius[from]);
+    m_dirty[to] = m_dirty[from];
+    m_changedUpdates[to] = m_changedUpdates[from];
+    m_slots[m_nodeSlots[to]].index = to;
+}
+
+void engine::Scene::resizeNodes(uint32_t count)
+{
+    m_nodeSlots.resize(count);
+    m_parents.resize(count);
+    m_depths.resize(count);
+    m_translations.resize(count);
+    m_rotations.resize(count);
+    m_scales.resize(count);
+    m_localMatrices.resize(count);
+    m_worldMatrices.resize(count);
+    m_localBounds.resize(count);
+    m_worldBounds.centerX.resize(count);
+    m_worldBounds.centerY.resize(count);
+    m_worldBounds.centerZ.resize(count);
+    m_worldBounds.radius.resize(count);
+    m_dirty.resize(count);
+    m_changedUpdates.resize(count);
+}
+
+void engine::Scene::sort()
+{
+    const uint32_t count = size();
+
+    // Depths of moved subtrees are stale, and parents may come after their
+    // children, so walk up until a known depth and fill in the chain on the way back
+    std::vector<uint32_t> depths(count, INVALID_INDEX);
+    std::vector<uint32_t> chain;
+    uint32_t maxDepth = 0;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        uint32_t j = i;
+        while (depths[j] == INVALID_INDEX && m_parents[j] != INVALID_INDEX)
+        {
+            chain.push_back(j);
+            j = m_parents[j];
+        }
+        if (depths[j] == INVALID_INDEX)
+            depths[j] = 0;
+
+        uint32_t depth = depths[j];
+        while (!chain.empty())
+        {
+            depths[chain.back()] = ++depth;
+            chain.pop_back();
+        }
+        maxDepth = std::max(maxDepth, depths[i]);
+    }
+
+    // Counting sort by depth, stable so siblings keep their order
+    std::vector<uint32_t> offsets(maxDepth + 2, 0);
+    for (uint32_t i = 0; i < count; i++)
+        offsets[depths[i] + 1]++;
+    for (uint32_t d = 1; d < offsets.size(); d++)
+        offsets[d] += offsets[d - 1];
+
+    std::vector<uint32_t> order(count);
+    std::vector<uint32_t> newIndices(count);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        uint32_t newIndex = offsets[depths[i]]++;
+        order[newIndex] = i;
+        newIndices[i] = newIndex;
+    }
+
+    m_depths.swap(depths);
+    reorder(m_nodeSlots, order);
+    reorder(m_parents, order);
+    reorder(m_depths, order);
+    reorder(m_translations, order);
+    reorder(m_rotations, order);
+    reorder(m_scales, order);
+    reorder(m_localMatrices, order);
+    reorder(m_worldMatrices, order);
+    reorder(m_localBounds, order);
+    reorder(m_worldBounds.centerX, order);
+    reorder(m_worldBounds.centerY, order);
+    reorder(m_worldBounds.centerZ, order);
+    reorder(m_worldBounds.radius, order);
+    reorder(m_dirty, order);
+    reorder(m_changedUpdates, order);
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        if (m_parents[i] != INVALID_INDEX)
+            m_parents[i] = newIndices[m_parents[i]];
+        m_slots[m_nodeSlots[i]].index = i;
+    }
+
+    updateLevelOffsets();
+    m_isSorted = true;
+    // Flagged nodes may have moved to any level
+    if (m_firstDirtyLevel != INVALID_INDEX)
+        m_firstDirtyLevel = 0;
+}
+
+void engine::Scene::updateLevelOffsets()
+{
+    // Every node below the roots has its parent one level up, so no level is empty
+    m_levelOffsets.clear();
+    for (uint32_t i = 0; i < size(); i++)
+    {
+        if (m_depths[i] == m_levelOffsets.size())
+            m_levelOffsets.push_back(i);
+    }
+    m_levelOffsets.push_back(size());
+}
+
+uint32_t engine::Scene::updateRange(uint32_t begin, uint32_t end)
+{
+    uint32_t changedCount = 0;
+    for (uint32_t i = begin; i < end; i++)
+    {
+        const uint32_t parent = m_parents[i];
+        const bool isParentChanged = parent != INVALID_INDEX && m_changedUpdates[parent] == m_updateCount;
+        if (!m_dirty[i] && !isParentChanged)
+            continue;
+
+        if (m_dirty[i])
+        {
+            m_localMatrices[i] = Mat4::fromTrs(m_translations[i], m_rotations[i], m_scales[i]);
+            m_dirty[i] = 0;
+        }
+
+        if (parent != INVALID_INDEX)
+            m_worldMatrices[i] = m_worldMatrices[parent] * m_localMatrices[i];
+        else
+            m_worldMatrices[i] = m_localMatrices[i];
+        const Mat4& world = m_worldMatrices[i];
+        m_changedUpdates[i] = m_updateCount;
+        changedCount++;
+
+        // The radius grows with the largest axis scale
+        const Vec4& bounds = m_localBounds[i];
+        const Vec3 center = world.transformPoint(bounds.xyz());
+        const float scale2 = std::max(std::max(dot(world.columns[0], world.columns[0]),
+                                          dot(world.columns[1], world.columns[1])),
+            dot(world.columns[2], world.columns[2]));
+        m_worldBounds.set(i, center.x, center.y, center.z, bounds.w * std::sqrt(scale2));
+    }
+    return changedCount;
+}
+
+void engine::Scene::reserve(uint32_t count)
+{
+    m_slots.reserve(count);
+    m_nodeSlots.reserve(count);
+    m_parents.reserve(count);
+    m_depths.reserve(count);
+    m_translations.reserve(count);
+    m_rotations.reserve(count);
+    m_scales.reserve(count);
+    m_localMatrices.reserve(count);
+    m_worldMatrices.reserve(count);
+    m_localBounds.reserve(count);
+    m_worldBounds.reserve(count);
+    m_dirty.reserve(count);
+    m_changedUpdates.reserve(count);
+}
+
+engine::NodeHandle engine::Scene::createNode(NodeHandle parent)
+{
+    uint32_t parentIndex = INVALID_INDEX;
+    if (parent.isValid())
+    {
+        const Slot* parentSlot = getSlot(parent);
+        if (!parentSlot)
+            return NodeHandle();
+        parentIndex = parentSlot->index;
+    }
+
+    uint32_t slotIndex = m_freeSlot;
+    if (slotIndex != INVALID_INDEX)
+        m_freeSlot = m_slots[slotIndex].index;
+    else
+    {
+        slotIndex = static_cast<uint32_t>(m_slots.size());
+        m_slots.push_back(Slot());
+    }
+
+    const uint32_t index = size();
+    const uint32_t depth = parentIndex != INVALID_INDEX ? m_depths[parentIndex] + 1 : 0;
+    resizeNodes(index + 1);
+    m_slots[slotIndex].index = index;
+    m_nodeSlots[index] = slotIndex;
+    m_parents[index] = parentIndex;
+    m_depths[index] = depth;
+    m_scales[index] = Vec3(1.0f, 1.0f, 1.0f);
+    m_localMatrices[index] = Mat4::identity();
+    m_worldMatrices[index] = Mat4::identity();
+
+    // Appending keeps the order unless the node goes above the last level
+    if (m_isSorted && index > 0 && depth < m_depths[index - 1])
+        m_isSorted = false;
+    else if (m_isSorted)
+    {
+        if (m_levelOffsets.empty())
+            m_levelOffsets.push_back(0);
+        if (depth == getLevelCount())
+            m_levelOffsets.push_back(index + 1);
+        else
+            m_levelOffsets.back() = index + 1;
+    }
+    markDirty(index);
+
+    NodeHandle node;
+    node.index = slotIndex;
+    node.generation = m_slots[slotIndex].generation;
+    return node;
+}
+
+bool engine::Scene::removeNode(NodeHandle node)
+{
+    const Slot* slot = getSlot(node);
+    if (!slot)
+        return false;
+    if (!m_isSorted)
+        sort();
+
+    // Descendants come after the node and after their parents
+    const uint32_t first = slot->index;
+    const uint32_t count = size();
+    std::vector<uint8_t> isRemoved(count, 0);
+    isRemoved[first] = 1;
+    for (uint32_t i = first + 1; i < count; i++)
+    {
+        const uint32_t parent = m_parents[i];
+        isRemoved[i] = parent != INVALID_INDEX && isRemoved[parent] ? 1 : 0;
+    }
+
+    // Compact in place, which keeps the depth order
+    std::vector<uint32_t> newIndices(count, INVALID_INDEX);
+    uint32_t write = first;
+    for (uint32_t i = 0; i < first; i++)
+        newIndices[i] = i;
+    for (uint32_t i = first; i < count; i++)
+    {
+        if (isRemoved[i])
+        {
+            Slot& removedSlot = m_slots[m_nodeSlots[i]];
+            // Skip 0 on wrap around, it marks invalid handles
+            if (++removedSlot.generation == 0)
+                removedSlot.generation = 1;
+            removedSlot.index = m_freeSlot;
+            m_freeSlot = m_nodeSlots[i];
+            continue;
+        }
+        if (write != i)
+            moveNode(i, write);
+        newIndices[i] = write++;
+    }
+
+    resizeNodes(write);
+    for (uint32_t i = first; i < write; i++)
+    {
+        if (m_parents[i] != INVALID_INDEX)
+            m_parents[i] = newIndices[m_parents[i]];
+    }
+    updateLevelOffsets();
+    return true;
+}
+
+bool engine::Scene::setParent(NodeHandle node, NodeHandle parent)
+{
+    const Slot* slot = getSlot(node);
+    if (!slot)
+        return false;
+
+    uint32_t parentIndex = INVALID_INDEX;
+    if (parent.isValid())
+    {
+        const Slot* parentSlot = getSlot(parent);
+        if (!parentSlot)
+            return false;
+        parentIndex = parentSlot->index;
+    }
+
+    // The new parent may not be the node itself or one of its descendants
+    const uint32_t index = slot->index;
+    for (uint32_t i = parentIndex; i != INVALID_INDEX; i = m_parents[i])
+    {
+        if (i == index)
+            return false;
+    }
+
+    // Only the grouping by depth matters, moving within the same level keeps the order
+    const uint32_t depth = parentIndex != INVALID_INDEX ? m_depths[parentIndex] + 1 : 0;
+    if (depth != m_depths[index])
+        m_isSorted = false;
+    m_parents[index] = parentIndex;
+    m_depths[index] = depth;
+    markDirty(index);
+    return true;
+}
+
+engine::NodeHandle engine::Scene::getParent(NodeHandle node) const
+{
+    const Slot* slot = getSlot(node);
+    if (!slot || m_parents[slot->index] == INVALID_INDEX)
+        return NodeHandle();
+    return getHandle(m_parents[slot->index]);
+}
+
+bool engine::Scene::setLocalTransform(NodeHandle node, const Vec3& translation, const Quat& rotation, const Vec3& scale)
+{
+    const Slot* slot = getSlot(node);
+    if (!slot)
+        return false;
+    m_translations[slot->index] = translation;
+    m_rotations[slot->index] = rotation;
+    m_scales[slot->index] = scale;
+    markDirty(slot->index);
+    return true;
+}
+
+bool engine::Scene::setTranslation(NodeHandle node, const Vec3& translation)
+{
+    const Slot* slot = getSlot(node);
+    if (!slot)
+        return false;
+    m_translations[slot->index] = translation;
+    markDirty(slot->index);
+    return true;
+}
+
+bool engine::Scene::setRotation(NodeHandle node, const Quat& rotation)
+{
+    const Slot* slot = getSlot(node);
+    if (!slot)
+        return false;
+    m_rotations[slot->index] = rotation;
+    markDirty(slot->index);
+    return true;
+}
+
+bool engine::Scene::setScale(NodeHandle node, const Vec3& scale)
+{
+    const Slot* slot = getSlot(node);
+    if (!slot)
+        return false;
+    m_scales[slot->index] = scale;
+    markDirty(slot->index);
+    return true;
+}
+
+bool engine::Scene::setLocalBounds(NodeHandle node, const Vec3& center, float radius)
+{
+    const Slot* slot = getSlot(node);
+    if (!slot)
+        return false;
+    m_localBounds[slot->index] = Vec4(center, radius);
+    markDirty(slot->index);
+    return true;
+}
+
+uint32_t engine::Scene::update(JobSystem* jobSystem)
+{
+    // Markers of old updates would match again after a wrap around
+    if (++m_updateCount == 0)
+    {
+        std::fill(m_changedUpdates.begin(), m_changedUpdates.end(), 0);
+        m_updateCount = 1;
+    }
+
+    if (!m_isSorted)
+        sort();
+    if (m_firstDirtyLevel == INVALID_INDEX)
+        return 0;
+
+    // A level only reads the world matrices of the level above, so its
+    // nodes are independent of each other
+    std::atomic<uint32_t> changedCount{0};
+    for (uint32_t level = m_firstDirtyLevel; level < getLevelCount(); level++)
+    {
+        const uint32_t begin = m_levelOffsets[level];
+        const uint32_t count = m_levelOffsets[level + 1] - begin;
+        if (jobSystem && count >= 2 * UPDATE_BATCH_SIZE)
+        {
+            jobSystem->parallelFor(count,
+                UPDATE_BATCH_SIZE,
+                [this, begin, &changedCount](uint32_t first, uint32_t last)
+                { changedCount += updateRange(begin + first, begin + last); });
+        }
+        else
+            changedCount += updateRange(begin, begin + count);
+    }
+
+    m_firstDirtyLevel = INVALID_INDEX;
+    return changedCount;
+}
+
+const engine::Vec3* engine::Scene::getTranslation(NodeHandle node) const
+{
+    const Slot* slot = getSlot(node);
+    return slot ? &m_translations[slot->index] : nullptr;
+}
+
+const engine::Quat* engine::Scene::getRotation(NodeHandle node) const
+{
+    const Slot* slot = getSlot(node);
+    return slot ? &m_rotations[slot->index] : nullptr;
+}
+
+const engine::Vec3* engine::Scene::getScale(NodeHandle node) const
+{
+    const Slot* slot = getSlot(node);
+    return slot ? &m_scales[slot->index] : nullptr;
+}
+
+const engine::Mat4* engine::Scene::getWorldMatrix(NodeHandle node) const
+{
+    const Slot* slot = getSlot(node);
+    return slot ? &m_worldMatrices[slot->index] : nullptr;
+}
+
+uint32_t engine::Scene::getIndex(NodeHandle node) const
+{
+    const Slot* slot = getSlot(node);
+    return slot ? slot->index : INVALID_INDEX;
+}
+
+engine::NodeHandle engine::Scene::getHandle(uint32_t index) const
+{
+    NodeHandle node;
+    node.index = m_nodeSlots[index];
+    node.generation = m_slots[node.index].generation;
+    return node;
+}
+
+void engine::Scene::clear()
+{
+    for (uint32_t i = 0; i < size(); i++)
+    {
+        Slot& slot = m_slots[m_nodeSlots[i]];
+        if (++slot.generation == 0)
+            slot.generation = 1;
+        slot.index = m_freeSlot;
+        m_freeSlot = m_nodeSlots[i];
+    }
+
+    resizeNodes(0);
+    m_levelOffsets.clear();
+    m_firstDirtyLevel = INVALID_INDEX;
+    m_isSorted = true;
+}
@@ -0,0 +1,202 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "math.h"
+#include "culling.h"
+#include "handle_pool.h"
+
+namespace engine
+{
+    class JobSystem;
+
+    struct SceneNodeTag
+    {
+    };
+    using NodeHandle = Handle<SceneNodeTag>;
+
+    /**
+     * @brief Transform hierarchy stored as parallel arrays instead of linked
+     * nodes. Nodes are kept sorted by depth, so every parent comes before its
+     * children and the nodes of one depth level are contiguous. update() then
+     * walks the arrays front to back, and all nodes of a level can be
+     * processed in parallel once the level above is done.
+     *
+     * Changing a local transform only flags the node. update() recomputes the
+     * world matrix of flagged nodes and of nodes whose parent changed, so the
+     * cost follows the changed subtrees. Levels above the first flagged node
+     * are skipped.
+     *
+     * Nodes are referred to by generational handles. Their dense index (the
+     * position in the arrays) changes when the hierarchy is reordered or nodes
+     * are removed, so it is only stable between structural changes.
+     * Not thread safe, apart from update() using the job system internally.
+     */
+    class Scene
+    {
+    public:
+        static constexpr uint32_t INVALID_INDEX = std::numeric_limits<uint32_t>::max();
+
+    private:
+        struct Slot
+        {
+            // Dense index while the slot is used, next free slot otherwise
+            uint32_t index = 0;
+            uint32_t generation = 1;
+        };
+
+        std::vector<Slot> m_slots;
+        uint32_t m_freeSlot = INVALID_INDEX;
+
+        // Dense arrays, sorted by depth
+        std::vector<uint32_t> m_nodeSlots;
+        // Dense index of the parent, INVALID_INDEX for roots
+        std::vector<uint32_t> m_parents;
+        std::vector<uint32_t> m_depths;
+        std::vector<Vec3> m_translations;
+        std::vector<Quat> m_rotations;
+        std::vector<Vec3> m_scales;
+        std::vector<Mat4> m_localMatrices;
+        std::vector<Mat4> m_worldMatrices;
+        // Local space bounding spheres, xyz center and w radius
+        std::vector<Vec4> m_localBounds;
+        SphereBounds m_worldBounds;
+        // Local transform changed since the last update
+        std::vector<uint8_t> m_dirty;
+        // Update in which the world matrix last changed. Compared against the
+        // update counter, so nothing has to be cleared between updates.
+        std::vector<uint32_t> m_changedUpdates;
+
+        // First dense index of each depth level, plus the node count
+        std::vector<uint32_t> m_levelOffsets;
+        // Lowest depth with a flagged node, INVALID_INDEX if none
+        uint32_t m_firstDirtyLevel = INVALID_INDEX;
+        uint32_t m_updateCount = 0;
+        bool m_isSorted = true;
+
+        const Slot* getSlot(NodeHandle node) const;
+        void markDirty(uint32_t index);
+        // Moves the node at index from to index to, fixing up its slot
+        void moveNode(uint32_t from, uint32_t to);
+        void resizeNodes(uint32_t count);
+        // Recomputes the depths and restores the depth order
+        void sort();
+        void updateLevelOffsets();
+        uint32_t updateRange(uint32_t begin, uint32_t end);
+
+    public:
+        Scene() = default;
+        Scene(const Scene&) = delete;
+        Scene& operator=(const Scene&) = delete;
+
+        void reserve(uint32_t count);
+
+        /**
+         * @brief Adds a node with an identity local transform
+         *
+         * @param parent Parent node, an invalid handle adds a root
+         * @return handle of the node, invalid if parent is stale
+         */
+        NodeHandle createNode(NodeHandle parent = NodeHandle());
+
+        /**
+         * @brief Removes the node and all of its descendants. Their handles
+         * become stale. Linear in the node count, so prefer removing the top
+         * of a subtree over removing its nodes one by one.
+         *
+         * @return false if the handle is stale
+         */
+        bool removeNode(NodeHandle node);
+
+        /**
+         * @brief Moves the node and its subtree under another parent. The local
+         * transform is kept, so the world transform follows the new parent.
+         *
+         * @param node Node to move
+         * @param parent New parent, an invalid handle makes the node a root
+         * @return false if a handle is stale or parent is inside the subtree of node
+         */
+        bool setParent(NodeHandle node, NodeHandle parent);
+
+        // Returns an invalid handle for roots and stale handles
+        NodeHandle getParent(NodeHandle node) const;
+
+        bool setLocalTransform(NodeHandle node, const Vec3& translation, const Quat& rotation, const Vec3& scale);
+        bool setTranslation(NodeHandle node, const Vec3& translation);
+        bool setRotation(NodeHandle node, const Quat& rotation);
+        bool setScale(NodeHandle node, const Vec3& scale);
+
+        /**
+         * @brief Sets the local space bounding sphere of the node, which update()
+         * transforms into getWorldBounds(). Nodes default to a point at their origin.
+         */
+        bool setLocalBounds(NodeHandle node, const Vec3& center, float radius);
+
+        /**
+         * @brief Recomputes the world matrices and bounds of the changed nodes
+         *
+         * @param jobSystem Job system large levels are split across, nullptr
+         * runs on the calling thread
+         * @return number of nodes whose world transform was recomputed
+         */
+        uint32_t update(JobSystem* jobSystem = nullptr);
+
+        // Returns nullptr if the handle is stale. World values are the ones of the last update().
+        const Vec3* getTranslation(NodeHandle node) const;
+        const Quat* getRotation(NodeHandle node) const;
+        const Vec3* getScale(NodeHandle node) const;
+        const Mat4* getWorldMatrix(NodeHandle node) const;
+
+        inline bool isValid(NodeHandle node) const
+        {
+            return getSlot(node) != nullptr;
+        }
+
+        // Dense index of the node, INVALID_INDEX if the handle is stale
+        uint32_t getIndex(NodeHandle node) const;
+
+        // Handle of the node at a dense index (Eg: while iterating getWorldMatrices())
+        NodeHandle getHandle(uint32_t index) const;
+
+        // True if the world transform at the dense index changed in the last update()
+        inline bool wasChanged(uint32_t index) const
+        {
+            return m_changedUpdates[index] == m_updateCount;
+        }
+
+        // World matrices by dense index
+        inline const std::vector<Mat4>& getWorldMatrices() const
+        {
+            return m_worldMatrices;
+        }
+
+        // World bounding spheres by dense index, ready for cullSpheres()
+        inline const SphereBounds& getWorldBounds() const
+        {
+            return m_worldBounds;
+        }
+
+        inline uint32_t getLevelCount() const
+        {
+            return m_levelOffsets.empty() ? 0 : static_cast<uint32_t>(m_levelOffsets.size()) - 1;
+        }
+
+        inline uint32_t size() const
+        {
+            return static_cast<uint32_t>(m_parents.size());
+        }
+
+        inline bool empty() const
+        {
+            return m_parents.empty();
+        }
+
+        // Removes every node, all handles become stale
+        void clear();
+    };
+}
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+// Instruction sets the SIMD code paths are compiled for. SSE2 is part of
+// x86-64, AVX2 has to be enabled by the build (ENGINE_ENABLE_AVX2 CMake option).
+#if defined(__AVX2__)
+#define ENGINE_SIMD_AVX2 1
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ENGINE_SIMD_SSE2 1
+#endif
+
+#if defined(ENGINE_SIMD_AVX2) || defined(ENGINE_SIMD_SSE2)
+#include <immintrin.h>
+#endif
+
+#include <cstdint>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace engine
+{
+    // Index of the lowest set bit, mask must not be 0
+    inline uint32_t countTrailingZeros(uint32_t mask)
+    {
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanForward(&index, mask);
+        return static_cast<uint32_t>(index);
+#else
+        return static_cast<uint32_t>(__builtin_ctz(mask));
+#endif
+    }
+
+    // Number of set bits, meant for the small masks of SIMD compares
+    inline uint32_t countBits(uint32_t mask)
+    {
+        uint32_t count = 0;
+        for (; mask; mask &= mask - 1)
+            count++;
+        return count;
+    }
+}
+
+#endif
@@ -1,4 +1,7 @@
+#include <chrono>
+
 #include "renderer.h"
+#include "core/profiler.h"
 
 bool engine::Renderer::init()
 {
@@ -31,14 +34,34 @@ bool engine::Renderer::run()
 
     m_isRunning = true;
 
+    const uint32_t startFrame = m_currentFrameNumber;
+    const auto startTime = std::chrono::steady_clock::now();
+
     while (m_isRunning)
     {
+        PROFILE_FRAME(m_currentFrameNumber);
+        PROFILE_ZONE("Frame");
         update();
         render();
+
+        if (m_maxFrames > 0 && m_currentFrameNumber - startFrame >= m_maxFrames)
+            m_isRunning = false;
     }
 
     m_isRunning = false;
 
+    const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - startTime;
+    const uint32_t frameCount = m_currentFrameNumber - startFrame;
+    if (frameCount > 0)
+    {
+        cout << "Rendered " << frameCount << " frames in " << elapsed.count() << " ms ("
+             << elapsed.count() / frameCount << " ms/frame, "
+             << frameCount * 1000.0 / elapsed.count() << " fps)" << endl;
+    }
+
+    if (m_writeCpuTraceOnExit)
+        Profiler::writeChromeTrace(m_cpuTraceFile);
+
     bool isCleaned = clean();
 
     if (!isCleaned)
@@ -50,14 +73,21 @@ bool engine::Renderer::run()
     return true;
 }
 
-engine::Renderer::Renderer(Window &window, RendererType type)
+engine::Renderer::Renderer(Window &window, RendererType type, uint32_t threadCount)
     : m_type{type},
       m_isRunning{false},
       m_currentFrameNumber{0},
-      m_window{window}
+      m_maxFrames{0},
+      m_window{window},
+      m_jobSystem{threadCount}
 {
     m_window.setWindowCloseListener([=]()
                                     { m_isRunning = false; });
+    m_window.setKeyPressListener([=](int key)
+                                 {
+                                     if (key == GLFW_KEY_F12 && Profiler::writeChromeTrace(m_cpuTraceFile))
+                                         cout << "CPU trace written to " << m_cpuTraceFile << endl;
+                                 });
 
     switch (type)
     {
@@ -3,6 +3,7 @@
 
 #include "renderer_utils.h"
 #include "window.h"
+#include "core/job_system.h"
 
 namespace engine
 {
@@ -12,8 +13,16 @@ namespace engine
         RendererType m_type = RendererType::None;
         bool m_isRunning = false;
         uint32_t m_currentFrameNumber = 0;
+        // Stops the render loop after this many frames. 0 means run until the
+        // window is closed (Used for headless/offline rendering)
+        uint32_t m_maxFrames = 0;
+        // CPU trace of the last frames is written here on exit or when F12 is pressed
+        string m_cpuTraceFile = "cpu_trace.json";
+        bool m_writeCpuTraceOnExit = false;
 
         Window &m_window;
+        // Runs the parallel work of every engine stage (Eg: command recording)
+        JobSystem m_jobSystem;
 
         virtual bool init();
         virtual void update();
@@ -21,9 +30,25 @@ namespace engine
         virtual bool clean();
 
     public:
-        Renderer(Window &window, RendererType type = RendererType::None);
+        /**
+         * @param threadCount Threads of the job system including the calling
+         * one, 0 uses one per hardware thread
+         */
+        Renderer(Window &window, RendererType type = RendererType::None, uint32_t threadCount = 0);
         virtual ~Renderer();
 
+        inline void setMaxFrames(uint32_t maxFrames)
+        {
+            m_maxFrames = maxFrames;
+        }
+
+        // Writes the CPU trace of the last frames to path when the render loop ends
+        inline void setCpuTraceFile(const string& path)
+        {
+            m_cpuTraceFile = path;
+            m_writeCpuTraceOnExit = true;
+        }
+
         bool run();
     };
 }
@@ -0,0 +1,181 @@
+#include "vulkan_bindless.h"
+
+uint32_t engine::vulkan::BindlessDescriptors::SlotArray::allocate()
+{
+    if (!freeSlots.empty())
+    {
+        uint32_t slot = freeSlots.back();
+        freeSlots.pop_back();
+        return slot;
+    }
+    return count < capacity ? count++ : INVALID_BINDLESS_INDEX;
+}
+
+bool engine::vulkan::BindlessDescriptors::init(const vk::PhysicalDevice& physicalDevice,
+    const vk::Device& device,
+    DeletionQueue& deletionQueue,
+    uint32_t maxTextures,
+    uint32_t maxBuffers)
+{
+    m_device = device;
+    m_deletionQueue = &deletionQueue;
+
+    auto properties = physicalDevice.getProperties2<vk::PhysicalDeviceProperties2, vk::PhysicalDeviceVulkan12Properties>();
+    const vk::PhysicalDeviceVulkan12Properties& limits = properties.get<vk::PhysicalDeviceVulkan12Properties>();
+    m_textures = SlotArray();
+    m_textures.capacity = std::min({ maxTextures,
+        limits.maxDescriptorSetUpdateAfterBindSampledImages,
+        limits.maxDescriptorSetUpdateAfterBindSamplers,
+        limits.maxPerStageDescriptorUpdateAfterBindSampledImages,
+        limits.maxPerStageDescriptorUpdateAfterBindSamplers });
+    m_buffers = SlotArray();
+    m_buffers.capacity = std::min({ maxBuffers,
+        limits.maxDescriptorSetUpdateAfterBindStorageBuffers,
+        limits.maxPerStageDescriptorUpdateAfterBindStorageBuffers });
+    if (m_textures.capacity == 0 || m_buffers.capacity == 0)
+    {
+        std::cerr << "Bindless error: Device doesn't support update after bind descriptors" << std::endl;
+        return false;
+    }
+
+    vector<vk::DescriptorSetLayoutBinding> bindings{
+        vk::DescriptorSetLayoutBinding(BINDLESS_TEXTURE_BINDING,
+            vk::DescriptorType::eCombinedImageSampler,
+            m_textures.capacity,
+            vk::ShaderStageFlagBits::eAll),
+        vk::DescriptorSetLayoutBinding(BINDLESS_BUFFER_BINDING,
+            vk::DescriptorType::eStorageBuffer,
+            m_buffers.capacity,
+            vk::ShaderStageFlagBits::eAll) };
+
+    // Unused slots may hold nothing, and slots can be written while command
+    // buffers using the set are pending as long as they don't index them
+    const vk::DescriptorBindingFlags bindingFlags = vk::DescriptorBindingFlagBits::ePartiallyBound
+        | vk::DescriptorBindingFlagBits::eUpdateAfterBind
+        | vk::DescriptorBindingFlagBits::eUpdateUnusedWhilePending;
+    vector<vk::DescriptorBindingFlags> flags(bindings.size(), bindingFlags);
+
+    try
+    {
+        vk::StructureChain<vk::DescriptorSetLayoutCreateInfo, vk::DescriptorSetLayoutBindingFlagsCreateInfo> layoutInfo(
+            vk::DescriptorSetLayoutCreateInfo(vk::DescriptorSetLayoutCreateFlagBits::eUpdateAfterBindPool, bindings),
+            vk::DescriptorSetLayoutBindingFlagsCreateInfo(flags));
+        m_layout = device.createDescriptorSetLayout(layoutInfo.get<vk::DescriptorSetLayoutCreateInfo>());
+
+        vector<vk::DescriptorPoolSize> sizes{
+            vk::DescriptorPoolSize(vk::DescriptorType::eCombinedImageSampler, m_textures.capacity),
+            vk::DescriptorPoolSize(vk::DescriptorType::eStorageBuffer, m_buffers.capacity) };
+        m_pool = device.createDescriptorPool(vk::DescriptorPoolCreateInfo(vk::DescriptorPoolCreateFlagBits::eUpdateAfterBind,
+            1,
+            sizes));
+        m_set = device.allocateDescriptorSets(vk::DescriptorSetAllocateInfo(m_pool, m_layout))[0];
+    }
+    catch (...)
+    {
+        handleVulkanException();
+        destroy();
+        return false;
+    }
+
+    return true;
+}
+
+uint32_t engine::vulkan::BindlessDescriptors::addTexture(const vk::ImageView& imageView,
+    const vk::Sampler& sampler,
+    vk::ImageLayout layout)
+{
+    uint32_t index = m_textures.allocate();
+    if (index == INVALID_BINDLESS_INDEX)
+        return index;
+
+    vk::DescriptorImageInfo imageInfo(sampler, imageView, layout);
+    m_device.updateDescriptorSets(vk::WriteDescriptorSet(m_set,
+        BINDLESS_TEXTURE_BINDING,
+        index,
+        vk::DescriptorType::eCombinedImageSampler,
+        imageInfo),
+        {});
+    return index;
+}
+
+uint32_t engine::vulkan::BindlessDescriptors::addBuffer(const vk::Buffer& buffer,
+    vk::DeviceSize offset,
+    vk::DeviceSize range)
+{
+    uint32_t index = m_buffers.allocate();
+    if (index == INVALID_BINDLESS_INDEX)
+        return index;
+
+    vk::DescriptorBufferInfo bufferInfo(buffer, offset, range);
+    m_device.updateDescriptorSets(vk::WriteDescriptorSet(m_set,
+        BINDLESS_BUFFER_BINDING,
+        index,
+        vk::DescriptorType::eStorageBuffer,
+        {},
+        bufferInfo),
+        {});
+    return index;
+}
+
+void engine::vulkan::BindlessDescriptors::removeTexture(uint32_t index, uint64_t timelineValue)
+{
+    if (index >= m_textures.count)
+        return;
+    // The slot keeps its old descriptor, partially bound arrays allow it as
+    // long as shaders don't index it
+    m_deletionQueue->push(timelineValue, [this, index]()
+        { m_textures.freeSlots.push_back(index); });
+}
+
+void engine::vulkan::BindlessDescriptors::removeBuffer(uint32_t index, uint64_t timelineValue)
+{
+    if (index >= m_buffers.count)
+        return;
+    m_deletionQueue->push(timelineValue, [this, index]()
+        { m_buffers.freeSlots.push_back(index); });
+}
+
+vk::PipelineLayout engine::vulkan::BindlessDescriptors::createPipelineLayout(const vector<vk::DescriptorSetLayout>& setLayouts) const
+{
+    vector<vk::DescriptorSetLayout> layouts{ m_layout };
+    layouts.insert(layouts.end(), setLayouts.begin(), setLayouts.end());
+    vk::PushConstantRange pushConstants(vk::ShaderStageFlagBits::eAll, 0, sizeof(BindlessPushConstants));
+
+    try
+    {
+        return m_device.createPipelineLayout(vk::PipelineLayoutCreateInfo(vk::PipelineLayoutCreateFlags(),
+            layouts,
+            pushConstants));
+    }
+    catch (...)
+    {
+        handleVulkanException();
+        return nullptr;
+    }
+}
+
+void engine::vulkan::BindlessDescriptors::bind(const vk::CommandBuffer& cmdBuffer,
+    const vk::PipelineLayout& pipelineLayout,
+    vk::PipelineBindPoint bindPoint) const
+{
+    cmdBuffer.bindDescriptorSets(bindPoint, pipelineLayout, 0, m_set, {});
+}
+
+bool engine::vulkan::BindlessDescriptors::destroy()
+{
+    if (!m_device)
+        return true;
+
+    // Destroying the pool frees the set
+    if (m_pool)
+        m_device.destroyDescriptorPool(m_pool);
+    if (m_layout)
+        m_device.destroyDescriptorSetLayout(m_layout);
+    m_pool = nullptr;
+    m_layout = nullptr;
+    m_set = nullptr;
+    m_textures = SlotArray();
+    m_buffers = SlotArray();
+    m_device = nullptr;
+    return true;
+}
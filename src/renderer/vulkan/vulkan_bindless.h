@@ -0,0 +1,141 @@
+#ifndef VULKAN_BINDLESS_H
+#define VULKAN_BINDLESS_H
+
+#include "vulkan_utils.h"
+#include "vulkan_deletion_queue.h"
+
+namespace engine
+{
+    namespace vulkan
+    {
+        // Bindings of the bindless descriptor set
+        static const uint32_t BINDLESS_TEXTURE_BINDING = 0;
+        static const uint32_t BINDLESS_BUFFER_BINDING = 1;
+        // Returned when the array is full
+        static const uint32_t INVALID_BINDLESS_INDEX = std::numeric_limits<uint32_t>::max();
+
+        /**
+         * @brief Push constants shared by pipelines using bindless descriptors.
+         * Indices select the textures and buffers of a draw in the bindless
+         * arrays, so switching materials only pushes new indices.
+         */
+        struct BindlessPushConstants
+        {
+            uint32_t materialBuffer = INVALID_BINDLESS_INDEX;
+            uint32_t materialIndex = 0;
+            uint32_t transformBuffer = INVALID_BINDLESS_INDEX;
+            uint32_t transformIndex = 0;
+        };
+
+        /**
+         * @brief One descriptor set holding every texture and storage buffer of
+         * the scene in two large update-after-bind arrays. The set is bound once
+         * per command buffer and shaders index the arrays with values from push
+         * constants (Eg: textures[nonuniformEXT(index)] in GLSL), so draws don't
+         * bind any descriptors.
+         *
+         * Needs a device created with the bindless features enabled. Array
+         * slots of removed resources are reused only once the GPU is done with
+         * them. Used from the render thread.
+         *
+         * The renderer doesn't create one, the mesh pipelines bind their
+         * instance buffer directly. A pipeline using it has to index the
+         * arrays with nonuniformEXT and enable the features on the device.
+         */
+        class BindlessDescriptors
+        {
+        private:
+            struct SlotArray
+            {
+                uint32_t capacity = 0;
+                uint32_t count = 0;
+                vector<uint32_t> freeSlots;
+
+                uint32_t allocate();
+            };
+
+            vk::Device m_device;
+            DeletionQueue* m_deletionQueue = nullptr;
+            vk::DescriptorSetLayout m_layout;
+            vk::DescriptorPool m_pool;
+            vk::DescriptorSet m_set;
+
+            SlotArray m_textures;
+            SlotArray m_buffers;
+
+        public:
+            BindlessDescriptors() = default;
+            BindlessDescriptors(const BindlessDescriptors&) = delete;
+            BindlessDescriptors& operator=(const BindlessDescriptors&) = delete;
+
+            /**
+             * @brief Creates the set layout, pool and set. The array sizes are
+             * clamped to the update-after-bind limits of the device.
+             *
+             * @param physicalDevice Vulkan physical device, used for the limits
+             * @param device Vulkan logical device created with the bindless features
+             * @param deletionQueue Queue the release of array slots goes through
+             * @param maxTextures Size of the texture array
+             * @param maxBuffers Size of the storage buffer array
+             * @return true if initialization is successful
+             * @return false if initialization fails
+             */
+            bool init(const vk::PhysicalDevice& physicalDevice,
+                const vk::Device& device,
+                DeletionQueue& deletionQueue,
+                uint32_t maxTextures = 16384,
+                uint32_t maxBuffers = 4096);
+
+            /**
+             * @brief Writes a texture into a free slot of the texture array
+             *
+             * @return index of the texture in the array, INVALID_BINDLESS_INDEX if full
+             */
+            uint32_t addTexture(const vk::ImageView& imageView,
+                const vk::Sampler& sampler,
+                vk::ImageLayout layout = vk::ImageLayout::eShaderReadOnlyOptimal);
+            // Writes a storage buffer range into a free slot of the buffer array
+            uint32_t addBuffer(const vk::Buffer& buffer,
+                vk::DeviceSize offset = 0,
+                vk::DeviceSize range = VK_WHOLE_SIZE);
+
+            /**
+             * @brief Frees a slot once the GPU has reached the timeline value.
+             * Shaders must not index it from later submits.
+             *
+             * @param index Index returned by addTexture()
+             * @param timelineValue Graphics timeline value of the last submit using it
+             */
+            void removeTexture(uint32_t index, uint64_t timelineValue);
+            void removeBuffer(uint32_t index, uint64_t timelineValue);
+
+            /**
+             * @brief Creates a pipeline layout with the bindless set at set 0
+             * and BindlessPushConstants visible to all stages
+             *
+             * @param setLayouts Additional set layouts, starting at set 1
+             * @return the layout, null if creation fails. Owned by the caller.
+             */
+            vk::PipelineLayout createPipelineLayout(const vector<vk::DescriptorSetLayout>& setLayouts = {}) const;
+
+            // Binds the set at set 0, once per command buffer and bind point
+            void bind(const vk::CommandBuffer& cmdBuffer,
+                const vk::PipelineLayout& pipelineLayout,
+                vk::PipelineBindPoint bindPoint = vk::PipelineBindPoint::eGraphics) const;
+
+            inline bool isValid() const
+            {
+                return m_set ? true : false;
+            }
+
+            inline const vk::DescriptorSetLayout& getLayout() const
+            {
+                return m_layout;
+            }
+
+            bool destroy();
+        };
+    }
+}
+
+#endif
@@ -0,0 +1,109 @@
+#include "vulkan_commands.h"
+#include "vulkan_functions.h"
+#include "core/profiler.h"
+
+void engine::vulkan::ParallelCommandRecorder::recordSlice(uint32_t sliceIndex)
+{
+    PROFILE_ZONE("RecordSlice");
+
+    // Contiguous slices, the first (itemCount % sliceCount) slices get one extra item
+    uint32_t sliceSize = m_itemCount / m_sliceCount;
+    uint32_t remainder = m_itemCount % m_sliceCount;
+    uint32_t first = sliceIndex * sliceSize + std::min(sliceIndex, remainder);
+    uint32_t count = sliceSize + (sliceIndex < remainder ? 1 : 0);
+
+    CommandData& data = m_commandData[m_frameIndex * m_sliceCount + sliceIndex];
+    try
+    {
+        // The frame's previous submit has finished, so the whole pool can be reset at once
+        m_device.resetCommandPool(data.pool);
+        if (count == 0)
+        {
+            m_slices[sliceIndex] = nullptr;
+            return;
+        }
+
+        const vk::CommandBuffer& cmdBuffer = data.buffers[0];
+        cmdBuffer.begin(vk::CommandBufferBeginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit
+            | vk::CommandBufferUsageFlagBits::eRenderPassContinue,
+            &m_inheritanceInfo));
+        (*m_recordFunc)(cmdBuffer, first, count);
+        cmdBuffer.end();
+        m_slices[sliceIndex] = cmdBuffer;
+    }
+    catch (...)
+    {
+        handleVulkanException();
+        m_slices[sliceIndex] = nullptr;
+    }
+}
+
+bool engine::vulkan::ParallelCommandRecorder::init(const vk::Device& device,
+    const QueueFamilyIndices& queueFamilyIndices,
+    uint32_t framesInFlight,
+    JobSystem& jobSystem)
+{
+    m_device = device;
+    m_jobSystem = &jobSystem;
+    m_sliceCount = jobSystem.getThreadCount();
+
+    m_commandData.clear();
+    for (uint32_t i = 0; i < framesInFlight * m_sliceCount; i++)
+    {
+        CommandData data = createCommandData(device,
+            queueFamilyIndices,
+            1,
+            vk::CommandBufferLevel::eSecondary);
+        if (!data.pool || data.buffers.empty())
+            return false;
+        m_commandData.push_back(data);
+    }
+
+    m_slices = vector<vk::CommandBuffer>(m_sliceCount, nullptr);
+    m_recorded.reserve(m_sliceCount);
+
+    return true;
+}
+
+const vector<vk::CommandBuffer>& engine::vulkan::ParallelCommandRecorder::record(uint32_t frameIndex,
+    const vk::CommandBufferInheritanceInfo& inheritanceInfo,
+    uint32_t itemCount,
+    const RecordCommandsFunc& recordFunc)
+{
+    m_recorded.clear();
+    if (itemCount == 0 || m_commandData.empty())
+        return m_recorded;
+
+    m_frameIndex = frameIndex;
+    m_itemCount = itemCount;
+    m_inheritanceInfo = inheritanceInfo;
+    m_recordFunc = &recordFunc;
+
+    // One job per slice, the calling thread records the first one and helps
+    // with the rest while waiting
+    m_jobSystem->parallelFor(m_sliceCount, 1, [this](uint32_t begin, uint32_t end)
+                             {
+                                 for (uint32_t i = begin; i < end; i++)
+                                     recordSlice(i);
+                             });
+
+    for (const vk::CommandBuffer& c : m_slices)
+    {
+        if (c)
+            m_recorded.push_back(c);
+    }
+
+    m_recordFunc = nullptr;
+    return m_recorded;
+}
+
+bool engine::vulkan::ParallelCommandRecorder::destroy()
+{
+    for (CommandData& data : m_commandData)
+        data.destroy(m_device);
+    m_commandData.clear();
+    m_slices.clear();
+    m_recorded.clear();
+
+    return true;
+}
@@ -0,0 +1,95 @@
+#ifndef VULKAN_COMMANDS_H
+#define VULKAN_COMMANDS_H
+
+#include <functional>
+
+#include "vulkan_utils.h"
+#include "core/job_system.h"
+
+namespace engine
+{
+    namespace vulkan
+    {
+        /**
+         * @brief Records a slice [first, first + count) of the draw list into a
+         * secondary command buffer. Called from job system threads.
+         */
+        using RecordCommandsFunc = std::function<void(const vk::CommandBuffer& cmdBuffer, uint32_t first, uint32_t count)>;
+
+        /**
+         * @brief Records secondary command buffers in parallel on the job system.
+         * The draw list is split in one slice per job system thread and every
+         * slice owns one command pool per frame in flight. A slice is recorded by
+         * a single job, so recording never needs a lock, and a frame's pools are
+         * reset in bulk once its previous submit has finished.
+         */
+        class ParallelCommandRecorder
+        {
+        private:
+            vk::Device m_device;
+            JobSystem* m_jobSystem = nullptr;
+            uint32_t m_sliceCount = 0;
+
+            // Indexed by [frameIndex * m_sliceCount + sliceIndex]
+            vector<CommandData> m_commandData;
+            // Buffer recorded for each slice in the current record() call, null if
+            // the slice was empty
+            vector<vk::CommandBuffer> m_slices;
+            vector<vk::CommandBuffer> m_recorded;
+
+            uint32_t m_frameIndex = 0;
+            uint32_t m_itemCount = 0;
+            vk::CommandBufferInheritanceInfo m_inheritanceInfo;
+            const RecordCommandsFunc* m_recordFunc = nullptr;
+
+            void recordSlice(uint32_t sliceIndex);
+
+        public:
+            ParallelCommandRecorder() = default;
+            ParallelCommandRecorder(const ParallelCommandRecorder&) = delete;
+            ParallelCommandRecorder& operator=(const ParallelCommandRecorder&) = delete;
+
+            /**
+             * @brief Creates the per slice command pools
+             *
+             * @param device Vulkan logical device object
+             * @param queueFamilyIndices struct with indices of all the necessary queue families
+             * @param framesInFlight Number of frames in flight, one pool per frame per slice
+             * @param jobSystem Job system the slices are recorded on, one slice per thread
+             * @return true if initialization is successful
+             * @return false if initialization fails
+             */
+            bool init(const vk::Device& device,
+                const QueueFamilyIndices& queueFamilyIndices,
+                uint32_t framesInFlight,
+                JobSystem& jobSystem);
+
+            /**
+             * @brief Splits the draw list in one slice per thread and records each
+             * slice into a secondary command buffer in parallel. Blocks until all
+             * slices are recorded. The frame's previous command buffers must not
+             * be in use by the GPU anymore.
+             *
+             * @param frameIndex Index of the frame in flight
+             * @param inheritanceInfo Render pass and framebuffer the commands are executed in
+             * @param itemCount Number of items in the draw list
+             * @param recordFunc Function recording a slice of the draw list
+             * @return secondary command buffers in draw list order, to be run with
+             * vk::CommandBuffer::executeCommands(). Empty if there is nothing to record.
+             */
+            const vector<vk::CommandBuffer>& record(uint32_t frameIndex,
+                const vk::CommandBufferInheritanceInfo& inheritanceInfo,
+                uint32_t itemCount,
+                const RecordCommandsFunc& recordFunc);
+
+            inline uint32_t getSliceCount() const
+            {
+                return m_sliceCount;
+            }
+
+            bool destroy();
+        };
+    }
+}
+
+#endif
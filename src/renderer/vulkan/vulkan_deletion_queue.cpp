@@ -0,0 +1,48 @@
+#include "vulkan_deletion_queue.h"
+
+void engine::vulkan::DeletionQueue::push(uint64_t timelineValue, std::function<void()> destroyFunc)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    // Values are expected to grow. An older value is kept behind the newest one,
+    // which only delays it, so entries always stay sorted.
+    if (!m_entries.empty())
+        timelineValue = std::max(timelineValue, m_entries.back().timelineValue);
+    m_entries.push_back(Entry{ timelineValue, std::move(destroyFunc) });
+}
+
+void engine::vulkan::DeletionQueue::free(uint64_t timelineValue, MemoryAllocator& allocator, const MemoryAllocation& allocation)
+{
+    if (!allocation.isValid())
+        return;
+    push(timelineValue, [&allocator, allocation]() mutable
+         { allocator.free(allocation); });
+}
+
+uint32_t engine::vulkan::DeletionQueue::collect(uint64_t completedValue)
+{
+    // Destroy outside of the lock, destroy functions may release more resources
+    vector<std::function<void()>> destroyFuncs;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        while (!m_entries.empty() && m_entries.front().timelineValue <= completedValue)
+        {
+            destroyFuncs.push_back(std::move(m_entries.front().destroyFunc));
+            m_entries.pop_front();
+        }
+    }
+
+    for (std::function<void()>& f : destroyFuncs)
+        f();
+
+    return static_cast<uint32_t>(destroyFuncs.size());
+}
+
+uint32_t engine::vulkan::DeletionQueue::flush()
+{
+    uint32_t count = 0;
+    // Destroy functions may queue more entries
+    while (size() > 0)
+        count += collect(std::numeric_limits<uint64_t>::max());
+    return count;
+}
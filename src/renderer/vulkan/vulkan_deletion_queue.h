@@ -0,0 +1,80 @@
+#ifndef VULKAN_DELETION_QUEUE_H
+#define VULKAN_DELETION_QUEUE_H
+
+#include <deque>
+#include <functional>
+#include <mutex>
+
+#include "vulkan_utils.h"
+#include "vulkan_memory.h"
+
+namespace engine
+{
+    namespace vulkan
+    {
+        /**
+         * @brief Destroys resources once the GPU has finished the work which
+         * used them, without waiting for the device to go idle. Each entry is
+         * tagged with the timeline value of the last submit using the resource
+         * and collect() destroys every entry whose value has been reached, in
+         * release order. Thread safe.
+         */
+        class DeletionQueue
+        {
+        private:
+            struct Entry
+            {
+                uint64_t timelineValue;
+                std::function<void()> destroyFunc;
+            };
+
+            std::deque<Entry> m_entries;
+            std::mutex m_mutex;
+
+        public:
+            DeletionQueue() = default;
+            DeletionQueue(const DeletionQueue&) = delete;
+            DeletionQueue& operator=(const DeletionQueue&) = delete;
+
+            /**
+             * @brief Queues a function destroying a resource
+             *
+             * @param timelineValue Timeline value of the last submit using the resource
+             * @param destroyFunc Destroys the resource, called from collect() or flush()
+             */
+            void push(uint64_t timelineValue, std::function<void()> destroyFunc);
+
+            // Destroys a Vulkan handle (Eg: vk::Buffer, vk::Framebuffer)
+            template <typename T>
+            void destroy(uint64_t timelineValue, const vk::Device& device, T handle)
+            {
+                if (!handle)
+                    return;
+                push(timelineValue, [device, handle]()
+                     { device.destroy(handle); });
+            }
+
+            // Frees memory handed out by the allocator
+            void free(uint64_t timelineValue, MemoryAllocator& allocator, const MemoryAllocation& allocation);
+
+            /**
+             * @brief Destroys the entries the GPU is done with
+             *
+             * @param completedValue Timeline value the GPU has reached
+             * @return number of destroyed entries
+             */
+            uint32_t collect(uint64_t completedValue);
+
+            // Destroys every entry. The device must be idle.
+            uint32_t flush();
+
+            inline size_t size()
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                return m_entries.size();
+            }
+        };
+    }
+}
+
+#endif
@@ -0,0 +1,261 @@
+#include <algorithm>
+
+#include "vulkan_descriptors.h"
+
+static inline void hashCombine(size_t& seed, size_t value)
+{
+    seed ^= value + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+}
+
+bool engine::vulkan::DescriptorLayoutCache::LayoutKey::operator==(const LayoutKey& other) const
+{
+    if (bindings.size() != other.bindings.size())
+        return false;
+
+    for (size_t i = 0; i < bindings.size(); i++)
+    {
+        const vk::DescriptorSetLayoutBinding& a = bindings[i];
+        const vk::DescriptorSetLayoutBinding& b = other.bindings[i];
+        if (a.binding != b.binding
+            || a.descriptorType != b.descriptorType
+            || a.descriptorCount != b.descriptorCount
+            || a.stageFlags != b.stageFlags)
+            return false;
+    }
+    return true;
+}
+
+size_t engine::vulkan::DescriptorLayoutCache::LayoutKeyHash::operator()(const LayoutKey& key) const
+{
+    size_t seed = key.bindings.size();
+    for (const vk::DescriptorSetLayoutBinding& b : key.bindings)
+    {
+        hashCombine(seed, b.binding);
+        hashCombine(seed, static_cast<size_t>(b.descriptorType));
+        hashCombine(seed, b.descriptorCount);
+        hashCombine(seed, static_cast<size_t>(static_cast<uint32_t>(b.stageFlags)));
+    }
+    return seed;
+}
+
+bool engine::vulkan::DescriptorLayoutCache::init(const vk::Device& device)
+{
+    m_device = device;
+    return m_device ? true : false;
+}
+
+vk::DescriptorSetLayout engine::vulkan::DescriptorLayoutCache::getLayout(const vector<vk::DescriptorSetLayoutBinding>& bindings)
+{
+    LayoutKey key{ bindings };
+    std::sort(key.bindings.begin(), key.bindings.end(),
+        [](const vk::DescriptorSetLayoutBinding& a, const vk::DescriptorSetLayoutBinding& b)
+        {
+            return a.binding < b.binding;
+        });
+    for (vk::DescriptorSetLayoutBinding& b : key.bindings)
+        b.pImmutableSamplers = nullptr;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto it = m_layouts.find(key);
+    if (it != m_layouts.end())
+        return it->second;
+
+    try
+    {
+        vk::DescriptorSetLayout layout = m_device.createDescriptorSetLayout(vk::DescriptorSetLayoutCreateInfo(vk::DescriptorSetLayoutCreateFlags(),
+            key.bindings));
+        m_layouts[key] = layout;
+        return layout;
+    }
+    catch (...)
+    {
+        handleVulkanException();
+        return nullptr;
+    }
+}
+
+bool engine::vulkan::DescriptorLayoutCache::destroy()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_device)
+        return true;
+
+    for (auto& layout : m_layouts)
+        m_device.destroyDescriptorSetLayout(layout.second);
+    m_layouts.clear();
+    m_device = nullptr;
+    return true;
+}
+
+bool engine::vulkan::DescriptorBinding::operator==(const DescriptorBinding& other) const
+{
+    return binding == other.binding
+        && type == other.type
+        && buffer == other.buffer
+        && offset == other.offset
+        && range == other.range
+        && imageView == other.imageView
+        && sampler == other.sampler
+        && imageLayout == other.imageLayout;
+}
+
+bool engine::vulkan::DescriptorSetDesc::operator==(const DescriptorSetDesc& other) const
+{
+    return layout == other.layout && bindings == other.bindings;
+}
+
+size_t engine::vulkan::DescriptorAllocator::DescriptorSetDescHash::operator()(const DescriptorSetDesc& desc) const
+{
+    size_t seed = std::hash<VkDescriptorSetLayout>()(static_cast<VkDescriptorSetLayout>(desc.layout));
+    for (const DescriptorBinding& b : desc.bindings)
+    {
+        hashCombine(seed, static_cast<size_t>(b.binding) | static_cast<size_t>(b.type) << 16);
+        hashCombine(seed, std::hash<VkBuffer>()(static_cast<VkBuffer>(b.buffer)));
+        hashCombine(seed, std::hash<uint64_t>()(b.offset ^ (b.range << 1)));
+        hashCombine(seed, std::hash<VkImageView>()(static_cast<VkImageView>(b.imageView)));
+        hashCombine(seed, std::hash<VkSampler>()(static_cast<VkSampler>(b.sampler)));
+        hashCombine(seed, static_cast<size_t>(b.imageLayout));
+    }
+    return seed;
+}
+
+bool engine::vulkan::DescriptorAllocator::init(const vk::Device& device,
+    uint32_t framesInFlight,
+    uint32_t setsPerPool,
+    const vector<DescriptorPoolRatio>& poolRatios)
+{
+    m_device = device;
+    m_setsPerPool = std::max(setsPerPool, 1u);
+    m_poolRatios = poolRatios;
+    m_frames = vector<FramePools>(std::max(framesInFlight, 1u));
+    m_frameIndex = 0;
+    return m_device ? true : false;
+}
+
+vk::DescriptorPool engine::vulkan::DescriptorAllocator::getPool()
+{
+    if (!m_freePools.empty())
+    {
+        vk::DescriptorPool pool = m_freePools.back();
+        m_freePools.pop_back();
+        return pool;
+    }
+
+    vector<vk::DescriptorPoolSize> sizes;
+    for (const DescriptorPoolRatio& r : m_poolRatios)
+        sizes.push_back(vk::DescriptorPoolSize(r.type, std::max(static_cast<uint32_t>(r.ratio * m_setsPerPool), 1u)));
+
+    // Sets are never freed individually, the whole pool is reset
+    return m_device.createDescriptorPool(vk::DescriptorPoolCreateInfo(vk::DescriptorPoolCreateFlags(),
+        m_setsPerPool,
+        sizes));
+}
+
+void engine::vulkan::DescriptorAllocator::beginFrame(uint32_t frameIndex)
+{
+    m_frameIndex = frameIndex % m_frames.size();
+    FramePools& frame = m_frames[m_frameIndex];
+
+    // Keep the first pool for the frame, hand the others back
+    for (size_t i = 0; i < frame.usedPools.size(); i++)
+    {
+        m_device.resetDescriptorPool(frame.usedPools[i]);
+        if (i > 0)
+            m_freePools.push_back(frame.usedPools[i]);
+    }
+    if (frame.usedPools.size() > 1)
+        frame.usedPools.resize(1);
+    frame.sets.clear();
+}
+
+vk::DescriptorSet engine::vulkan::DescriptorAllocator::allocate(const vk::DescriptorSetLayout& layout)
+{
+    FramePools& frame = m_frames[m_frameIndex];
+
+    try
+    {
+        if (frame.usedPools.empty())
+            frame.usedPools.push_back(getPool());
+
+        try
+        {
+            return m_device.allocateDescriptorSets(vk::DescriptorSetAllocateInfo(frame.usedPools.back(), layout))[0];
+        }
+        catch (const vk::OutOfPoolMemoryError&)
+        {
+        }
+        catch (const vk::FragmentedPoolError&)
+        {
+        }
+
+        // Current pool is full, continue in a new one
+        frame.usedPools.push_back(getPool());
+        return m_device.allocateDescriptorSets(vk::DescriptorSetAllocateInfo(frame.usedPools.back(), layout))[0];
+    }
+    catch (...)
+    {
+        handleVulkanException();
+        return nullptr;
+    }
+}
+
+vk::DescriptorSet engine::vulkan::DescriptorAllocator::getSet(const DescriptorSetDesc& desc)
+{
+    FramePools& frame = m_frames[m_frameIndex];
+    auto it = frame.sets.find(desc);
+    if (it != frame.sets.end())
+        return it->second;
+
+    vk::DescriptorSet set = allocate(desc.layout);
+    if (!set)
+        return nullptr;
+
+    // Infos are referenced by the writes, so they are filled first
+    vector<vk::DescriptorBufferInfo> bufferInfos(desc.bindings.size());
+    vector<vk::DescriptorImageInfo> imageInfos(desc.bindings.size());
+    vector<vk::WriteDescriptorSet> writes;
+    writes.reserve(desc.bindings.size());
+    for (size_t i = 0; i < desc.bindings.size(); i++)
+    {
+        const DescriptorBinding& b = desc.bindings[i];
+        vk::WriteDescriptorSet write(set, b.binding, 0, 1, b.type);
+        switch (b.type)
+        {
+        case vk::DescriptorType::eUniformBuffer:
+        case vk::DescriptorType::eUniformBufferDynamic:
+        case vk::DescriptorType::eStorageBuffer:
+        case vk::DescriptorType::eStorageBufferDynamic:
+            bufferInfos[i] = vk::DescriptorBufferInfo(b.buffer, b.offset, b.range);
+            write.setPBufferInfo(&bufferInfos[i]);
+            break;
+        default:
+            imageInfos[i] = vk::DescriptorImageInfo(b.sampler, b.imageView, b.imageLayout);
+            write.setPImageInfo(&imageInfos[i]);
+            break;
+        }
+        writes.push_back(write);
+    }
+    m_device.updateDescriptorSets(writes, {});
+
+    frame.sets[desc] = set;
+    return set;
+}
+
+bool engine::vulkan::DescriptorAllocator::destroy()
+{
+    if (!m_device)
+        return true;
+
+    for (FramePools& frame : m_frames)
+    {
+        for (vk::DescriptorPool& pool : frame.usedPools)
+            m_device.destroyDescriptorPool(pool);
+    }
+    m_frames.clear();
+    for (vk::DescriptorPool& pool : m_freePools)
+        m_device.destroyDescriptorPool(pool);
+    m_freePools.clear();
+    m_device = nullptr;
+    return true;
+}
@@ -0,0 +1,186 @@
+#ifndef VULKAN_DESCRIPTORS_H
+#define VULKAN_DESCRIPTORS_H
+
+#include <mutex>
+#include <unordered_map>
+
+#include "vulkan_utils.h"
+
+namespace engine
+{
+    namespace vulkan
+    {
+        /**
+         * @brief Number of descriptors of a type a pool holds per set, used to
+         * size the pools of DescriptorAllocator
+         */
+        struct DescriptorPoolRatio
+        {
+            vk::DescriptorType type;
+            float ratio;
+        };
+
+        static const vector<DescriptorPoolRatio> DEFAULT_DESCRIPTOR_POOL_RATIOS{
+            { vk::DescriptorType::eUniformBuffer, 2.0f },
+            { vk::DescriptorType::eUniformBufferDynamic, 1.0f },
+            { vk::DescriptorType::eStorageBuffer, 2.0f },
+            { vk::DescriptorType::eCombinedImageSampler, 4.0f },
+            { vk::DescriptorType::eSampledImage, 1.0f },
+            { vk::DescriptorType::eStorageImage, 1.0f },
+            { vk::DescriptorType::eSampler, 1.0f } };
+
+        /**
+         * @brief Creates each distinct descriptor set layout once. Layouts are
+         * keyed on their bindings, sorted by binding number, so the same
+         * bindings in any order return the same layout. Thread safe.
+         */
+        class DescriptorLayoutCache
+        {
+        private:
+            struct LayoutKey
+            {
+                vector<vk::DescriptorSetLayoutBinding> bindings;
+
+                bool operator==(const LayoutKey& other) const;
+            };
+
+            struct LayoutKeyHash
+            {
+                size_t operator()(const LayoutKey& key) const;
+            };
+
+            vk::Device m_device;
+            std::unordered_map<LayoutKey, vk::DescriptorSetLayout, LayoutKeyHash> m_layouts;
+            std::mutex m_mutex;
+
+        public:
+            DescriptorLayoutCache() = default;
+            DescriptorLayoutCache(const DescriptorLayoutCache&) = delete;
+            DescriptorLayoutCache& operator=(const DescriptorLayoutCache&) = delete;
+
+            bool init(const vk::Device& device);
+
+            /**
+             * @brief Returns the layout with the given bindings, creating it on first use.
+             * Immutable samplers are not supported.
+             *
+             * @param bindings Bindings of the layout
+             * @return the layout, null if creation fails. Owned by the cache.
+             */
+            vk::DescriptorSetLayout getLayout(const vector<vk::DescriptorSetLayoutBinding>& bindings);
+
+            inline size_t size()
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                return m_layouts.size();
+            }
+
+            bool destroy();
+        };
+
+        /**
+         * @brief Resource bound to one binding of a descriptor set. Buffer
+         * fields are used for buffer descriptors, image fields otherwise.
+         */
+        struct DescriptorBinding
+        {
+            uint32_t binding = 0;
+            vk::DescriptorType type = vk::DescriptorType::eUniformBuffer;
+            vk::Buffer buffer;
+            vk::DeviceSize offset = 0;
+            vk::DeviceSize range = VK_WHOLE_SIZE;
+            vk::ImageView imageView;
+            vk::Sampler sampler;
+            vk::ImageLayout imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+
+            bool operator==(const DescriptorBinding& other) const;
+        };
+
+        /**
+         * @brief Layout of a descriptor set and the resources written to it
+         */
+        struct DescriptorSetDesc
+        {
+            vk::DescriptorSetLayout layout;
+            vector<DescriptorBinding> bindings;
+
+            bool operator==(const DescriptorSetDesc& other) const;
+        };
+
+        /**
+         * @brief Allocates descriptor sets which live for one frame. Every frame
+         * in flight owns a list of descriptor pools. A new pool is added when
+         * the current one runs out, and all of them are reset together once
+         * the frame slot is reused, instead of freeing sets one by one.
+         *
+         * Sets are also cached per frame on their layout and bound resources,
+         * so draws binding the same resources share one set. Used from the
+         * render thread.
+         */
+        class DescriptorAllocator
+        {
+        private:
+            struct DescriptorSetDescHash
+            {
+                size_t operator()(const DescriptorSetDesc& desc) const;
+            };
+
+            struct FramePools
+            {
+                vector<vk::DescriptorPool> usedPools;
+                std::unordered_map<DescriptorSetDesc, vk::DescriptorSet, DescriptorSetDescHash> sets;
+            };
+
+            vk::Device m_device;
+            vector<DescriptorPoolRatio> m_poolRatios;
+            uint32_t m_setsPerPool = 0;
+            vector<FramePools> m_frames;
+            uint32_t m_frameIndex = 0;
+            // Pools which were reset and can be reused by any frame
+            vector<vk::DescriptorPool> m_freePools;
+
+            vk::DescriptorPool getPool();
+
+        public:
+            DescriptorAllocator() = default;
+            DescriptorAllocator(const DescriptorAllocator&) = delete;
+            DescriptorAllocator& operator=(const DescriptorAllocator&) = delete;
+
+            /**
+             * @param device Vulkan logical device object
+             * @param framesInFlight Number of frames in flight
+             * @param setsPerPool Maximum sets of each pool
+             * @param poolRatios Descriptors of each type per set in a pool
+             * @return true if initialization is successful
+             */
+            bool init(const vk::Device& device,
+                uint32_t framesInFlight,
+                uint32_t setsPerPool = 1000,
+                const vector<DescriptorPoolRatio>& poolRatios = DEFAULT_DESCRIPTOR_POOL_RATIOS);
+
+            /**
+             * @brief Resets the pools of the frame slot. Must be called once the
+             * slot's previous submit has finished, before allocating from it.
+             *
+             * @param frameIndex Index of the frame in flight
+             */
+            void beginFrame(uint32_t frameIndex);
+
+            // Allocates an empty set from the current frame's pools
+            vk::DescriptorSet allocate(const vk::DescriptorSetLayout& layout);
+
+            /**
+             * @brief Returns a set with the resources of desc written to it.
+             * A set written with the same resources earlier in the frame is reused.
+             *
+             * @param desc Layout and bindings of the set
+             * @return the set, null if allocation fails. Valid until the frame slot is reused.
+             */
+            vk::DescriptorSet getSet(const DescriptorSetDesc& desc);
+
+            bool destroy();
+        };
+    }
+}
+
+#endif
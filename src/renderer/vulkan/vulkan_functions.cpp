@@ -25,7 +25,7 @@ VULKAN_HPP_DEFAULT_DISPATCH_LOADER_DYNAMIC_STORAGE
                 availExtensions.end(),
                 [&reqE](const vk::ExtensionProperties& e)
                 {
-                    return strcmp(reqE, e.extensionName.data());
+                    return strcmp(reqE, e.extensionName.data()) == 0;
                 }) == availExtensions.end();
         });
 
@@ -79,7 +79,7 @@ bool hasRequiredValidationLayers(const vector<const char*> validationLayers)
                 layerProps.end(),
                 [&vLayer](const vk::LayerProperties& l)
                 {
-                    return strcmp(vLayer, l.layerName);
+                    return strcmp(vLayer, l.layerName) == 0;
                 }) == layerProps.end();
         });
 
@@ -194,16 +194,51 @@ engine::vulkan::QueueFamilyIndices engine::vulkan::getQueueFamilyIndices(const v
     QueueFamilyIndices indices;
 
     auto queueFamilies = physicalDevice.getQueueFamilyProperties();
-    uint32_t i = 0;
-    for (const auto& q : queueFamilies)
+    uint32_t asyncTransfer = std::numeric_limits<uint32_t>::max();
+    for (uint32_t i = 0; i < queueFamilies.size(); i++)
     {
-        if (q.queueFlags & vk::QueueFlagBits::eGraphics)
+        const vk::QueueFlags flags = queueFamilies[i].queueFlags;
+        if ((flags & vk::QueueFlagBits::eGraphics) && !indices.isGraphicsSupported())
             indices.graphics = i;
+
+        // Prefer a transfer only family, then one without graphics (Eg: async compute)
+        if (!(flags & vk::QueueFlagBits::eGraphics))
+        {
+            if ((flags & vk::QueueFlagBits::eTransfer) && !(flags & vk::QueueFlagBits::eCompute))
+            {
+                if (!indices.isTransferSupported())
+                    indices.transfer = i;
+            }
+            else if ((flags & (vk::QueueFlagBits::eTransfer | vk::QueueFlagBits::eCompute))
+                && asyncTransfer == std::numeric_limits<uint32_t>::max())
+                asyncTransfer = i;
+        }
     }
 
-    vk::Bool32 isPresentSupported = physicalDevice.getSurfaceSupportKHR(indices.graphics, surface);
-    if (isPresentSupported)
+    if (!indices.isTransferSupported())
+        indices.transfer = asyncTransfer;
+    // Graphics queues always support transfer operations
+    if (!indices.isTransferSupported())
+        indices.transfer = indices.graphics;
+
+    if (!surface || !indices.isGraphicsSupported())
+        return indices;
+
+    // Presenting from the graphics family avoids ownership transfers of swapchain images
+    if (physicalDevice.getSurfaceSupportKHR(indices.graphics, surface))
+    {
         indices.presentation = indices.graphics;
+        return indices;
+    }
+
+    for (uint32_t i = 0; i < queueFamilies.size(); i++)
+    {
+        if (physicalDevice.getSurfaceSupportKHR(i, surface))
+        {
+            indices.presentation = i;
+            break;
+        }
+    }
 
     return indices;
 }
@@ -219,6 +254,52 @@ engine::vulkan::SwapchainSupportInfo engine::vulkan::getSwapchainSupportInfo(con
     return supportInfo;
 }
 
+static bool isTimelineSemaphoreSupported(const vk::PhysicalDevice& physicalDevice)
+{
+    if (physicalDevice.getProperties().apiVersion < VK_API_VERSION_1_2)
+        return false;
+
+    auto features = physicalDevice.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceVulkan12Features>();
+    return features.get<vk::PhysicalDeviceVulkan12Features>().timelineSemaphore ? true : false;
+}
+
+bool engine::vulkan::isBindlessSupported(const vk::PhysicalDevice& physicalDevice)
+{
+    if (physicalDevice.getProperties().apiVersion < VK_API_VERSION_1_2)
+        return false;
+
+    auto features = physicalDevice.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceVulkan12Features>();
+    const vk::PhysicalDeviceVulkan12Features& f = features.get<vk::PhysicalDeviceVulkan12Features>();
+    return f.descriptorIndexing
+        && f.runtimeDescriptorArray
+        && f.descriptorBindingPartiallyBound
+        && f.descriptorBindingUpdateUnusedWhilePending
+        && f.descriptorBindingSampledImageUpdateAfterBind
+        && f.descriptorBindingStorageBufferUpdateAfterBind
+        && f.shaderSampledImageArrayNonUniformIndexing
+        && f.shaderStorageBufferArrayNonUniformIndexing;
+}
+
+bool engine::vulkan::isDrawIndirectCountSupported(const vk::PhysicalDevice& physicalDevice)
+{
+    if (physicalDevice.getProperties().apiVersion < VK_API_VERSION_1_2)
+        return false;
+
+    auto features = physicalDevice.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceVulkan12Features>();
+    return features.get<vk::PhysicalDeviceVulkan12Features>().drawIndirectCount ? true : false;
+}
+
+bool engine::vulkan::isMeshShaderSupported(const vk::PhysicalDevice& physicalDevice)
+{
+    if (physicalDevice.getProperties().apiVersion < VK_API_VERSION_1_2
+        || !hasRequiredDeviceExtensions(physicalDevice, { VK_EXT_MESH_SHADER_EXTENSION_NAME }))
+        return false;
+
+    auto features = physicalDevice.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceMeshShaderFeaturesEXT>();
+    const vk::PhysicalDeviceMeshShaderFeaturesEXT& f = features.get<vk::PhysicalDeviceMeshShaderFeaturesEXT>();
+    return f.taskShader && f.meshShader;
+}
+
 vk::PhysicalDevice engine::vulkan::selectPhysicalDevice(const vk::Instance& instance,
     const vk::SurfaceKHR& surface,
     const vector<const char*>& reqExtensions)
@@ -230,12 +311,11 @@ vk::PhysicalDevice engine::vulkan::selectPhysicalDevice(const vk::Instance& inst
     // or features. The devices are stored in a multi-map in ascending order
     // of their score
     std::multimap<int, vk::PhysicalDevice> deviceScores;
-    int score = 0;
     for (const vk::PhysicalDevice& d : devices)
     {
+        int score = 0;
         if (!d.getFeatures().geometryShader)
         {
-            score = 0;
             deviceScores.insert(std::make_pair(score, d));
             continue;
         }
@@ -243,6 +323,9 @@ vk::PhysicalDevice engine::vulkan::selectPhysicalDevice(const vk::Instance& inst
         if (d.getProperties().deviceType == vk::PhysicalDeviceType::eDiscreteGpu)
             score += 1000;
         score += d.getProperties().limits.maxImageDimension2D;
+        // Meshlets are culled per cluster on the GPU instead of on the CPU
+        if (isMeshShaderSupported(d))
+            score += 500;
         deviceScores.insert(std::make_pair(score, d));
     }
 
@@ -258,7 +341,7 @@ vk::PhysicalDevice engine::vulkan::selectPhysicalDevice(const vk::Instance& inst
 
     // Check if the device has the necessary queue families
     auto indices = getQueueFamilyIndices(idealDevice, surface);
-    if (!(indices.isGraphicsSupported() && indices.isPresentationSupported()))
+    if (!(indices.isGraphicsSupported() && (!surface || indices.isPresentationSupported())))
     {
         std::cerr << "Failed to find GPU with necessary Queue Families" << std::endl;
         return nullptr;
@@ -271,8 +354,15 @@ vk::PhysicalDevice engine::vulkan::selectPhysicalDevice(const vk::Instance& inst
         return nullptr;
     }
 
+    // Frame and upload synchronization rely on timeline semaphores (Vulkan 1.2)
+    if (!isTimelineSemaphoreSupported(idealDevice))
+    {
+        std::cerr << "Failed to find GPU with timeline semaphore support" << std::endl;
+        return nullptr;
+    }
+
     // Check if device has swapchain capabilities
-    if (!getSwapchainSupportInfo(idealDevice, surface).isSupported())
+    if (surface && !getSwapchainSupportInfo(idealDevice, surface).isSupported())
     {
         std::cerr << "Failed to find GPU with swapchain capabilities" << std::endl;
         return nullptr;
@@ -284,7 +374,9 @@ vk::PhysicalDevice engine::vulkan::selectPhysicalDevice(const vk::Instance& inst
 vk::Device engine::vulkan::getLogicalDevice(const vk::PhysicalDevice& physicalDevice,
     const QueueFamilyIndices& queueFamilyIndices,
     const vector<const char*>& validationLayers,
-    const vector<const char*>& reqExtensions)
+    const vector<const char*>& reqExtensions,
+    bool enableBindless,
+    bool enableMeshShader)
 {
     std::set<uint32_t> indices = queueFamilyIndices.getIndices();
 
@@ -296,15 +388,52 @@ vk::Device engine::vulkan::getLogicalDevice(const vk::PhysicalDevice& physicalDe
         queueCreateInfos.push_back(createInfo);
     }
 
+    // Indirect draws are issued in one call when the device allows it, and
+    // select their instance with firstInstance
+    const vk::PhysicalDeviceFeatures supportedFeatures = physicalDevice.getFeatures();
     vk::PhysicalDeviceFeatures deviceFeatures{};
-    vk::DeviceCreateInfo createInfo({},
-        queueCreateInfos,
-        validationLayers,
-        reqExtensions);
+    deviceFeatures.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+    deviceFeatures.drawIndirectFirstInstance = supportedFeatures.drawIndirectFirstInstance;
+    vk::PhysicalDeviceVulkan12Features vulkan12Features;
+    vulkan12Features.timelineSemaphore = true;
+    vulkan12Features.drawIndirectCount = isDrawIndirectCountSupported(physicalDevice);
+    if (enableBindless)
+    {
+        // Large arrays of descriptors updated while sets are bound and
+        // indexed with per draw values in shaders
+        vulkan12Features.descriptorIndexing = true;
+        vulkan12Features.runtimeDescriptorArray = true;
+        vulkan12Features.descriptorBindingPartiallyBound = true;
+        vulkan12Features.descriptorBindingUpdateUnusedWhilePending = true;
+        vulkan12Features.descriptorBindingSampledImageUpdateAfterBind = true;
+        vulkan12Features.descriptorBindingStorageBufferUpdateAfterBind = true;
+        vulkan12Features.shaderSampledImageArrayNonUniformIndexing = true;
+        vulkan12Features.shaderStorageBufferArrayNonUniformIndexing = true;
+    }
+
+    vector<const char*> extensions = reqExtensions;
+    vk::PhysicalDeviceMeshShaderFeaturesEXT meshShaderFeatures;
+    if (enableMeshShader)
+    {
+        extensions.push_back(VK_EXT_MESH_SHADER_EXTENSION_NAME);
+        meshShaderFeatures.taskShader = true;
+        meshShaderFeatures.meshShader = true;
+    }
+
+    vk::StructureChain<vk::DeviceCreateInfo, vk::PhysicalDeviceVulkan12Features, vk::PhysicalDeviceMeshShaderFeaturesEXT> createInfo(
+        vk::DeviceCreateInfo({},
+            queueCreateInfos,
+            validationLayers,
+            extensions,
+            &deviceFeatures),
+        vulkan12Features,
+        meshShaderFeatures);
+    if (!enableMeshShader)
+        createInfo.unlink<vk::PhysicalDeviceMeshShaderFeaturesEXT>();
 
     try
     {
-        vk::Device device = physicalDevice.createDevice(createInfo);
+        vk::Device device = physicalDevice.createDevice(createInfo.get<vk::DeviceCreateInfo>());
 #if VULKAN_HPP_DISPATCH_LOADER_DYNAMIC == 1
         VULKAN_HPP_DEFAULT_DISPATCHER.init(device);
 #endif
@@ -404,12 +533,11 @@ engine::vulkan::SwapchainData engine::vulkan::createSwapchain(const vk::Physical
         true,
         oldSwapchain);
 
+    // Only the queues touching swapchain images share them. createInfo keeps a
+    // pointer to the indices, so they have to outlive the createSwapchainKHR call.
+    vector<uint32_t> indices{ queueFamilyIndices.graphics, queueFamilyIndices.presentation };
     if (sharingMode == vk::SharingMode::eConcurrent)
-    {
-        vector<uint32_t> indices = vector<uint32_t>(queueFamilyIndices.getIndices().begin(),
-            queueFamilyIndices.getIndices().end());
         createInfo.setQueueFamilyIndices(indices);
-    }
 
     SwapchainData swapchainData;
     swapchainData.imageFormat = data.surfaceFormat.format;
@@ -446,8 +574,88 @@ engine::vulkan::SwapchainData engine::vulkan::createSwapchain(const vk::Physical
     return swapchainData;
 }
 
+uint32_t engine::vulkan::findMemoryType(const vk::PhysicalDevice& physicalDevice,
+    uint32_t typeBits,
+    vk::MemoryPropertyFlags properties)
+{
+    vk::PhysicalDeviceMemoryProperties memProps = physicalDevice.getMemoryProperties();
+    for (uint32_t i = 0; i < memProps.memoryTypeCount; i++)
+    {
+        if ((typeBits & (1 << i))
+            && (memProps.memoryTypes[i].propertyFlags & properties) == properties)
+            return i;
+    }
+
+    return std::numeric_limits<uint32_t>::max();
+}
+
+engine::vulkan::SwapchainData engine::vulkan::createOffscreenImages(const vk::PhysicalDevice& physicalDevice,
+    const vk::Device& device,
+    const vk::Extent2D& extent,
+    uint32_t imageCount,
+    vk::Format format)
+{
+    SwapchainData swapchainData;
+    swapchainData.imageFormat = format;
+    swapchainData.imageExtent = extent;
+
+    // Transfer source so that the rendered images can be read back
+    vk::ImageCreateInfo imageInfo(vk::ImageCreateFlags(),
+        vk::ImageType::e2D,
+        format,
+        vk::Extent3D(extent, 1),
+        1,
+        1,
+        vk::SampleCountFlagBits::e1,
+        vk::ImageTiling::eOptimal,
+        vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferSrc,
+        vk::SharingMode::eExclusive,
+        {},
+        vk::ImageLayout::eUndefined);
+
+    vk::ComponentMapping cmpMap;
+    vk::ImageSubresourceRange subRR(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1);
+    try
+    {
+        for (uint32_t i = 0; i < imageCount; i++)
+        {
+            vk::Image image = device.createImage(imageInfo);
+            swapchainData.images.push_back(image);
+
+            vk::MemoryRequirements memReq = device.getImageMemoryRequirements(image);
+            uint32_t memType = findMemoryType(physicalDevice,
+                memReq.memoryTypeBits,
+                vk::MemoryPropertyFlagBits::eDeviceLocal);
+            if (memType == std::numeric_limits<uint32_t>::max())
+                throw std::runtime_error("Failed to find device local memory for offscreen image");
+
+            vk::DeviceMemory memory = device.allocateMemory(vk::MemoryAllocateInfo(memReq.size, memType));
+            swapchainData.imageMemory.push_back(memory);
+            device.bindImageMemory(image, memory, 0);
+
+            vk::ImageViewCreateInfo viewInfo(vk::ImageViewCreateFlags(),
+                image,
+                vk::ImageViewType::e2D,
+                format,
+                cmpMap,
+                subRR);
+            swapchainData.imageViews.push_back(device.createImageView(viewInfo));
+        }
+    }
+    catch (...)
+    {
+        handleVulkanException();
+        swapchainData.imageMemory.resize(swapchainData.images.size());
+        swapchainData.destroy(device);
+    }
+
+    return swapchainData;
+}
+
 engine::vulkan::CommandData engine::vulkan::createCommandData(const vk::Device& device,
-    const QueueFamilyIndices& queueFamilyIndices)
+    const QueueFamilyIndices& queueFamilyIndices,
+    uint32_t bufferCount,
+    vk::CommandBufferLevel level)
 {
     CommandData data;
 
@@ -456,7 +664,7 @@ engine::vulkan::CommandData engine::vulkan::createCommandData(const vk::Device&
 
     try {
         data.pool = device.createCommandPool(createInfo);
-        vk::CommandBufferAllocateInfo allocateInfo(data.pool, vk::CommandBufferLevel::ePrimary, 1);
+        vk::CommandBufferAllocateInfo allocateInfo(data.pool, level, bufferCount);
         data.buffers = device.allocateCommandBuffers(allocateInfo);
     }
     catch (...)
@@ -465,4 +673,22 @@ engine::vulkan::CommandData engine::vulkan::createCommandData(const vk::Device&
     }
 
     return data;
+}
+
+vk::Semaphore engine::vulkan::createTimelineSemaphore(const vk::Device& device, uint64_t initialValue)
+{
+    vk::SemaphoreTypeCreateInfo typeInfo(vk::SemaphoreType::eTimeline, initialValue);
+    vk::SemaphoreCreateInfo createInfo;
+    createInfo.setPNext(&typeInfo);
+
+    try
+    {
+        return device.createSemaphore(createInfo);
+    }
+    catch (...)
+    {
+        handleVulkanException();
+    }
+
+    return nullptr;
 }
\ No newline at end of file
@@ -37,7 +37,9 @@ namespace engine
          *
          * @param physicalDevice Vulkan Physical device object. (Obtained through
          * engine::vulkan::selectPhysicalDevice() function call)
-         * @param surface Vulkan surface object
+         * @param surface Vulkan surface object. If nullptr (headless), the
+         * presentation queue family is not searched for. A transfer only
+         * queue family is preferred for transfers, with the graphics family as fallback
          * @return QueueFamilyIndices struct with necessary queue family indices.
          * The indices might not be intialized if it the physical device does not
          * support the queue families present in QueueFamilyIndices
@@ -58,10 +60,12 @@ namespace engine
         /**
          * @brief Selects an appropriate Vulkan Physical Device (GPU). It filters
          * out GPU based on their capabilites. For example, if it a discrete GPU,
-         * supports geometry shader, has required extensions etc.
+         * supports geometry shader, has required extensions etc. Mesh shader
+         * support raises the score, it isn't required.
          *
          * @param instance Vulkan instance object
-         * @param surface Vulkan surface object
+         * @param surface Vulkan surface object. If nullptr (headless), presentation
+         * and swapchain support is not checked
          * @param reqExtensions vector of required device extensions
          *  (Eg: VK_KHR_swapchain)
          * @return vk::PhysicalDevice if a valid GPU is found
@@ -80,13 +84,26 @@ namespace engine
          * @param validationLayers needed for debugging
          * @param reqExtensions The device extensions which will be used
          * (Eg: VK_KHR_swapchain)
+         * @param enableBindless Enables the descriptor indexing features used by
+         * BindlessDescriptors. Check isBindlessSupported() first.
+         * @param enableMeshShader Enables VK_EXT_mesh_shader with task and mesh
+         * shaders. Check isMeshShaderSupported() first.
          * @return vk::Device vulkan logical device object
          * @return nullptr if it fails to create the device
          */
         vk::Device getLogicalDevice(const vk::PhysicalDevice& physicalDevice,
             const QueueFamilyIndices& queueFamilyIndices,
             const vector<const char*>& validationLayers = {},
-            const vector<const char*>& reqExtensions = {});
+            const vector<const char*>& reqExtensions = {},
+            bool enableBindless = false,
+            bool enableMeshShader = false);
+
+        // Checks for the descriptor indexing features bindless descriptors need
+        bool isBindlessSupported(const vk::PhysicalDevice& physicalDevice);
+        // Checks for vkCmdDrawIndexedIndirectCount, enabled by getLogicalDevice() when supported
+        bool isDrawIndirectCountSupported(const vk::PhysicalDevice& physicalDevice);
+        // Checks for VK_EXT_mesh_shader with task and mesh shaders
+        bool isMeshShaderSupported(const vk::PhysicalDevice& physicalDevice);
 
         SwapchainInitData selectSwapchainInitData(const SwapchainSupportInfo& supportInfo,
             const std::array<int, 2> windowResolution);
@@ -98,8 +115,65 @@ namespace engine
             const std::array<int, 2> windowResolution,
             const vk::SwapchainKHR& oldSwapchain = nullptr);
 
+        /**
+         * @brief Finds the index of a memory type which is allowed by the given
+         * type bits and has all the requested properties
+         *
+         * @param physicalDevice Vulkan physical device object
+         * @param typeBits Memory type bits from vk::MemoryRequirements
+         * @param properties Required memory properties (Eg: eDeviceLocal)
+         * @return uint32_t index of the memory type
+         * @return std::numeric_limits<uint32_t>::max() if no memory type matches
+         */
+        uint32_t findMemoryType(const vk::PhysicalDevice& physicalDevice,
+            uint32_t typeBits,
+            vk::MemoryPropertyFlags properties);
+
+        /**
+         * @brief Creates device local images to render into when there is no
+         * surface to present to (headless rendering). The images can be used
+         * in place of swapchain images.
+         *
+         * @param physicalDevice Vulkan physical device object
+         * @param device Vulkan logical device object
+         * @param extent Resolution of the images
+         * @param imageCount Number of images to create (Eg: one per frame in flight)
+         * @param format Format of the images
+         * @return SwapchainData struct with a null swapchain and the created
+         * images, image views and their memory
+         */
+        SwapchainData createOffscreenImages(const vk::PhysicalDevice& physicalDevice,
+            const vk::Device& device,
+            const vk::Extent2D& extent,
+            uint32_t imageCount,
+            vk::Format format = vk::Format::eR8G8B8A8Unorm);
+
+        /**
+         * @brief Creates a command pool on the graphics queue family and allocates
+         * command buffers from it
+         *
+         * @param device Vulkan logical device object
+         * @param queueFamilyIndices struct with indices of all the necessary queue families
+         * @param bufferCount Number of command buffers to allocate
+         * (Eg: one per frame in flight)
+         * @param level Primary buffers are submitted to a queue, secondary ones are
+         * executed from a primary buffer (Eg: recorded on worker threads)
+         * @return CommandData struct with the pool and the allocated buffers
+         */
         CommandData createCommandData(const vk::Device& device,
-            const QueueFamilyIndices& queueFamilyIndices);
+            const QueueFamilyIndices& queueFamilyIndices,
+            uint32_t bufferCount = 1,
+            vk::CommandBufferLevel level = vk::CommandBufferLevel::ePrimary);
+
+        /**
+         * @brief Creates a timeline semaphore (Vulkan 1.2)
+         *
+         * @param device Vulkan logical device object
+         * @param initialValue Value the semaphore counter starts at
+         * @return vk::Semaphore the semaphore object
+         * @return nullptr if creation fails
+         */
+        vk::Semaphore createTimelineSemaphore(const vk::Device& device, uint64_t initialValue = 0);
     }
 }
 
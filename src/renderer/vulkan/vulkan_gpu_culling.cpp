@@ -0,0 +1,272 @@
+#include "vulkan_gpu_culling.h"
+#include "vulkan_functions.h"
+#include "vulkan_graphics.h"
+#include "core/culling.h"
+
+// Threads per workgroup of cull_instances.comp
+static const uint32_t CULL_GROUP_SIZE = 64;
+
+// writeIndirectDraws() is the CPU reference of the draws the shader writes
+static_assert(sizeof(engine::IndirectDraw) == sizeof(vk::DrawIndexedIndirectCommand),
+    "IndirectDraw must match VkDrawIndexedIndirectCommand");
+
+bool engine::vulkan::GpuCulling::init(const vk::PhysicalDevice& physicalDevice,
+    const vk::Device& device,
+    const vk::PipelineCache& pipelineCache,
+    ResourceRegistry& resources,
+    DescriptorLayoutCache& layoutCache,
+    DescriptorAllocator& descriptorAllocator,
+    UploadService& uploadService)
+{
+    m_device = device;
+    m_resources = &resources;
+    m_descriptorAllocator = &descriptorAllocator;
+    m_uploadService = &uploadService;
+    m_useDrawCount = isDrawIndirectCountSupported(physicalDevice);
+    m_useMultiDraw = physicalDevice.getFeatures().multiDrawIndirect ? true : false;
+    m_useFirstInstance = physicalDevice.getFeatures().drawIndirectFirstInstance ? true : false;
+
+    m_setLayout = layoutCache.getLayout({
+        vk::DescriptorSetLayoutBinding(0, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute),
+        vk::DescriptorSetLayoutBinding(1, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute),
+        vk::DescriptorSetLayoutBinding(2, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute),
+        vk::DescriptorSetLayoutBinding(3, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute) });
+    if (!m_setLayout)
+        return false;
+
+    vk::ShaderModule shader = createShaderModule(device, std::string(SHADER_DIR) + "cull_instances.comp.spv");
+    if (!shader)
+        return false;
+
+    try
+    {
+        vk::PushConstantRange pushConstants(vk::ShaderStageFlagBits::eCompute, 0, sizeof(CullPushConstants));
+        m_pipelineLayout = device.createPipelineLayout(vk::PipelineLayoutCreateInfo(vk::PipelineLayoutCreateFlags(),
+            m_setLayout,
+            pushConstants));
+
+        vk::ComputePipelineCreateInfo pipelineInfo(vk::PipelineCreateFlags(),
+            vk::PipelineShaderStageCreateInfo(vk::PipelineShaderStageCreateFlags(),
+                vk::ShaderStageFlagBits::eCompute,
+                shader,
+                "main"),
+            m_pipelineLayout);
+        m_pipeline = device.createComputePipeline(pipelineCache, pipelineInfo).value;
+    }
+    catch (...)
+    {
+        handleVulkanException();
+    }
+    device.destroyShaderModule(shader);
+
+    // Only the count is reset every frame, it lives as long as the culling pass
+    // Transfer source so that the results can be read back (Eg: by tests)
+    m_countBuffer = resources.createBuffer(sizeof(uint32_t),
+        vk::BufferUsageFlagBits::eStorageBuffer
+        | vk::BufferUsageFlagBits::eIndirectBuffer
+        | vk::BufferUsageFlagBits::eTransferDst
+        | vk::BufferUsageFlagBits::eTransferSrc);
+
+    return m_pipeline && m_countBuffer.isValid();
+}
+
+engine::vulkan::BufferHandle engine::vulkan::GpuCulling::uploadStorageBuffer(BufferHandle oldBuffer,
+    const void* data,
+    vk::DeviceSize size,
+    uint64_t releaseValue)
+{
+    m_resources->release(oldBuffer, releaseValue);
+    if (size == 0)
+        return BufferHandle();
+
+    BufferHandle buffer = m_resources->createBuffer(size,
+        vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst);
+    const BufferResource* resource = m_resources->get(buffer);
+    if (!resource)
+        return BufferHandle();
+
+    uint64_t uploadValue = m_uploadService->uploadBuffer(resource->buffer,
+        0,
+        data,
+        size,
+        vk::PipelineStageFlagBits::eComputeShader | vk::PipelineStageFlagBits::eVertexShader,
+        vk::AccessFlagBits::eShaderRead);
+    if (uploadValue == 0)
+    {
+        m_resources->release(buffer, releaseValue);
+        return BufferHandle();
+    }
+    return buffer;
+}
+
+bool engine::vulkan::GpuCulling::setMeshes(const vector<GpuMeshDraw>& meshes, uint64_t releaseValue)
+{
+    m_meshBuffer = uploadStorageBuffer(m_meshBuffer, meshes.data(), meshes.size() * sizeof(GpuMeshDraw), releaseValue);
+    return meshes.empty() || m_meshBuffer.isValid();
+}
+
+bool engine::vulkan::GpuCulling::setInstances(const vector<GpuInstance>& instances, uint64_t releaseValue)
+{
+    m_instanceBuffer = uploadStorageBuffer(m_instanceBuffer,
+        instances.data(),
+        instances.size() * sizeof(GpuInstance),
+        releaseValue);
+
+    // One draw slot per instance, enough when nothing is culled
+    m_resources->release(m_drawBuffer, releaseValue);
+    m_drawBuffer = BufferHandle();
+    if (!instances.empty())
+    {
+        m_drawBuffer = m_resources->createBuffer(instances.size() * sizeof(vk::DrawIndexedIndirectCommand),
+            vk::BufferUsageFlagBits::eStorageBuffer
+            | vk::BufferUsageFlagBits::eIndirectBuffer
+            | vk::BufferUsageFlagBits::eTransferSrc);
+    }
+
+    bool isValid = m_instanceBuffer.isValid() && m_drawBuffer.isValid();
+    m_instanceCount = isValid ? static_cast<uint32_t>(instances.size()) : 0;
+    return instances.empty() || isValid;
+}
+
+void engine::vulkan::GpuCulling::cull(const vk::CommandBuffer& cmdBuffer)
+{
+    const BufferResource* instances = m_resources->get(m_instanceBuffer);
+    const BufferResource* meshes = m_resources->get(m_meshBuffer);
+    const BufferResource* draws = m_resources->get(m_drawBuffer);
+    const BufferResource* count = m_resources->get(m_countBuffer);
+    // The draws select their instance with firstInstance, there is nothing to write without it
+    if (!isDrawSupported() || m_instanceCount == 0 || !instances || !meshes || !draws || !count)
+        return;
+
+    DescriptorSetDesc setDesc;
+    setDesc.layout = m_setLayout;
+    setDesc.bindings = {
+        DescriptorBinding{ 0, vk::DescriptorType::eStorageBuffer, instances->buffer },
+        DescriptorBinding{ 1, vk::DescriptorType::eStorageBuffer, meshes->buffer },
+        DescriptorBinding{ 2, vk::DescriptorType::eStorageBuffer, draws->buffer },
+        DescriptorBinding{ 3, vk::DescriptorType::eStorageBuffer, count->buffer } };
+    vk::DescriptorSet set = m_descriptorAllocator->getSet(setDesc);
+    if (!set)
+        return;
+
+    // The previous frame's draws have to be done reading the commands before
+    // they are overwritten
+    vector<vk::BufferMemoryBarrier> writeBarriers{
+        vk::BufferMemoryBarrier(vk::AccessFlagBits::eIndirectCommandRead,
+            vk::AccessFlagBits::eTransferWrite,
+            VK_QUEUE_FAMILY_IGNORED,
+            VK_QUEUE_FAMILY_IGNORED,
+            count->buffer,
+            0,
+            VK_WHOLE_SIZE),
+        vk::BufferMemoryBarrier(vk::AccessFlagBits::eIndirectCommandRead,
+            vk::AccessFlagBits::eShaderWrite,
+            VK_QUEUE_FAMILY_IGNORED,
+            VK_QUEUE_FAMILY_IGNORED,
+            draws->buffer,
+            0,
+            VK_WHOLE_SIZE) };
+    cmdBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eDrawIndirect,
+        vk::PipelineStageFlagBits::eTransfer | vk::PipelineStageFlagBits::eComputeShader,
+        vk::DependencyFlags(),
+        {},
+        writeBarriers,
+        {});
+
+    cmdBuffer.fillBuffer(count->buffer, 0, sizeof(uint32_t), 0);
+    cmdBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+        vk::PipelineStageFlagBits::eComputeShader,
+        vk::DependencyFlags(),
+        {},
+        vk::BufferMemoryBarrier(vk::AccessFlagBits::eTransferWrite,
+            vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite,
+            VK_QUEUE_FAMILY_IGNORED,
+            VK_QUEUE_FAMILY_IGNORED,
+            count->buffer,
+            0,
+            VK_WHOLE_SIZE),
+        {});
+
+    CullPushConstants pushConstants;
+    pushConstants.frustumPlanes = m_frustum;
+    pushConstants.instanceCount = m_instanceCount;
+    pushConstants.compactDraws = m_useDrawCount ? 1 : 0;
+
+    cmdBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, m_pipeline);
+    cmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, m_pipelineLayout, 0, set, {});
+    cmdBuffer.pushConstants(m_pipelineLayout,
+        vk::ShaderStageFlagBits::eCompute,
+        0,
+        sizeof(CullPushConstants),
+        &pushConstants);
+    cmdBuffer.dispatch((m_instanceCount + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+
+    vector<vk::BufferMemoryBarrier> readBarriers{
+        vk::BufferMemoryBarrier(vk::AccessFlagBits::eShaderWrite,
+            vk::AccessFlagBits::eIndirectCommandRead,
+            VK_QUEUE_FAMILY_IGNORED,
+            VK_QUEUE_FAMILY_IGNORED,
+            count->buffer,
+            0,
+            VK_WHOLE_SIZE),
+        vk::BufferMemoryBarrier(vk::AccessFlagBits::eShaderWrite,
+            vk::AccessFlagBits::eIndirectCommandRead,
+            VK_QUEUE_FAMILY_IGNORED,
+            VK_QUEUE_FAMILY_IGNORED,
+            draws->buffer,
+            0,
+            VK_WHOLE_SIZE) };
+    cmdBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,
+        vk::PipelineStageFlagBits::eDrawIndirect,
+        vk::DependencyFlags(),
+        {},
+        readBarriers,
+        {});
+}
+
+void engine::vulkan::GpuCulling::draw(const vk::CommandBuffer& cmdBuffer) const
+{
+    const BufferResource* draws = m_resources->get(m_drawBuffer);
+    const BufferResource* count = m_resources->get(m_countBuffer);
+    if (!isDrawSupported() || m_instanceCount == 0 || !draws || !count)
+        return;
+
+    const uint32_t stride = sizeof(vk::DrawIndexedIndirectCommand);
+    if (m_useDrawCount)
+        cmdBuffer.drawIndexedIndirectCount(draws->buffer, 0, count->buffer, 0, m_instanceCount, stride);
+    else if (m_useMultiDraw)
+        cmdBuffer.drawIndexedIndirect(draws->buffer, 0, m_instanceCount, stride);
+    else
+    {
+        for (uint32_t i = 0; i < m_instanceCount; i++)
+            cmdBuffer.drawIndexedIndirect(draws->buffer, i * stride, 1, stride);
+    }
+}
+
+bool engine::vulkan::GpuCulling::destroy()
+{
+    if (!m_device)
+        return true;
+
+    // Called once the device is idle, nothing uses the buffers anymore
+    m_resources->release(m_instanceBuffer, 0);
+    m_resources->release(m_meshBuffer, 0);
+    m_resources->release(m_drawBuffer, 0);
+    m_resources->release(m_countBuffer, 0);
+    m_instanceBuffer = BufferHandle();
+    m_meshBuffer = BufferHandle();
+    m_drawBuffer = BufferHandle();
+    m_countBuffer = BufferHandle();
+    m_instanceCount = 0;
+
+    if (m_pipeline)
+        m_device.destroyPipeline(m_pipeline);
+    if (m_pipelineLayout)
+        m_device.destroyPipelineLayout(m_pipelineLayout);
+    m_pipeline = nullptr;
+    m_pipelineLayout = nullptr;
+    // The set layout belongs to the layout cache
+    m_setLayout = nullptr;
+    m_device = nullptr;
+    return true;
+}
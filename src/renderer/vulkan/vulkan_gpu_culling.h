@@ -0,0 +1,219 @@
+#ifndef VULKAN_GPU_CULLING_H
+#define VULKAN_GPU_CULLING_H
+
+#include <array>
+
+#include "vulkan_utils.h"
+#include "vulkan_resources.h"
+#include "vulkan_descriptors.h"
+#include "vulkan_upload.h"
+
+namespace engine
+{
+    namespace vulkan
+    {
+        /**
+         * @brief Instance data read by the culling shader and the vertex shaders,
+         * matches the Instance struct of cull_instances.comp
+         *
+         * @param transform Rows of the 3x4 world transform
+         * @param boundingSphere World space bounding sphere, xyz center and w radius
+         * @param meshIndex Index of the mesh in the mesh draw list
+         */
+        struct GpuInstance
+        {
+            float transform[12];
+            float boundingSphere[4];
+            uint32_t meshIndex = 0;
+            uint32_t materialIndex = 0;
+            uint32_t pad[2] = { 0, 0 };
+        };
+
+        // Index range of a mesh in the shared index and vertex buffers
+        struct GpuMeshDraw
+        {
+            uint32_t indexCount = 0;
+            uint32_t firstIndex = 0;
+            int32_t vertexOffset = 0;
+            uint32_t pad = 0;
+        };
+
+        /**
+         * @brief Frustum planes pointing inside, a point p is inside if
+         * dot(plane.xyz, p) + plane.w >= 0 for all of them. The default
+         * planes accept everything.
+         */
+        using FrustumPlanes = std::array<std::array<float, 4>, 6>;
+        static const FrustumPlanes INFINITE_FRUSTUM{ { { 0.0f, 0.0f, 0.0f, 1.0f },
+            { 0.0f, 0.0f, 0.0f, 1.0f },
+            { 0.0f, 0.0f, 0.0f, 1.0f },
+            { 0.0f, 0.0f, 0.0f, 1.0f },
+            { 0.0f, 0.0f, 0.0f, 1.0f },
+            { 0.0f, 0.0f, 0.0f, 1.0f } } };
+
+        /**
+         * @brief GPU driven draw path. Instances live in a storage buffer and a
+         * compute pass frustum culls them every frame, writing one
+         * VkDrawIndexedIndirectCommand per visible instance and a draw count.
+         * draw() then issues every instance with a single
+         * vkCmdDrawIndexedIndirectCount, so the CPU cost doesn't grow with the
+         * instance count.
+         *
+         * Devices without draw indirect count get a draw per instance written in
+         * place, culled instances with no instances, drawn with one multi draw.
+         * Each draw's firstInstance is the instance index, which vertex shaders
+         * use to fetch the GpuInstance. Indirect draws need the
+         * drawIndirectFirstInstance feature for that, without it nothing is
+         * culled or drawn and isDrawSupported() tells the renderer to record
+         * the draws on the CPU instead. Used from the render thread.
+         */
+        class GpuCulling
+        {
+        private:
+            struct CullPushConstants
+            {
+                FrustumPlanes frustumPlanes;
+                uint32_t instanceCount;
+                uint32_t compactDraws;
+            };
+
+            vk::Device m_device;
+            ResourceRegistry* m_resources = nullptr;
+            DescriptorAllocator* m_descriptorAllocator = nullptr;
+            UploadService* m_uploadService = nullptr;
+            bool m_useDrawCount = false;
+            bool m_useMultiDraw = false;
+            // Indirect draws may have a non zero firstInstance
+            bool m_useFirstInstance = false;
+
+            vk::DescriptorSetLayout m_setLayout;
+            vk::PipelineLayout m_pipelineLayout;
+            vk::Pipeline m_pipeline;
+
+            BufferHandle m_instanceBuffer;
+            BufferHandle m_meshBuffer;
+            BufferHandle m_drawBuffer;
+            BufferHandle m_countBuffer;
+            uint32_t m_instanceCount = 0;
+            FrustumPlanes m_frustum = INFINITE_FRUSTUM;
+
+            BufferHandle uploadStorageBuffer(BufferHandle oldBuffer,
+                const void* data,
+                vk::DeviceSize size,
+                uint64_t releaseValue);
+
+        public:
+            GpuCulling() = default;
+            GpuCulling(const GpuCulling&) = delete;
+            GpuCulling& operator=(const GpuCulling&) = delete;
+
+            /**
+             * @brief Creates the culling compute pipeline
+             *
+             * @param physicalDevice Vulkan physical device, used to check the indirect draw features
+             * @param device Vulkan logical device object
+             * @param pipelineCache Pipeline cache the compute pipeline is created with
+             * @param resources Registry the buffers are created in
+             * @param layoutCache Cache the descriptor set layout comes from
+             * @param descriptorAllocator Per frame allocator of the culling descriptor set
+             * @param uploadService Service the instance and mesh data is uploaded with
+             * @return true if initialization is successful
+             * @return false if the shader is missing or pipeline creation fails
+             */
+            bool init(const vk::PhysicalDevice& physicalDevice,
+                const vk::Device& device,
+                const vk::PipelineCache& pipelineCache,
+                ResourceRegistry& resources,
+                DescriptorLayoutCache& layoutCache,
+                DescriptorAllocator& descriptorAllocator,
+                UploadService& uploadService);
+
+            /**
+             * @brief Replaces the mesh draw list instances refer to
+             *
+             * @param meshes Index ranges of the meshes
+             * @param releaseValue Graphics timeline value after which the old
+             * buffer is no longer used (Eg: the value of the frame being recorded)
+             * @return false if the upload fails
+             */
+            bool setMeshes(const vector<GpuMeshDraw>& meshes, uint64_t releaseValue);
+
+            /**
+             * @brief Replaces the instances. The data is uploaded into new buffers
+             * on the transfer queue, so frames in flight keep using the old ones.
+             *
+             * @param instances Instances to cull and draw
+             * @param releaseValue Graphics timeline value after which the old
+             * buffers are no longer used
+             * @return false if the upload fails
+             */
+            bool setInstances(const vector<GpuInstance>& instances, uint64_t releaseValue);
+
+            inline void setFrustum(const FrustumPlanes& planes)
+            {
+                m_frustum = planes;
+            }
+
+            /**
+             * @brief Records the culling pass. Must be recorded outside of a render
+             * pass, after the upload acquire barriers and before draw().
+             *
+             * @param cmdBuffer Command buffer of the frame on the graphics queue
+             */
+            void cull(const vk::CommandBuffer& cmdBuffer);
+
+            /**
+             * @brief Draws the visible instances. The graphics pipeline, index and
+             * vertex buffers have to be bound already.
+             *
+             * @param cmdBuffer Command buffer inside the render pass, primary or secondary
+             */
+            void draw(const vk::CommandBuffer& cmdBuffer) const;
+
+            inline uint32_t getInstanceCount() const
+            {
+                return m_instanceCount;
+            }
+
+            inline bool isValid() const
+            {
+                return m_pipeline ? true : false;
+            }
+
+            // False if the device can't draw the culled instances, they have to be drawn another way
+            inline bool isDrawSupported() const
+            {
+                return isValid() && m_useFirstInstance;
+            }
+
+            // Instance buffer, for binding in the vertex shaders
+            inline BufferHandle getInstanceBuffer() const
+            {
+                return m_instanceBuffer;
+            }
+
+            // Draws written by cull(), compacted if isCompacted(), one per instance otherwise
+            inline BufferHandle getDrawBuffer() const
+            {
+                return m_drawBuffer;
+            }
+
+            // Number of compacted draws written by cull()
+            inline BufferHandle getCountBuffer() const
+            {
+                return m_countBuffer;
+            }
+
+            // True if visible draws are packed at the start of the draw buffer
+            inline bool isCompacted() const
+            {
+                return m_useDrawCount;
+            }
+
+            // Buffers are released through the resource registry
+            bool destroy();
+        };
+    }
+}
+
+#endif
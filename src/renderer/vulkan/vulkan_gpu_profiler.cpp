@@ -0,0 +1,220 @@
+#include <iomanip>
+
+#include "vulkan_gpu_profiler.h"
+
+bool engine::vulkan::GpuProfiler::init(const vk::PhysicalDevice& physicalDevice,
+    const vk::Device& device,
+    uint32_t queueFamilyIndex,
+    uint32_t framesInFlight,
+    uint32_t maxZonesPerFrame)
+{
+    m_device = device;
+    m_isEnabled = false;
+
+    vector<vk::QueueFamilyProperties> families = physicalDevice.getQueueFamilyProperties();
+    if (queueFamilyIndex >= families.size() || families[queueFamilyIndex].timestampValidBits == 0)
+    {
+        std::cout << "GPU profiler disabled: timestamps are not supported by the queue" << std::endl;
+        return true;
+    }
+
+    const uint32_t validBits = families[queueFamilyIndex].timestampValidBits;
+    m_timestampMask = validBits >= 64 ? std::numeric_limits<uint64_t>::max() : (1ull << validBits) - 1;
+    m_timestampPeriod = static_cast<double>(physicalDevice.getProperties().limits.timestampPeriod);
+
+    // Every zone needs a begin and an end timestamp
+    m_queriesPerFrame = std::max(maxZonesPerFrame, 1u) * 2;
+    m_frames = vector<FrameQueries>(framesInFlight);
+
+    try
+    {
+        m_queryPool = device.createQueryPool(vk::QueryPoolCreateInfo(vk::QueryPoolCreateFlags(),
+            vk::QueryType::eTimestamp,
+            m_queriesPerFrame * framesInFlight));
+    }
+    catch (...)
+    {
+        handleVulkanException();
+        return false;
+    }
+
+    m_isEnabled = true;
+    return true;
+}
+
+void engine::vulkan::GpuProfiler::readback(FrameQueries& frame)
+{
+    if (!frame.isPending)
+        return;
+    frame.isPending = false;
+    if (frame.queryCount == 0)
+        return;
+
+    // Each query is followed by its availability, so a frame whose queries
+    // never ran (Eg: skipped submit) is dropped instead of waited on
+    vector<uint64_t> results(static_cast<size_t>(frame.queryCount) * 2);
+    vk::Result result = m_device.getQueryPoolResults(m_queryPool,
+        m_frameIndex * m_queriesPerFrame,
+        frame.queryCount,
+        results.size() * sizeof(uint64_t),
+        results.data(),
+        2 * sizeof(uint64_t),
+        vk::QueryResultFlagBits::e64 | vk::QueryResultFlagBits::eWithAvailability);
+    if (result != vk::Result::eSuccess && result != vk::Result::eNotReady)
+        return;
+
+    vector<TraceEvent> events;
+    for (const Zone& zone : frame.zones)
+    {
+        if (results[zone.beginQuery * 2 + 1] == 0 || results[zone.endQuery * 2 + 1] == 0)
+            continue;
+
+        const uint64_t begin = results[zone.beginQuery * 2] & m_timestampMask;
+        const uint64_t end = results[zone.endQuery * 2] & m_timestampMask;
+        const double durationMs = static_cast<double>((end - begin) & m_timestampMask) * m_timestampPeriod * 1e-6;
+
+        ZoneHistory& history = m_history[zone.name];
+        history.samples.push_back(durationMs);
+        history.sum += durationMs;
+        if (history.samples.size() > m_historySize)
+        {
+            history.sum -= history.samples.front();
+            history.samples.pop_front();
+        }
+
+        GpuZoneStatistics& stats = m_statistics[zone.name];
+        stats.lastMs = durationMs;
+        stats.sampleCount = static_cast<uint32_t>(history.samples.size());
+        stats.averageMs = history.sum / stats.sampleCount;
+        auto minMax = std::minmax_element(history.samples.begin(), history.samples.end());
+        stats.minMs = *minMax.first;
+        stats.maxMs = *minMax.second;
+
+        if (!m_hasTraceOrigin)
+        {
+            m_traceOrigin = begin;
+            m_hasTraceOrigin = true;
+        }
+
+        TraceEvent event;
+        event.name = zone.name;
+        event.category = "gpu";
+        event.startUs = static_cast<double>((begin - m_traceOrigin) & m_timestampMask) * m_timestampPeriod * 1e-3;
+        event.durationUs = durationMs * 1e3;
+        event.frameNumber = frame.frameNumber;
+        events.push_back(event);
+    }
+
+    m_traceFrames.push_back(std::move(events));
+    if (m_traceFrames.size() > m_traceFrameCount)
+        m_traceFrames.pop_front();
+}
+
+void engine::vulkan::GpuProfiler::beginFrame(const vk::CommandBuffer& cmdBuffer, uint32_t frameIndex, uint64_t frameNumber)
+{
+    if (!m_isEnabled)
+        return;
+
+    m_frameIndex = frameIndex;
+    m_cmdBuffer = cmdBuffer;
+    m_openZones.clear();
+
+    FrameQueries& frame = m_frames[frameIndex];
+    readback(frame);
+
+    frame.zones.clear();
+    frame.queryCount = 0;
+    frame.frameNumber = frameNumber;
+    frame.isPending = true;
+
+    cmdBuffer.resetQueryPool(m_queryPool, frameIndex * m_queriesPerFrame, m_queriesPerFrame);
+}
+
+void engine::vulkan::GpuProfiler::endFrame()
+{
+    while (!m_openZones.empty())
+        endZone();
+    m_cmdBuffer = nullptr;
+}
+
+void engine::vulkan::GpuProfiler::beginZone(const std::string& name)
+{
+    if (!m_isEnabled || !m_cmdBuffer)
+        return;
+
+    FrameQueries& frame = m_frames[m_frameIndex];
+    if (frame.queryCount + 2 > m_queriesPerFrame)
+    {
+        // Out of queries, the zone is not timed but endZone() stays balanced
+        m_openZones.push_back(std::numeric_limits<uint32_t>::max());
+        return;
+    }
+
+    Zone zone;
+    zone.name = name;
+    zone.depth = static_cast<uint32_t>(m_openZones.size());
+    zone.beginQuery = frame.queryCount++;
+    // Reserve the end query now so zones never run out of queries midway
+    zone.endQuery = frame.queryCount++;
+
+    m_cmdBuffer.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe,
+        m_queryPool,
+        m_frameIndex * m_queriesPerFrame + zone.beginQuery);
+
+    m_openZones.push_back(static_cast<uint32_t>(frame.zones.size()));
+    frame.zones.push_back(zone);
+}
+
+void engine::vulkan::GpuProfiler::endZone()
+{
+    if (!m_isEnabled || !m_cmdBuffer || m_openZones.empty())
+        return;
+
+    uint32_t zoneIndex = m_openZones.back();
+    m_openZones.pop_back();
+    if (zoneIndex == std::numeric_limits<uint32_t>::max())
+        return;
+
+    // Bottom of pipe waits for all previous commands to finish
+    const Zone& zone = m_frames[m_frameIndex].zones[zoneIndex];
+    m_cmdBuffer.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe,
+        m_queryPool,
+        m_frameIndex * m_queriesPerFrame + zone.endQuery);
+}
+
+bool engine::vulkan::GpuProfiler::writeChromeTrace(const std::string& path) const
+{
+    vector<TraceEvent> events;
+    for (const vector<TraceEvent>& frameEvents : m_traceFrames)
+        events.insert(events.end(), frameEvents.begin(), frameEvents.end());
+
+    return engine::writeChromeTrace(path, events, { "GPU" });
+}
+
+void engine::vulkan::GpuProfiler::printStatistics() const
+{
+    if (m_statistics.empty())
+        return;
+
+    std::cout << "GPU timings over the last " << m_historySize << " frames (ms):" << std::endl;
+    std::cout << std::fixed << std::setprecision(3);
+    for (const auto& s : m_statistics)
+    {
+        std::cout << "  " << std::left << std::setw(24) << s.first << std::right
+                  << " avg " << s.second.averageMs
+                  << "  min " << s.second.minMs
+                  << "  max " << s.second.maxMs
+                  << "  last " << s.second.lastMs << std::endl;
+    }
+    std::cout << std::defaultfloat;
+}
+
+bool engine::vulkan::GpuProfiler::destroy()
+{
+    if (m_queryPool)
+        m_device.destroyQueryPool(m_queryPool);
+    m_queryPool = nullptr;
+    m_isEnabled = false;
+    m_frames.clear();
+    return true;
+}
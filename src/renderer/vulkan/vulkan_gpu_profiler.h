@@ -0,0 +1,171 @@
+#ifndef VULKAN_GPU_PROFILER_H
+#define VULKAN_GPU_PROFILER_H
+
+#include <deque>
+#include <string>
+
+#include "vulkan_utils.h"
+#include "core/chrome_trace.h"
+
+namespace engine
+{
+    namespace vulkan
+    {
+        /**
+         * @brief Rolling GPU timings of a zone over the last frames, in milliseconds
+         */
+        struct GpuZoneStatistics
+        {
+            double lastMs = 0.0;
+            double averageMs = 0.0;
+            double minMs = 0.0;
+            double maxMs = 0.0;
+            uint32_t sampleCount = 0;
+        };
+
+        /**
+         * @brief Measures GPU time of zones of a command buffer with timestamp
+         * queries. Every frame in flight owns a range of the query pool, which
+         * is read back when the frame slot is reused, N frames later, after its
+         * submit has been waited on. Reading back never stalls the CPU.
+         *
+         * Zones can be nested but must be written to the primary command buffer
+         * outside of render passes recorded with secondary command buffers.
+         */
+        class GpuProfiler
+        {
+        private:
+            struct Zone
+            {
+                std::string name;
+                uint32_t depth = 0;
+                // Query indices relative to the frame's range
+                uint32_t beginQuery = 0;
+                uint32_t endQuery = 0;
+            };
+
+            struct FrameQueries
+            {
+                vector<Zone> zones;
+                uint32_t queryCount = 0;
+                uint64_t frameNumber = 0;
+                bool isPending = false;
+            };
+
+            struct ZoneHistory
+            {
+                std::deque<double> samples;
+                double sum = 0.0;
+            };
+
+            vk::Device m_device;
+            vk::QueryPool m_queryPool;
+            bool m_isEnabled = false;
+            // Nanoseconds per timestamp tick
+            double m_timestampPeriod = 1.0;
+            uint64_t m_timestampMask = std::numeric_limits<uint64_t>::max();
+            uint32_t m_queriesPerFrame = 0;
+
+            vector<FrameQueries> m_frames;
+            uint32_t m_frameIndex = 0;
+            vk::CommandBuffer m_cmdBuffer;
+            // Zones of the current frame which are not ended yet
+            vector<uint32_t> m_openZones;
+
+            uint32_t m_historySize = 120;
+            std::map<std::string, ZoneHistory> m_history;
+            std::map<std::string, GpuZoneStatistics> m_statistics;
+
+            uint32_t m_traceFrameCount = 300;
+            std::deque<vector<TraceEvent>> m_traceFrames;
+            bool m_hasTraceOrigin = false;
+            uint64_t m_traceOrigin = 0;
+
+            void readback(FrameQueries& frame);
+
+        public:
+            GpuProfiler() = default;
+            GpuProfiler(const GpuProfiler&) = delete;
+            GpuProfiler& operator=(const GpuProfiler&) = delete;
+
+            /**
+             * @brief Creates the timestamp query pool. The profiler stays
+             * disabled (and does nothing) if the queue family doesn't support
+             * timestamps.
+             *
+             * @param physicalDevice Vulkan physical device, used for the timestamp period
+             * @param device Vulkan logical device object
+             * @param queueFamilyIndex Queue family the profiled command buffers are submitted to
+             * @param framesInFlight Number of frames in flight
+             * @param maxZonesPerFrame Zones beyond this are ignored
+             * @return true if the profiler is ready or disabled
+             * @return false if the query pool creation fails
+             */
+            bool init(const vk::PhysicalDevice& physicalDevice,
+                const vk::Device& device,
+                uint32_t queueFamilyIndex,
+                uint32_t framesInFlight,
+                uint32_t maxZonesPerFrame = 64);
+
+            /**
+             * @brief Reads back the results of the frame which used the slot
+             * before and resets its queries. Must be called after the slot's
+             * previous submit was waited on, at the start of the command buffer.
+             *
+             * @param cmdBuffer Primary command buffer of the frame, in recording state
+             * @param frameIndex Index of the frame in flight
+             * @param frameNumber Frame number, stored in the trace
+             */
+            void beginFrame(const vk::CommandBuffer& cmdBuffer, uint32_t frameIndex, uint64_t frameNumber);
+            // Ends the zones left open
+            void endFrame();
+
+            void beginZone(const std::string& name);
+            void endZone();
+
+            // Zones with the same name are accumulated together
+            inline const std::map<std::string, GpuZoneStatistics>& getStatistics() const
+            {
+                return m_statistics;
+            }
+
+            inline bool isEnabled() const
+            {
+                return m_isEnabled;
+            }
+
+            // Writes the zones of the last read back frames as a Chrome trace
+            bool writeChromeTrace(const std::string& path) const;
+
+            void printStatistics() const;
+
+            bool destroy();
+        };
+
+        /**
+         * @brief Times the commands recorded during its lifetime
+         */
+        class GpuProfileZone
+        {
+        private:
+            GpuProfiler& m_profiler;
+
+        public:
+            GpuProfileZone(GpuProfiler& profiler, const std::string& name)
+                : m_profiler{profiler}
+            {
+                m_profiler.beginZone(name);
+            }
+
+            ~GpuProfileZone()
+            {
+                m_profiler.endZone();
+            }
+
+            GpuProfileZone(const GpuProfileZone&) = delete;
+            GpuProfileZone& operator=(const GpuProfileZone&) = delete;
+        };
+    }
+}
+
+#endif
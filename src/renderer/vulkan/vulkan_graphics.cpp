@@ -1,6 +1,40 @@
+#include <fstream>
+#include <filesystem>
+#include <cstring>
+
 #include "vulkan_graphics.h"
 
-engine::vulkan::RenderData engine::vulkan::getRenderData(const vk::Device& device, const SwapchainData& swapchainData)
+/**
+ * @brief Checks if the pipeline cache data was created by the given physical
+ * device. Data from another GPU or driver version is rejected before it's
+ * handed to the driver.
+ *
+ * @param physicalDevice Vulkan physical device
+ * @param data Pipeline cache data read from disk
+ * @return true if the header matches the device
+ * @return false if the data is invalid or from another device
+ */
+static bool isPipelineCacheCompatible(const vk::PhysicalDevice& physicalDevice, const vector<char>& data)
+{
+    // Header layout: headerSize, headerVersion, vendorID, deviceID, pipelineCacheUUID
+    const size_t headerSize = 4 * sizeof(uint32_t) + VK_UUID_SIZE;
+    if (data.size() < headerSize)
+        return false;
+
+    uint32_t header[4];
+    std::memcpy(header, data.data(), sizeof(header));
+
+    vk::PhysicalDeviceProperties props = physicalDevice.getProperties();
+    return header[0] >= headerSize
+        && header[1] == VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+        && header[2] == props.vendorID
+        && header[3] == props.deviceID
+        && std::memcmp(data.data() + sizeof(header), props.pipelineCacheUUID.data(), VK_UUID_SIZE) == 0;
+}
+
+engine::vulkan::RenderData engine::vulkan::getRenderData(const vk::Device& device,
+    const SwapchainData& swapchainData,
+    vk::ImageLayout finalLayout)
 {
     RenderData data;
 
@@ -14,7 +48,7 @@ engine::vulkan::RenderData engine::vulkan::getRenderData(const vk::Device& devic
         vk::AttachmentLoadOp::eDontCare,
         vk::AttachmentStoreOp::eDontCare,
         vk::ImageLayout::eUndefined,
-        vk::ImageLayout::ePresentSrcKHR);
+        finalLayout);
 
     // TODO: Create Depth attachment
 
@@ -35,28 +69,45 @@ engine::vulkan::RenderData engine::vulkan::getRenderData(const vk::Device& devic
     try
     {
         data.renderPass = device.createRenderPass(createInfo);
+    }
+    catch (...)
+    {
+        handleVulkanException();
+        return data;
+    }
+
+    data.framebuffers = createFramebuffers(device, data.renderPass, swapchainData);
 
-        vk::FramebufferCreateInfo frameBufferInfo(vk::FramebufferCreateFlags(),
-            data.renderPass,
-            {},
-            swapchainData.imageExtent.width,
-            swapchainData.imageExtent.height,
-            1);
+    return data;
+}
+
+vector<vk::Framebuffer> engine::vulkan::createFramebuffers(const vk::Device& device,
+    const vk::RenderPass& renderPass,
+    const SwapchainData& swapchainData)
+{
+    vector<vk::Framebuffer> framebuffers;
+
+    vk::FramebufferCreateInfo frameBufferInfo(vk::FramebufferCreateFlags(),
+        renderPass,
+        {},
+        swapchainData.imageExtent.width,
+        swapchainData.imageExtent.height,
+        1);
 
-        data.framebuffers.clear();
+    try
+    {
         for (const auto& i : swapchainData.imageViews)
         {
             frameBufferInfo.setAttachments(i);
-            data.framebuffers.push_back(device.createFramebuffer(frameBufferInfo));
+            framebuffers.push_back(device.createFramebuffer(frameBufferInfo));
         }
-
     }
     catch (...)
     {
         handleVulkanException();
     }
 
-    return data;
+    return framebuffers;
 }
 
 engine::vulkan::RenderSyncData engine::vulkan::getRenderSyncData(const vk::Device& device)
@@ -64,7 +115,6 @@ engine::vulkan::RenderSyncData engine::vulkan::getRenderSyncData(const vk::Devic
     RenderSyncData data;
     try
     {
-        data.renderFence = device.createFence(vk::FenceCreateInfo(vk::FenceCreateFlagBits::eSignaled));
         data.renderSemaphore = device.createSemaphore(vk::SemaphoreCreateInfo());
         data.presentSemaphore = device.createSemaphore(vk::SemaphoreCreateInfo());
 
@@ -75,4 +125,103 @@ engine::vulkan::RenderSyncData engine::vulkan::getRenderSyncData(const vk::Devic
     }
     return data;
 
-}
\ No newline at end of file
+}
+
+vk::PipelineCache engine::vulkan::createPipelineCache(const vk::PhysicalDevice& physicalDevice,
+    const vk::Device& device,
+    const std::string& path)
+{
+    vector<char> data;
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (file.is_open())
+    {
+        data.resize(static_cast<size_t>(file.tellg()));
+        file.seekg(0);
+        file.read(data.data(), data.size());
+        if (!file || !isPipelineCacheCompatible(physicalDevice, data))
+        {
+            std::cout << "Pipeline cache " << path << " is invalid or from another device, ignoring it" << std::endl;
+            data.clear();
+        }
+    }
+
+    vk::PipelineCacheCreateInfo createInfo(vk::PipelineCacheCreateFlags(), data.size(), data.data());
+    try
+    {
+        return device.createPipelineCache(createInfo);
+    }
+    catch (...)
+    {
+        handleVulkanException();
+    }
+
+    return nullptr;
+}
+
+bool engine::vulkan::savePipelineCache(const vk::Device& device,
+    const vk::PipelineCache& pipelineCache,
+    const std::string& path)
+{
+    if (!pipelineCache)
+        return false;
+
+    try
+    {
+        vector<uint8_t> data = device.getPipelineCacheData(pipelineCache);
+
+        const std::string tempPath = path + ".tmp";
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(data.data()), data.size());
+        // Write errors may only show up when the buffered data is flushed on close
+        file.close();
+        if (file.fail())
+        {
+            std::cerr << "Failed to write pipeline cache " << tempPath << std::endl;
+            std::error_code error;
+            std::filesystem::remove(tempPath, error);
+            return false;
+        }
+
+        // Rename replaces the old file in one step
+        std::filesystem::rename(tempPath, path);
+    }
+    catch (...)
+    {
+        handleVulkanException();
+        return false;
+    }
+
+    return true;
+}
+
+vk::ShaderModule engine::vulkan::createShaderModule(const vk::Device& device, const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file.is_open())
+    {
+        std::cerr << "Failed to open shader " << path << std::endl;
+        return nullptr;
+    }
+
+    // SPIR-V is made of 32 bit words
+    size_t size = static_cast<size_t>(file.tellg());
+    vector<uint32_t> code(size / sizeof(uint32_t));
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(code.data()), code.size() * sizeof(uint32_t));
+    if (!file || code.empty() || size % sizeof(uint32_t) != 0)
+    {
+        std::cerr << "Failed to read shader " << path << std::endl;
+        return nullptr;
+    }
+
+    try
+    {
+        return device.createShaderModule(vk::ShaderModuleCreateInfo(vk::ShaderModuleCreateFlags(), code));
+    }
+    catch (...)
+    {
+        handleVulkanException();
+    }
+
+    return nullptr;
+}
@@ -7,8 +7,62 @@ namespace engine
 {
     namespace vulkan
     {
-        RenderData getRenderData(const vk::Device& device, const SwapchainData& swapchainData);
+        RenderData getRenderData(const vk::Device& device,
+            const SwapchainData& swapchainData,
+            vk::ImageLayout finalLayout = vk::ImageLayout::ePresentSrcKHR);
+        /**
+         * @brief Creates one framebuffer per swapchain image view for the given
+         * render pass. Used on its own when only the swapchain is recreated.
+         *
+         * @param device Vulkan logical device object
+         * @param renderPass Render pass the framebuffers are compatible with
+         * @param swapchainData Swapchain whose image views are attached
+         * @return vector of framebuffers in the same order as the image views
+         */
+        vector<vk::Framebuffer> createFramebuffers(const vk::Device& device,
+            const vk::RenderPass& renderPass,
+            const SwapchainData& swapchainData);
         RenderSyncData getRenderSyncData(const vk::Device& device);
+
+        /**
+         * @brief Creates a pipeline cache, seeded with the cache data saved on
+         * disk if it was written by the same GPU and driver. An empty cache is
+         * created if the file is missing or doesn't match.
+         *
+         * @param physicalDevice Vulkan physical device, used to validate the cache header
+         * @param device Vulkan logical device object
+         * @param path Path of the pipeline cache file
+         * @return vk::PipelineCache the pipeline cache object
+         * @return nullptr if it fails to create the cache
+         */
+        vk::PipelineCache createPipelineCache(const vk::PhysicalDevice& physicalDevice,
+            const vk::Device& device,
+            const std::string& path);
+
+        /**
+         * @brief Writes the pipeline cache data to disk. The data is written to
+         * a temporary file which then replaces the old file, so a crash while
+         * saving never leaves a truncated cache behind.
+         *
+         * @param device Vulkan logical device object
+         * @param pipelineCache Pipeline cache to save
+         * @param path Path of the pipeline cache file
+         * @return true if the cache was saved
+         * @return false if saving fails
+         */
+        bool savePipelineCache(const vk::Device& device,
+            const vk::PipelineCache& pipelineCache,
+            const std::string& path);
+
+        /**
+         * @brief Creates a shader module from a SPIR-V file
+         *
+         * @param device Vulkan logical device object
+         * @param path Path of the SPIR-V file (Eg: SHADER_DIR + "cull_instances.comp.spv")
+         * @return vk::ShaderModule the shader module
+         * @return nullptr if the file can't be read or creation fails
+         */
+        vk::ShaderModule createShaderModule(const vk::Device& device, const std::string& path);
     }
 }
 #endif
\ No newline at end of file
@@ -0,0 +1,349 @@
+#include "vulkan_memory.h"
+
+// LinearMemoryPool
+
+engine::vulkan::MemoryAllocation engine::vulkan::LinearMemoryPool::allocate(const vk::MemoryRequirements& requirements)
+{
+    MemoryAllocation allocation;
+    if (!m_memory || !(requirements.memoryTypeBits & (1 << m_memoryType)))
+        return allocation;
+
+    uint64_t offset = 0;
+    if (!m_block.allocate(requirements.size, std::max(requirements.alignment, m_minAlignment), offset))
+        return allocation;
+
+    allocation.memory = m_memory;
+    allocation.offset = offset;
+    allocation.size = requirements.size;
+    allocation.memoryType = m_memoryType;
+    if (m_mapped)
+        allocation.mapped = static_cast<char*>(m_mapped) + offset;
+
+    return allocation;
+}
+
+// MemoryAllocator
+
+uint32_t engine::vulkan::MemoryAllocator::getPoolIndex(uint32_t memoryType, MemoryResourceType resourceType) const
+{
+    // Linear and optimal resources only need separate pools when the device
+    // asks for them to be kept apart
+    if (m_bufferImageGranularity <= 1)
+        resourceType = MemoryResourceType::Linear;
+    return memoryType * 2 + static_cast<uint32_t>(resourceType);
+}
+
+vk::DeviceSize engine::vulkan::MemoryAllocator::getMinAlignment(uint32_t memoryType) const
+{
+    // Flushing non coherent memory works on nonCoherentAtomSize ranges, keep
+    // allocations on that boundary so a flush never touches a neighbour
+    vk::MemoryPropertyFlags flags = m_memoryProperties.memoryTypes[memoryType].propertyFlags;
+    if ((flags & vk::MemoryPropertyFlagBits::eHostVisible)
+        && !(flags & vk::MemoryPropertyFlagBits::eHostCoherent))
+        return m_nonCoherentAtomSize;
+    return 1;
+}
+
+vk::DeviceSize engine::vulkan::MemoryAllocator::getBlockSize(uint32_t memoryType) const
+{
+    // Small heaps (Eg: 256MB device local host visible BAR memory) get
+    // smaller blocks so one block doesn't take the whole heap
+    uint32_t heapIndex = m_memoryProperties.memoryTypes[memoryType].heapIndex;
+    vk::DeviceSize heapSize = m_memoryProperties.memoryHeaps[heapIndex].size;
+    if (heapSize <= 1024ull * 1024 * 1024)
+        return std::min(m_blockSize, heapSize / 8);
+    return m_blockSize;
+}
+
+std::unique_ptr<engine::vulkan::MemoryAllocator::MemoryBlock> engine::vulkan::MemoryAllocator::createBlock(uint32_t memoryType,
+    vk::DeviceSize size,
+    bool isDedicated)
+{
+    if (m_maxAllocationCount > 0 && m_deviceAllocationCount >= m_maxAllocationCount)
+    {
+        std::cerr << "Memory allocator error: Reached maxMemoryAllocationCount" << std::endl;
+        return nullptr;
+    }
+
+    std::unique_ptr<MemoryBlock> block = std::make_unique<MemoryBlock>();
+    try
+    {
+        block->memory = m_device.allocateMemory(vk::MemoryAllocateInfo(size, memoryType));
+        if (m_memoryProperties.memoryTypes[memoryType].propertyFlags & vk::MemoryPropertyFlagBits::eHostVisible)
+            block->mapped = m_device.mapMemory(block->memory, 0, VK_WHOLE_SIZE);
+    }
+    catch (...)
+    {
+        handleVulkanException();
+        if (block->memory)
+            m_device.freeMemory(block->memory);
+        return nullptr;
+    }
+
+    block->isDedicated = isDedicated;
+    block->allocator.reset(size);
+    m_deviceAllocationCount++;
+
+    return block;
+}
+
+void engine::vulkan::MemoryAllocator::destroyBlock(MemoryBlock& block)
+{
+    if (!block.memory)
+        return;
+
+    // Freeing memory implicitly unmaps it
+    m_device.freeMemory(block.memory);
+    block.memory = nullptr;
+    block.mapped = nullptr;
+    m_deviceAllocationCount--;
+}
+
+engine::vulkan::MemoryAllocation engine::vulkan::MemoryAllocator::allocateFromPool(uint32_t poolIndex,
+    vk::DeviceSize size,
+    vk::DeviceSize alignment)
+{
+    MemoryAllocation allocation;
+    MemoryPool& pool = m_pools[poolIndex];
+    vk::DeviceSize blockSize = getBlockSize(pool.memoryType);
+
+    // Large resources get their own device memory instead of wasting most of a block
+    bool isDedicated = size > blockSize / 2;
+
+    uint32_t blockIndex = std::numeric_limits<uint32_t>::max();
+    uint64_t offset = 0;
+    uint32_t handle = INVALID_BLOCK_HANDLE;
+
+    if (!isDedicated)
+    {
+        for (uint32_t i = 0; i < pool.blocks.size(); i++)
+        {
+            MemoryBlock* block = pool.blocks[i].get();
+            if (block && !block->isDedicated && block->allocator.allocate(size, alignment, offset, handle))
+            {
+                blockIndex = i;
+                break;
+            }
+        }
+    }
+
+    if (blockIndex == std::numeric_limits<uint32_t>::max())
+    {
+        std::unique_ptr<MemoryBlock> block = createBlock(pool.memoryType,
+            isDedicated ? size : blockSize,
+            isDedicated);
+        // A dedicated block holds exactly this resource at offset 0, which any
+        // alignment the device asks for already satisfies. Its allocator only
+        // tracks the range for free() and the statistics.
+        if (!block || !block->allocator.allocate(size, isDedicated ? 1 : alignment, offset, handle))
+        {
+            if (block)
+                destroyBlock(*block);
+            return allocation;
+        }
+
+        // Reuse an empty slot so that indices of the other blocks don't change
+        auto slot = std::find(pool.blocks.begin(), pool.blocks.end(), nullptr);
+        blockIndex = static_cast<uint32_t>(slot - pool.blocks.begin());
+        if (slot == pool.blocks.end())
+            pool.blocks.push_back(std::move(block));
+        else
+            *slot = std::move(block);
+    }
+
+    MemoryBlock& block = *pool.blocks[blockIndex];
+    allocation.memory = block.memory;
+    allocation.offset = offset;
+    allocation.size = size;
+    allocation.memoryType = pool.memoryType;
+    allocation.poolIndex = poolIndex;
+    allocation.blockIndex = blockIndex;
+    allocation.handle = handle;
+    if (block.mapped)
+        allocation.mapped = static_cast<char*>(block.mapped) + offset;
+
+    return allocation;
+}
+
+bool engine::vulkan::MemoryAllocator::init(const vk::PhysicalDevice& physicalDevice,
+    const vk::Device& device,
+    vk::DeviceSize blockSize)
+{
+    m_device = device;
+    m_memoryProperties = physicalDevice.getMemoryProperties();
+    m_blockSize = blockSize;
+
+    vk::PhysicalDeviceLimits limits = physicalDevice.getProperties().limits;
+    m_bufferImageGranularity = limits.bufferImageGranularity;
+    m_nonCoherentAtomSize = limits.nonCoherentAtomSize;
+    m_maxAllocationCount = limits.maxMemoryAllocationCount;
+    m_deviceAllocationCount = 0;
+
+    m_pools.clear();
+    m_pools.resize(m_memoryProperties.memoryTypeCount * 2);
+    for (uint32_t i = 0; i < m_pools.size(); i++)
+        m_pools[i].memoryType = i / 2;
+
+    return m_device ? true : false;
+}
+
+engine::vulkan::MemoryAllocation engine::vulkan::MemoryAllocator::allocate(const vk::MemoryRequirements& requirements,
+    vk::MemoryPropertyFlags properties,
+    MemoryResourceType resourceType)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    // Try every memory type which fits, a later one might still have room if
+    // the heap of the first one is full
+    for (uint32_t i = 0; i < m_memoryProperties.memoryTypeCount; i++)
+    {
+        if (!(requirements.memoryTypeBits & (1 << i))
+            || (m_memoryProperties.memoryTypes[i].propertyFlags & properties) != properties)
+            continue;
+
+        MemoryAllocation allocation = allocateFromPool(getPoolIndex(i, resourceType),
+            requirements.size,
+            std::max(requirements.alignment, getMinAlignment(i)));
+        if (allocation.isValid())
+            return allocation;
+    }
+
+    std::cerr << "Memory allocator error: Failed to allocate " << requirements.size << " bytes" << std::endl;
+    return MemoryAllocation();
+}
+
+engine::vulkan::MemoryAllocation engine::vulkan::MemoryAllocator::allocateForBuffer(const vk::Buffer& buffer,
+    vk::MemoryPropertyFlags properties)
+{
+    MemoryAllocation allocation = allocate(m_device.getBufferMemoryRequirements(buffer),
+        properties,
+        MemoryResourceType::Linear);
+    if (allocation.isValid())
+        m_device.bindBufferMemory(buffer, allocation.memory, allocation.offset);
+    return allocation;
+}
+
+engine::vulkan::MemoryAllocation engine::vulkan::MemoryAllocator::allocateForImage(const vk::Image& image,
+    vk::MemoryPropertyFlags properties,
+    vk::ImageTiling tiling)
+{
+    MemoryAllocation allocation = allocate(m_device.getImageMemoryRequirements(image),
+        properties,
+        tiling == vk::ImageTiling::eOptimal ? MemoryResourceType::Optimal : MemoryResourceType::Linear);
+    if (allocation.isValid())
+        m_device.bindImageMemory(image, allocation.memory, allocation.offset);
+    return allocation;
+}
+
+void engine::vulkan::MemoryAllocator::free(MemoryAllocation& allocation)
+{
+    if (!allocation.isValid() || allocation.poolIndex >= m_pools.size())
+        return;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    MemoryPool& pool = m_pools[allocation.poolIndex];
+    if (allocation.blockIndex < pool.blocks.size() && pool.blocks[allocation.blockIndex])
+    {
+        MemoryBlock& block = *pool.blocks[allocation.blockIndex];
+        block.allocator.free(allocation.handle);
+
+        // Dedicated blocks are released right away. Shared blocks are kept if
+        // it's the last one to avoid allocating it again on the next request.
+        if (block.allocator.isEmpty())
+        {
+            size_t sharedBlockCount = std::count_if(pool.blocks.begin(),
+                pool.blocks.end(),
+                [](const std::unique_ptr<MemoryBlock>& b)
+                {
+                    return b && !b->isDedicated;
+                });
+            if (block.isDedicated || sharedBlockCount > 1)
+            {
+                destroyBlock(block);
+                pool.blocks[allocation.blockIndex].reset();
+            }
+        }
+    }
+
+    allocation = MemoryAllocation();
+}
+
+engine::vulkan::LinearMemoryPool engine::vulkan::MemoryAllocator::createLinearPool(uint32_t memoryTypeBits,
+    vk::MemoryPropertyFlags properties,
+    vk::DeviceSize size)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    LinearMemoryPool pool;
+    for (uint32_t i = 0; i < m_memoryProperties.memoryTypeCount; i++)
+    {
+        if (!(memoryTypeBits & (1 << i))
+            || (m_memoryProperties.memoryTypes[i].propertyFlags & properties) != properties)
+            continue;
+
+        std::unique_ptr<MemoryBlock> block = createBlock(i, size, true);
+        if (!block)
+            continue;
+
+        pool.m_memory = block->memory;
+        pool.m_mapped = block->mapped;
+        pool.m_memoryType = i;
+        pool.m_minAlignment = getMinAlignment(i);
+        pool.m_block.reset(size);
+        break;
+    }
+
+    return pool;
+}
+
+void engine::vulkan::MemoryAllocator::destroyLinearPool(LinearMemoryPool& pool)
+{
+    if (!pool.m_memory)
+        return;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_device.freeMemory(pool.m_memory);
+    m_deviceAllocationCount--;
+    pool = LinearMemoryPool();
+}
+
+engine::vulkan::MemoryStatistics engine::vulkan::MemoryAllocator::getStatistics()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    MemoryStatistics stats;
+    stats.deviceAllocationCount = m_deviceAllocationCount;
+    for (const MemoryPool& pool : m_pools)
+    {
+        for (const std::unique_ptr<MemoryBlock>& block : pool.blocks)
+        {
+            if (!block)
+                continue;
+            MemoryBlockStatistics blockStats = block->allocator.getStatistics();
+            stats.memoryTypes[pool.memoryType] += blockStats;
+            stats.total += blockStats;
+        }
+    }
+
+    return stats;
+}
+
+bool engine::vulkan::MemoryAllocator::destroy()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    for (MemoryPool& pool : m_pools)
+    {
+        for (std::unique_ptr<MemoryBlock>& block : pool.blocks)
+        {
+            if (block)
+                destroyBlock(*block);
+        }
+        pool.blocks.clear();
+    }
+    m_pools.clear();
+
+    return true;
+}
@@ -0,0 +1,236 @@
+#ifndef VULKAN_MEMORY_H
+#define VULKAN_MEMORY_H
+
+#include <memory>
+#include <mutex>
+
+#include "vulkan_utils.h"
+#include "vulkan_memory_block.h"
+
+namespace engine
+{
+    namespace vulkan
+    {
+        // Size of the device memory blocks requested from the driver. Allocations
+        // are sub-allocated from these blocks.
+        static const vk::DeviceSize DEFAULT_MEMORY_BLOCK_SIZE = 64 * 1024 * 1024;
+
+        /**
+         * @brief Kind of resource the memory is bound to. Linear resources
+         * (buffers, linear images) and optimal tiling images have to be kept
+         * bufferImageGranularity apart when placed in the same device memory.
+         */
+        enum class MemoryResourceType
+        {
+            Linear = 0,
+            Optimal = 1
+        };
+
+        /**
+         * @brief A range of device memory handed out by MemoryAllocator or
+         * LinearMemoryPool
+         *
+         * @param memory The device memory object the range belongs to
+         * @param offset Offset of the range in the device memory object
+         * @param size Size of the range in bytes
+         * @param mapped Host pointer to the start of the range if the memory is
+         * host visible, nullptr otherwise
+         */
+        struct MemoryAllocation
+        {
+            vk::DeviceMemory memory;
+            vk::DeviceSize offset = 0;
+            vk::DeviceSize size = 0;
+            void* mapped = nullptr;
+            uint32_t memoryType = std::numeric_limits<uint32_t>::max();
+
+            // Location of the range inside the allocator, used when freeing
+            uint32_t poolIndex = std::numeric_limits<uint32_t>::max();
+            uint32_t blockIndex = std::numeric_limits<uint32_t>::max();
+            uint32_t handle = INVALID_BLOCK_HANDLE;
+
+            inline bool isValid() const
+            {
+                return memory ? true : false;
+            }
+        };
+
+        /**
+         * @brief Usage statistics of the allocator
+         *
+         * @param total Statistics of all the blocks combined
+         * @param memoryTypes Statistics per memory type index
+         * @param deviceAllocationCount Number of vk::DeviceMemory objects allocated.
+         * Has to stay below maxMemoryAllocationCount
+         */
+        struct MemoryStatistics
+        {
+            MemoryBlockStatistics total;
+            std::array<MemoryBlockStatistics, VK_MAX_MEMORY_TYPES> memoryTypes;
+            uint32_t deviceAllocationCount = 0;
+        };
+
+        /**
+         * @brief Ring buffer of device memory for transient data which is
+         * released in bulk (Eg: per frame uniforms, staging data). Created
+         * through MemoryAllocator::createLinearPool()
+         */
+        class LinearMemoryPool
+        {
+        private:
+            vk::DeviceMemory m_memory;
+            void* m_mapped = nullptr;
+            uint32_t m_memoryType = std::numeric_limits<uint32_t>::max();
+            vk::DeviceSize m_minAlignment = 1;
+            LinearBlock m_block;
+
+            friend class MemoryAllocator;
+
+        public:
+            MemoryAllocation allocate(const vk::MemoryRequirements& requirements);
+
+            // Marker of everything allocated so far. Release it once the GPU has
+            // finished using those allocations (Eg: once the frame has finished).
+            inline uint64_t getMarker() const
+            {
+                return m_block.getMarker();
+            }
+
+            inline void release(uint64_t marker)
+            {
+                m_block.release(marker);
+            }
+
+            inline bool isValid() const
+            {
+                return m_memory ? true : false;
+            }
+
+            // The pool spans the whole memory object starting at offset 0
+            inline const vk::DeviceMemory& getMemory() const
+            {
+                return m_memory;
+            }
+
+            inline vk::DeviceSize getSize() const
+            {
+                return m_block.getSize();
+            }
+
+            inline MemoryBlockStatistics getStatistics() const
+            {
+                return m_block.getStatistics();
+            }
+        };
+
+        /**
+         * @brief Allocates large blocks of device memory per memory type and
+         * sub-allocates buffers and images from them, so that the number of
+         * vkAllocateMemory calls stays small. Thread safe.
+         */
+        class MemoryAllocator
+        {
+        private:
+            struct MemoryBlock
+            {
+                vk::DeviceMemory memory;
+                void* mapped = nullptr;
+                bool isDedicated = false;
+                TlsfBlock allocator;
+            };
+
+            struct MemoryPool
+            {
+                uint32_t memoryType;
+                // Slots are set to nullptr when a block is freed so that indices
+                // stored in MemoryAllocation stay valid
+                vector<std::unique_ptr<MemoryBlock>> blocks;
+            };
+
+            vk::Device m_device;
+            vk::PhysicalDeviceMemoryProperties m_memoryProperties;
+            vk::DeviceSize m_blockSize = DEFAULT_MEMORY_BLOCK_SIZE;
+            vk::DeviceSize m_bufferImageGranularity = 1;
+            vk::DeviceSize m_nonCoherentAtomSize = 1;
+            uint32_t m_maxAllocationCount = 0;
+            uint32_t m_deviceAllocationCount = 0;
+
+            // Two pools per memory type, one per MemoryResourceType. Only the
+            // linear pool is used when bufferImageGranularity doesn't matter.
+            vector<MemoryPool> m_pools;
+            std::mutex m_mutex;
+
+            uint32_t getPoolIndex(uint32_t memoryType, MemoryResourceType resourceType) const;
+            vk::DeviceSize getMinAlignment(uint32_t memoryType) const;
+            vk::DeviceSize getBlockSize(uint32_t memoryType) const;
+            std::unique_ptr<MemoryBlock> createBlock(uint32_t memoryType, vk::DeviceSize size, bool isDedicated);
+            void destroyBlock(MemoryBlock& block);
+            MemoryAllocation allocateFromPool(uint32_t poolIndex,
+                vk::DeviceSize size,
+                vk::DeviceSize alignment);
+
+        public:
+            MemoryAllocator() = default;
+            MemoryAllocator(const MemoryAllocator&) = delete;
+            MemoryAllocator& operator=(const MemoryAllocator&) = delete;
+
+            /**
+             * @brief Initializes the allocator for the given device
+             *
+             * @param physicalDevice Vulkan physical device the memory types are queried from
+             * @param device Vulkan logical device to allocate memory from
+             * @param blockSize Preferred size of the device memory blocks
+             * @return true if initialization is successful
+             * @return false if initialization fails
+             */
+            bool init(const vk::PhysicalDevice& physicalDevice,
+                const vk::Device& device,
+                vk::DeviceSize blockSize = DEFAULT_MEMORY_BLOCK_SIZE);
+
+            /**
+             * @brief Allocates memory for the given requirements
+             *
+             * @param requirements Memory requirements of the resource
+             * @param properties Required memory properties (Eg: eDeviceLocal)
+             * @param resourceType Whether the resource is linear or an optimal tiling image
+             * @return MemoryAllocation the allocated range. Invalid if allocation failed
+             */
+            MemoryAllocation allocate(const vk::MemoryRequirements& requirements,
+                vk::MemoryPropertyFlags properties,
+                MemoryResourceType resourceType);
+
+            // Allocate memory for the resource and bind it
+            MemoryAllocation allocateForBuffer(const vk::Buffer& buffer, vk::MemoryPropertyFlags properties);
+            MemoryAllocation allocateForImage(const vk::Image& image,
+                vk::MemoryPropertyFlags properties,
+                vk::ImageTiling tiling = vk::ImageTiling::eOptimal);
+
+            void free(MemoryAllocation& allocation);
+
+            /**
+             * @brief Creates a ring buffer of device memory for transient data
+             *
+             * @param memoryTypeBits Memory types the pool may use (Eg: from the
+             * memory requirements of the buffers which will be placed in it)
+             * @param properties Required memory properties
+             * @param size Size of the pool in bytes
+             * @return LinearMemoryPool invalid if creation failed
+             */
+            LinearMemoryPool createLinearPool(uint32_t memoryTypeBits,
+                vk::MemoryPropertyFlags properties,
+                vk::DeviceSize size);
+            void destroyLinearPool(LinearMemoryPool& pool);
+
+            MemoryStatistics getStatistics();
+
+            inline vk::DeviceSize getBufferImageGranularity() const
+            {
+                return m_bufferImageGranularity;
+            }
+
+            bool destroy();
+        };
+    }
+}
+
+#endif
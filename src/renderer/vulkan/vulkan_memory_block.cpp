@@ -0,0 +1,412 @@
+#include "vulkan_memory_block.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+/**
+ * @brief Index of the most significant set bit. Value must not be 0
+ */
+inline uint32_t findLastSet(uint64_t value)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanReverse64(&index, value);
+    return static_cast<uint32_t>(index);
+#else
+    return 63 - static_cast<uint32_t>(__builtin_clzll(value));
+#endif
+}
+
+/**
+ * @brief Index of the least significant set bit. Value must not be 0
+ */
+inline uint32_t findFirstSet(uint64_t value)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward64(&index, value);
+    return static_cast<uint32_t>(index);
+#else
+    return static_cast<uint32_t>(__builtin_ctzll(value));
+#endif
+}
+
+// TlsfBlock
+
+void engine::vulkan::TlsfBlock::mapping(uint64_t size, uint32_t& fl, uint32_t& sl)
+{
+    if (size < SMALL_BLOCK_SIZE)
+    {
+        // Small sizes are spread linearly in the first list
+        fl = 0;
+        sl = static_cast<uint32_t>(size);
+    }
+    else
+    {
+        uint32_t lastSet = findLastSet(size);
+        sl = static_cast<uint32_t>(size >> (lastSet - SL_INDEX_COUNT_LOG2)) ^ SL_INDEX_COUNT;
+        fl = lastSet - SL_INDEX_COUNT_LOG2 + 1;
+    }
+}
+
+void engine::vulkan::TlsfBlock::mappingSearch(uint64_t size, uint32_t& fl, uint32_t& sl)
+{
+    // Round up to the next size class, so that any range in the found list is
+    // big enough and the list head can be taken without searching.
+    if (size >= SMALL_BLOCK_SIZE)
+        size += (1ull << (findLastSet(size) - SL_INDEX_COUNT_LOG2)) - 1;
+    mapping(size, fl, sl);
+}
+
+uint32_t engine::vulkan::TlsfBlock::createNode()
+{
+    if (!m_unusedNodes.empty())
+    {
+        uint32_t node = m_unusedNodes.back();
+        m_unusedNodes.pop_back();
+        m_nodes[node] = Node();
+        return node;
+    }
+
+    m_nodes.push_back(Node());
+    return static_cast<uint32_t>(m_nodes.size() - 1);
+}
+
+void engine::vulkan::TlsfBlock::releaseNode(uint32_t node)
+{
+    m_unusedNodes.push_back(node);
+}
+
+uint32_t engine::vulkan::TlsfBlock::findSuitableNode(uint32_t fl, uint32_t sl) const
+{
+    if (fl >= FL_INDEX_COUNT)
+        return INVALID_BLOCK_HANDLE;
+
+    // Search the current first level list for a second level list at least as big
+    uint32_t slMap = m_slBitmap[fl] & (~0u << sl);
+    if (!slMap)
+    {
+        // Otherwise use the smallest non empty first level list above it
+        uint64_t flMap = fl + 1 < FL_INDEX_COUNT ? m_flBitmap & (~0ull << (fl + 1)) : 0;
+        if (!flMap)
+            return INVALID_BLOCK_HANDLE;
+
+        fl = findFirstSet(flMap);
+        slMap = m_slBitmap[fl];
+    }
+    sl = findFirstSet(slMap);
+
+    return m_freeHeads[fl][sl];
+}
+
+uint32_t engine::vulkan::TlsfBlock::findFittingNode(uint64_t size, uint64_t alignment) const
+{
+    // Walk every free range from the class of the exact size up. This finds
+    // ranges which fit but are skipped by the rounded up search, like a
+    // request as big as the whole block or an already aligned range.
+    uint32_t fl, sl;
+    mapping(size, fl, sl);
+    for (; fl < FL_INDEX_COUNT; fl++, sl = 0)
+    {
+        uint32_t slMap = m_slBitmap[fl] & (~0u << sl);
+        while (slMap)
+        {
+            uint32_t list = findFirstSet(slMap);
+            slMap &= slMap - 1;
+            for (uint32_t node = m_freeHeads[fl][list]; node != INVALID_BLOCK_HANDLE; node = m_nodes[node].nextFree)
+            {
+                const Node& n = m_nodes[node];
+                if (alignUp(n.offset, alignment) - n.offset + size <= n.size)
+                    return node;
+            }
+        }
+    }
+
+    return INVALID_BLOCK_HANDLE;
+}
+
+void engine::vulkan::TlsfBlock::insertFreeNode(uint32_t node)
+{
+    uint32_t fl, sl;
+    mapping(m_nodes[node].size, fl, sl);
+
+    Node& n = m_nodes[node];
+    n.isFree = true;
+    n.prevFree = INVALID_BLOCK_HANDLE;
+    n.nextFree = m_freeHeads[fl][sl];
+    if (n.nextFree != INVALID_BLOCK_HANDLE)
+        m_nodes[n.nextFree].prevFree = node;
+    m_freeHeads[fl][sl] = node;
+
+    m_flBitmap |= 1ull << fl;
+    m_slBitmap[fl] |= 1u << sl;
+}
+
+void engine::vulkan::TlsfBlock::removeFreeNode(uint32_t node)
+{
+    uint32_t fl, sl;
+    mapping(m_nodes[node].size, fl, sl);
+
+    Node& n = m_nodes[node];
+    if (n.prevFree != INVALID_BLOCK_HANDLE)
+        m_nodes[n.prevFree].nextFree = n.nextFree;
+    if (n.nextFree != INVALID_BLOCK_HANDLE)
+        m_nodes[n.nextFree].prevFree = n.prevFree;
+
+    if (m_freeHeads[fl][sl] == node)
+    {
+        m_freeHeads[fl][sl] = n.nextFree;
+        if (n.nextFree == INVALID_BLOCK_HANDLE)
+        {
+            m_slBitmap[fl] &= ~(1u << sl);
+            if (!m_slBitmap[fl])
+                m_flBitmap &= ~(1ull << fl);
+        }
+    }
+
+    n.isFree = false;
+    n.prevFree = INVALID_BLOCK_HANDLE;
+    n.nextFree = INVALID_BLOCK_HANDLE;
+}
+
+engine::vulkan::TlsfBlock::TlsfBlock(uint64_t size)
+{
+    reset(size);
+}
+
+void engine::vulkan::TlsfBlock::reset(uint64_t size)
+{
+    m_size = size;
+    m_usedSize = 0;
+    m_allocationCount = 0;
+    m_nodes.clear();
+    m_unusedNodes.clear();
+
+    m_flBitmap = 0;
+    for (uint32_t fl = 0; fl < FL_INDEX_COUNT; fl++)
+    {
+        m_slBitmap[fl] = 0;
+        for (uint32_t sl = 0; sl < SL_INDEX_COUNT; sl++)
+            m_freeHeads[fl][sl] = INVALID_BLOCK_HANDLE;
+    }
+
+    m_firstNode = INVALID_BLOCK_HANDLE;
+    if (size > 0)
+    {
+        m_firstNode = createNode();
+        m_nodes[m_firstNode].size = size;
+        insertFreeNode(m_firstNode);
+    }
+}
+
+bool engine::vulkan::TlsfBlock::allocate(uint64_t size, uint64_t alignment, uint64_t& offset, uint32_t& handle)
+{
+    if (size == 0 || size > m_size)
+        return false;
+
+    // Ask for enough room to align the offset inside any range that is found
+    uint64_t searchSize = size + (alignment > 1 ? alignment - 1 : 0);
+    uint32_t fl, sl;
+    mappingSearch(searchSize, fl, sl);
+
+    uint32_t node = findSuitableNode(fl, sl);
+    // Nothing in the rounded up classes, the range may still be in a smaller
+    // class (Eg: the largest free class of the block), look at each range there
+    if (node == INVALID_BLOCK_HANDLE)
+        node = findFittingNode(size, alignment);
+    if (node == INVALID_BLOCK_HANDLE)
+        return false;
+
+    removeFreeNode(node);
+
+    // Split the alignment padding in front into its own free range. The previous
+    // range can't be free since free neighbours are always merged.
+    uint64_t alignedOffset = alignUp(m_nodes[node].offset, alignment);
+    uint64_t padding = alignedOffset - m_nodes[node].offset;
+    if (padding > 0)
+    {
+        uint32_t front = createNode();
+        Node& n = m_nodes[node];
+        Node& f = m_nodes[front];
+        f.offset = n.offset;
+        f.size = padding;
+        f.prevPhysical = n.prevPhysical;
+        f.nextPhysical = node;
+        if (n.prevPhysical != INVALID_BLOCK_HANDLE)
+            m_nodes[n.prevPhysical].nextPhysical = front;
+        else
+            m_firstNode = front;
+        n.prevPhysical = front;
+        n.offset = alignedOffset;
+        n.size -= padding;
+        insertFreeNode(front);
+    }
+
+    // Return the unused end of the range back to the free lists
+    if (m_nodes[node].size > size)
+    {
+        uint32_t back = createNode();
+        Node& n = m_nodes[node];
+        Node& b = m_nodes[back];
+        b.offset = n.offset + size;
+        b.size = n.size - size;
+        b.prevPhysical = node;
+        b.nextPhysical = n.nextPhysical;
+        if (n.nextPhysical != INVALID_BLOCK_HANDLE)
+            m_nodes[n.nextPhysical].prevPhysical = back;
+        n.nextPhysical = back;
+        n.size = size;
+        insertFreeNode(back);
+    }
+
+    m_usedSize += size;
+    m_allocationCount++;
+
+    offset = m_nodes[node].offset;
+    handle = node;
+    return true;
+}
+
+void engine::vulkan::TlsfBlock::free(uint32_t handle)
+{
+    if (handle >= m_nodes.size() || m_nodes[handle].isFree)
+        return;
+
+    m_usedSize -= m_nodes[handle].size;
+    m_allocationCount--;
+
+    // Merge with the previous range if it's free
+    uint32_t prev = m_nodes[handle].prevPhysical;
+    if (prev != INVALID_BLOCK_HANDLE && m_nodes[prev].isFree)
+    {
+        removeFreeNode(prev);
+        Node& n = m_nodes[handle];
+        Node& p = m_nodes[prev];
+        n.offset = p.offset;
+        n.size += p.size;
+        n.prevPhysical = p.prevPhysical;
+        if (p.prevPhysical != INVALID_BLOCK_HANDLE)
+            m_nodes[p.prevPhysical].nextPhysical = handle;
+        else
+            m_firstNode = handle;
+        releaseNode(prev);
+    }
+
+    // Merge with the next range if it's free
+    uint32_t next = m_nodes[handle].nextPhysical;
+    if (next != INVALID_BLOCK_HANDLE && m_nodes[next].isFree)
+    {
+        removeFreeNode(next);
+        Node& n = m_nodes[handle];
+        Node& x = m_nodes[next];
+        n.size += x.size;
+        n.nextPhysical = x.nextPhysical;
+        if (x.nextPhysical != INVALID_BLOCK_HANDLE)
+            m_nodes[x.nextPhysical].prevPhysical = handle;
+        releaseNode(next);
+    }
+
+    insertFreeNode(handle);
+}
+
+engine::vulkan::MemoryBlockStatistics engine::vulkan::TlsfBlock::getStatistics() const
+{
+    MemoryBlockStatistics stats;
+    stats.size = m_size;
+    stats.usedSize = m_usedSize;
+    stats.allocationCount = m_allocationCount;
+
+    for (uint32_t node = m_firstNode; node != INVALID_BLOCK_HANDLE; node = m_nodes[node].nextPhysical)
+    {
+        if (!m_nodes[node].isFree)
+            continue;
+        stats.freeRegionCount++;
+        stats.largestFreeRegion = std::max(stats.largestFreeRegion, m_nodes[node].size);
+    }
+
+    return stats;
+}
+
+// LinearBlock
+
+void engine::vulkan::LinearBlock::reset(uint64_t size)
+{
+    m_size = size;
+    m_allocatedTotal = 0;
+    m_releasedTotal = 0;
+    m_allocationEnds.clear();
+}
+
+bool engine::vulkan::LinearBlock::allocate(uint64_t size, uint64_t alignment, uint64_t& offset)
+{
+    if (size == 0 || size > m_size)
+        return false;
+
+    // Nothing is in use, restart from the beginning of the ring
+    if (m_allocatedTotal == m_releasedTotal)
+    {
+        m_allocatedTotal = alignUp(m_allocatedTotal, m_size);
+        m_releasedTotal = m_allocatedTotal;
+    }
+
+    uint64_t head = m_allocatedTotal % m_size;
+    uint64_t alignedOffset = alignUp(head, alignment);
+    uint64_t required = alignedOffset - head + size;
+
+    // Not enough room before the end of the ring, skip the tail and start from 0
+    if (alignedOffset + size > m_size)
+    {
+        alignedOffset = 0;
+        required = m_size - head + size;
+    }
+
+    if (m_allocatedTotal - m_releasedTotal + required > m_size)
+        return false;
+
+    m_allocatedTotal += required;
+    m_allocationEnds.push_back(m_allocatedTotal);
+
+    offset = alignedOffset;
+    return true;
+}
+
+void engine::vulkan::LinearBlock::release(uint64_t marker)
+{
+    marker = std::min(marker, m_allocatedTotal);
+    if (marker <= m_releasedTotal)
+        return;
+
+    m_releasedTotal = marker;
+    while (!m_allocationEnds.empty() && m_allocationEnds.front() <= marker)
+        m_allocationEnds.pop_front();
+}
+
+engine::vulkan::MemoryBlockStatistics engine::vulkan::LinearBlock::getStatistics() const
+{
+    MemoryBlockStatistics stats;
+    stats.size = m_size;
+    stats.usedSize = m_allocatedTotal - m_releasedTotal;
+    stats.allocationCount = m_allocationEnds.size();
+
+    // Free memory is the range from the head to the tail of the ring, which
+    // is split in two when it crosses the end
+    uint64_t freeSize = m_size - stats.usedSize;
+    if (freeSize > 0)
+    {
+        uint64_t head = m_allocatedTotal % m_size;
+        uint64_t untilEnd = m_size - head;
+        if (stats.usedSize == 0 || freeSize <= untilEnd)
+        {
+            stats.freeRegionCount = 1;
+            stats.largestFreeRegion = freeSize;
+        }
+        else
+        {
+            stats.freeRegionCount = 2;
+            stats.largestFreeRegion = std::max(untilEnd, freeSize - untilEnd);
+        }
+    }
+
+    return stats;
+}
@@ -0,0 +1,184 @@
+#ifndef VULKAN_MEMORY_BLOCK_H
+#define VULKAN_MEMORY_BLOCK_H
+
+#include <cstdint>
+#include <vector>
+#include <deque>
+#include <limits>
+#include <algorithm>
+
+// Sub-allocation algorithms used by the Vulkan memory allocator. They only
+// deal with offsets and sizes inside a block, so they don't depend on Vulkan.
+namespace engine
+{
+    namespace vulkan
+    {
+        static const uint32_t INVALID_BLOCK_HANDLE = std::numeric_limits<uint32_t>::max();
+
+        inline uint64_t alignUp(uint64_t value, uint64_t alignment)
+        {
+            return alignment > 1 ? (value + alignment - 1) / alignment * alignment : value;
+        }
+
+        /**
+         * @brief Usage statistics of one or more memory blocks
+         *
+         * @param size Total size of the blocks in bytes
+         * @param usedSize Bytes handed out to allocations (Excluding alignment padding)
+         * @param allocationCount Number of live allocations
+         * @param freeRegionCount Number of separate free ranges
+         * @param largestFreeRegion Size of the largest free range in bytes
+         */
+        struct MemoryBlockStatistics
+        {
+            uint64_t size = 0;
+            uint64_t usedSize = 0;
+            uint64_t allocationCount = 0;
+            uint64_t freeRegionCount = 0;
+            uint64_t largestFreeRegion = 0;
+
+            // 0 when all the free memory is one contiguous range, approaching
+            // 1 when the free memory is split in many small ranges
+            inline float getFragmentation() const
+            {
+                uint64_t freeSize = size - usedSize;
+                if (freeSize == 0 || largestFreeRegion >= freeSize)
+                    return 0.0f;
+                return 1.0f - static_cast<float>(largestFreeRegion) / static_cast<float>(freeSize);
+            }
+
+            MemoryBlockStatistics& operator+=(const MemoryBlockStatistics& other)
+            {
+                size += other.size;
+                usedSize += other.usedSize;
+                allocationCount += other.allocationCount;
+                freeRegionCount += other.freeRegionCount;
+                largestFreeRegion = std::max(largestFreeRegion, other.largestFreeRegion);
+                return *this;
+            }
+        };
+
+        /**
+         * @brief Two-Level Segregated Fit allocator over a range of memory.
+         * Free ranges are kept in size classes (power of two, each split in
+         * linear sub classes) so allocation and free are O(1). Neighbouring free
+         * ranges are merged on free.
+         */
+        class TlsfBlock
+        {
+        private:
+            static const uint32_t SL_INDEX_COUNT_LOG2 = 5;
+            static const uint32_t SL_INDEX_COUNT = 1 << SL_INDEX_COUNT_LOG2;
+            static const uint32_t FL_INDEX_COUNT = 64;
+            static const uint64_t SMALL_BLOCK_SIZE = 1 << SL_INDEX_COUNT_LOG2;
+
+            struct Node
+            {
+                uint64_t offset = 0;
+                uint64_t size = 0;
+                uint32_t prevPhysical = INVALID_BLOCK_HANDLE;
+                uint32_t nextPhysical = INVALID_BLOCK_HANDLE;
+                uint32_t prevFree = INVALID_BLOCK_HANDLE;
+                uint32_t nextFree = INVALID_BLOCK_HANDLE;
+                bool isFree = false;
+            };
+
+            uint64_t m_size = 0;
+            uint64_t m_usedSize = 0;
+            uint64_t m_allocationCount = 0;
+            uint32_t m_firstNode = INVALID_BLOCK_HANDLE;
+
+            // Nodes are recycled through m_unusedNodes so handles stay stable
+            std::vector<Node> m_nodes;
+            std::vector<uint32_t> m_unusedNodes;
+
+            uint64_t m_flBitmap = 0;
+            uint32_t m_slBitmap[FL_INDEX_COUNT] = {};
+            uint32_t m_freeHeads[FL_INDEX_COUNT][SL_INDEX_COUNT];
+
+            static void mapping(uint64_t size, uint32_t& fl, uint32_t& sl);
+            static void mappingSearch(uint64_t size, uint32_t& fl, uint32_t& sl);
+
+            uint32_t createNode();
+            void releaseNode(uint32_t node);
+            uint32_t findSuitableNode(uint32_t fl, uint32_t sl) const;
+            uint32_t findFittingNode(uint64_t size, uint64_t alignment) const;
+            void insertFreeNode(uint32_t node);
+            void removeFreeNode(uint32_t node);
+
+        public:
+            TlsfBlock(uint64_t size = 0);
+
+            void reset(uint64_t size);
+
+            /**
+             * @brief Allocates a range from the block
+             *
+             * @param size Size of the range in bytes
+             * @param alignment Required alignment of the offset
+             * @param offset Offset of the allocated range
+             * @param handle Handle used to free the range
+             * @return true if the range was allocated
+             * @return false if there is no free range which can fit the request
+             */
+            bool allocate(uint64_t size, uint64_t alignment, uint64_t& offset, uint32_t& handle);
+            void free(uint32_t handle);
+
+            inline uint64_t getSize() const
+            {
+                return m_size;
+            }
+
+            inline bool isEmpty() const
+            {
+                return m_allocationCount == 0;
+            }
+
+            MemoryBlockStatistics getStatistics() const;
+        };
+
+        /**
+         * @brief Ring allocator for transient data (Eg: per frame uniforms or
+         * staging data). Allocations are released in the order they were made
+         * by releasing everything up to a marker taken earlier with getMarker().
+         */
+        class LinearBlock
+        {
+        private:
+            uint64_t m_size = 0;
+            // Monotonic counters, position in the ring is counter % m_size.
+            // Padding and the unused tail skipped on wrap around are counted as
+            // allocated so that both counters stay in sync with the ring positions.
+            uint64_t m_allocatedTotal = 0;
+            uint64_t m_releasedTotal = 0;
+            // End counter of each live allocation, oldest first
+            std::deque<uint64_t> m_allocationEnds;
+
+        public:
+            LinearBlock(uint64_t size = 0)
+                : m_size{size} {}
+
+            void reset(uint64_t size);
+
+            bool allocate(uint64_t size, uint64_t alignment, uint64_t& offset);
+
+            // Marker of everything allocated so far. Pass it to release() once the
+            // GPU is done with those allocations (Eg: once the frame has finished).
+            inline uint64_t getMarker() const
+            {
+                return m_allocatedTotal;
+            }
+
+            void release(uint64_t marker);
+
+            inline uint64_t getSize() const
+            {
+                return m_size;
+            }
+
+            MemoryBlockStatistics getStatistics() const;
+        };
+    }
+}
+
+#endif
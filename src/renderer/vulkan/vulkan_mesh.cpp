@@ -0,0 +1,116 @@
+#include "vulkan_mesh.h"
+
+bool engine::vulkan::uploadMeshFile(const MeshFile& file,
+    ResourceRegistry& resources,
+    UploadService& uploadService,
+    MeshBuffers& buffers,
+    bool withMeshletBuffers)
+{
+    if (!file.isOpen() || file.getVertexCount() == 0 || file.getIndexCount() == 0)
+        return false;
+
+    struct Upload
+    {
+        BufferHandle* handle;
+        const void* data;
+        vk::DeviceSize size;
+        vk::BufferUsageFlags usage;
+        vk::PipelineStageFlags stages;
+    };
+
+    // Storage usage lets vertex shaders pull vertices (Eg: with bindless buffers)
+    const vk::PipelineStageFlags vertexStages = vk::PipelineStageFlagBits::eVertexInput
+        | vk::PipelineStageFlagBits::eVertexShader;
+    vector<Upload> uploads{
+        Upload{ &buffers.vertexBuffer,
+            file.getVertexData(),
+            file.getVertexCount() * file.getVertexStride(),
+            vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eStorageBuffer,
+            vertexStages },
+        Upload{ &buffers.indexBuffer,
+            file.getIndices(),
+            (file.getIndexCount() + file.getLodIndexCount()) * sizeof(uint32_t),
+            vk::BufferUsageFlagBits::eIndexBuffer | vk::BufferUsageFlagBits::eStorageBuffer,
+            vertexStages } };
+    if (withMeshletBuffers && file.getMeshletCount() > 0)
+    {
+        // Mesh shaders read the vertices too
+        const vk::PipelineStageFlags meshStages = vk::PipelineStageFlagBits::eTaskShaderEXT
+            | vk::PipelineStageFlagBits::eMeshShaderEXT;
+        uploads[0].stages |= meshStages;
+        uploads.push_back(Upload{ &buffers.meshletBuffer,
+            file.getMeshlets(),
+            file.getMeshletCount() * sizeof(Meshlet),
+            vk::BufferUsageFlagBits::eStorageBuffer,
+            meshStages });
+        uploads.push_back(Upload{ &buffers.meshletVertexBuffer,
+            file.getMeshletVertices(),
+            file.getMeshletVertexCount() * sizeof(uint32_t),
+            vk::BufferUsageFlagBits::eStorageBuffer,
+            meshStages });
+        uploads.push_back(Upload{ &buffers.meshletTriangleBuffer,
+            file.getMeshletTriangles(),
+            file.getIndexCount() / 3 * sizeof(uint32_t),
+            vk::BufferUsageFlagBits::eStorageBuffer,
+            meshStages });
+    }
+
+    const vk::AccessFlags access = vk::AccessFlagBits::eVertexAttributeRead
+        | vk::AccessFlagBits::eIndexRead
+        | vk::AccessFlagBits::eShaderRead;
+    uint64_t uploadValue = 0;
+    bool isUploaded = true;
+    for (const Upload& upload : uploads)
+    {
+        *upload.handle = resources.createBuffer(upload.size, upload.usage | vk::BufferUsageFlagBits::eTransferDst);
+        const BufferResource* buffer = resources.get(*upload.handle);
+        const uint64_t value = buffer
+            ? uploadService.uploadBuffer(buffer->buffer, 0, upload.data, upload.size, upload.stages, access)
+            : 0;
+        if (value == 0)
+        {
+            isUploaded = false;
+            break;
+        }
+        uploadValue = std::max(uploadValue, value);
+    }
+
+    if (!isUploaded)
+    {
+        // Queued copies have to finish before their buffers go away
+        if (uploadValue != 0)
+            uploadService.wait(uploadService.flush());
+        releaseMeshBuffers(resources, buffers, 0);
+        return false;
+    }
+
+    buffers.uploadValue = uploadValue;
+    buffers.vertexFormat = file.getVertexFormat();
+    buffers.draws.resize(file.getMeshCount());
+    buffers.meshletRanges.resize(file.getMeshCount());
+    buffers.lodRanges.resize(file.getMeshCount());
+    const MeshFileEntry* meshes = file.getMeshes();
+    for (uint32_t i = 0; i < file.getMeshCount(); i++)
+    {
+        buffers.draws[i].indexCount = meshes[i].indexCount;
+        buffers.draws[i].firstIndex = meshes[i].firstIndex;
+        buffers.draws[i].vertexOffset = static_cast<int32_t>(meshes[i].firstVertex);
+        buffers.meshletRanges[i].firstMeshlet = meshes[i].firstMeshlet;
+        buffers.meshletRanges[i].meshletCount = meshes[i].meshletCount;
+        buffers.lodRanges[i].firstLod = meshes[i].firstLod;
+        buffers.lodRanges[i].lodCount = meshes[i].lodCount;
+    }
+    buffers.meshlets.assign(file.getMeshlets(), file.getMeshlets() + file.getMeshletCount());
+    buffers.lods.assign(file.getLods(), file.getLods() + file.getLodCount());
+    return true;
+}
+
+void engine::vulkan::releaseMeshBuffers(ResourceRegistry& resources, MeshBuffers& buffers, uint64_t releaseValue)
+{
+    resources.release(buffers.vertexBuffer, releaseValue);
+    resources.release(buffers.indexBuffer, releaseValue);
+    resources.release(buffers.meshletBuffer, releaseValue);
+    resources.release(buffers.meshletVertexBuffer, releaseValue);
+    resources.release(buffers.meshletTriangleBuffer, releaseValue);
+    buffers = MeshBuffers();
+}
@@ -0,0 +1,84 @@
+#ifndef VULKAN_MESH_H
+#define VULKAN_MESH_H
+
+#include "vulkan_utils.h"
+#include "vulkan_resources.h"
+#include "vulkan_upload.h"
+#include "vulkan_gpu_culling.h"
+#include "core/mesh_file.h"
+
+namespace engine
+{
+    namespace vulkan
+    {
+        // Meshlets of one mesh in MeshBuffers::meshlets
+        struct MeshletRange
+        {
+            uint32_t firstMeshlet = 0;
+            uint32_t meshletCount = 0;
+        };
+
+        // Levels of one mesh in MeshBuffers::lods, lodCount is 0 if it has none
+        struct MeshLodRange
+        {
+            uint32_t firstLod = 0;
+            uint32_t lodCount = 0;
+        };
+
+        /**
+         * @brief Shared vertex and index buffers of the meshes of a mesh file
+         *
+         * @param vertexFormat Layout of the vertices, which selects the vertex input of the pipelines
+         * @param draws Index range of each mesh, in file order, ready for GpuCulling::setMeshes()
+         * @param meshlets Meshlets of every mesh, kept on the CPU for cullMeshlets().
+         * Empty if the file has none.
+         * @param meshletRanges Meshlets of each mesh, in file order
+         * @param meshletBuffer Meshlets, meshlet vertices and local triangles for
+         * the mesh shaders, only created when requested
+         * @param lods Index range and error of every level of every mesh. A
+         * level is drawn with the vertexOffset of its mesh's draw.
+         * @param lodRanges Levels of each mesh, in file order
+         * @param uploadValue Upload timeline value the buffers are filled at
+         */
+        struct MeshBuffers
+        {
+            BufferHandle vertexBuffer;
+            BufferHandle indexBuffer;
+            MeshVertexFormat vertexFormat = MeshVertexFormat::Float;
+            vector<GpuMeshDraw> draws;
+            vector<Meshlet> meshlets;
+            vector<MeshletRange> meshletRanges;
+            BufferHandle meshletBuffer;
+            BufferHandle meshletVertexBuffer;
+            BufferHandle meshletTriangleBuffer;
+            vector<MeshFileLod> lods;
+            vector<MeshLodRange> lodRanges;
+            uint64_t uploadValue = 0;
+        };
+
+        /**
+         * @brief Creates the vertex and index buffers of a mesh file and queues
+         * their upload. The index buffer holds the indices of every level. The ranges are copied from the file mapping straight
+         * into the staging ring, so the data is copied once on the CPU. Called
+         * from the render thread.
+         *
+         * @param file Opened mesh file, may be closed once the call returns
+         * @param resources Registry the buffers are created in
+         * @param uploadService Service the data is uploaded with
+         * @param buffers Receives the buffers and draw ranges
+         * @param withMeshletBuffers Uploads the meshlet data for the mesh
+         * shaders too. Requires a device with mesh shaders enabled.
+         * @return false if a buffer can't be created or the upload fails
+         */
+        bool uploadMeshFile(const MeshFile& file,
+            ResourceRegistry& resources,
+            UploadService& uploadService,
+            MeshBuffers& buffers,
+            bool withMeshletBuffers = false);
+
+        // Releases the buffers of uploadMeshFile() once releaseValue is reached on the graphics timeline
+        void releaseMeshBuffers(ResourceRegistry& resources, MeshBuffers& buffers, uint64_t releaseValue);
+    }
+}
+
+#endif
@@ -0,0 +1,185 @@
+#include <cstring>
+
+#include "vulkan_mesh_pipeline.h"
+#include "vulkan_functions.h"
+#include "vulkan_graphics.h"
+
+bool engine::vulkan::MeshPipeline::init(const vk::Device& device,
+    ResourceRegistry& resources,
+    DescriptorLayoutCache& layoutCache,
+    DescriptorAllocator& descriptorAllocator)
+{
+    m_device = device;
+    m_resources = &resources;
+    m_descriptorAllocator = &descriptorAllocator;
+
+    m_setLayout = layoutCache.getLayout({
+        vk::DescriptorSetLayoutBinding(0, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eVertex),
+        vk::DescriptorSetLayoutBinding(1, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eVertex) });
+    if (!m_setLayout)
+        return false;
+
+    try
+    {
+        vk::PushConstantRange pushConstants(vk::ShaderStageFlagBits::eVertex, 0, sizeof(PushConstants));
+        m_pipelineLayout = device.createPipelineLayout(vk::PipelineLayoutCreateInfo(vk::PipelineLayoutCreateFlags(),
+            m_setLayout,
+            pushConstants));
+    }
+    catch (...)
+    {
+        handleVulkanException();
+    }
+
+    return m_pipelineLayout ? true : false;
+}
+
+bool engine::vulkan::MeshPipeline::createPipeline(const vk::PipelineCache& pipelineCache,
+    const vk::RenderPass& renderPass,
+    DeletionQueue& deletionQueue,
+    uint64_t releaseValue)
+{
+    deletionQueue.destroy(releaseValue, m_device, m_pipeline);
+    m_pipeline = nullptr;
+    if (!m_pipelineLayout)
+        return false;
+
+    // Shading is the same as the meshlets, so the fragment shader is shared
+    vector<vk::ShaderModule> shaders{
+        createShaderModule(m_device, std::string(SHADER_DIR) + "mesh.vert.spv"),
+        createShaderModule(m_device, std::string(SHADER_DIR) + "meshlet.frag.spv") };
+    if (shaders[0] && shaders[1])
+    {
+        vector<vk::PipelineShaderStageCreateInfo> stages{
+            vk::PipelineShaderStageCreateInfo(vk::PipelineShaderStageCreateFlags(), vk::ShaderStageFlagBits::eVertex, shaders[0], "main"),
+            vk::PipelineShaderStageCreateInfo(vk::PipelineShaderStageCreateFlags(), vk::ShaderStageFlagBits::eFragment, shaders[1], "main") };
+
+        // Vertices are pulled from a storage buffer, there are no vertex attributes
+        vk::PipelineVertexInputStateCreateInfo vertexInputState;
+        vk::PipelineInputAssemblyStateCreateInfo inputAssemblyState(vk::PipelineInputAssemblyStateCreateFlags(),
+            vk::PrimitiveTopology::eTriangleList);
+
+        // Viewport follows the swapchain, so the pipeline survives resizes
+        vk::PipelineViewportStateCreateInfo viewportState(vk::PipelineViewportStateCreateFlags(), 1, nullptr, 1, nullptr);
+        vector<vk::DynamicState> dynamicStates{ vk::DynamicState::eViewport, vk::DynamicState::eScissor };
+        vk::PipelineDynamicStateCreateInfo dynamicState(vk::PipelineDynamicStateCreateFlags(), dynamicStates);
+
+        // Same rasterization as the meshlet pipeline, so every path draws the same image
+        vk::PipelineRasterizationStateCreateInfo rasterizationState(vk::PipelineRasterizationStateCreateFlags(),
+            false,
+            false,
+            vk::PolygonMode::eFill,
+            vk::CullModeFlagBits::eNone,
+            vk::FrontFace::eCounterClockwise,
+            false,
+            0.0f,
+            0.0f,
+            0.0f,
+            1.0f);
+        vk::PipelineMultisampleStateCreateInfo multisampleState(vk::PipelineMultisampleStateCreateFlags(),
+            vk::SampleCountFlagBits::e1);
+        vk::PipelineColorBlendAttachmentState blendAttachment;
+        blendAttachment.colorWriteMask = vk::ColorComponentFlagBits::eR
+            | vk::ColorComponentFlagBits::eG
+            | vk::ColorComponentFlagBits::eB
+            | vk::ColorComponentFlagBits::eA;
+        vk::PipelineColorBlendStateCreateInfo blendState(vk::PipelineColorBlendStateCreateFlags(),
+            false,
+            vk::LogicOp::eCopy,
+            blendAttachment);
+
+        vk::GraphicsPipelineCreateInfo pipelineInfo(vk::PipelineCreateFlags(),
+            stages,
+            &vertexInputState,
+            &inputAssemblyState,
+            nullptr,
+            &viewportState,
+            &rasterizationState,
+            &multisampleState,
+            nullptr,
+            &blendState,
+            &dynamicState,
+            m_pipelineLayout,
+            renderPass,
+            0);
+        try
+        {
+            m_pipeline = m_device.createGraphicsPipeline(pipelineCache, pipelineInfo).value;
+        }
+        catch (...)
+        {
+            handleVulkanException();
+        }
+    }
+    for (vk::ShaderModule& shader : shaders)
+    {
+        if (shader)
+            m_device.destroyShaderModule(shader);
+    }
+
+    return m_pipeline ? true : false;
+}
+
+engine::vulkan::MeshDrawState engine::vulkan::MeshPipeline::getDrawState(const MeshBuffers& buffers,
+    BufferHandle instanceBuffer)
+{
+    MeshDrawState state;
+    const BufferResource* vertices = m_resources->get(buffers.vertexBuffer);
+    const BufferResource* indices = m_resources->get(buffers.indexBuffer);
+    const BufferResource* instances = m_resources->get(instanceBuffer);
+    if (!m_pipeline || !vertices || !indices || !instances)
+        return state;
+
+    DescriptorSetDesc setDesc;
+    setDesc.layout = m_setLayout;
+    setDesc.bindings = {
+        DescriptorBinding{ 0, vk::DescriptorType::eStorageBuffer, vertices->buffer },
+        DescriptorBinding{ 1, vk::DescriptorType::eStorageBuffer, instances->buffer } };
+    state.descriptorSet = m_descriptorAllocator->getSet(setDesc);
+    state.indexBuffer = indices->buffer;
+    state.vertexFormat = static_cast<uint32_t>(buffers.vertexFormat);
+    return state;
+}
+
+void engine::vulkan::MeshPipeline::bind(const vk::CommandBuffer& cmdBuffer,
+    const MeshDrawState& state,
+    const Mat4& viewProjection,
+    const vk::Extent2D& extent) const
+{
+    PushConstants pushConstants;
+    std::memcpy(pushConstants.viewProjection, viewProjection.data(), sizeof(pushConstants.viewProjection));
+    pushConstants.vertexFormat = state.vertexFormat;
+
+    cmdBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, m_pipeline);
+    cmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, m_pipelineLayout, 0, state.descriptorSet, {});
+    cmdBuffer.bindIndexBuffer(state.indexBuffer, 0, vk::IndexType::eUint32);
+    cmdBuffer.pushConstants(m_pipelineLayout,
+        vk::ShaderStageFlagBits::eVertex,
+        0,
+        sizeof(PushConstants),
+        &pushConstants);
+    cmdBuffer.setViewport(0, vk::Viewport(0.0f,
+        0.0f,
+        static_cast<float>(extent.width),
+        static_cast<float>(extent.height),
+        0.0f,
+        1.0f));
+    cmdBuffer.setScissor(0, vk::Rect2D({ 0, 0 }, extent));
+}
+
+bool engine::vulkan::MeshPipeline::destroy()
+{
+    if (!m_device)
+        return true;
+
+    if (m_pipeline)
+        m_device.destroyPipeline(m_pipeline);
+    if (m_pipelineLayout)
+        m_device.destroyPipelineLayout(m_pipelineLayout);
+    m_pipeline = nullptr;
+    m_pipelineLayout = nullptr;
+    // The set layout belongs to the layout cache
+    m_setLayout = nullptr;
+    m_device = nullptr;
+    return true;
+}
@@ -0,0 +1,127 @@
+#ifndef VULKAN_MESH_PIPELINE_H
+#define VULKAN_MESH_PIPELINE_H
+
+#include "vulkan_utils.h"
+#include "vulkan_resources.h"
+#include "vulkan_descriptors.h"
+#include "vulkan_deletion_queue.h"
+#include "vulkan_mesh.h"
+#include "core/math.h"
+
+namespace engine
+{
+    namespace vulkan
+    {
+        /**
+         * @brief Everything a command buffer needs to draw the meshes of a
+         * mesh file with MeshPipeline, resolved on the render thread so that
+         * secondary command buffers can bind it from job system threads
+         */
+        struct MeshDrawState
+        {
+            vk::DescriptorSet descriptorSet;
+            vk::Buffer indexBuffer;
+            uint32_t vertexFormat = 0;
+
+            inline bool isValid() const
+            {
+                return descriptorSet && indexBuffer;
+            }
+        };
+
+        /**
+         * @brief Graphics pipeline for indexed draws of mesh file meshes.
+         * mesh.vert pulls the vertices from the vertex buffer as a storage
+         * buffer, so both vertex formats share the pipeline, and places them
+         * with the GpuInstance selected by the draw's firstInstance, which
+         * every indexed draw path of the renderer writes.
+         */
+        class MeshPipeline
+        {
+        private:
+            // Matches the DrawData push constants of mesh.vert
+            struct PushConstants
+            {
+                float viewProjection[16];
+                uint32_t vertexFormat;
+            };
+
+            vk::Device m_device;
+            ResourceRegistry* m_resources = nullptr;
+            DescriptorAllocator* m_descriptorAllocator = nullptr;
+
+            vk::DescriptorSetLayout m_setLayout;
+            vk::PipelineLayout m_pipelineLayout;
+            vk::Pipeline m_pipeline;
+
+        public:
+            MeshPipeline() = default;
+            MeshPipeline(const MeshPipeline&) = delete;
+            MeshPipeline& operator=(const MeshPipeline&) = delete;
+
+            /**
+             * @brief Creates the pipeline layout
+             *
+             * @param device Vulkan logical device object
+             * @param resources Registry the mesh and instance buffers are looked up in
+             * @param layoutCache Cache the descriptor set layout comes from
+             * @param descriptorAllocator Per frame allocator of the descriptor sets
+             * @return true if initialization is successful
+             */
+            bool init(const vk::Device& device,
+                ResourceRegistry& resources,
+                DescriptorLayoutCache& layoutCache,
+                DescriptorAllocator& descriptorAllocator);
+
+            /**
+             * @brief Creates the graphics pipeline. Called again when the render
+             * pass is recreated, the old pipeline is destroyed through the
+             * deletion queue.
+             *
+             * @param pipelineCache Pipeline cache the pipeline is created with
+             * @param renderPass Render pass the meshes are drawn in, subpass 0
+             * @param deletionQueue Queue the replaced pipeline is destroyed with
+             * @param releaseValue Graphics timeline value after which the replaced pipeline is unused
+             * @return false if the shaders are missing or pipeline creation fails
+             */
+            bool createPipeline(const vk::PipelineCache& pipelineCache,
+                const vk::RenderPass& renderPass,
+                DeletionQueue& deletionQueue,
+                uint64_t releaseValue);
+
+            /**
+             * @brief Allocates the frame's descriptor set of a mesh file and its
+             * instances. Called from the render thread, once per frame.
+             *
+             * @param buffers Buffers of the mesh file
+             * @param instanceBuffer Storage buffer of GpuInstance the draws index
+             * @return state to bind, invalid if a buffer is missing
+             */
+            MeshDrawState getDrawState(const MeshBuffers& buffers, BufferHandle instanceBuffer);
+
+            /**
+             * @brief Binds the pipeline, descriptor set, index buffer, push
+             * constants and the dynamic viewport and scissor. Only records into
+             * cmdBuffer, so it can be called from any thread.
+             *
+             * @param cmdBuffer Command buffer inside the render pass, primary or secondary
+             * @param state State returned by getDrawState() this frame
+             * @param viewProjection View projection matrix of the camera
+             * @param extent Size of the render area
+             */
+            void bind(const vk::CommandBuffer& cmdBuffer,
+                const MeshDrawState& state,
+                const Mat4& viewProjection,
+                const vk::Extent2D& extent) const;
+
+            inline bool isValid() const
+            {
+                return m_pipeline ? true : false;
+            }
+
+            bool destroy();
+        };
+    }
+}
+
+#endif
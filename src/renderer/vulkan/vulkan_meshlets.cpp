@@ -0,0 +1,332 @@
+#include <cstring>
+
+#include "vulkan_meshlets.h"
+#include "vulkan_functions.h"
+#include "vulkan_graphics.h"
+
+// Meshlets culled per workgroup of meshlet.task
+static const uint32_t TASK_GROUP_SIZE = 32;
+
+bool engine::vulkan::MeshletCulling::init(const vk::PhysicalDevice& physicalDevice,
+    const vk::Device& device,
+    ResourceRegistry& resources,
+    DescriptorLayoutCache& layoutCache,
+    DescriptorAllocator& descriptorAllocator,
+    uint32_t framesInFlight,
+    bool useMeshShader)
+{
+    m_device = device;
+    m_resources = &resources;
+    m_descriptorAllocator = &descriptorAllocator;
+    m_useMeshShader = useMeshShader;
+    m_useMultiDraw = physicalDevice.getFeatures().multiDrawIndirect ? true : false;
+    m_useFirstInstance = physicalDevice.getFeatures().drawIndirectFirstInstance ? true : false;
+    m_frameDraws.resize(framesInFlight);
+    if (!useMeshShader)
+        return true;
+
+    const vk::ShaderStageFlags stages = vk::ShaderStageFlagBits::eTaskEXT | vk::ShaderStageFlagBits::eMeshEXT;
+    m_setLayout = layoutCache.getLayout({
+        vk::DescriptorSetLayoutBinding(0, vk::DescriptorType::eStorageBuffer, 1, stages),
+        vk::DescriptorSetLayoutBinding(1, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eMeshEXT),
+        vk::DescriptorSetLayoutBinding(2, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eMeshEXT),
+        vk::DescriptorSetLayoutBinding(3, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eMeshEXT) });
+    m_drawMeshTasks = reinterpret_cast<PFN_vkCmdDrawMeshTasksEXT>(device.getProcAddr("vkCmdDrawMeshTasksEXT"));
+    if (!m_setLayout || !m_drawMeshTasks)
+        return false;
+
+    try
+    {
+        vk::PushConstantRange pushConstants(stages, 0, sizeof(MeshPushConstants));
+        m_pipelineLayout = device.createPipelineLayout(vk::PipelineLayoutCreateInfo(vk::PipelineLayoutCreateFlags(),
+            m_setLayout,
+            pushConstants));
+    }
+    catch (...)
+    {
+        handleVulkanException();
+    }
+
+    return m_pipelineLayout ? true : false;
+}
+
+bool engine::vulkan::MeshletCulling::createMeshPipeline(const vk::PipelineCache& pipelineCache,
+    const vk::RenderPass& renderPass,
+    DeletionQueue& deletionQueue,
+    uint64_t releaseValue)
+{
+    deletionQueue.destroy(releaseValue, m_device, m_meshPipeline);
+    m_meshPipeline = nullptr;
+    if (!m_useMeshShader || !m_pipelineLayout)
+        return false;
+
+    vector<vk::ShaderModule> shaders{
+        createShaderModule(m_device, std::string(SHADER_DIR) + "meshlet.task.spv"),
+        createShaderModule(m_device, std::string(SHADER_DIR) + "meshlet.mesh.spv"),
+        createShaderModule(m_device, std::string(SHADER_DIR) + "meshlet.frag.spv") };
+    if (shaders[0] && shaders[1] && shaders[2])
+    {
+        vector<vk::PipelineShaderStageCreateInfo> stages{
+            vk::PipelineShaderStageCreateInfo(vk::PipelineShaderStageCreateFlags(), vk::ShaderStageFlagBits::eTaskEXT, shaders[0], "main"),
+            vk::PipelineShaderStageCreateInfo(vk::PipelineShaderStageCreateFlags(), vk::ShaderStageFlagBits::eMeshEXT, shaders[1], "main"),
+            vk::PipelineShaderStageCreateInfo(vk::PipelineShaderStageCreateFlags(), vk::ShaderStageFlagBits::eFragment, shaders[2], "main") };
+
+        // Viewport follows the swapchain, so the pipeline survives resizes
+        vk::PipelineViewportStateCreateInfo viewportState(vk::PipelineViewportStateCreateFlags(), 1, nullptr, 1, nullptr);
+        vector<vk::DynamicState> dynamicStates{ vk::DynamicState::eViewport, vk::DynamicState::eScissor };
+        vk::PipelineDynamicStateCreateInfo dynamicState(vk::PipelineDynamicStateCreateFlags(), dynamicStates);
+
+        // Backfacing meshlets are already gone, the winding of the remaining
+        // triangles is left to the source asset
+        vk::PipelineRasterizationStateCreateInfo rasterizationState(vk::PipelineRasterizationStateCreateFlags(),
+            false,
+            false,
+            vk::PolygonMode::eFill,
+            vk::CullModeFlagBits::eNone,
+            vk::FrontFace::eCounterClockwise,
+            false,
+            0.0f,
+            0.0f,
+            0.0f,
+            1.0f);
+        vk::PipelineMultisampleStateCreateInfo multisampleState(vk::PipelineMultisampleStateCreateFlags(),
+            vk::SampleCountFlagBits::e1);
+        vk::PipelineColorBlendAttachmentState blendAttachment;
+        blendAttachment.colorWriteMask = vk::ColorComponentFlagBits::eR
+            | vk::ColorComponentFlagBits::eG
+            | vk::ColorComponentFlagBits::eB
+            | vk::ColorComponentFlagBits::eA;
+        vk::PipelineColorBlendStateCreateInfo blendState(vk::PipelineColorBlendStateCreateFlags(),
+            false,
+            vk::LogicOp::eCopy,
+            blendAttachment);
+
+        // Mesh pipelines have no vertex input or input assembly state
+        vk::GraphicsPipelineCreateInfo pipelineInfo(vk::PipelineCreateFlags(),
+            stages,
+            nullptr,
+            nullptr,
+            nullptr,
+            &viewportState,
+            &rasterizationState,
+            &multisampleState,
+            nullptr,
+            &blendState,
+            &dynamicState,
+            m_pipelineLayout,
+            renderPass,
+            0);
+        try
+        {
+            m_meshPipeline = m_device.createGraphicsPipeline(pipelineCache, pipelineInfo).value;
+        }
+        catch (...)
+        {
+            handleVulkanException();
+        }
+    }
+    for (vk::ShaderModule& shader : shaders)
+    {
+        if (shader)
+            m_device.destroyShaderModule(shader);
+    }
+
+    return m_meshPipeline ? true : false;
+}
+
+uint32_t engine::vulkan::MeshletCulling::cull(const Frustum& frustum,
+    const Vec3& cameraPosition,
+    const Mat4& transform,
+    const MeshBuffers& buffers,
+    uint32_t meshIndex,
+    uint32_t instanceIndex)
+{
+    if (isMeshShaderPath() || meshIndex >= buffers.meshletRanges.size())
+        return 0;
+
+    const MeshletRange& range = buffers.meshletRanges[meshIndex];
+    const Meshlet* meshlets = buffers.meshlets.data() + range.firstMeshlet;
+    const uint32_t visibleCount = cullMeshlets(frustum,
+        cameraPosition,
+        transform,
+        meshlets,
+        range.meshletCount,
+        m_visible,
+        &m_stats);
+
+    // Meshlets are index ranges of the mesh, so each one is a plain indexed draw
+    const int32_t vertexOffset = buffers.draws[meshIndex].vertexOffset;
+    const size_t first = m_draws.size();
+    m_draws.resize(first + visibleCount);
+    for (uint32_t i = 0; i < visibleCount; i++)
+    {
+        const Meshlet& meshlet = meshlets[m_visible[i]];
+        m_draws[first + i] = vk::DrawIndexedIndirectCommand(meshlet.triangleCount * 3,
+            1,
+            meshlet.triangleOffset * 3,
+            vertexOffset,
+            instanceIndex);
+    }
+    return visibleCount;
+}
+
+bool engine::vulkan::MeshletCulling::writeDraws(uint32_t frameIndex, uint64_t releaseValue)
+{
+    m_frameIndex = frameIndex;
+    m_frameDrawCount = 0;
+    m_frameStats = m_stats;
+    m_stats = MeshletCullStats();
+    if (frameIndex >= m_frameDraws.size())
+    {
+        m_draws.clear();
+        return false;
+    }
+
+    // Direct draws are recorded from the CPU copy, nothing goes to the GPU
+    if (!m_useFirstInstance)
+    {
+        m_directDraws.swap(m_draws);
+        m_frameDrawCount = static_cast<uint32_t>(m_directDraws.size());
+        m_draws.clear();
+        return true;
+    }
+
+    // Grown by half again, so a slowly rising count doesn't reallocate every frame
+    FrameDraws& frame = m_frameDraws[frameIndex];
+    const uint32_t count = static_cast<uint32_t>(m_draws.size());
+    if (count > frame.capacity)
+    {
+        m_resources->release(frame.buffer, releaseValue);
+        frame.capacity = std::max(count, frame.capacity + frame.capacity / 2);
+        frame.buffer = m_resources->createBuffer(frame.capacity * sizeof(vk::DrawIndexedIndirectCommand),
+            vk::BufferUsageFlagBits::eIndirectBuffer,
+            vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+    }
+
+    const BufferResource* buffer = m_resources->get(frame.buffer);
+    bool isWritten = count == 0 || (buffer && buffer->allocation.mapped);
+    if (isWritten && count > 0)
+    {
+        std::memcpy(buffer->allocation.mapped, m_draws.data(), count * sizeof(vk::DrawIndexedIndirectCommand));
+        m_frameDrawCount = count;
+    }
+    else if (!isWritten)
+    {
+        frame.buffer = BufferHandle();
+        frame.capacity = 0;
+    }
+    m_draws.clear();
+    return isWritten;
+}
+
+void engine::vulkan::MeshletCulling::draw(const vk::CommandBuffer& cmdBuffer) const
+{
+    if (m_frameDrawCount == 0)
+        return;
+    if (!m_useFirstInstance)
+    {
+        for (const vk::DrawIndexedIndirectCommand& d : m_directDraws)
+            cmdBuffer.drawIndexed(d.indexCount, d.instanceCount, d.firstIndex, d.vertexOffset, d.firstInstance);
+        return;
+    }
+
+    const BufferResource* draws = m_resources->get(m_frameDraws[m_frameIndex].buffer);
+    if (!draws)
+        return;
+
+    const uint32_t stride = sizeof(vk::DrawIndexedIndirectCommand);
+    if (m_useMultiDraw)
+        cmdBuffer.drawIndexedIndirect(draws->buffer, 0, m_frameDrawCount, stride);
+    else
+    {
+        for (uint32_t i = 0; i < m_frameDrawCount; i++)
+            cmdBuffer.drawIndexedIndirect(draws->buffer, i * stride, 1, stride);
+    }
+}
+
+bool engine::vulkan::MeshletCulling::prepareMeshTasks(const MeshBuffers& buffers)
+{
+    m_frameSet = nullptr;
+    if (!isMeshShaderPath())
+        return false;
+    const BufferResource* meshlets = m_resources->get(buffers.meshletBuffer);
+    const BufferResource* meshletVertices = m_resources->get(buffers.meshletVertexBuffer);
+    const BufferResource* meshletTriangles = m_resources->get(buffers.meshletTriangleBuffer);
+    const BufferResource* vertices = m_resources->get(buffers.vertexBuffer);
+    if (!meshlets || !meshletVertices || !meshletTriangles || !vertices)
+        return false;
+
+    DescriptorSetDesc setDesc;
+    setDesc.layout = m_setLayout;
+    setDesc.bindings = {
+        DescriptorBinding{ 0, vk::DescriptorType::eStorageBuffer, meshlets->buffer },
+        DescriptorBinding{ 1, vk::DescriptorType::eStorageBuffer, meshletVertices->buffer },
+        DescriptorBinding{ 2, vk::DescriptorType::eStorageBuffer, meshletTriangles->buffer },
+        DescriptorBinding{ 3, vk::DescriptorType::eStorageBuffer, vertices->buffer } };
+    m_frameSet = m_descriptorAllocator->getSet(setDesc);
+    return m_frameSet ? true : false;
+}
+
+void engine::vulkan::MeshletCulling::drawMeshTasks(const vk::CommandBuffer& cmdBuffer,
+    const Mat4& viewProjection,
+    const Vec3& cameraPosition,
+    const Mat4& transform,
+    const MeshBuffers& buffers,
+    uint32_t meshIndex) const
+{
+    if (!isMeshShaderPath() || !m_frameSet || meshIndex >= buffers.meshletRanges.size())
+        return;
+    const MeshletRange& range = buffers.meshletRanges[meshIndex];
+    if (range.meshletCount == 0)
+        return;
+
+    // The task shader tests against the camera moved into mesh space, like cullMeshlets()
+    MeshPushConstants pushConstants;
+    const Mat4 modelViewProjection = viewProjection * transform;
+    const Vec3 meshCamera = transform.inverseAffine().transformPoint(cameraPosition);
+    std::memcpy(pushConstants.modelViewProjection, modelViewProjection.data(), sizeof(pushConstants.modelViewProjection));
+    pushConstants.cameraPosition[0] = meshCamera.x;
+    pushConstants.cameraPosition[1] = meshCamera.y;
+    pushConstants.cameraPosition[2] = meshCamera.z;
+    pushConstants.cameraPosition[3] = 1.0f;
+    pushConstants.firstMeshlet = range.firstMeshlet;
+    pushConstants.meshletCount = range.meshletCount;
+    pushConstants.vertexOffset = buffers.draws[meshIndex].vertexOffset;
+    pushConstants.vertexFormat = static_cast<uint32_t>(buffers.vertexFormat);
+
+    cmdBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, m_meshPipeline);
+    cmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, m_pipelineLayout, 0, m_frameSet, {});
+    cmdBuffer.pushConstants(m_pipelineLayout,
+        vk::ShaderStageFlagBits::eTaskEXT | vk::ShaderStageFlagBits::eMeshEXT,
+        0,
+        sizeof(MeshPushConstants),
+        &pushConstants);
+    m_drawMeshTasks(cmdBuffer, (range.meshletCount + TASK_GROUP_SIZE - 1) / TASK_GROUP_SIZE, 1, 1);
+}
+
+bool engine::vulkan::MeshletCulling::destroy()
+{
+    if (!m_device)
+        return true;
+
+    // Called once the device is idle, nothing uses the buffers anymore
+    for (FrameDraws& frame : m_frameDraws)
+        m_resources->release(frame.buffer, 0);
+    m_frameDraws.clear();
+    m_draws.clear();
+    m_directDraws.clear();
+    m_frameDrawCount = 0;
+    m_frameSet = nullptr;
+
+    if (m_meshPipeline)
+        m_device.destroyPipeline(m_meshPipeline);
+    if (m_pipelineLayout)
+        m_device.destroyPipelineLayout(m_pipelineLayout);
+    m_meshPipeline = nullptr;
+    m_pipelineLayout = nullptr;
+    m_drawMeshTasks = nullptr;
+    // The set layout belongs to the layout cache
+    m_setLayout = nullptr;
+    m_device = nullptr;
+    return true;
+}
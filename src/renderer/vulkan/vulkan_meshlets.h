@@ -0,0 +1,217 @@
+#ifndef VULKAN_MESHLETS_H
+#define VULKAN_MESHLETS_H
+
+#include "vulkan_utils.h"
+#include "vulkan_resources.h"
+#include "vulkan_descriptors.h"
+#include "vulkan_mesh.h"
+#include "core/meshlet.h"
+
+namespace engine
+{
+    namespace vulkan
+    {
+        /**
+         * @brief Draws meshes of a mesh file meshlet by meshlet, skipping the
+         * ones outside the frustum or facing away from the camera.
+         *
+         * With mesh shaders, meshlet.task culls the meshlets of an instance
+         * and meshlet.mesh emits the visible ones, so nothing is culled on the
+         * CPU. Any other device takes the CPU path: cull() runs cullMeshlets()
+         * for each instance and appends one indexed indirect draw per visible
+         * meshlet, writeDraws() copies them into a host visible buffer of the
+         * frame slot once the GPU is done with it, and draw() issues them with
+         * one multi draw. Each draw's firstInstance is the instance index
+         * given to cull(). Devices without the drawIndirectFirstInstance
+         * feature keep the draws on the CPU and draw() records them as direct
+         * draws, which may use any firstInstance. draw() and drawMeshTasks()
+         * only read the frame's state and may record secondary command
+         * buffers on job system threads, everything else is used from the
+         * render thread.
+         */
+        class MeshletCulling
+        {
+        private:
+            // Matches the DrawData push constants of meshlet.task and meshlet.mesh
+            struct MeshPushConstants
+            {
+                float modelViewProjection[16];
+                float cameraPosition[4];
+                uint32_t firstMeshlet;
+                uint32_t meshletCount;
+                int32_t vertexOffset;
+                uint32_t vertexFormat;
+            };
+
+            struct FrameDraws
+            {
+                BufferHandle buffer;
+                uint32_t capacity = 0;
+            };
+
+            vk::Device m_device;
+            ResourceRegistry* m_resources = nullptr;
+            DescriptorAllocator* m_descriptorAllocator = nullptr;
+            bool m_useMeshShader = false;
+            bool m_useMultiDraw = false;
+            // Indirect draws may have a non zero firstInstance
+            bool m_useFirstInstance = false;
+
+            vk::DescriptorSetLayout m_setLayout;
+            vk::PipelineLayout m_pipelineLayout;
+            vk::Pipeline m_meshPipeline;
+            // Extension command, loaded from the device like the debug messenger functions
+            PFN_vkCmdDrawMeshTasksEXT m_drawMeshTasks = nullptr;
+            // Set of the mesh file drawn this frame, from prepareMeshTasks()
+            vk::DescriptorSet m_frameSet;
+
+            // Draws of the frame being culled, copied out by writeDraws()
+            vector<vk::DrawIndexedIndirectCommand> m_draws;
+            vector<uint32_t> m_visible;
+            MeshletCullStats m_stats;
+            // One draw buffer per frame in flight, grown when a frame needs more
+            vector<FrameDraws> m_frameDraws;
+            // Draws of the written frame when they can't be drawn indirectly
+            vector<vk::DrawIndexedIndirectCommand> m_directDraws;
+            uint32_t m_frameIndex = 0;
+            uint32_t m_frameDrawCount = 0;
+            MeshletCullStats m_frameStats;
+
+        public:
+            MeshletCulling() = default;
+            MeshletCulling(const MeshletCulling&) = delete;
+            MeshletCulling& operator=(const MeshletCulling&) = delete;
+
+            /**
+             * @brief Sets up the culling paths
+             *
+             * @param physicalDevice Vulkan physical device, used to check the indirect draw features
+             * @param device Vulkan logical device object
+             * @param resources Registry the draw buffers are created in
+             * @param layoutCache Cache the descriptor set layout of the mesh shaders comes from
+             * @param descriptorAllocator Per frame allocator of the mesh shader descriptor sets
+             * @param framesInFlight Number of frames recorded ahead, one draw buffer each
+             * @param useMeshShader Takes the mesh shader path, the device must have mesh shaders enabled
+             * @return true if initialization is successful
+             */
+            bool init(const vk::PhysicalDevice& physicalDevice,
+                const vk::Device& device,
+                ResourceRegistry& resources,
+                DescriptorLayoutCache& layoutCache,
+                DescriptorAllocator& descriptorAllocator,
+                uint32_t framesInFlight,
+                bool useMeshShader);
+
+            /**
+             * @brief Creates the task and mesh shader pipeline. Called again
+             * when the render pass is recreated, the old pipeline is destroyed
+             * through the deletion queue.
+             *
+             * @param pipelineCache Pipeline cache the pipeline is created with
+             * @param renderPass Render pass the meshlets are drawn in, subpass 0
+             * @param deletionQueue Queue the replaced pipeline is destroyed with
+             * @param releaseValue Graphics timeline value after which the replaced pipeline is unused
+             * @return false if the shaders are missing or pipeline creation
+             * fails, the CPU path is used from then on
+             */
+            bool createMeshPipeline(const vk::PipelineCache& pipelineCache,
+                const vk::RenderPass& renderPass,
+                DeletionQueue& deletionQueue,
+                uint64_t releaseValue);
+
+            /**
+             * @brief Culls the meshlets of an instance on the CPU and appends a
+             * draw per visible meshlet. Does nothing on the mesh shader path,
+             * where drawMeshTasks() culls on the GPU.
+             *
+             * @param frustum World space frustum
+             * @param cameraPosition World space camera position
+             * @param transform Mesh to world transform of the instance
+             * @param buffers Buffers of the mesh file the mesh belongs to
+             * @param meshIndex Index of the mesh in the file
+             * @param instanceIndex Written as the firstInstance of the draws
+             * @return number of visible meshlets
+             */
+            uint32_t cull(const Frustum& frustum,
+                const Vec3& cameraPosition,
+                const Mat4& transform,
+                const MeshBuffers& buffers,
+                uint32_t meshIndex,
+                uint32_t instanceIndex);
+
+            /**
+             * @brief Moves the draws culled since the last call into the draw
+             * buffer of a frame slot, which draw() then reads (or keeps them on
+             * the CPU without drawIndirectFirstInstance). Called by the
+             * renderer once the frame which used the slot before has finished.
+             *
+             * @param frameIndex Frame slot, m_currentFrameNumber % framesInFlight
+             * @param releaseValue Graphics timeline value of the frame, a replaced draw buffer is released with it
+             * @return false if the draw buffer couldn't be grown, the frame draws nothing
+             */
+            bool writeDraws(uint32_t frameIndex, uint64_t releaseValue);
+
+            /**
+             * @brief Draws what writeDraws() moved into the frame. The graphics pipeline,
+             * index and vertex buffers have to be bound already.
+             *
+             * @param cmdBuffer Command buffer inside the render pass, primary or secondary
+             */
+            void draw(const vk::CommandBuffer& cmdBuffer) const;
+
+            /**
+             * @brief Gets the descriptor set drawMeshTasks() binds this frame,
+             * from the per frame descriptor allocator. Called on the render
+             * thread once per frame, before drawMeshTasks() is recorded.
+             *
+             * @param buffers Buffers of the mesh file, uploaded with the meshlet buffers
+             * @return false if not on the mesh shader path, the meshlet buffers
+             * are missing or the set can't be allocated
+             */
+            bool prepareMeshTasks(const MeshBuffers& buffers);
+
+            /**
+             * @brief Culls and draws the meshlets of an instance with the mesh
+             * shader pipeline. Binds the pipeline and the set of
+             * prepareMeshTasks(), the viewport and scissor are dynamic and
+             * have to be set.
+             *
+             * @param cmdBuffer Command buffer inside the render pass, primary or secondary
+             * @param viewProjection View projection matrix of the camera
+             * @param cameraPosition World space camera position
+             * @param transform Mesh to world transform of the instance
+             * @param buffers Buffers of the mesh file, uploaded with the meshlet buffers
+             * @param meshIndex Index of the mesh in the file
+             */
+            void drawMeshTasks(const vk::CommandBuffer& cmdBuffer,
+                const Mat4& viewProjection,
+                const Vec3& cameraPosition,
+                const Mat4& transform,
+                const MeshBuffers& buffers,
+                uint32_t meshIndex) const;
+
+            // True if meshlets are culled and drawn with task and mesh shaders
+            inline bool isMeshShaderPath() const
+            {
+                return m_meshPipeline ? true : false;
+            }
+
+            // Culled meshlets and triangles of the CPU path in the last written frame
+            inline const MeshletCullStats& getStats() const
+            {
+                return m_frameStats;
+            }
+
+            // Meshlets drawn by draw() in the last written frame
+            inline uint32_t getDrawCount() const
+            {
+                return m_frameDrawCount;
+            }
+
+            // Buffers are released through the resource registry
+            bool destroy();
+        };
+    }
+}
+
+#endif
@@ -0,0 +1,610 @@
+#include "vulkan_render_graph.h"
+
+namespace
+{
+    /**
+     * @brief Layout, stages and access flags a resource needs for a usage
+     */
+    struct RenderUsageState
+    {
+        vk::ImageLayout layout;
+        vk::PipelineStageFlags stage;
+        vk::AccessFlags access;
+        bool isWrite;
+        // Writes which keep or combine with the previous contents also read them,
+        // so the passes producing those contents must not be culled
+        bool isRead;
+    };
+
+    RenderUsageState getUsageState(engine::vulkan::RenderResourceUsage usage)
+    {
+        using engine::vulkan::RenderResourceUsage;
+        using Stage = vk::PipelineStageFlagBits;
+        using Access = vk::AccessFlagBits;
+
+        switch (usage)
+        {
+        case RenderResourceUsage::ColorAttachment:
+            return { vk::ImageLayout::eColorAttachmentOptimal,
+                Stage::eColorAttachmentOutput,
+                Access::eColorAttachmentRead | Access::eColorAttachmentWrite,
+                true,
+                true };
+        case RenderResourceUsage::DepthAttachment:
+            return { vk::ImageLayout::eDepthStencilAttachmentOptimal,
+                Stage::eEarlyFragmentTests | Stage::eLateFragmentTests,
+                Access::eDepthStencilAttachmentRead | Access::eDepthStencilAttachmentWrite,
+                true,
+                true };
+        case RenderResourceUsage::DepthRead:
+            return { vk::ImageLayout::eDepthStencilReadOnlyOptimal,
+                Stage::eEarlyFragmentTests | Stage::eLateFragmentTests | Stage::eFragmentShader,
+                Access::eDepthStencilAttachmentRead | Access::eShaderRead,
+                false,
+                true };
+        case RenderResourceUsage::Sampled:
+            return { vk::ImageLayout::eShaderReadOnlyOptimal,
+                Stage::eFragmentShader | Stage::eComputeShader,
+                Access::eShaderRead,
+                false,
+                true };
+        case RenderResourceUsage::StorageRead:
+            return { vk::ImageLayout::eGeneral,
+                Stage::eComputeShader,
+                Access::eShaderRead,
+                false,
+                true };
+        case RenderResourceUsage::StorageWrite:
+            return { vk::ImageLayout::eGeneral,
+                Stage::eComputeShader,
+                Access::eShaderRead | Access::eShaderWrite,
+                true,
+                true };
+        case RenderResourceUsage::IndirectRead:
+            return { vk::ImageLayout::eUndefined,
+                Stage::eDrawIndirect,
+                Access::eIndirectCommandRead,
+                false,
+                true };
+        case RenderResourceUsage::TransferSrc:
+            return { vk::ImageLayout::eTransferSrcOptimal,
+                Stage::eTransfer,
+                Access::eTransferRead,
+                false,
+                true };
+        case RenderResourceUsage::TransferDst:
+            return { vk::ImageLayout::eTransferDstOptimal,
+                Stage::eTransfer,
+                Access::eTransferWrite,
+                true,
+                false };
+        case RenderResourceUsage::Present:
+        default:
+            return { vk::ImageLayout::ePresentSrcKHR,
+                Stage::eBottomOfPipe,
+                vk::AccessFlags(),
+                false,
+                true };
+        }
+    }
+
+    /**
+     * @brief Rough bytes per pixel of common formats, used to estimate image
+     * sizes before the real memory requirements are known
+     */
+    vk::DeviceSize getFormatSizeEstimate(vk::Format format)
+    {
+        switch (format)
+        {
+        case vk::Format::eR8Unorm:
+            return 1;
+        case vk::Format::eR16G16B16A16Sfloat:
+        case vk::Format::eR32G32Sfloat:
+            return 8;
+        case vk::Format::eR32G32B32A32Sfloat:
+            return 16;
+        default:
+            return 4;
+        }
+    }
+
+    bool isDepthFormat(vk::Format format)
+    {
+        return format == vk::Format::eD16Unorm
+            || format == vk::Format::eD32Sfloat
+            || format == vk::Format::eD16UnormS8Uint
+            || format == vk::Format::eD24UnormS8Uint
+            || format == vk::Format::eD32SfloatS8Uint;
+    }
+
+    bool hasStencil(vk::Format format)
+    {
+        return format == vk::Format::eD16UnormS8Uint
+            || format == vk::Format::eD24UnormS8Uint
+            || format == vk::Format::eD32SfloatS8Uint;
+    }
+}
+
+engine::vulkan::RenderResourceId engine::vulkan::RenderGraph::createResource(const std::string& name,
+    const RenderResourceDesc& desc)
+{
+    Resource resource;
+    resource.name = name;
+    resource.desc = desc;
+    m_resources.push_back(resource);
+    m_isCompiled = false;
+    return static_cast<RenderResourceId>(m_resources.size() - 1);
+}
+
+engine::vulkan::RenderResourceId engine::vulkan::RenderGraph::importResource(const std::string& name,
+    const RenderResourceDesc& desc,
+    vk::ImageLayout initialLayout,
+    vk::ImageLayout finalLayout)
+{
+    Resource resource;
+    resource.name = name;
+    resource.desc = desc;
+    resource.isImported = true;
+    resource.initialLayout = initialLayout;
+    resource.finalLayout = finalLayout;
+    m_resources.push_back(resource);
+    m_isCompiled = false;
+    return static_cast<RenderResourceId>(m_resources.size() - 1);
+}
+
+uint32_t engine::vulkan::RenderGraph::addPass(const std::string& name,
+    const vector<RenderPassResource>& resources,
+    RenderPassExecuteFunc execute,
+    bool hasSideEffects)
+{
+    Pass pass;
+    pass.name = name;
+    pass.resources = resources;
+    pass.execute = execute;
+    pass.hasSideEffects = hasSideEffects;
+    m_passes.push_back(pass);
+    m_isCompiled = false;
+    return static_cast<uint32_t>(m_passes.size() - 1);
+}
+
+void engine::vulkan::RenderGraph::cullPasses()
+{
+    // Walk backwards from the passes producing visible results (imported
+    // resources or side effects). A pass is kept if it writes something a kept
+    // pass after it reads.
+    vector<bool> isResourceNeeded(m_resources.size(), false);
+    m_schedule.isPassCulled = vector<bool>(m_passes.size(), true);
+
+    for (size_t p = m_passes.size(); p-- > 0;)
+    {
+        const Pass& pass = m_passes[p];
+        bool isNeeded = pass.hasSideEffects;
+        for (const RenderPassResource& r : pass.resources)
+        {
+            if (getUsageState(r.usage).isWrite
+                && (m_resources[r.resource].isImported || isResourceNeeded[r.resource]))
+                isNeeded = true;
+        }
+
+        if (!isNeeded)
+            continue;
+
+        m_schedule.isPassCulled[p] = false;
+        for (const RenderPassResource& r : pass.resources)
+        {
+            if (getUsageState(r.usage).isRead)
+                isResourceNeeded[r.resource] = true;
+        }
+    }
+
+    m_schedule.passOrder.clear();
+    for (uint32_t p = 0; p < m_passes.size(); p++)
+    {
+        if (!m_schedule.isPassCulled[p])
+            m_schedule.passOrder.push_back(p);
+    }
+}
+
+void engine::vulkan::RenderGraph::computeAliasing()
+{
+    const uint32_t noUse = std::numeric_limits<uint32_t>::max();
+
+    // Lifetime of each transient resource as [first, last] step in passOrder
+    vector<std::pair<uint32_t, uint32_t>> lifetimes(m_resources.size(), { noUse, 0 });
+    for (uint32_t step = 0; step < m_schedule.passOrder.size(); step++)
+    {
+        for (const RenderPassResource& r : m_passes[m_schedule.passOrder[step]].resources)
+        {
+            lifetimes[r.resource].first = std::min(lifetimes[r.resource].first, step);
+            lifetimes[r.resource].second = std::max(lifetimes[r.resource].second, step);
+        }
+    }
+
+    vector<RenderResourceId> transients;
+    m_schedule.unaliasedMemorySize = 0;
+    for (RenderResourceId r = 0; r < m_resources.size(); r++)
+    {
+        Resource& resource = m_resources[r];
+        if (resource.isImported || lifetimes[r].first == noUse)
+            continue;
+
+        RenderResourceDesc& desc = resource.desc;
+        if (desc.size == 0)
+            desc.size = static_cast<vk::DeviceSize>(desc.extent.width) * desc.extent.height * getFormatSizeEstimate(desc.format);
+
+        transients.push_back(r);
+        m_schedule.unaliasedMemorySize = alignUp(m_schedule.unaliasedMemorySize, desc.alignment) + desc.size;
+    }
+
+    // Place the biggest resources first, each at the lowest offset which doesn't
+    // overlap the memory of a placed resource whose lifetime overlaps
+    std::sort(transients.begin(), transients.end(), [this](RenderResourceId a, RenderResourceId b)
+              { return m_resources[a].desc.size > m_resources[b].desc.size; });
+
+    m_schedule.memoryOffsets = vector<vk::DeviceSize>(m_resources.size(), std::numeric_limits<vk::DeviceSize>::max());
+    m_schedule.transientMemorySize = 0;
+    vector<RenderResourceId> placed;
+    for (RenderResourceId r : transients)
+    {
+        const RenderResourceDesc& desc = m_resources[r].desc;
+
+        vector<RenderResourceId> conflicts;
+        for (RenderResourceId o : placed)
+        {
+            if (lifetimes[o].first <= lifetimes[r].second && lifetimes[r].first <= lifetimes[o].second)
+                conflicts.push_back(o);
+        }
+
+        // Candidate offsets are 0 and the end of every conflicting resource
+        vector<vk::DeviceSize> candidates{ 0 };
+        for (RenderResourceId o : conflicts)
+            candidates.push_back(alignUp(m_schedule.memoryOffsets[o] + m_resources[o].desc.size, desc.alignment));
+        std::sort(candidates.begin(), candidates.end());
+
+        for (vk::DeviceSize offset : candidates)
+        {
+            bool isFree = std::none_of(conflicts.begin(), conflicts.end(), [&](RenderResourceId o)
+                                       {
+                                           vk::DeviceSize begin = m_schedule.memoryOffsets[o];
+                                           return offset < begin + m_resources[o].desc.size && begin < offset + desc.size;
+                                       });
+            if (isFree)
+            {
+                m_schedule.memoryOffsets[r] = offset;
+                break;
+            }
+        }
+
+        m_schedule.transientMemorySize = std::max(m_schedule.transientMemorySize, m_schedule.memoryOffsets[r] + desc.size);
+        placed.push_back(r);
+    }
+}
+
+void engine::vulkan::RenderGraph::computeBarriers()
+{
+    struct ResourceState
+    {
+        vk::ImageLayout layout;
+        vk::PipelineStageFlags writeStage;
+        vk::AccessFlags writeAccess;
+        // Stages which read since the last write, and the stages the last write
+        // has already been made visible to
+        vk::PipelineStageFlags readStages;
+        vk::PipelineStageFlags visibleStages;
+        bool isUsed = false;
+    };
+
+    vector<ResourceState> states(m_resources.size());
+    for (RenderResourceId r = 0; r < m_resources.size(); r++)
+        states[r].layout = m_resources[r].isImported ? m_resources[r].initialLayout : vk::ImageLayout::eUndefined;
+
+    m_schedule.passBarriers = vector<vector<RenderBarrier>>(m_schedule.passOrder.size());
+    for (uint32_t step = 0; step < m_schedule.passOrder.size(); step++)
+    {
+        for (const RenderPassResource& r : m_passes[m_schedule.passOrder[step]].resources)
+        {
+            const Resource& resource = m_resources[r.resource];
+            RenderUsageState usage = getUsageState(r.usage);
+            ResourceState& state = states[r.resource];
+            if (resource.desc.isBuffer)
+                usage.layout = vk::ImageLayout::eUndefined;
+
+            vk::PipelineStageFlags srcStage = state.writeStage | state.readStages;
+            vk::AccessFlags srcAccess = state.writeAccess;
+
+            // Memory shared with transient resources used before has to be
+            // done with before it's reused
+            if (!resource.isImported && !state.isUsed)
+            {
+                const vk::DeviceSize begin = m_schedule.memoryOffsets[r.resource];
+                for (RenderResourceId o = 0; o < m_resources.size(); o++)
+                {
+                    if (o == r.resource || !states[o].isUsed || m_resources[o].isImported
+                        || m_schedule.memoryOffsets[o] == std::numeric_limits<vk::DeviceSize>::max())
+                        continue;
+                    const vk::DeviceSize otherBegin = m_schedule.memoryOffsets[o];
+                    if (begin < otherBegin + m_resources[o].desc.size
+                        && otherBegin < begin + resource.desc.size)
+                        srcStage |= states[o].writeStage | states[o].readStages;
+                }
+            }
+
+            bool isLayoutChange = state.layout != usage.layout;
+            bool isWriteHazard = usage.isWrite && (state.writeStage || state.readStages);
+            bool isReadHazard = !usage.isWrite && state.writeStage && (state.visibleStages & usage.stage) != usage.stage;
+            bool isAliased = !state.isUsed && srcStage;
+
+            if (isLayoutChange || isWriteHazard || isReadHazard || isAliased)
+            {
+                RenderBarrier barrier;
+                barrier.resource = r.resource;
+                barrier.srcStage = srcStage;
+                barrier.dstStage = usage.stage;
+                barrier.srcAccess = srcAccess;
+                barrier.dstAccess = usage.access;
+                // Content of transient resources is undefined before their first use
+                barrier.oldLayout = state.isUsed || resource.isImported ? state.layout : vk::ImageLayout::eUndefined;
+                barrier.newLayout = usage.layout;
+                m_schedule.passBarriers[step].push_back(barrier);
+            }
+
+            state.isUsed = true;
+            state.layout = usage.layout;
+            if (usage.isWrite)
+            {
+                state.writeStage = usage.stage;
+                state.writeAccess = usage.access;
+                state.readStages = vk::PipelineStageFlags();
+                state.visibleStages = vk::PipelineStageFlags();
+            }
+            else
+            {
+                state.readStages |= usage.stage;
+                state.visibleStages |= usage.stage;
+            }
+        }
+    }
+
+    // Leave imported images in the layout the owner expects
+    m_schedule.finalBarriers.clear();
+    for (RenderResourceId r = 0; r < m_resources.size(); r++)
+    {
+        const Resource& resource = m_resources[r];
+        if (!resource.isImported
+            || resource.desc.isBuffer
+            || resource.finalLayout == vk::ImageLayout::eUndefined
+            || resource.finalLayout == states[r].layout)
+            continue;
+
+        RenderBarrier barrier;
+        barrier.resource = r;
+        barrier.srcStage = states[r].writeStage | states[r].readStages;
+        barrier.dstStage = vk::PipelineStageFlagBits::eBottomOfPipe;
+        barrier.srcAccess = states[r].writeAccess;
+        barrier.oldLayout = states[r].layout;
+        barrier.newLayout = resource.finalLayout;
+        m_schedule.finalBarriers.push_back(barrier);
+    }
+}
+
+bool engine::vulkan::RenderGraph::compile()
+{
+    for (const Pass& pass : m_passes)
+    {
+        for (const RenderPassResource& r : pass.resources)
+        {
+            if (r.resource >= m_resources.size())
+            {
+                std::cerr << "Render graph error: Pass " << pass.name << " uses an unknown resource" << std::endl;
+                return false;
+            }
+        }
+    }
+
+    m_schedule = RenderGraphSchedule();
+    cullPasses();
+    computeAliasing();
+    computeBarriers();
+
+    m_isCompiled = true;
+    return true;
+}
+
+void engine::vulkan::RenderGraph::setImage(RenderResourceId resource, const vk::Image& image)
+{
+    if (resource < m_resources.size())
+        m_resources[resource].image = image;
+}
+
+void engine::vulkan::RenderGraph::setBuffer(RenderResourceId resource, const vk::Buffer& buffer)
+{
+    if (resource < m_resources.size())
+        m_resources[resource].buffer = buffer;
+}
+
+vk::Image engine::vulkan::RenderGraph::getImage(RenderResourceId resource) const
+{
+    return resource < m_resources.size() ? m_resources[resource].image : nullptr;
+}
+
+vk::Buffer engine::vulkan::RenderGraph::getBuffer(RenderResourceId resource) const
+{
+    return resource < m_resources.size() ? m_resources[resource].buffer : nullptr;
+}
+
+bool engine::vulkan::RenderGraph::createTransientResources(const vk::Device& device, MemoryAllocator& allocator)
+{
+    if (!m_isCompiled && !compile())
+        return false;
+
+    destroy();
+    m_device = device;
+    m_allocator = &allocator;
+
+    // Buffers and optimal images share the aliased memory, so every resource
+    // is kept bufferImageGranularity apart
+    vk::DeviceSize granularity = allocator.getBufferImageGranularity();
+    uint32_t memoryTypeBits = ~0u;
+    vk::DeviceSize maxAlignment = 1;
+
+    try
+    {
+        for (RenderResourceId r = 0; r < m_resources.size(); r++)
+        {
+            Resource& resource = m_resources[r];
+            if (resource.isImported || m_schedule.memoryOffsets[r] == std::numeric_limits<vk::DeviceSize>::max())
+                continue;
+
+            vk::MemoryRequirements requirements;
+            if (resource.desc.isBuffer)
+            {
+                resource.buffer = device.createBuffer(vk::BufferCreateInfo(vk::BufferCreateFlags(),
+                    resource.desc.size,
+                    resource.desc.bufferUsage));
+                requirements = device.getBufferMemoryRequirements(resource.buffer);
+            }
+            else
+            {
+                resource.image = device.createImage(vk::ImageCreateInfo(vk::ImageCreateFlags(),
+                    vk::ImageType::e2D,
+                    resource.desc.format,
+                    vk::Extent3D(resource.desc.extent, 1),
+                    1,
+                    1,
+                    vk::SampleCountFlagBits::e1,
+                    vk::ImageTiling::eOptimal,
+                    resource.desc.imageUsage));
+                requirements = device.getImageMemoryRequirements(resource.image);
+            }
+
+            resource.desc.size = requirements.size;
+            resource.desc.alignment = std::max(requirements.alignment, granularity);
+            memoryTypeBits &= requirements.memoryTypeBits;
+            maxAlignment = std::max(maxAlignment, resource.desc.alignment);
+        }
+    }
+    catch (...)
+    {
+        handleVulkanException();
+        destroy();
+        return false;
+    }
+
+    // Place the resources again with their real sizes. The aliasing barriers
+    // depend on which resources share memory, so they are computed again too.
+    computeAliasing();
+    computeBarriers();
+
+    if (m_schedule.transientMemorySize == 0)
+        return true;
+
+    m_transientMemory = allocator.allocate(vk::MemoryRequirements(m_schedule.transientMemorySize, maxAlignment, memoryTypeBits),
+        vk::MemoryPropertyFlagBits::eDeviceLocal,
+        MemoryResourceType::Optimal);
+    if (!m_transientMemory.isValid())
+    {
+        destroy();
+        return false;
+    }
+
+    for (RenderResourceId r = 0; r < m_resources.size(); r++)
+    {
+        Resource& resource = m_resources[r];
+        if (resource.isImported)
+            continue;
+        vk::DeviceSize offset = m_transientMemory.offset + m_schedule.memoryOffsets[r];
+        if (resource.buffer)
+            device.bindBufferMemory(resource.buffer, m_transientMemory.memory, offset);
+        if (resource.image)
+            device.bindImageMemory(resource.image, m_transientMemory.memory, offset);
+    }
+
+    return true;
+}
+
+void engine::vulkan::RenderGraph::execute(const vk::CommandBuffer& cmdBuffer) const
+{
+    auto recordBarriers = [&](const vector<RenderBarrier>& barriers)
+    {
+        if (barriers.empty())
+            return;
+
+        vk::PipelineStageFlags srcStage;
+        vk::PipelineStageFlags dstStage;
+        vector<vk::ImageMemoryBarrier> imageBarriers;
+        vector<vk::BufferMemoryBarrier> bufferBarriers;
+        for (const RenderBarrier& b : barriers)
+        {
+            const Resource& resource = m_resources[b.resource];
+            srcStage |= b.srcStage;
+            dstStage |= b.dstStage;
+            if (resource.desc.isBuffer)
+            {
+                bufferBarriers.push_back(vk::BufferMemoryBarrier(b.srcAccess,
+                    b.dstAccess,
+                    VK_QUEUE_FAMILY_IGNORED,
+                    VK_QUEUE_FAMILY_IGNORED,
+                    resource.buffer,
+                    0,
+                    VK_WHOLE_SIZE));
+            }
+            else
+            {
+                vk::ImageAspectFlags aspect = vk::ImageAspectFlagBits::eColor;
+                if (isDepthFormat(resource.desc.format))
+                {
+                    aspect = vk::ImageAspectFlagBits::eDepth;
+                    if (hasStencil(resource.desc.format))
+                        aspect |= vk::ImageAspectFlagBits::eStencil;
+                }
+                imageBarriers.push_back(vk::ImageMemoryBarrier(b.srcAccess,
+                    b.dstAccess,
+                    b.oldLayout,
+                    b.newLayout,
+                    VK_QUEUE_FAMILY_IGNORED,
+                    VK_QUEUE_FAMILY_IGNORED,
+                    resource.image,
+                    vk::ImageSubresourceRange(aspect, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS)));
+            }
+        }
+
+        // Nothing to wait for (Eg: first use), only the layout transition remains
+        if (!srcStage)
+            srcStage = vk::PipelineStageFlagBits::eTopOfPipe;
+
+        cmdBuffer.pipelineBarrier(srcStage, dstStage, vk::DependencyFlags(), {}, bufferBarriers, imageBarriers);
+    };
+
+    for (size_t step = 0; step < m_schedule.passOrder.size(); step++)
+    {
+        recordBarriers(m_schedule.passBarriers[step]);
+        const Pass& pass = m_passes[m_schedule.passOrder[step]];
+        if (pass.execute)
+            pass.execute(cmdBuffer, *this);
+    }
+
+    recordBarriers(m_schedule.finalBarriers);
+}
+
+bool engine::vulkan::RenderGraph::destroy()
+{
+    if (!m_device)
+        return true;
+
+    for (Resource& resource : m_resources)
+    {
+        if (resource.isImported)
+            continue;
+        if (resource.image)
+            m_device.destroyImage(resource.image);
+        if (resource.buffer)
+            m_device.destroyBuffer(resource.buffer);
+        resource.image = nullptr;
+        resource.buffer = nullptr;
+    }
+
+    if (m_allocator)
+        m_allocator->free(m_transientMemory);
+
+    return true;
+}
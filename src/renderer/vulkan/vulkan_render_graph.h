@@ -0,0 +1,223 @@
+#ifndef VULKAN_RENDER_GRAPH_H
+#define VULKAN_RENDER_GRAPH_H
+
+#include <functional>
+#include <string>
+
+#include "vulkan_utils.h"
+#include "vulkan_memory.h"
+
+namespace engine
+{
+    namespace vulkan
+    {
+        using RenderResourceId = uint32_t;
+        static const RenderResourceId INVALID_RENDER_RESOURCE = std::numeric_limits<uint32_t>::max();
+
+        /**
+         * @brief How a pass uses a resource. Each usage maps to an image layout,
+         * pipeline stages and access flags which are used to compute barriers.
+         * Attachments and storage writes also read the previous contents (Eg:
+         * load ops, blending, atomics), so the passes writing those contents
+         * before are kept. Only TransferDst overwrites without reading.
+         */
+        enum class RenderResourceUsage
+        {
+            ColorAttachment,
+            DepthAttachment,
+            DepthRead,
+            Sampled,
+            StorageRead,
+            StorageWrite,
+            IndirectRead,
+            TransferSrc,
+            TransferDst,
+            Present
+        };
+
+        /**
+         * @brief Description of an image or buffer used by the render graph
+         *
+         * @param isBuffer Buffers don't have a layout, only memory dependencies
+         * @param size Memory size in bytes. If 0 for images it's estimated from
+         * the format and extent until real memory requirements are known
+         * @param alignment Required memory alignment
+         */
+        struct RenderResourceDesc
+        {
+            bool isBuffer = false;
+            vk::Format format = vk::Format::eUndefined;
+            vk::Extent2D extent;
+            vk::ImageUsageFlags imageUsage;
+            vk::BufferUsageFlags bufferUsage;
+            vk::DeviceSize size = 0;
+            vk::DeviceSize alignment = 256;
+        };
+
+        struct RenderPassResource
+        {
+            RenderResourceId resource;
+            RenderResourceUsage usage;
+        };
+
+        class RenderGraph;
+        using RenderPassExecuteFunc = std::function<void(const vk::CommandBuffer& cmdBuffer, const RenderGraph& graph)>;
+
+        /**
+         * @brief A pipeline barrier for one resource, recorded before a pass
+         */
+        struct RenderBarrier
+        {
+            RenderResourceId resource;
+            vk::PipelineStageFlags srcStage;
+            vk::PipelineStageFlags dstStage;
+            vk::AccessFlags srcAccess;
+            vk::AccessFlags dstAccess;
+            vk::ImageLayout oldLayout = vk::ImageLayout::eUndefined;
+            vk::ImageLayout newLayout = vk::ImageLayout::eUndefined;
+        };
+
+        /**
+         * @brief Result of RenderGraph::compile()
+         *
+         * @param passOrder Indices of the passes which are executed, in order
+         * @param passBarriers Barriers recorded before each pass in passOrder
+         * @param finalBarriers Barriers moving imported resources to their final layout
+         * @param isPassCulled Whether each declared pass was removed as unused
+         * @param memoryOffsets Offset of each transient resource in the aliased memory
+         * @param transientMemorySize Memory needed by transient resources with aliasing
+         * @param unaliasedMemorySize Memory the transient resources would need without aliasing
+         */
+        struct RenderGraphSchedule
+        {
+            vector<uint32_t> passOrder;
+            vector<vector<RenderBarrier>> passBarriers;
+            vector<RenderBarrier> finalBarriers;
+            vector<bool> isPassCulled;
+            vector<vk::DeviceSize> memoryOffsets;
+            vk::DeviceSize transientMemorySize = 0;
+            vk::DeviceSize unaliasedMemorySize = 0;
+
+            inline uint32_t getBarrierCount() const
+            {
+                size_t count = finalBarriers.size();
+                for (const vector<RenderBarrier>& b : passBarriers)
+                    count += b.size();
+                return static_cast<uint32_t>(count);
+            }
+        };
+
+        /**
+         * @brief Declarative frame graph. Passes declare which resources they
+         * read and write, then compile() removes passes whose results are never
+         * used, computes the barriers and layout transitions between passes and
+         * places transient resources with non overlapping lifetimes in the same
+         * memory. compile() doesn't touch the device, only
+         * createTransientResources() and execute() do.
+         */
+        class RenderGraph
+        {
+        private:
+            struct Resource
+            {
+                std::string name;
+                RenderResourceDesc desc;
+                bool isImported = false;
+                vk::ImageLayout initialLayout = vk::ImageLayout::eUndefined;
+                vk::ImageLayout finalLayout = vk::ImageLayout::eUndefined;
+
+                vk::Image image;
+                vk::Buffer buffer;
+            };
+
+            struct Pass
+            {
+                std::string name;
+                vector<RenderPassResource> resources;
+                RenderPassExecuteFunc execute;
+                bool hasSideEffects = false;
+            };
+
+            vector<Resource> m_resources;
+            vector<Pass> m_passes;
+            RenderGraphSchedule m_schedule;
+            bool m_isCompiled = false;
+
+            // Transient resources created by createTransientResources()
+            vk::Device m_device;
+            MemoryAllocator* m_allocator = nullptr;
+            MemoryAllocation m_transientMemory;
+
+            void cullPasses();
+            void computeAliasing();
+            void computeBarriers();
+
+        public:
+            RenderGraph() = default;
+            RenderGraph(const RenderGraph&) = delete;
+            RenderGraph& operator=(const RenderGraph&) = delete;
+
+            // Transient resource owned by the graph, its memory may be aliased
+            RenderResourceId createResource(const std::string& name, const RenderResourceDesc& desc);
+
+            /**
+             * @brief Adds a resource owned outside the graph (Eg: swapchain image).
+             * Passes writing to imported resources are never culled.
+             *
+             * @param initialLayout Layout the image is in when the graph starts
+             * @param finalLayout Layout the image has to be left in (Eg: ePresentSrcKHR)
+             */
+            RenderResourceId importResource(const std::string& name,
+                const RenderResourceDesc& desc,
+                vk::ImageLayout initialLayout = vk::ImageLayout::eUndefined,
+                vk::ImageLayout finalLayout = vk::ImageLayout::eUndefined);
+
+            /**
+             * @brief Declares a pass. Passes are executed in declaration order.
+             *
+             * @param name Name of the pass
+             * @param resources Resources the pass reads or writes and how
+             * @param execute Records the pass commands
+             * @param hasSideEffects Never cull the pass even if nothing reads its outputs
+             * @return index of the pass
+             */
+            uint32_t addPass(const std::string& name,
+                const vector<RenderPassResource>& resources,
+                RenderPassExecuteFunc execute,
+                bool hasSideEffects = false);
+
+            bool compile();
+
+            inline const RenderGraphSchedule& getSchedule() const
+            {
+                return m_schedule;
+            }
+
+            // Sets the handle of an imported resource for this frame
+            void setImage(RenderResourceId resource, const vk::Image& image);
+            void setBuffer(RenderResourceId resource, const vk::Buffer& buffer);
+
+            vk::Image getImage(RenderResourceId resource) const;
+            vk::Buffer getBuffer(RenderResourceId resource) const;
+
+            /**
+             * @brief Creates the transient images and buffers and binds them to
+             * one aliased memory allocation. Updates the schedule with the real
+             * memory requirements.
+             *
+             * @param device Vulkan logical device object
+             * @param allocator Allocator the aliased memory is taken from
+             * @return true if all resources were created
+             * @return false if creation fails
+             */
+            bool createTransientResources(const vk::Device& device, MemoryAllocator& allocator);
+
+            // Records the compiled passes and their barriers
+            void execute(const vk::CommandBuffer& cmdBuffer) const;
+
+            bool destroy();
+        };
+    }
+}
+
+#endif
@@ -0,0 +1,201 @@
+#include "vulkan_resources.h"
+
+bool engine::vulkan::ResourceRegistry::init(const vk::Device& device,
+    MemoryAllocator& allocator,
+    DeletionQueue& deletionQueue)
+{
+    m_device = device;
+    m_allocator = &allocator;
+    m_deletionQueue = &deletionQueue;
+    return m_device ? true : false;
+}
+
+engine::vulkan::BufferHandle engine::vulkan::ResourceRegistry::createBuffer(vk::DeviceSize size,
+    vk::BufferUsageFlags usage,
+    vk::MemoryPropertyFlags memoryProperties)
+{
+    BufferResource buffer;
+    buffer.size = size;
+    buffer.usage = usage;
+    try
+    {
+        buffer.buffer = m_device.createBuffer(vk::BufferCreateInfo(vk::BufferCreateFlags(), size, usage));
+        buffer.allocation = m_allocator->allocateForBuffer(buffer.buffer, memoryProperties);
+    }
+    catch (...)
+    {
+        handleVulkanException();
+    }
+
+    if (!buffer.allocation.isValid())
+    {
+        destroyBuffer(buffer);
+        return BufferHandle();
+    }
+    return m_buffers.create(buffer);
+}
+
+engine::vulkan::ImageHandle engine::vulkan::ResourceRegistry::createImage(const ImageDesc& desc)
+{
+    ImageResource image;
+    image.format = desc.format;
+    image.extent = vk::Extent3D(desc.extent, 1);
+    image.mipLevels = std::max(desc.mipLevels, 1u);
+    image.usage = desc.usage;
+    try
+    {
+        image.image = m_device.createImage(vk::ImageCreateInfo(vk::ImageCreateFlags(),
+            vk::ImageType::e2D,
+            image.format,
+            image.extent,
+            image.mipLevels,
+            1,
+            vk::SampleCountFlagBits::e1,
+            vk::ImageTiling::eOptimal,
+            image.usage));
+        image.allocation = m_allocator->allocateForImage(image.image, desc.memoryProperties);
+
+        const vk::ImageUsageFlags viewUsage = vk::ImageUsageFlagBits::eSampled
+            | vk::ImageUsageFlagBits::eStorage
+            | vk::ImageUsageFlagBits::eColorAttachment
+            | vk::ImageUsageFlagBits::eDepthStencilAttachment
+            | vk::ImageUsageFlagBits::eInputAttachment;
+        if (image.allocation.isValid() && (image.usage & viewUsage))
+        {
+            image.view = m_device.createImageView(vk::ImageViewCreateInfo(vk::ImageViewCreateFlags(),
+                image.image,
+                vk::ImageViewType::e2D,
+                image.format,
+                vk::ComponentMapping(),
+                vk::ImageSubresourceRange(desc.aspect, 0, image.mipLevels, 0, 1)));
+        }
+    }
+    catch (...)
+    {
+        handleVulkanException();
+        destroyImage(image);
+        return ImageHandle();
+    }
+
+    if (!image.allocation.isValid())
+    {
+        destroyImage(image);
+        return ImageHandle();
+    }
+    return m_images.create(image);
+}
+
+engine::vulkan::SamplerHandle engine::vulkan::ResourceRegistry::createSampler(const vk::SamplerCreateInfo& createInfo)
+{
+    try
+    {
+        return m_samplers.create(m_device.createSampler(createInfo));
+    }
+    catch (...)
+    {
+        handleVulkanException();
+        return SamplerHandle();
+    }
+}
+
+engine::vulkan::PipelineHandle engine::vulkan::ResourceRegistry::addPipeline(const vk::Pipeline& pipeline,
+    const vk::PipelineLayout& layout,
+    vk::PipelineBindPoint bindPoint)
+{
+    if (!pipeline)
+        return PipelineHandle();
+
+    PipelineResource resource;
+    resource.pipeline = pipeline;
+    resource.layout = layout;
+    resource.bindPoint = bindPoint;
+    return m_pipelines.create(resource);
+}
+
+void engine::vulkan::ResourceRegistry::destroyBuffer(BufferResource& buffer)
+{
+    if (buffer.buffer)
+        m_device.destroyBuffer(buffer.buffer);
+    m_allocator->free(buffer.allocation);
+    buffer = BufferResource();
+}
+
+void engine::vulkan::ResourceRegistry::destroyImage(ImageResource& image)
+{
+    if (image.view)
+        m_device.destroyImageView(image.view);
+    if (image.image)
+        m_device.destroyImage(image.image);
+    m_allocator->free(image.allocation);
+    image = ImageResource();
+}
+
+void engine::vulkan::ResourceRegistry::destroyPipeline(PipelineResource& pipeline)
+{
+    if (pipeline.pipeline)
+        m_device.destroyPipeline(pipeline.pipeline);
+    if (pipeline.layout)
+        m_device.destroyPipelineLayout(pipeline.layout);
+    pipeline = PipelineResource();
+}
+
+bool engine::vulkan::ResourceRegistry::release(BufferHandle handle, uint64_t timelineValue)
+{
+    BufferResource buffer;
+    if (!m_buffers.remove(handle, &buffer))
+        return false;
+    m_deletionQueue->push(timelineValue, [this, buffer]() mutable
+        { destroyBuffer(buffer); });
+    return true;
+}
+
+bool engine::vulkan::ResourceRegistry::release(ImageHandle handle, uint64_t timelineValue)
+{
+    ImageResource image;
+    if (!m_images.remove(handle, &image))
+        return false;
+    m_deletionQueue->push(timelineValue, [this, image]() mutable
+        { destroyImage(image); });
+    return true;
+}
+
+bool engine::vulkan::ResourceRegistry::release(SamplerHandle handle, uint64_t timelineValue)
+{
+    vk::Sampler sampler;
+    if (!m_samplers.remove(handle, &sampler))
+        return false;
+    m_deletionQueue->destroy(timelineValue, m_device, sampler);
+    return true;
+}
+
+bool engine::vulkan::ResourceRegistry::release(PipelineHandle handle, uint64_t timelineValue)
+{
+    PipelineResource pipeline;
+    if (!m_pipelines.remove(handle, &pipeline))
+        return false;
+    m_deletionQueue->push(timelineValue, [this, pipeline]() mutable
+        { destroyPipeline(pipeline); });
+    return true;
+}
+
+bool engine::vulkan::ResourceRegistry::destroy()
+{
+    if (!m_device)
+        return true;
+
+    for (BufferResource& buffer : m_buffers)
+        destroyBuffer(buffer);
+    m_buffers.clear();
+    for (ImageResource& image : m_images)
+        destroyImage(image);
+    m_images.clear();
+    for (vk::Sampler& sampler : m_samplers)
+        m_device.destroySampler(sampler);
+    m_samplers.clear();
+    for (PipelineResource& pipeline : m_pipelines)
+        destroyPipeline(pipeline);
+    m_pipelines.clear();
+
+    m_device = nullptr;
+    return true;
+}
@@ -0,0 +1,170 @@
+#ifndef VULKAN_RESOURCES_H
+#define VULKAN_RESOURCES_H
+
+#include "vulkan_utils.h"
+#include "vulkan_memory.h"
+#include "vulkan_deletion_queue.h"
+#include "core/handle_pool.h"
+
+namespace engine
+{
+    namespace vulkan
+    {
+        struct BufferResource
+        {
+            vk::Buffer buffer;
+            MemoryAllocation allocation;
+            vk::DeviceSize size = 0;
+            vk::BufferUsageFlags usage;
+        };
+
+        struct ImageResource
+        {
+            vk::Image image;
+            // View of every mip level, null for images without view usage
+            vk::ImageView view;
+            MemoryAllocation allocation;
+            vk::Format format = vk::Format::eUndefined;
+            vk::Extent3D extent;
+            uint32_t mipLevels = 1;
+            vk::ImageUsageFlags usage;
+        };
+
+        struct PipelineResource
+        {
+            vk::Pipeline pipeline;
+            vk::PipelineLayout layout;
+            vk::PipelineBindPoint bindPoint = vk::PipelineBindPoint::eGraphics;
+        };
+
+        using BufferHandle = Handle<BufferResource>;
+        using ImageHandle = Handle<ImageResource>;
+        using SamplerHandle = Handle<vk::Sampler>;
+        using PipelineHandle = Handle<PipelineResource>;
+
+        /**
+         * @brief Description of a 2D image created by ResourceRegistry
+         *
+         * @param aspect Aspect of the view. Eg: eDepth for depth images
+         */
+        struct ImageDesc
+        {
+            vk::Format format = vk::Format::eR8G8B8A8Unorm;
+            vk::Extent2D extent;
+            uint32_t mipLevels = 1;
+            vk::ImageUsageFlags usage = vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst;
+            vk::ImageAspectFlags aspect = vk::ImageAspectFlagBits::eColor;
+            vk::MemoryPropertyFlags memoryProperties = vk::MemoryPropertyFlagBits::eDeviceLocal;
+        };
+
+        /**
+         * @brief Owns the long lived GPU resources of the renderer and hands out
+         * generational handles to them, so that the rest of the engine never
+         * keeps raw Vulkan handles which may already be destroyed. Resources of
+         * each type are stored packed in a HandlePool. Using a released handle
+         * returns nullptr instead of a dangling object.
+         *
+         * Released resources are destroyed through the deletion queue once the
+         * GPU has reached the given timeline value. Not thread safe, used from
+         * the render thread.
+         */
+        class ResourceRegistry
+        {
+        private:
+            vk::Device m_device;
+            MemoryAllocator* m_allocator = nullptr;
+            DeletionQueue* m_deletionQueue = nullptr;
+
+            HandlePool<BufferResource> m_buffers;
+            HandlePool<ImageResource> m_images;
+            HandlePool<vk::Sampler> m_samplers;
+            HandlePool<PipelineResource> m_pipelines;
+
+            void destroyBuffer(BufferResource& buffer);
+            void destroyImage(ImageResource& image);
+            void destroyPipeline(PipelineResource& pipeline);
+
+        public:
+            ResourceRegistry() = default;
+            ResourceRegistry(const ResourceRegistry&) = delete;
+            ResourceRegistry& operator=(const ResourceRegistry&) = delete;
+
+            /**
+             * @param device Vulkan logical device object
+             * @param allocator Allocator the buffer and image memory comes from
+             * @param deletionQueue Queue released resources are destroyed through
+             * @return true if initialization is successful
+             */
+            bool init(const vk::Device& device, MemoryAllocator& allocator, DeletionQueue& deletionQueue);
+
+            /**
+             * @brief Creates a buffer and binds memory to it
+             *
+             * @param size Size in bytes
+             * @param usage Buffer usage
+             * @param memoryProperties Memory properties (Eg: eHostVisible for mapped buffers)
+             * @return handle of the buffer, invalid if creation fails
+             */
+            BufferHandle createBuffer(vk::DeviceSize size,
+                vk::BufferUsageFlags usage,
+                vk::MemoryPropertyFlags memoryProperties = vk::MemoryPropertyFlagBits::eDeviceLocal);
+            // Creates a 2D image, its memory and a view if the usage needs one
+            ImageHandle createImage(const ImageDesc& desc);
+            SamplerHandle createSampler(const vk::SamplerCreateInfo& createInfo);
+            // Takes ownership of a pipeline and its layout
+            PipelineHandle addPipeline(const vk::Pipeline& pipeline,
+                const vk::PipelineLayout& layout,
+                vk::PipelineBindPoint bindPoint = vk::PipelineBindPoint::eGraphics);
+
+            // Return nullptr if the handle is stale
+            inline const BufferResource* get(BufferHandle handle) const
+            {
+                return m_buffers.get(handle);
+            }
+
+            inline const ImageResource* get(ImageHandle handle) const
+            {
+                return m_images.get(handle);
+            }
+
+            inline const vk::Sampler* get(SamplerHandle handle) const
+            {
+                return m_samplers.get(handle);
+            }
+
+            inline const PipelineResource* get(PipelineHandle handle) const
+            {
+                return m_pipelines.get(handle);
+            }
+
+            /**
+             * @brief Invalidates the handle right away and destroys the resource
+             * once the GPU is done with it
+             *
+             * @param handle Handle of the resource
+             * @param timelineValue Graphics timeline value of the last submit using it
+             * @return false if the handle is stale
+             */
+            bool release(BufferHandle handle, uint64_t timelineValue);
+            bool release(ImageHandle handle, uint64_t timelineValue);
+            bool release(SamplerHandle handle, uint64_t timelineValue);
+            bool release(PipelineHandle handle, uint64_t timelineValue);
+
+            // Live resources, stored contiguously
+            inline const HandlePool<BufferResource>& getBuffers() const
+            {
+                return m_buffers;
+            }
+
+            inline const HandlePool<ImageResource>& getImages() const
+            {
+                return m_images;
+            }
+
+            // Destroys every live resource. The device must be idle.
+            bool destroy();
+        };
+    }
+}
+
+#endif
@@ -0,0 +1,400 @@
+#include <cstring>
+
+#include "vulkan_upload.h"
+#include "vulkan_functions.h"
+
+bool engine::vulkan::UploadService::init(const vk::Device& device,
+    const QueueFamilyIndices& queueFamilyIndices,
+    MemoryAllocator& allocator,
+    vk::DeviceSize stagingSize,
+    std::mutex* queueMutex)
+{
+    m_device = device;
+    m_queueMutex = queueMutex;
+    m_allocator = &allocator;
+    m_queueFamilyIndices = queueFamilyIndices;
+    if (!queueFamilyIndices.isTransferSupported())
+        return false;
+
+    m_queue = device.getQueue(queueFamilyIndices.transfer, 0);
+
+    try
+    {
+        m_commandPool = device.createCommandPool(vk::CommandPoolCreateInfo(vk::CommandPoolCreateFlagBits::eResetCommandBuffer
+            | vk::CommandPoolCreateFlagBits::eTransient,
+            queueFamilyIndices.transfer));
+
+        // The staging buffer covers the whole ring, so ring offsets are buffer offsets
+        m_stagingBuffer = device.createBuffer(vk::BufferCreateInfo(vk::BufferCreateFlags(),
+            stagingSize,
+            vk::BufferUsageFlagBits::eTransferSrc));
+        vk::MemoryRequirements requirements = device.getBufferMemoryRequirements(m_stagingBuffer);
+        if (requirements.size != stagingSize)
+        {
+            device.destroyBuffer(m_stagingBuffer);
+            m_stagingBuffer = device.createBuffer(vk::BufferCreateInfo(vk::BufferCreateFlags(),
+                requirements.size,
+                vk::BufferUsageFlagBits::eTransferSrc));
+            requirements = device.getBufferMemoryRequirements(m_stagingBuffer);
+        }
+
+        m_staging = allocator.createLinearPool(requirements.memoryTypeBits,
+            vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+            requirements.size);
+        if (!m_staging.isValid())
+        {
+            std::cerr << "Upload service error: Failed to allocate staging memory" << std::endl;
+            return false;
+        }
+        device.bindBufferMemory(m_stagingBuffer, m_staging.getMemory(), 0);
+    }
+    catch (...)
+    {
+        handleVulkanException();
+        return false;
+    }
+
+    m_timeline = QueueTimeline();
+    m_timeline.semaphore = createTimelineSemaphore(device);
+
+    return m_timeline.semaphore ? true : false;
+}
+
+bool engine::vulkan::UploadService::beginBatch()
+{
+    if (m_currentBatch.cmdBuffer)
+        return true;
+
+    try
+    {
+        if (m_freeCommandBuffers.empty())
+        {
+            m_currentBatch.cmdBuffer = m_device.allocateCommandBuffers(vk::CommandBufferAllocateInfo(m_commandPool,
+                vk::CommandBufferLevel::ePrimary,
+                1))[0];
+        }
+        else
+        {
+            m_currentBatch.cmdBuffer = m_freeCommandBuffers.back();
+            m_freeCommandBuffers.pop_back();
+        }
+
+        m_currentBatch.cmdBuffer.begin(vk::CommandBufferBeginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+    }
+    catch (...)
+    {
+        handleVulkanException();
+        m_currentBatch.cmdBuffer = nullptr;
+        return false;
+    }
+
+    return true;
+}
+
+uint64_t engine::vulkan::UploadService::submitBatch()
+{
+    if (!m_currentBatch.cmdBuffer)
+        return m_timeline.submittedValue;
+
+    Batch batch = m_currentBatch;
+    m_currentBatch = Batch();
+
+    batch.cmdBuffer.end();
+    batch.timelineValue = m_timeline.getNextValue();
+    batch.stagingMarker = m_staging.getMarker();
+
+    vk::TimelineSemaphoreSubmitInfo timelineInfo;
+    timelineInfo.setSignalSemaphoreValues(batch.timelineValue);
+    vk::SubmitInfo submitInfo;
+    submitInfo.setCommandBuffers(batch.cmdBuffer)
+        .setSignalSemaphores(m_timeline.semaphore)
+        .setPNext(&timelineInfo);
+
+    try
+    {
+        // Uploads can be submitted from any thread once the staging ring is full
+        std::unique_lock<std::mutex> queueLock;
+        if (m_queueMutex)
+            queueLock = std::unique_lock<std::mutex>(*m_queueMutex);
+        m_queue.submit(submitInfo, nullptr);
+    }
+    catch (...)
+    {
+        handleVulkanException();
+        m_freeCommandBuffers.push_back(batch.cmdBuffer);
+        m_batchBufferBarriers.clear();
+        m_batchImageBarriers.clear();
+        m_batchStages = vk::PipelineStageFlags();
+        return m_timeline.submittedValue;
+    }
+
+    m_timeline.submittedValue = batch.timelineValue;
+    m_submittedBatches.push_back(batch);
+
+    // The graphics queue can only acquire what has been released in a submitted batch
+    m_acquireBufferBarriers.insert(m_acquireBufferBarriers.end(), m_batchBufferBarriers.begin(), m_batchBufferBarriers.end());
+    m_acquireImageBarriers.insert(m_acquireImageBarriers.end(), m_batchImageBarriers.begin(), m_batchImageBarriers.end());
+    m_acquireStages |= m_batchStages;
+    m_acquireValue = m_timeline.submittedValue;
+    m_batchBufferBarriers.clear();
+    m_batchImageBarriers.clear();
+    m_batchStages = vk::PipelineStageFlags();
+
+    return m_timeline.submittedValue;
+}
+
+void engine::vulkan::UploadService::retireBatches(bool waitForOldest)
+{
+    if (m_submittedBatches.empty())
+        return;
+
+    if (waitForOldest)
+        m_timeline.wait(m_device, m_submittedBatches.front().timelineValue);
+
+    while (!m_submittedBatches.empty() && m_timeline.isReached(m_device, m_submittedBatches.front().timelineValue))
+    {
+        const Batch& batch = m_submittedBatches.front();
+        m_staging.release(batch.stagingMarker);
+        m_freeCommandBuffers.push_back(batch.cmdBuffer);
+        m_submittedBatches.pop_front();
+    }
+}
+
+engine::vulkan::MemoryAllocation engine::vulkan::UploadService::allocateStaging(vk::DeviceSize size)
+{
+    // 16 bytes covers the texel size alignment of every uncompressed format
+    const vk::MemoryRequirements requirements(size, 16, ~0u);
+    while (true)
+    {
+        MemoryAllocation allocation = m_staging.allocate(requirements);
+        if (allocation.isValid())
+            return allocation;
+
+        // Ring is full. Submit what is queued and wait for the oldest batch to
+        // give its staging memory back.
+        if (m_currentBatch.copyCount > 0)
+            submitBatch();
+        if (m_submittedBatches.empty())
+            return MemoryAllocation();
+        retireBatches(true);
+    }
+}
+
+uint64_t engine::vulkan::UploadService::uploadBuffer(const vk::Buffer& dstBuffer,
+    vk::DeviceSize dstOffset,
+    const void* data,
+    vk::DeviceSize size,
+    vk::PipelineStageFlags dstStage,
+    vk::AccessFlags dstAccess)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_timeline.semaphore || size == 0)
+        return 0;
+
+    // Large uploads are split so that they never need the whole ring at once
+    const vk::DeviceSize chunkSize = std::max<vk::DeviceSize>(m_staging.getSize() / 4, 16);
+    for (vk::DeviceSize offset = 0; offset < size; offset += chunkSize)
+    {
+        const vk::DeviceSize copySize = std::min(chunkSize, size - offset);
+        MemoryAllocation staging = allocateStaging(copySize);
+        if (!staging.isValid() || !beginBatch())
+            return 0;
+
+        std::memcpy(staging.mapped, static_cast<const char*>(data) + offset, static_cast<size_t>(copySize));
+        m_currentBatch.cmdBuffer.copyBuffer(m_stagingBuffer,
+            dstBuffer,
+            vk::BufferCopy(staging.offset, dstOffset + offset, copySize));
+        m_currentBatch.copyCount++;
+    }
+
+    // Without a separate transfer family the timeline semaphore wait already
+    // makes the writes visible to the graphics queue
+    if (m_queueFamilyIndices.hasSeparateTransfer())
+    {
+        vk::BufferMemoryBarrier release(vk::AccessFlagBits::eTransferWrite,
+            vk::AccessFlags(),
+            m_queueFamilyIndices.transfer,
+            m_queueFamilyIndices.graphics,
+            dstBuffer,
+            dstOffset,
+            size);
+        m_currentBatch.cmdBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+            vk::PipelineStageFlagBits::eBottomOfPipe,
+            vk::DependencyFlags(),
+            {},
+            release,
+            {});
+
+        vk::BufferMemoryBarrier acquire = release;
+        acquire.setSrcAccessMask(vk::AccessFlags()).setDstAccessMask(dstAccess);
+        m_batchBufferBarriers.push_back(acquire);
+        m_batchStages |= dstStage;
+    }
+
+    return m_timeline.getNextValue();
+}
+
+uint64_t engine::vulkan::UploadService::uploadImage(const vk::Image& dstImage,
+    const vk::Extent3D& extent,
+    const void* data,
+    vk::DeviceSize size,
+    vk::ImageLayout finalLayout,
+    vk::PipelineStageFlags dstStage,
+    vk::AccessFlags dstAccess)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_timeline.semaphore || size == 0)
+        return 0;
+
+    if (size > m_staging.getSize())
+    {
+        std::cerr << "Upload service error: Image of " << size << " bytes does not fit in the staging ring" << std::endl;
+        return 0;
+    }
+
+    MemoryAllocation staging = allocateStaging(size);
+    if (!staging.isValid() || !beginBatch())
+        return 0;
+    std::memcpy(staging.mapped, data, static_cast<size_t>(size));
+
+    const vk::CommandBuffer& cmdBuffer = m_currentBatch.cmdBuffer;
+    const vk::ImageSubresourceRange range(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1);
+
+    cmdBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe,
+        vk::PipelineStageFlagBits::eTransfer,
+        vk::DependencyFlags(),
+        {},
+        {},
+        vk::ImageMemoryBarrier(vk::AccessFlags(),
+            vk::AccessFlagBits::eTransferWrite,
+            vk::ImageLayout::eUndefined,
+            vk::ImageLayout::eTransferDstOptimal,
+            VK_QUEUE_FAMILY_IGNORED,
+            VK_QUEUE_FAMILY_IGNORED,
+            dstImage,
+            range));
+
+    cmdBuffer.copyBufferToImage(m_stagingBuffer,
+        dstImage,
+        vk::ImageLayout::eTransferDstOptimal,
+        vk::BufferImageCopy(staging.offset,
+            0,
+            0,
+            vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, 0, 0, 1),
+            vk::Offset3D(0, 0, 0),
+            extent));
+    m_currentBatch.copyCount++;
+
+    // The layout transition to finalLayout happens as part of the ownership
+    // transfer, it must be identical in the release and acquire barriers
+    const bool isSeparate = m_queueFamilyIndices.hasSeparateTransfer();
+    vk::ImageMemoryBarrier release(vk::AccessFlagBits::eTransferWrite,
+        vk::AccessFlags(),
+        vk::ImageLayout::eTransferDstOptimal,
+        finalLayout,
+        isSeparate ? m_queueFamilyIndices.transfer : VK_QUEUE_FAMILY_IGNORED,
+        isSeparate ? m_queueFamilyIndices.graphics : VK_QUEUE_FAMILY_IGNORED,
+        dstImage,
+        range);
+    cmdBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+        vk::PipelineStageFlagBits::eBottomOfPipe,
+        vk::DependencyFlags(),
+        {},
+        {},
+        release);
+
+    if (isSeparate)
+    {
+        vk::ImageMemoryBarrier acquire = release;
+        acquire.setSrcAccessMask(vk::AccessFlags()).setDstAccessMask(dstAccess);
+        m_batchImageBarriers.push_back(acquire);
+        m_batchStages |= dstStage;
+    }
+
+    return m_timeline.getNextValue();
+}
+
+uint64_t engine::vulkan::UploadService::flush()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_currentBatch.copyCount > 0)
+        submitBatch();
+    retireBatches(false);
+
+    return m_timeline.submittedValue;
+}
+
+uint64_t engine::vulkan::UploadService::recordAcquireBarriers(const vk::CommandBuffer& cmdBuffer)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    const uint64_t value = m_acquireValue;
+    m_acquireValue = 0;
+
+    if (m_acquireBufferBarriers.empty() && m_acquireImageBarriers.empty())
+        return value;
+
+    // Chained to the semaphore wait, which waits at eAllCommands
+    cmdBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eAllCommands,
+        m_acquireStages,
+        vk::DependencyFlags(),
+        {},
+        m_acquireBufferBarriers,
+        m_acquireImageBarriers);
+
+    m_acquireBufferBarriers.clear();
+    m_acquireImageBarriers.clear();
+    m_acquireStages = vk::PipelineStageFlags();
+
+    return value;
+}
+
+bool engine::vulkan::UploadService::isComplete(uint64_t value)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_timeline.semaphore)
+        return false;
+    return m_timeline.isReached(m_device, value);
+}
+
+void engine::vulkan::UploadService::wait(uint64_t value)
+{
+    // Waits without the lock so that other threads can keep uploading
+    vk::Semaphore semaphore;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        semaphore = m_timeline.semaphore;
+    }
+    if (!semaphore)
+        return;
+    VK_HANDLE_RESULT(m_device.waitSemaphores(vk::SemaphoreWaitInfo().setSemaphores(semaphore).setValues(value),
+        std::numeric_limits<uint64_t>::max()));
+}
+
+bool engine::vulkan::UploadService::destroy()
+{
+    if (!m_device)
+        return true;
+
+    m_timeline.destroy(m_device);
+
+    m_currentBatch = Batch();
+    m_submittedBatches.clear();
+    m_freeCommandBuffers.clear();
+    m_acquireBufferBarriers.clear();
+    m_acquireImageBarriers.clear();
+    m_batchBufferBarriers.clear();
+    m_batchImageBarriers.clear();
+
+    // Destroying the pool frees its command buffers
+    if (m_commandPool)
+        m_device.destroyCommandPool(m_commandPool);
+    m_commandPool = nullptr;
+    if (m_stagingBuffer)
+        m_device.destroyBuffer(m_stagingBuffer);
+    m_stagingBuffer = nullptr;
+    if (m_allocator)
+        m_allocator->destroyLinearPool(m_staging);
+
+    return true;
+}
@@ -0,0 +1,176 @@
+#ifndef VULKAN_UPLOAD_H
+#define VULKAN_UPLOAD_H
+
+#include <deque>
+#include <mutex>
+
+#include "vulkan_utils.h"
+#include "vulkan_memory.h"
+
+namespace engine
+{
+    namespace vulkan
+    {
+        // Size of the persistently mapped staging ring used for uploads
+        static const vk::DeviceSize DEFAULT_STAGING_SIZE = 32 * 1024 * 1024;
+
+        /**
+         * @brief Uploads buffer and image data on the transfer queue without
+         * stalling the frame loop. Data is copied into a persistently mapped
+         * staging ring and the copies are batched into one command buffer until
+         * flush(), so many small uploads cost a single submit. Every submit
+         * signals a timeline semaphore value which tells when the uploads of
+         * the batch are done and when their staging memory can be reused.
+         *
+         * With a separate transfer queue family the uploaded resources are
+         * released to the graphics family, and recordAcquireBarriers() records
+         * the matching acquire on the graphics queue. Thread safe. When the
+         * device has no transfer capable family besides graphics the queue is
+         * shared with the renderer, and every submit locks the queue mutex
+         * passed to init().
+         */
+        class UploadService
+        {
+        private:
+            struct Batch
+            {
+                vk::CommandBuffer cmdBuffer;
+                uint64_t timelineValue = 0;
+                // Staging memory allocated up to this batch
+                uint64_t stagingMarker = 0;
+                uint32_t copyCount = 0;
+            };
+
+            vk::Device m_device;
+            MemoryAllocator* m_allocator = nullptr;
+            QueueFamilyIndices m_queueFamilyIndices;
+            vk::Queue m_queue;
+            // Guards m_queue when other threads submit to it too, can be null
+            std::mutex* m_queueMutex = nullptr;
+            vk::CommandPool m_commandPool;
+            vector<vk::CommandBuffer> m_freeCommandBuffers;
+
+            LinearMemoryPool m_staging;
+            vk::Buffer m_stagingBuffer;
+
+            QueueTimeline m_timeline;
+
+            Batch m_currentBatch;
+            std::deque<Batch> m_submittedBatches;
+
+            // Acquire half of the ownership transfers of submitted batches, not
+            // yet recorded on the graphics queue
+            vector<vk::BufferMemoryBarrier> m_acquireBufferBarriers;
+            vector<vk::ImageMemoryBarrier> m_acquireImageBarriers;
+            vk::PipelineStageFlags m_acquireStages;
+            // Last submitted value the graphics queue hasn't been told to wait for
+            uint64_t m_acquireValue = 0;
+            vector<vk::BufferMemoryBarrier> m_batchBufferBarriers;
+            vector<vk::ImageMemoryBarrier> m_batchImageBarriers;
+            vk::PipelineStageFlags m_batchStages;
+
+            std::mutex m_mutex;
+
+            bool beginBatch();
+            uint64_t submitBatch();
+            void retireBatches(bool waitForOldest);
+            MemoryAllocation allocateStaging(vk::DeviceSize size);
+
+        public:
+            UploadService() = default;
+            UploadService(const UploadService&) = delete;
+            UploadService& operator=(const UploadService&) = delete;
+
+            /**
+             * @brief Creates the staging ring, command pool and timeline semaphore
+             *
+             * @param device Vulkan logical device object
+             * @param queueFamilyIndices Queue families, uploads run on the transfer family
+             * @param allocator Allocator the staging ring is created from
+             * @param stagingSize Size of the staging ring. Uploads are split in
+             * chunks so it only bounds how much data is in flight.
+             * @param queueMutex Locked around every submit, required if the
+             * transfer queue is also used by other threads (Eg: the renderer
+             * when transfer and graphics families are the same)
+             * @return true if initialization is successful
+             * @return false if initialization fails
+             */
+            bool init(const vk::Device& device,
+                const QueueFamilyIndices& queueFamilyIndices,
+                MemoryAllocator& allocator,
+                vk::DeviceSize stagingSize = DEFAULT_STAGING_SIZE,
+                std::mutex* queueMutex = nullptr);
+
+            /**
+             * @brief Queues a copy of data into a buffer. The data is copied to the
+             * staging ring right away, so it can be freed when the call returns.
+             *
+             * @param dstBuffer Buffer created with eTransferDst usage
+             * @param dstOffset Offset in the buffer
+             * @param data Data to upload
+             * @param size Size of the data in bytes
+             * @param dstStage Stages of the graphics queue which use the buffer
+             * @param dstAccess How the graphics queue accesses the buffer
+             * @return timeline value the upload is complete at, 0 if it failed
+             */
+            uint64_t uploadBuffer(const vk::Buffer& dstBuffer,
+                vk::DeviceSize dstOffset,
+                const void* data,
+                vk::DeviceSize size,
+                vk::PipelineStageFlags dstStage = vk::PipelineStageFlagBits::eVertexInput,
+                vk::AccessFlags dstAccess = vk::AccessFlagBits::eVertexAttributeRead | vk::AccessFlagBits::eIndexRead);
+
+            /**
+             * @brief Queues a copy of tightly packed texel data into the first mip
+             * level of a color image, and moves it to finalLayout
+             *
+             * @param dstImage Image created with eTransferDst usage, in undefined layout
+             * @param extent Size of the image
+             * @param data Texel data
+             * @param size Size of the data in bytes, has to fit in the staging ring
+             * @param finalLayout Layout the image is left in
+             * @param dstStage Stages of the graphics queue which use the image
+             * @param dstAccess How the graphics queue accesses the image
+             * @return timeline value the upload is complete at, 0 if it failed
+             */
+            uint64_t uploadImage(const vk::Image& dstImage,
+                const vk::Extent3D& extent,
+                const void* data,
+                vk::DeviceSize size,
+                vk::ImageLayout finalLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
+                vk::PipelineStageFlags dstStage = vk::PipelineStageFlagBits::eFragmentShader,
+                vk::AccessFlags dstAccess = vk::AccessFlagBits::eShaderRead);
+
+            /**
+             * @brief Submits the queued copies and frees the staging memory of
+             * finished batches. Called once per frame.
+             *
+             * @return timeline value all uploads so far are complete at
+             */
+            uint64_t flush();
+
+            /**
+             * @brief Records the acquire half of the ownership transfers of every
+             * flushed upload on the graphics queue. The submit of cmdBuffer has to
+             * wait on getSemaphore() for the returned value at eAllCommands.
+             *
+             * @param cmdBuffer Graphics command buffer, outside of a render pass
+             * @return timeline value to wait for, 0 if there is nothing to wait for
+             */
+            uint64_t recordAcquireBarriers(const vk::CommandBuffer& cmdBuffer);
+
+            // Checks if the uploads up to the timeline value are done, without waiting
+            bool isComplete(uint64_t value);
+            void wait(uint64_t value);
+
+            inline const vk::Semaphore& getSemaphore() const
+            {
+                return m_timeline.semaphore;
+            }
+
+            bool destroy();
+        };
+    }
+}
+
+#endif
@@ -104,6 +104,9 @@ namespace engine
         {
             uint32_t graphics = std::numeric_limits<uint32_t>::max();
             uint32_t presentation = std::numeric_limits<uint32_t>::max();
+            // Transfer only family if the device has one (Eg: DMA engine),
+            // otherwise the graphics family
+            uint32_t transfer = std::numeric_limits<uint32_t>::max();
 
             inline bool isGraphicsSupported() const
             {
@@ -115,16 +118,36 @@ namespace engine
                 return presentation != std::numeric_limits<uint32_t>::max();
             }
 
+            inline bool isTransferSupported() const
+            {
+                return transfer != std::numeric_limits<uint32_t>::max();
+            }
+
             inline bool isGraphicsAndPresentSame() const
             {
                 return graphics == presentation;
             }
 
+            // Resources written on the transfer queue then need queue family
+            // ownership transfers before the graphics queue can use them
+            inline bool hasSeparateTransfer() const
+            {
+                return isTransferSupported() && transfer != graphics;
+            }
+
             // Set is used so that each value is unique. Graphics and presenstation
-            // queue family can refer to the same thing, so this step is necessary
+            // queue family can refer to the same thing, so this step is necessary.
+            // Unsupported families (Eg: presentation in headless mode) are skipped.
             inline std::set<uint32_t> getIndices() const
             {
-                return std::set<uint32_t>({ graphics, presentation });
+                std::set<uint32_t> indices;
+                if (isGraphicsSupported())
+                    indices.insert(graphics);
+                if (isPresentationSupported())
+                    indices.insert(presentation);
+                if (isTransferSupported())
+                    indices.insert(transfer);
+                return indices;
             }
         };
 
@@ -156,6 +179,9 @@ namespace engine
             vk::Extent2D imageExtent;
             vector<vk::Image> images;
             vector<vk::ImageView> imageViews;
+            // Only used by offscreen (headless) images which are owned by us
+            // instead of the swapchain
+            vector<vk::DeviceMemory> imageMemory;
 
             bool destroy(const vk::Device& device)
             {
@@ -166,8 +192,16 @@ namespace engine
                     for (const vk::ImageView& i : imageViews)
                         device.destroyImageView(i);
                     imageViews.clear();
-                    images.clear();
                 }
+                if (imageMemory.size() > 0)
+                {
+                    for (const vk::Image& i : images)
+                        device.destroyImage(i);
+                    for (const vk::DeviceMemory& m : imageMemory)
+                        device.freeMemory(m);
+                    imageMemory.clear();
+                }
+                images.clear();
                 return true;
             }
         };
@@ -210,19 +244,23 @@ namespace engine
             }
         };
 
+        /**
+         * @brief Binary semaphores of one frame in flight. Swapchain acquire and
+         * present only work with binary semaphores, everything else is ordered
+         * with QueueTimeline values.
+         *
+         * @param timelineValue Value the graphics timeline reaches once the last
+         * submit of this frame slot has finished. 0 if the slot wasn't used yet.
+         */
         struct RenderSyncData
         {
-            vk::Fence renderFence;
             vk::Semaphore renderSemaphore;
             vk::Semaphore presentSemaphore;
+            uint64_t timelineValue = 0;
 
+            // The frame must have finished (Eg: graphics timeline waited on)
             bool destroy(const vk::Device& device)
             {
-                if (renderFence)
-                {
-                    VK_HANDLE_RESULT(device.waitForFences(renderFence, true, 1000000000));
-                    device.destroyFence(renderFence);
-                }
                 if (renderSemaphore)
                     device.destroySemaphore(renderSemaphore);
                 if (presentSemaphore)
@@ -231,11 +269,73 @@ namespace engine
             }
         };
 
+        /**
+         * @brief Timeline semaphore counting the submits of one queue. Submit n
+         * signals value n, so "has the GPU finished submit n" is a compare
+         * against the counter and other queues can wait on any submit.
+         *
+         * @param submittedValue Value signalled by the last submit
+         * @param completedValue Last value read back from the semaphore
+         */
+        struct QueueTimeline
+        {
+            vk::Semaphore semaphore;
+            uint64_t submittedValue = 0;
+            uint64_t completedValue = 0;
+
+            inline uint64_t getNextValue() const
+            {
+                return submittedValue + 1;
+            }
+
+            // Checks if the value is reached without blocking. Only asks the
+            // driver when the cached value is too old.
+            inline bool isReached(const vk::Device& device, uint64_t value)
+            {
+                if (value <= completedValue)
+                    return true;
+                completedValue = device.getSemaphoreCounterValue(semaphore);
+                return value <= completedValue;
+            }
+
+            inline void wait(const vk::Device& device, uint64_t value)
+            {
+                if (isReached(device, value))
+                    return;
+                VK_HANDLE_RESULT(device.waitSemaphores(vk::SemaphoreWaitInfo().setSemaphores(semaphore).setValues(value),
+                    std::numeric_limits<uint64_t>::max()));
+                completedValue = std::max(completedValue, value);
+            }
+
+            // Asks the driver for the value the GPU has reached
+            inline uint64_t getCompletedValue(const vk::Device& device)
+            {
+                completedValue = std::max(completedValue, device.getSemaphoreCounterValue(semaphore));
+                return completedValue;
+            }
+
+            // Waits for every submit before destroying the semaphore
+            bool destroy(const vk::Device& device)
+            {
+                if (!semaphore)
+                    return true;
+                wait(device, submittedValue);
+                device.destroySemaphore(semaphore);
+                semaphore = nullptr;
+                return true;
+            }
+        };
+
         static const char* ENGINE_NAME = "Vulkan";
+        static const char* PIPELINE_CACHE_FILE = "pipeline_cache.bin";
+        // Compiled SPIR-V shaders are placed here by the build, next to the executable
+        static const char* SHADER_DIR = "shaders/";
         static const int ENINGE_VERSION[3] = { 1, 0, 0 };
 
         static const vector<const char*> DEVICE_EXTENSIONS{
             VK_KHR_SWAPCHAIN_EXTENSION_NAME };
+        // Nothing is presented in headless mode so swapchain is not needed
+        static const vector<const char*> HEADLESS_DEVICE_EXTENSIONS{};
         static const vector<const char*> VALIDATION_LAYERS = {
             "VK_LAYER_KHRONOS_validation" };
     }
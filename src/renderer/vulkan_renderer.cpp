@@ -1,10 +1,25 @@
+#include <algorithm>
+#include <cmath>
+
 #include "vulkan_renderer.h"
 #include "vulkan/vulkan_functions.h"
 #include "vulkan/vulkan_graphics.h"
+#include "core/mesh_file.h"
+#include "core/profiler.h"
+
+// Mesh to world matrix of an instance, whose transform holds the rows of a 3x4 matrix
+static engine::Mat4 getInstanceTransform(const engine::vulkan::GpuInstance& instance)
+{
+    const float* t = instance.transform;
+    return engine::Mat4(engine::Vec4(t[0], t[4], t[8], 0.0f),
+        engine::Vec4(t[1], t[5], t[9], 0.0f),
+        engine::Vec4(t[2], t[6], t[10], 0.0f),
+        engine::Vec4(t[3], t[7], t[11], 1.0f));
+}
 
 vector<const char*> engine::vulkan::VulkanRenderer::getRequiredExtenstions() const
 {
-    // Required extensions by GLFW
+    // Required extensions by GLFW (None in headless mode)
     vector<const char*> reqExtensions = m_window.vkGetRequiredInstanceExtensions();
     if (m_isValidationLayerEnabled)
         reqExtensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
@@ -29,18 +44,29 @@ bool engine::vulkan::VulkanRenderer::initSurface()
 
 bool engine::vulkan::VulkanRenderer::initDevice()
 {
-    m_gpu = selectPhysicalDevice(m_instance, m_surface, DEVICE_EXTENSIONS);
+    const vector<const char*>& deviceExtensions = m_window.isHeadless()
+        ? HEADLESS_DEVICE_EXTENSIONS
+        : DEVICE_EXTENSIONS;
+
+    m_gpu = selectPhysicalDevice(m_instance, m_surface, deviceExtensions);
     if (m_gpu)
     {
         m_queueFamilyIndices = getQueueFamilyIndices(m_gpu, m_surface);
+        m_isMeshShaderEnabled = isMeshShaderSupported(m_gpu);
         m_device = getLogicalDevice(m_gpu,
             m_queueFamilyIndices,
             m_isValidationLayerEnabled
             ? VALIDATION_LAYERS
             : vector<const char*>{},
-            DEVICE_EXTENSIONS);
+            deviceExtensions,
+            // No pipeline reads BindlessDescriptors yet
+            false,
+            m_isMeshShaderEnabled);
+        if (!m_device || !m_memoryAllocator.init(m_gpu, m_device))
+            return false;
         m_graphicsQueue = m_device.getQueue(m_queueFamilyIndices.graphics, 0);
-        m_presentationQueue = m_device.getQueue(m_queueFamilyIndices.presentation, 0);
+        if (m_queueFamilyIndices.isPresentationSupported())
+            m_presentationQueue = m_device.getQueue(m_queueFamilyIndices.presentation, 0);
     }
 
     return m_gpu && m_device && m_graphicsQueue ? true : false;
@@ -48,6 +74,18 @@ bool engine::vulkan::VulkanRenderer::initDevice()
 
 bool engine::vulkan::VulkanRenderer::initSwapchain()
 {
+    if (m_window.isHeadless())
+    {
+        // Each frame in flight renders into its own offscreen image
+        std::array<int, 2> resolution = m_window.getWindowResolution();
+        m_swapchainData = createOffscreenImages(m_gpu,
+            m_device,
+            vk::Extent2D(static_cast<uint32_t>(resolution[0]), static_cast<uint32_t>(resolution[1])),
+            m_framesInFlight);
+
+        return m_swapchainData.images.size() == m_framesInFlight;
+    }
+
     m_swapchainData = createSwapchain(m_gpu,
         m_device,
         m_surface,
@@ -57,26 +95,555 @@ bool engine::vulkan::VulkanRenderer::initSwapchain()
     return m_swapchainData.swapchain;
 }
 
+bool engine::vulkan::VulkanRenderer::recreateSwapchain()
+{
+    // Window is minimized, wait until it has a drawable area again
+    std::array<int, 2> resolution = m_window.getWindowResolution();
+    if (resolution[0] == 0 || resolution[1] == 0)
+        return false;
+
+    // Old swapchain is passed in so that the presentation engine can reuse its
+    // resources. It is retired but not destroyed, frames in flight may still be using it.
+    SwapchainData swapchainData = createSwapchain(m_gpu,
+        m_device,
+        m_surface,
+        m_queueFamilyIndices,
+        resolution,
+        m_swapchainData.swapchain);
+    if (!swapchainData.swapchain)
+        return false;
+
+    // Old resources are used by every submit up to the last one
+    const uint64_t lastUsedValue = m_graphicsTimeline.submittedValue;
+    for (vk::Framebuffer& framebuffer : m_renderData.framebuffers)
+        m_deletionQueue.destroy(lastUsedValue, m_device, framebuffer);
+
+    // Render pass only depends on the image format, so it is rebuilt only if
+    // the surface format changed
+    if (swapchainData.imageFormat != m_swapchainData.imageFormat)
+    {
+        m_deletionQueue.destroy(lastUsedValue, m_device, m_renderData.renderPass);
+        m_renderData = getRenderData(m_device, swapchainData);
+        if (m_meshletCulling.isMeshShaderPath()
+            && !m_meshletCulling.createMeshPipeline(m_pipelineCache, m_renderData.renderPass, m_deletionQueue, lastUsedValue))
+            std::cerr << "Failed to recreate the meshlet pipeline, meshlets are culled on the CPU" << std::endl;
+        if (m_meshPipeline.isValid()
+            && !m_meshPipeline.createPipeline(m_pipelineCache, m_renderData.renderPass, m_deletionQueue, lastUsedValue))
+            std::cerr << "Failed to recreate the mesh pipeline, the scene is not drawn" << std::endl;
+    }
+    else
+        m_renderData.framebuffers = createFramebuffers(m_device, m_renderData.renderPass, swapchainData);
+
+    SwapchainData oldSwapchainData = m_swapchainData;
+    const vk::Device device = m_device;
+    m_deletionQueue.push(lastUsedValue, [device, oldSwapchainData]() mutable
+        { oldSwapchainData.destroy(device); });
+    m_swapchainData = swapchainData;
+    m_imagesInFlight = vector<uint64_t>(m_swapchainData.images.size(), 0);
+    m_isSwapchainOutdated = false;
+
+    return m_renderData.renderPass && m_renderData.framebuffers.size() > 0;
+}
+
+engine::vulkan::FrameTimeSummary engine::vulkan::VulkanRenderer::getFrameTimeSummary() const
+{
+    FrameTimeSummary summary;
+    summary.framesInFlight = m_framesInFlight;
+    summary.frameCount = static_cast<uint32_t>(m_frameTimings.frameTimes.size());
+    if (m_frameTimings.frameTimes.empty())
+        return summary;
+
+    // Nearest rank percentiles
+    vector<double> sorted = m_frameTimings.frameTimes;
+    std::sort(sorted.begin(), sorted.end());
+    auto getPercentile = [&sorted](double percentile)
+    {
+        const size_t rank = static_cast<size_t>(std::ceil(percentile / 100.0 * sorted.size()));
+        return sorted[std::min(std::max(rank, static_cast<size_t>(1)), sorted.size()) - 1];
+    };
+    summary.averageMs = m_frameTimings.frameMs / sorted.size();
+    summary.p50Ms = getPercentile(50.0);
+    summary.p90Ms = getPercentile(90.0);
+    summary.p99Ms = getPercentile(99.0);
+    summary.maxMs = sorted.back();
+    return summary;
+}
+
+void engine::vulkan::VulkanRenderer::printFrameTimings() const
+{
+    // The first frame has no previous start to measure its period from
+    if (m_frameTimings.frameCount < 2)
+        return;
+
+    const FrameTimeSummary summary = getFrameTimeSummary();
+    const double frameMs = summary.averageMs;
+    const double waitMs = m_frameTimings.waitMs / m_frameTimings.frameCount;
+    const double recordMs = m_frameTimings.recordMs / m_frameTimings.frameCount;
+    std::cout << "Frame timings with " << m_framesInFlight << " frames in flight, "
+              << m_jobSystem.getThreadCount() << " recording threads";
+    if (!m_sceneInstances.empty())
+    {
+        std::cout << ", " << m_sceneInstances.size() << " instances drawn on the "
+                  << (m_frameDrawPath == DrawPath::GpuCulled
+                      ? "GPU culled"
+                      : m_frameDrawPath == DrawPath::Meshlets ? "meshlet" : "CPU culled")
+                  << " path";
+    }
+    if (m_frameDrawPath == DrawPath::Meshlets && m_meshletCulling.isMeshShaderPath())
+        std::cout << " (meshlets culled by task shaders)";
+    else if (m_frameDrawPath == DrawPath::Meshlets)
+    {
+        const double frameCount = m_frameTimings.frameCount;
+        std::cout << " (" << m_frameTimings.meshletCount / frameCount << " meshlets drawn, "
+                  << m_frameTimings.frustumCulledTriangles / frameCount << " triangles frustum culled and "
+                  << m_frameTimings.backfaceCulledTriangles / frameCount << " backface culled per frame)";
+    }
+    else if (m_frameDrawPath == DrawPath::Cpu && !m_sceneInstances.empty())
+    {
+        const double frameCount = m_frameTimings.frameCount;
+        std::cout << " (" << m_frameTimings.simplifiedInstances / frameCount << " instances drawn simplified and "
+                  << m_frameTimings.lodChanges / frameCount << " level switches per frame)";
+    }
+    std::cout << ": "
+              << frameMs << " ms/frame (p50 " << summary.p50Ms << ", p90 " << summary.p90Ms << ", p99 " << summary.p99Ms
+              << ", max " << summary.maxMs << "), CPU recording " << recordMs << " ms, CPU waiting for the GPU " << waitMs << " ms";
+
+    // Recording and GPU work run in sequence with one frame in flight, so the
+    // frame time drops below their sum only if they overlap
+    const std::map<std::string, GpuZoneStatistics>& statistics = m_gpuProfiler.getStatistics();
+    auto frameZone = statistics.find("Frame");
+    if (frameZone != statistics.end())
+    {
+        const double gpuMs = frameZone->second.averageMs;
+        std::cout << ", GPU " << gpuMs << " ms, overlap " << std::max(recordMs + gpuMs - frameMs, 0.0) << " ms";
+    }
+    std::cout << std::endl;
+}
+
+void engine::vulkan::VulkanRenderer::updateDrawList()
+{
+    PROFILE_ZONE("UpdateDrawList");
+
+    m_drawList.clear();
+    m_meshDrawState = MeshDrawState();
+    m_frameDrawPath = DrawPath::Cpu;
+    if (m_drawPath == DrawPath::GpuCulled && m_gpuCulling.isDrawSupported())
+        m_frameDrawPath = DrawPath::GpuCulled;
+    // Mesh shaders need the meshlet buffers, scenes uploaded without them are drawn per instance
+    else if (m_drawPath == DrawPath::Meshlets && !m_sceneMeshes.meshlets.empty()
+        && (!m_meshletCulling.isMeshShaderPath() || m_meshletCulling.prepareMeshTasks(m_sceneMeshes)))
+        m_frameDrawPath = DrawPath::Meshlets;
+    if (m_sceneInstances.empty())
+        return;
+
+    // No depth buffer, so the far plane only has to contain the whole scene
+    const vk::Extent2D extent = m_swapchainData.imageExtent;
+    const float aspect = static_cast<float>(extent.width) / static_cast<float>(std::max(extent.height, 1u));
+    const float zFar = std::max(length(m_cameraPosition) + m_sceneRadius, 1.0f) * 2.0f;
+    // The vertical field of view is also the one selectLods() projects the errors with
+    m_viewProjection = Mat4::perspective(1.0f, aspect, 0.1f, zFar)
+        * Mat4::lookAt(m_cameraPosition, m_cameraTarget, Vec3(0.0f, 1.0f, 0.0f));
+
+    // Descriptor sets come from the per frame allocator, which only the render thread may use
+    m_meshDrawState = m_meshPipeline.getDrawState(m_sceneMeshes, m_gpuCulling.getInstanceBuffer());
+    if (!m_meshDrawState.isValid())
+        return;
+
+    const Frustum frustum = Frustum::fromMatrix(m_viewProjection.data());
+    if (m_frameDrawPath == DrawPath::GpuCulled)
+    {
+        // The compute pass culls against the same planes
+        FrustumPlanes planes;
+        for (uint32_t i = 0; i < Frustum::Count; i++)
+            std::copy(frustum.planes[i], frustum.planes[i] + 4, planes[i].begin());
+        m_gpuCulling.setFrustum(planes);
+        return;
+    }
+    cullSpheres(frustum, m_sceneBounds, m_drawList);
+
+    if (m_frameDrawPath == DrawPath::Cpu)
+    {
+        // Only the indexed draws have simplified levels, the meshlets are built from level 0
+        PROFILE_ZONE("SelectLods");
+        LodSettings settings;
+        settings.cameraPosition = m_cameraPosition;
+        settings.pixelsPerUnit = getPixelsPerUnit(1.0f, static_cast<float>(extent.height));
+        m_frameTimings.lodChanges += selectLods(settings,
+            m_sceneLods,
+            m_drawList.data(),
+            static_cast<uint32_t>(m_drawList.size()));
+        for (uint32_t instance : m_drawList)
+            m_frameTimings.simplifiedInstances += m_sceneLods.lods[instance] > 0 ? 1 : 0;
+        return;
+    }
+
+    // Task shaders cull the meshlets of each visible instance while drawing,
+    // without them the meshlets are culled here and drawn with one multi draw
+    if (m_frameDrawPath != DrawPath::Meshlets || m_meshletCulling.isMeshShaderPath())
+        return;
+    PROFILE_ZONE("CullMeshlets");
+    for (uint32_t instance : m_drawList)
+    {
+        m_meshletCulling.cull(frustum,
+            m_cameraPosition,
+            getInstanceTransform(m_sceneInstances[instance]),
+            m_sceneMeshes,
+            m_sceneInstances[instance].meshIndex,
+            instance);
+    }
+}
+
+void engine::vulkan::VulkanRenderer::recordDraws(const vk::CommandBuffer& cmdBuffer, uint32_t first, uint32_t count) const
+{
+    // Draws items [first, first + count) of the draw list, one indexed draw per
+    // visible instance. Called from job system threads, which only read the
+    // state updateDrawList() prepared.
+    m_meshPipeline.bind(cmdBuffer, m_meshDrawState, m_viewProjection, m_swapchainData.imageExtent);
+    if (m_frameDrawPath == DrawPath::GpuCulled)
+    {
+        // The whole scene is a single item, drawn with the commands the culling pass wrote
+        m_gpuCulling.draw(cmdBuffer);
+        return;
+    }
+    const bool isMeshShaded = m_frameDrawPath == DrawPath::Meshlets && m_meshletCulling.isMeshShaderPath();
+    if (m_frameDrawPath == DrawPath::Meshlets && !isMeshShaded)
+    {
+        // Single item too, the visible meshlets are index ranges of the bound pipeline
+        m_meshletCulling.draw(cmdBuffer);
+        return;
+    }
+    for (uint32_t i = first; i < first + count; i++)
+    {
+        const uint32_t instance = m_drawList[i];
+        const uint32_t meshIndex = m_sceneInstances[instance].meshIndex;
+        if (isMeshShaded)
+        {
+            // Binds the meshlet pipeline, the viewport and scissor set above stay
+            m_meshletCulling.drawMeshTasks(cmdBuffer,
+                m_viewProjection,
+                m_cameraPosition,
+                getInstanceTransform(m_sceneInstances[instance]),
+                m_sceneMeshes,
+                meshIndex);
+            continue;
+        }
+        const GpuMeshDraw& draw = m_sceneMeshes.draws[meshIndex];
+        uint32_t indexCount = draw.indexCount;
+        uint32_t firstIndex = draw.firstIndex;
+        // Levels share the vertices of their mesh, only the index range changes.
+        // Instances of meshes without levels always stay at level 0.
+        const uint32_t level = m_sceneLods.lods[instance];
+        if (level > 0)
+        {
+            const MeshFileLod& lod = m_sceneMeshes.lods[m_sceneMeshes.lodRanges[meshIndex].firstLod + level];
+            indexCount = lod.indexCount;
+            firstIndex = lod.firstIndex;
+        }
+        // firstInstance selects the instance in mesh.vert
+        cmdBuffer.drawIndexed(indexCount, 1, firstIndex, draw.vertexOffset, instance);
+    }
+}
+
+uint64_t engine::vulkan::VulkanRenderer::recordFrame(const vk::CommandBuffer& cmdBuffer, uint32_t frameIndex, uint32_t imgIndex)
+{
+    PROFILE_ZONE("RecordCommands");
+
+    cmdBuffer.reset();
+    cmdBuffer.begin(vk::CommandBufferBeginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+
+    // Results of the frame which used this slot before are read back here,
+    // render() has already waited on its submit
+    m_gpuProfiler.beginFrame(cmdBuffer, frameIndex, m_currentFrameNumber);
+    m_gpuProfiler.beginZone("Frame");
+
+    updateDrawList();
+    // Meshlets culled by updateDrawList() go into this slot's draw buffer,
+    // the frame which used it before has finished
+    m_meshletCulling.writeDraws(frameIndex, m_graphicsTimeline.getNextValue());
+    if (m_frameDrawPath == DrawPath::Meshlets)
+    {
+        const MeshletCullStats& stats = m_meshletCulling.getStats();
+        m_frameTimings.meshletCount += m_meshletCulling.getDrawCount();
+        m_frameTimings.frustumCulledTriangles += stats.frustumCulledTriangles;
+        m_frameTimings.backfaceCulledTriangles += stats.backfaceCulledTriangles;
+    }
+
+    // Take ownership of the resources uploaded on the transfer queue
+    uint64_t uploadValue = m_uploadService.recordAcquireBarriers(cmdBuffer);
+
+    // Instances are culled on the GPU before the render pass, draws inside it
+    // consume the commands with m_gpuCulling.draw()
+    const bool isGpuCulled = m_frameDrawPath == DrawPath::GpuCulled && m_meshDrawState.isValid();
+    if (isGpuCulled && m_gpuCulling.getInstanceCount() > 0)
+    {
+        GpuProfileZone zone(m_gpuProfiler, "Culling");
+        m_gpuCulling.cull(cmdBuffer);
+    }
+
+    vk::ClearValue clearValue;
+    float flash = abs(sin(m_currentFrameNumber / 120.f));
+    std::array<float, 4> color = {{0.0f, 0.0f, 0.0f, 1.0f}};
+    color[2] = flash;
+    clearValue.setColor(vk::ClearColorValue(color));
+
+    // Timestamps can't be written inside a subpass recorded with secondary
+    // command buffers, so the zone wraps the whole render pass
+    m_gpuProfiler.beginZone("MainPass");
+    cmdBuffer.beginRenderPass(vk::RenderPassBeginInfo(m_renderData.renderPass,
+        m_renderData.framebuffers[imgIndex],
+        vk::Rect2D({ 0, 0 }, { m_swapchainData.imageExtent }),
+        clearValue), vk::SubpassContents::eSecondaryCommandBuffers);
+
+    // Draws are recorded into secondary command buffers on all cores
+    vk::CommandBufferInheritanceInfo inheritanceInfo(m_renderData.renderPass,
+        0,
+        m_renderData.framebuffers[imgIndex]);
+    const bool isMeshletDraw = m_frameDrawPath == DrawPath::Meshlets
+        && !m_meshletCulling.isMeshShaderPath()
+        && m_meshDrawState.isValid();
+    const uint32_t itemCount = isGpuCulled || isMeshletDraw ? 1 : static_cast<uint32_t>(m_drawList.size());
+    const vector<vk::CommandBuffer>& secondaryBuffers = m_commandRecorder.record(frameIndex,
+        inheritanceInfo,
+        itemCount,
+        m_recordDrawsFunc);
+    if (!secondaryBuffers.empty())
+        cmdBuffer.executeCommands(secondaryBuffers);
+
+    cmdBuffer.endRenderPass();
+    m_gpuProfiler.endZone();
+
+    m_gpuProfiler.endFrame();
+    cmdBuffer.end();
+
+    return uploadValue;
+}
+
 bool engine::vulkan::VulkanRenderer::initCommands()
 {
-    m_commandData = createCommandData(m_device, m_queueFamilyIndices);
-    return m_commandData.pool && m_commandData.buffers.size() > 0;
+    m_commandData = createCommandData(m_device, m_queueFamilyIndices, m_framesInFlight);
+
+    bool isRecorderInit = m_commandRecorder.init(m_device, m_queueFamilyIndices, m_framesInFlight, m_jobSystem);
+    m_recordDrawsFunc = [this](const vk::CommandBuffer& cmdBuffer, uint32_t first, uint32_t count)
+    {
+        recordDraws(cmdBuffer, first, count);
+    };
+
+    return m_commandData.pool
+        && m_commandData.buffers.size() == m_framesInFlight
+        && isRecorderInit;
 }
 
 bool engine::vulkan::VulkanRenderer::initRenderpass()
 {
-    m_renderData = getRenderData(m_device, m_swapchainData);
+    // Offscreen images are left ready to be copied out instead of presented
+    m_renderData = getRenderData(m_device,
+        m_swapchainData,
+        m_window.isHeadless()
+        ? vk::ImageLayout::eTransferSrcOptimal
+        : vk::ImageLayout::ePresentSrcKHR);
 
     return m_renderData.renderPass && m_renderData.framebuffers.size() > 0;
 }
 
 bool engine::vulkan::VulkanRenderer::initRenderSyncData()
 {
-    m_renderSyncData = getRenderSyncData(m_device);
+    m_graphicsTimeline = QueueTimeline();
+    m_graphicsTimeline.semaphore = createTimelineSemaphore(m_device);
+    if (!m_graphicsTimeline.semaphore)
+        return false;
+
+    m_renderSyncData.clear();
+    for (uint32_t i = 0; i < m_framesInFlight; i++)
+    {
+        RenderSyncData syncData = getRenderSyncData(m_device);
+        if (!(syncData.renderSemaphore
+            && syncData.presentSemaphore))
+            return false;
+        m_renderSyncData.push_back(syncData);
+    }
+
+    m_imagesInFlight = vector<uint64_t>(m_swapchainData.images.size(), 0);
+
+    return true;
+}
+
+bool engine::vulkan::VulkanRenderer::initPipelineCache()
+{
+    m_pipelineCache = createPipelineCache(m_gpu, m_device, PIPELINE_CACHE_FILE);
+
+    return m_pipelineCache ? true : false;
+}
+
+bool engine::vulkan::VulkanRenderer::initGpuProfiler()
+{
+    return m_gpuProfiler.init(m_gpu, m_device, m_queueFamilyIndices.graphics, m_framesInFlight);
+}
+
+bool engine::vulkan::VulkanRenderer::initGpuCulling()
+{
+    // CPU recorded draws keep working without it, so a missing shader only
+    // disables the GPU driven path
+    if (!m_gpuCulling.init(m_gpu,
+        m_device,
+        m_pipelineCache,
+        m_resources,
+        m_descriptorLayoutCache,
+        m_descriptorAllocator,
+        m_uploadService))
+    {
+        std::cerr << "Failed to create the culling pipeline, GPU driven draws are disabled" << std::endl;
+        m_gpuCulling.destroy();
+    }
+    else if (!m_gpuCulling.isDrawSupported())
+        std::cerr << "No drawIndirectFirstInstance support, GPU driven draws are disabled" << std::endl;
+    return true;
+}
+
+bool engine::vulkan::VulkanRenderer::initMeshletCulling()
+{
+    if (!m_meshletCulling.init(m_gpu,
+        m_device,
+        m_resources,
+        m_descriptorLayoutCache,
+        m_descriptorAllocator,
+        m_framesInFlight,
+        m_isMeshShaderEnabled))
+        return false;
+
+    // The CPU path works on any device, so mesh shader failures only disable them
+    if (m_isMeshShaderEnabled && !m_meshletCulling.createMeshPipeline(m_pipelineCache, m_renderData.renderPass, m_deletionQueue, 0))
+        std::cerr << "Failed to create the meshlet pipeline, meshlets are culled on the CPU" << std::endl;
+    return true;
+}
 
-    return m_renderSyncData.renderFence
-        && m_renderSyncData.renderSemaphore
-        && m_renderSyncData.presentSemaphore;
+bool engine::vulkan::VulkanRenderer::initMeshPipeline()
+{
+    if (!m_meshPipeline.init(m_device, m_resources, m_descriptorLayoutCache, m_descriptorAllocator))
+        return false;
+
+    // Nothing else depends on it, so missing shaders only leave the scene undrawn
+    if (!m_meshPipeline.createPipeline(m_pipelineCache, m_renderData.renderPass, m_deletionQueue, 0))
+        std::cerr << "Failed to create the mesh pipeline, the scene is not drawn" << std::endl;
+    else if (m_isPipelineBenchmarkEnabled)
+        benchmarkPipelineCreation();
+    return true;
+}
+
+void engine::vulkan::VulkanRenderer::benchmarkPipelineCreation()
+{
+    // Drivers may keep their own shader cache on disk (Eg: Mesa, disabled with
+    // MESA_SHADER_CACHE_DISABLE=true), which makes the cold numbers warm too
+    const uint32_t repeatCount = 20;
+    double coldMs = 0.0;
+    double warmMs = 0.0;
+    bool isCreated = true;
+    for (uint32_t i = 0; i < repeatCount && isCreated; i++)
+    {
+        vk::PipelineCache emptyCache;
+        try
+        {
+            emptyCache = m_device.createPipelineCache(vk::PipelineCacheCreateInfo());
+        }
+        catch (...)
+        {
+            handleVulkanException();
+            return;
+        }
+
+        // Shader modules are read from disk in both cases, so only the cache differs
+        auto start = std::chrono::steady_clock::now();
+        isCreated = m_meshPipeline.createPipeline(emptyCache, m_renderData.renderPass, m_deletionQueue, 0);
+        coldMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        m_device.destroyPipelineCache(emptyCache);
+
+        start = std::chrono::steady_clock::now();
+        isCreated = isCreated && m_meshPipeline.createPipeline(m_pipelineCache, m_renderData.renderPass, m_deletionQueue, 0);
+        warmMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+    if (!isCreated)
+    {
+        std::cerr << "Failed to create the mesh pipeline during the pipeline benchmark" << std::endl;
+        return;
+    }
+
+    std::cout << "Mesh pipeline creation over " << repeatCount << " runs: cold " << coldMs / repeatCount
+              << " ms, warm " << warmMs / repeatCount << " ms with the pipeline cache" << std::endl;
+}
+
+bool engine::vulkan::VulkanRenderer::initScene()
+{
+    if (m_sceneFile.empty())
+        return true;
+
+    MeshFile file;
+    MeshBuffers meshes;
+    // Mesh shaders read the meshlets from their own buffers
+    const bool withMeshletBuffers = m_drawPath == DrawPath::Meshlets && m_meshletCulling.isMeshShaderPath();
+    if (!file.open(m_sceneFile) || file.getMeshCount() == 0
+        || !uploadMeshFile(file, m_resources, m_uploadService, meshes, withMeshletBuffers))
+    {
+        std::cerr << "Failed to load the scene " << m_sceneFile << std::endl;
+        return false;
+    }
+    if (m_drawPath == DrawPath::Meshlets && file.getMeshletCount() == 0)
+        std::cerr << "Scene " << m_sceneFile << " has no meshlets (convert it with --meshlets), it is drawn per instance" << std::endl;
+
+    // Instances cycle through the meshes on a square grid in the xz plane,
+    // spaced so that the bounding spheres of neighbours don't overlap
+    const MeshFileEntry* entries = file.getMeshes();
+    float spacing = 0.0f;
+    for (uint32_t i = 0; i < file.getMeshCount(); i++)
+    {
+        const Vec3 center(entries[i].boundsCenter[0], entries[i].boundsCenter[1], entries[i].boundsCenter[2]);
+        spacing = std::max(spacing, 2.0f * (length(center) + entries[i].boundsRadius));
+    }
+    spacing = std::max(spacing, 1e-3f);
+
+    const uint32_t side = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(m_sceneInstanceCount))));
+    const float start = -0.5f * spacing * (side - 1);
+    vector<GpuInstance> instances(m_sceneInstanceCount);
+    for (uint32_t i = 0; i < m_sceneInstanceCount; i++)
+    {
+        const MeshFileEntry& entry = entries[i % file.getMeshCount()];
+        const float x = start + spacing * (i % side);
+        const float z = start + spacing * (i / side);
+        const float transform[12] = { 1.0f, 0.0f, 0.0f, x, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, z };
+        GpuInstance& instance = instances[i];
+        std::copy(transform, transform + 12, instance.transform);
+        instance.boundingSphere[0] = entry.boundsCenter[0] + x;
+        instance.boundingSphere[1] = entry.boundsCenter[1];
+        instance.boundingSphere[2] = entry.boundsCenter[2] + z;
+        instance.boundingSphere[3] = entry.boundsRadius;
+        instance.meshIndex = i % file.getMeshCount();
+    }
+
+    // Looks down at the grid from the front, so the far rows get culled once the grid is large
+    const float size = spacing * side;
+    setCamera(Vec3(0.0f, 0.5f * size, 0.75f * size + spacing), Vec3(0.0f, 0.0f, 0.0f));
+    return setScene(meshes, instances);
+}
+
+bool engine::vulkan::VulkanRenderer::initUploadService()
+{
+    // Transfer queue is one of the renderer's queues unless the family is separate
+    const bool isQueueShared = m_queueFamilyIndices.transfer == m_queueFamilyIndices.graphics
+        || m_queueFamilyIndices.transfer == m_queueFamilyIndices.presentation;
+    return m_uploadService.init(m_device,
+        m_queueFamilyIndices,
+        m_memoryAllocator,
+        DEFAULT_STAGING_SIZE,
+        isQueueShared ? &m_queueMutex : nullptr);
+}
+
+bool engine::vulkan::VulkanRenderer::initResources()
+{
+    return m_resources.init(m_device, m_memoryAllocator, m_deletionQueue);
+}
+
+bool engine::vulkan::VulkanRenderer::initDescriptors()
+{
+    return m_descriptorLayoutCache.init(m_device)
+        && m_descriptorAllocator.init(m_device, m_framesInFlight);
 }
 
 bool engine::vulkan::VulkanRenderer::initVulkan()
@@ -90,16 +657,33 @@ bool engine::vulkan::VulkanRenderer::initVulkan()
     InstanceCreateData data{ appInfo, m_isValidationLayerEnabled, getRequiredExtenstions(), VALIDATION_LAYERS };
     bool isInstanceCreated = createInstance(data, m_instance, m_debugMessenger);
 
+    // There is no surface in headless mode, images are rendered offscreen
     bool isSurfaceCreated = false;
     if (isInstanceCreated)
-        isSurfaceCreated = initSurface();
+        isSurfaceCreated = m_window.isHeadless() || initSurface();
 
     bool isDeviceInit = false;
     if (isSurfaceCreated)
         isDeviceInit = initDevice();
 
-    bool isSwapchainInit = false;
+    bool isPipelineCacheInit = false;
     if (isDeviceInit)
+        isPipelineCacheInit = initPipelineCache();
+
+    bool isUploadServiceInit = false;
+    if (isPipelineCacheInit)
+        isUploadServiceInit = initUploadService();
+
+    bool isResourcesInit = false;
+    if (isUploadServiceInit)
+        isResourcesInit = initResources();
+
+    bool isDescriptorsInit = false;
+    if (isResourcesInit)
+        isDescriptorsInit = initDescriptors();
+
+    bool isSwapchainInit = false;
+    if (isDescriptorsInit)
         isSwapchainInit = initSwapchain();
 
     bool isCommandsInit = false;
@@ -114,23 +698,87 @@ bool engine::vulkan::VulkanRenderer::initVulkan()
     if (isRenderpassInit)
         isRenderSyncInit = initRenderSyncData();
 
+    bool isGpuProfilerInit = false;
+    if (isRenderSyncInit)
+        isGpuProfilerInit = initGpuProfiler();
+
+    bool isGpuCullingInit = false;
+    if (isGpuProfilerInit)
+        isGpuCullingInit = initGpuCulling();
+
+    bool isMeshletCullingInit = false;
+    if (isGpuCullingInit)
+        isMeshletCullingInit = initMeshletCulling();
+
+    bool isMeshPipelineInit = false;
+    if (isMeshletCullingInit)
+        isMeshPipelineInit = initMeshPipeline();
+
+    bool isSceneInit = false;
+    if (isMeshPipelineInit)
+        isSceneInit = initScene();
+
     return isInstanceCreated
         && isSurfaceCreated
         && isDeviceInit
+        && isPipelineCacheInit
+        && isUploadServiceInit
+        && isResourcesInit
+        && isDescriptorsInit
         && isSwapchainInit
         && isCommandsInit
         && isRenderpassInit
-        && isRenderSyncInit;
+        && isRenderSyncInit
+        && isGpuProfilerInit
+        && isGpuCullingInit
+        && isMeshletCullingInit
+        && isMeshPipelineInit
+        && isSceneInit;
 }
 
 bool engine::vulkan::VulkanRenderer::cleanVulkan()
 {
     if (m_device)
     {
-        m_renderSyncData.destroy(m_device);
+        // Every submitted frame has to finish, and the presentation engine has
+        // to be done with the render semaphores
+        m_graphicsTimeline.destroy(m_device);
+        if (m_presentationQueue)
+        {
+            std::lock_guard<std::mutex> queueLock(m_queueMutex);
+            m_presentationQueue.waitIdle();
+        }
+        // Printed before the scene is released, it reports the scene size
+        printFrameTimings();
+        for (RenderSyncData& s : m_renderSyncData)
+            s.destroy(m_device);
+        m_renderSyncData.clear();
+        m_imagesInFlight.clear();
+        m_gpuCulling.destroy();
+        m_meshletCulling.destroy();
+        m_meshPipeline.destroy();
+        releaseMeshBuffers(m_resources, m_sceneMeshes, 0);
+        m_sceneInstances.clear();
+        m_drawList.clear();
+        m_deletionQueue.flush();
+        m_gpuProfiler.printStatistics();
+        if (!m_gpuTraceFile.empty())
+            m_gpuProfiler.writeChromeTrace(m_gpuTraceFile);
+        m_gpuProfiler.destroy();
         m_renderData.destroy(m_device);
+        m_commandRecorder.destroy();
         m_commandData.destroy(m_device);
         m_swapchainData.destroy(m_device);
+        if (m_pipelineCache)
+        {
+            savePipelineCache(m_device, m_pipelineCache, PIPELINE_CACHE_FILE);
+            m_device.destroyPipelineCache(m_pipelineCache);
+        }
+        m_descriptorAllocator.destroy();
+        m_descriptorLayoutCache.destroy();
+        m_resources.destroy();
+        m_uploadService.destroy();
+        m_memoryAllocator.destroy();
 
         m_device.destroy();
     }
@@ -145,6 +793,8 @@ bool engine::vulkan::VulkanRenderer::cleanVulkan()
 
 bool engine::vulkan::VulkanRenderer::init()
 {
+    m_window.setWindowResizeListener([this](int, int) { m_isSwapchainOutdated = true; });
+
     bool isInit = Renderer::init();
     if (isInit)
     {
@@ -154,6 +804,54 @@ bool engine::vulkan::VulkanRenderer::init()
     return isInit;
 }
 
+bool engine::vulkan::VulkanRenderer::setScene(const MeshBuffers& meshes, const vector<GpuInstance>& instances)
+{
+    // Frames in flight and the one being recorded keep using the old buffers
+    const uint64_t releaseValue = m_graphicsTimeline.getNextValue();
+    releaseMeshBuffers(m_resources, m_sceneMeshes, releaseValue);
+    m_sceneMeshes = meshes;
+    m_sceneInstances = instances;
+
+    m_sceneBounds.clear();
+    m_sceneBounds.reserve(static_cast<uint32_t>(instances.size()));
+    m_sceneLods.clear();
+    m_sceneLods.reserve(static_cast<uint32_t>(instances.size()));
+    m_sceneRadius = 0.0f;
+    for (const GpuInstance& instance : instances)
+    {
+        const float* sphere = instance.boundingSphere;
+        m_sceneBounds.add(sphere[0], sphere[1], sphere[2], sphere[3]);
+        m_sceneRadius = std::max(m_sceneRadius, length(Vec3(sphere[0], sphere[1], sphere[2])) + sphere[3]);
+
+        // Errors are in mesh space, the largest row length scales them to world space
+        float levelErrors[MAX_LOD_COUNT] = {};
+        uint32_t levelCount = 0;
+        if (instance.meshIndex < meshes.lodRanges.size())
+        {
+            const MeshLodRange& lodRange = meshes.lodRanges[instance.meshIndex];
+            levelCount = std::min(lodRange.lodCount, MAX_LOD_COUNT);
+            for (uint32_t level = 0; level < levelCount; level++)
+                levelErrors[level] = meshes.lods[lodRange.firstLod + level].error;
+        }
+        const float* t = instance.transform;
+        const float scale = std::sqrt(std::max({ t[0] * t[0] + t[1] * t[1] + t[2] * t[2],
+            t[4] * t[4] + t[5] * t[5] + t[6] * t[6],
+            t[8] * t[8] + t[9] * t[9] + t[10] * t[10] }));
+        m_sceneLods.add(Vec3(sphere[0], sphere[1], sphere[2]), sphere[3], levelErrors, levelCount, scale);
+    }
+
+    bool isUploaded = m_gpuCulling.setMeshes(meshes.draws, releaseValue)
+        && m_gpuCulling.setInstances(instances, releaseValue);
+    if (!isUploaded)
+    {
+        std::cerr << "Failed to upload the scene instances" << std::endl;
+        m_sceneInstances.clear();
+        m_sceneBounds.clear();
+        m_sceneLods.clear();
+    }
+    return isUploaded;
+}
+
 void engine::vulkan::VulkanRenderer::update()
 {
     Renderer::update();
@@ -163,38 +861,147 @@ void engine::vulkan::VulkanRenderer::render()
 {
     Renderer::render();
 
-    VK_HANDLE_RESULT(m_device.waitForFences(m_renderSyncData.renderFence, true, 1000000000));
-    m_device.resetFences(m_renderSyncData.renderFence);
+    const uint32_t frameIndex = m_currentFrameNumber % m_framesInFlight;
+    RenderSyncData& syncData = m_renderSyncData[frameIndex];
+    const vk::CommandBuffer& cmdBuffer = m_commandData.buffers[frameIndex];
+
+    using Clock = std::chrono::steady_clock;
+    const Clock::time_point frameStart = Clock::now();
+    if (m_frameTimings.frameCount > 0)
+    {
+        const double frameMs = std::chrono::duration<double, std::milli>(frameStart - m_frameTimings.lastFrameStart).count();
+        m_frameTimings.frameMs += frameMs;
+        m_frameTimings.frameTimes.push_back(frameMs);
+    }
+    m_frameTimings.lastFrameStart = frameStart;
 
-    uint32_t imgIndex = m_device.acquireNextImageKHR(m_swapchainData.swapchain, 1000000000, m_renderSyncData.presentSemaphore).value;
+    // Only wait for the frame which used this slot N frames ago, the other
+    // frames in flight keep executing on the GPU while we record this one.
+    {
+        PROFILE_ZONE("WaitForFrame");
+        m_graphicsTimeline.wait(m_device, syncData.timelineValue);
+    }
+    m_frameTimings.waitMs += std::chrono::duration<double, std::milli>(Clock::now() - frameStart).count();
 
-    m_commandData.buffers[0].reset();
-    m_commandData.buffers[0].begin(vk::CommandBufferBeginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+    // Destroy resources released by frames which are done
+    m_deletionQueue.collect(m_graphicsTimeline.getCompletedValue(m_device));
+    m_descriptorAllocator.beginFrame(frameIndex);
 
-    vk::ClearValue clearValue;
-    float flash = abs(sin(m_currentFrameNumber / 120.f));
-    std::array<float, 4> color = {{0.0f, 0.0f, 0.0f, 1.0f}};
-    color[2] = flash;
-    clearValue.setColor(vk::ClearColorValue(color));
+    // Uploads queued since the last frame are submitted in one batch
+    m_uploadService.flush();
 
-    m_commandData.buffers[0].beginRenderPass(vk::RenderPassBeginInfo(m_renderData.renderPass,
-        m_renderData.framebuffers[imgIndex],
-        vk::Rect2D({ 0, 0 }, { m_swapchainData.imageExtent }),
-        clearValue), vk::SubpassContents::eInline);
+    // Skip the frame if the swapchain can't be recreated yet (Eg: minimized window)
+    if (m_isSwapchainOutdated && !recreateSwapchain())
+    {
+        // A minimized window has a zero sized framebuffer, sleep until it is
+        // restored (or closed) instead of spinning through empty frames
+        const std::array<int, 2> resolution = m_window.getWindowResolution();
+        if (resolution[0] == 0 || resolution[1] == 0)
+            m_window.waitEvents();
+        return;
+    }
+
+    // Headless mode owns one offscreen image per frame in flight, so there is
+    // nothing to acquire or present.
+    const bool isHeadless = m_window.isHeadless();
+    uint32_t imgIndex = frameIndex;
+    if (!isHeadless)
+    {
+        PROFILE_ZONE("AcquireImage");
+        try
+        {
+            vk::ResultValue<uint32_t> acquired = m_device.acquireNextImageKHR(m_swapchainData.swapchain,
+                1000000000,
+                syncData.presentSemaphore);
+            // Suboptimal image can still be presented, recreate after this frame
+            if (acquired.result == vk::Result::eSuboptimalKHR)
+                m_isSwapchainOutdated = true;
+            imgIndex = acquired.value;
+        }
+        catch (vk::OutOfDateKHRError&)
+        {
+            m_isSwapchainOutdated = true;
+            return;
+        }
+    }
+
+    // The swapchain can hand back an image which is still being rendered to
+    // by another frame in flight (Eg: less images than frames in flight).
+    m_graphicsTimeline.wait(m_device, m_imagesInFlight[imgIndex]);
+
+    // Value the graphics timeline reaches once this frame's submit finished
+    const uint64_t frameValue = m_graphicsTimeline.getNextValue();
+    m_imagesInFlight[imgIndex] = frameValue;
+
+    const Clock::time_point recordStart = Clock::now();
+    uint64_t uploadValue = recordFrame(cmdBuffer, frameIndex, imgIndex);
+    m_frameTimings.recordMs += std::chrono::duration<double, std::milli>(Clock::now() - recordStart).count();
+    m_frameTimings.frameCount++;
+
+    PROFILE_ZONE("SubmitAndPresent");
+
+    // Binary semaphores ignore their entry in the timeline wait values
+    vector<vk::Semaphore> waitSemaphores;
+    vector<vk::PipelineStageFlags> waitStages;
+    vector<uint64_t> waitValues;
+    if (!isHeadless)
+    {
+        waitSemaphores.push_back(syncData.presentSemaphore);
+        waitStages.push_back(vk::PipelineStageFlagBits::eColorAttachmentOutput);
+        waitValues.push_back(0);
+    }
+    if (uploadValue > 0)
+    {
+        waitSemaphores.push_back(m_uploadService.getSemaphore());
+        waitStages.push_back(vk::PipelineStageFlagBits::eAllCommands);
+        waitValues.push_back(uploadValue);
+    }
+
+    vector<vk::Semaphore> signalSemaphores{ m_graphicsTimeline.semaphore };
+    vector<uint64_t> signalValues{ frameValue };
+    if (!isHeadless)
+    {
+        signalSemaphores.push_back(syncData.renderSemaphore);
+        signalValues.push_back(0);
+    }
 
-    m_commandData.buffers[0].endRenderPass();
+    vk::TimelineSemaphoreSubmitInfo timelineInfo;
+    timelineInfo.setWaitSemaphoreValues(waitValues)
+        .setSignalSemaphoreValues(signalValues);
+    vk::SubmitInfo submitInfo;
+    submitInfo.setWaitSemaphores(waitSemaphores)
+        .setWaitDstStageMask(waitStages)
+        .setCommandBuffers(cmdBuffer)
+        .setSignalSemaphores(signalSemaphores)
+        .setPNext(&timelineInfo);
 
-    m_commandData.buffers[0].end();
+    {
+        std::lock_guard<std::mutex> queueLock(m_queueMutex);
+        m_graphicsQueue.submit(submitInfo, nullptr);
+    }
+    m_graphicsTimeline.submittedValue = frameValue;
+    syncData.timelineValue = frameValue;
 
-    vk::PipelineStageFlags pipelineFlags(vk::PipelineStageFlagBits::eColorAttachmentOutput);
-    m_graphicsQueue.submit(vk::SubmitInfo(m_renderSyncData.presentSemaphore,
-        pipelineFlags,
-        m_commandData.buffers[0],
-        m_renderSyncData.renderSemaphore), m_renderSyncData.renderFence);
+    if (isHeadless)
+    {
+        m_currentFrameNumber++;
+        return;
+    }
 
-    VK_HANDLE_RESULT(m_presentationQueue.presentKHR(vk::PresentInfoKHR(m_renderSyncData.renderSemaphore,
-        m_swapchainData.swapchain,
-        imgIndex)));
+    try
+    {
+        PROFILE_ZONE("Present");
+        std::lock_guard<std::mutex> queueLock(m_queueMutex);
+        vk::Result result = m_presentationQueue.presentKHR(vk::PresentInfoKHR(syncData.renderSemaphore,
+            m_swapchainData.swapchain,
+            imgIndex));
+        if (result == vk::Result::eSuboptimalKHR)
+            m_isSwapchainOutdated = true;
+    }
+    catch (vk::OutOfDateKHRError&)
+    {
+        m_isSwapchainOutdated = true;
+    }
 
     m_currentFrameNumber++;
 }
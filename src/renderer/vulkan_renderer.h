@@ -5,16 +5,60 @@
 // This is done to ensure window header (GLFW) is included after
 // vulkan is included so that GLFW knows to include vulkan functions.
 #include "vulkan/vulkan_utils.h"
+#include "vulkan/vulkan_memory.h"
+#include "vulkan/vulkan_commands.h"
+#include "vulkan/vulkan_gpu_profiler.h"
+#include "vulkan/vulkan_upload.h"
+#include "vulkan/vulkan_deletion_queue.h"
+#include "vulkan/vulkan_resources.h"
+#include "vulkan/vulkan_descriptors.h"
+#include "vulkan/vulkan_gpu_culling.h"
+#include "vulkan/vulkan_meshlets.h"
+#include "vulkan/vulkan_mesh_pipeline.h"
+#include "core/culling.h"
+#include "core/lod.h"
 #include "renderer.h"
 
 namespace engine
 {
     namespace vulkan
     {
+        // How the scene instances are culled and drawn
+        enum class DrawPath
+        {
+            // Culled on the CPU, one draw per visible instance recorded on all cores
+            Cpu,
+            // Culled by a compute pass, drawn with indirect draws. Falls back to
+            // Cpu if the device can't draw the culled instances.
+            GpuCulled,
+            // Instances culled on the CPU, then the meshlets of the visible ones,
+            // by task shaders if the device has mesh shaders. Falls back to Cpu
+            // if the scene has no meshlets.
+            Meshlets
+        };
+
+        /**
+         * @brief Distribution of the frame times of a run, in milliseconds.
+         * Frame times are the periods between the starts of consecutive frames.
+         *
+         * @param frameCount Number of frame times, one less than the rendered frames
+         */
+        struct FrameTimeSummary
+        {
+            uint32_t framesInFlight = 0;
+            uint32_t frameCount = 0;
+            double averageMs = 0.0;
+            double p50Ms = 0.0;
+            double p90Ms = 0.0;
+            double p99Ms = 0.0;
+            double maxMs = 0.0;
+        };
+
         class VulkanRenderer : public Renderer
         {
         private:
             bool m_isValidationLayerEnabled = true;
+            uint32_t m_framesInFlight = 2;
             const char *m_appName;
             const int *m_version;
 
@@ -26,14 +70,95 @@ namespace engine
 
             QueueFamilyIndices m_queueFamilyIndices;
 
+            MemoryAllocator m_memoryAllocator;
+            UploadService m_uploadService;
+
             SwapchainData m_swapchainData;
+            // Set when the window is resized or the swapchain reports it is out of date
+            bool m_isSwapchainOutdated = false;
 
             CommandData m_commandData;
+            ParallelCommandRecorder m_commandRecorder;
+            RecordCommandsFunc m_recordDrawsFunc;
             vk::Queue m_graphicsQueue;
             vk::Queue m_presentationQueue;
+            // Locked around graphics and presentation queue access, the upload
+            // service submits to the same queue from other threads when the
+            // device has no separate transfer family
+            std::mutex m_queueMutex;
 
             RenderData m_renderData;
-            RenderSyncData m_renderSyncData;
+            vk::PipelineCache m_pipelineCache;
+            // One set of sync objects per frame in flight, indexed by
+            // m_currentFrameNumber % m_framesInFlight
+            vector<RenderSyncData> m_renderSyncData;
+            // Graphics timeline value of the frame currently using each swapchain image
+            vector<uint64_t> m_imagesInFlight;
+            // Counts graphics queue submits, frames wait on its values
+            QueueTimeline m_graphicsTimeline;
+            // Resources released while frames in flight may still use them
+            DeletionQueue m_deletionQueue;
+            // Buffers, images, samplers and pipelines referenced by handles
+            ResourceRegistry m_resources;
+            DescriptorLayoutCache m_descriptorLayoutCache;
+            // Per frame descriptor sets, reset when the frame slot is reused
+            DescriptorAllocator m_descriptorAllocator;
+            // Culls instances on the GPU and writes their indirect draws
+            GpuCulling m_gpuCulling;
+            // Enabled if the device supports task and mesh shaders
+            bool m_isMeshShaderEnabled = false;
+            // Culls meshlets with task shaders, or on the CPU without them
+            MeshletCulling m_meshletCulling;
+
+            // Draws the scene instances with indexed draws
+            MeshPipeline m_meshPipeline;
+            // Times the mesh pipeline creation with and without the pipeline cache after init
+            bool m_isPipelineBenchmarkEnabled = false;
+            // Mesh file loaded in init() if set, drawn as a grid of instances
+            std::string m_sceneFile;
+            uint32_t m_sceneInstanceCount = 1;
+            // Scene set with setScene(), its instance buffer lives in m_gpuCulling
+            MeshBuffers m_sceneMeshes;
+            vector<GpuInstance> m_sceneInstances;
+            SphereBounds m_sceneBounds;
+            // Selected level of each instance, kept across frames for the hysteresis
+            LodInstances m_sceneLods;
+            // Distance from the origin which bounds every instance
+            float m_sceneRadius = 0.0f;
+            Vec3 m_cameraPosition;
+            Vec3 m_cameraTarget;
+            Mat4 m_viewProjection;
+            // Visible instances of the frame, the draw list recordDraws()
+            // records in parallel. Built on the render thread with the draw state.
+            vector<uint32_t> m_drawList;
+            MeshDrawState m_meshDrawState;
+            DrawPath m_drawPath = DrawPath::GpuCulled;
+            // Path of the frame being recorded, m_drawPath unless it isn't supported
+            DrawPath m_frameDrawPath = DrawPath::Cpu;
+
+            GpuProfiler m_gpuProfiler;
+            // Chrome trace of the GPU zones is written here on exit if set
+            std::string m_gpuTraceFile;
+
+            // CPU side of every rendered frame, printed on exit next to the GPU
+            // frame time to show how much recording overlaps GPU work
+            struct FrameTimings
+            {
+                std::chrono::steady_clock::time_point lastFrameStart;
+                double frameMs = 0.0;
+                double waitMs = 0.0;
+                double recordMs = 0.0;
+                uint32_t frameCount = 0;
+                // Period of every frame after the first one, for the percentiles
+                vector<double> frameTimes;
+                // Totals of the meshlets culled on the CPU
+                uint64_t meshletCount = 0;
+                uint64_t frustumCulledTriangles = 0;
+                uint64_t backfaceCulledTriangles = 0;
+                // Totals of the instances drawn below level 0 and of the level switches
+                uint64_t simplifiedInstances = 0;
+                uint64_t lodChanges = 0;
+            } m_frameTimings;
 
             std::vector<const char *> getRequiredExtenstions() const;
             bool initSurface();
@@ -42,7 +167,26 @@ namespace engine
             bool initCommands();
             bool initRenderpass();
             bool initRenderSyncData();
+            bool initPipelineCache();
+            bool initGpuProfiler();
+            bool initGpuCulling();
+            bool initMeshletCulling();
+            bool initMeshPipeline();
+            bool initScene();
+            bool initUploadService();
+            bool initResources();
+            bool initDescriptors();
             bool initVulkan();
+            bool recreateSwapchain();
+            void printFrameTimings() const;
+            // Creates the mesh pipeline repeatedly with an empty cache and with m_pipelineCache
+            void benchmarkPipelineCreation();
+            // Culls the scene and resolves its draw state, called on the render thread before recording
+            void updateDrawList();
+            // Records the frame's primary command buffer. Returns the upload
+            // timeline value the frame has to wait for, 0 if none.
+            uint64_t recordFrame(const vk::CommandBuffer& cmdBuffer, uint32_t frameIndex, uint32_t imgIndex);
+            void recordDraws(const vk::CommandBuffer& cmdBuffer, uint32_t first, uint32_t count) const;
             bool cleanVulkan();
         protected:
             bool init() override;
@@ -51,12 +195,125 @@ namespace engine
             bool clean() override;
 
         public:
-            VulkanRenderer(Window &window, const char *appName, const int version[3], bool enableValidationLayers = true)
-                : Renderer(window, RendererType::Vulkan),
+            VulkanRenderer(Window &window, const char *appName, const int version[3], bool enableValidationLayers = true,
+                           uint32_t framesInFlight = 2, uint32_t threadCount = 0)
+                : Renderer(window, RendererType::Vulkan, threadCount),
                   m_isValidationLayerEnabled{enableValidationLayers},
+                  m_framesInFlight{std::max(framesInFlight, 1u)},
                   m_appName{appName},
                   m_version{version} {}
             ~VulkanRenderer() = default;
+
+            // Streams buffer and image data to the GPU on the transfer queue
+            inline UploadService& getUploadService()
+            {
+                return m_uploadService;
+            }
+
+            /**
+             * @brief Destroys a resource once every frame submitted so far,
+             * and the frame being recorded, has finished on the GPU
+             *
+             * @param destroyFunc Destroys the resource, called on the render thread
+             */
+            inline void deferDestroy(std::function<void()> destroyFunc)
+            {
+                m_deletionQueue.push(m_graphicsTimeline.getNextValue(), std::move(destroyFunc));
+            }
+
+            inline ResourceRegistry& getResources()
+            {
+                return m_resources;
+            }
+
+            inline DescriptorLayoutCache& getDescriptorLayoutCache()
+            {
+                return m_descriptorLayoutCache;
+            }
+
+            // Descriptor sets allocated from it are valid for the frame being recorded
+            inline DescriptorAllocator& getDescriptorAllocator()
+            {
+                return m_descriptorAllocator;
+            }
+
+            // GPU driven draw path, valid if the culling shader was found
+            inline GpuCulling& getGpuCulling()
+            {
+                return m_gpuCulling;
+            }
+
+            // Meshlet draw path of mesh files written with meshlets
+            inline MeshletCulling& getMeshletCulling()
+            {
+                return m_meshletCulling;
+            }
+
+            inline bool isMeshShaderEnabled() const
+            {
+                return m_isMeshShaderEnabled;
+            }
+
+            // Graphics timeline value of the frame being recorded. Resources
+            // released with it are destroyed once this frame has finished.
+            // Frame times of the frames rendered so far (Eg: after run() returned)
+            FrameTimeSummary getFrameTimeSummary() const;
+
+            inline uint64_t getFrameTimelineValue() const
+            {
+                return m_graphicsTimeline.getNextValue();
+            }
+
+            // Releases a resource once the frame being recorded has finished
+            template <typename Tag>
+            inline bool releaseResource(Handle<Tag> handle)
+            {
+                return m_resources.release(handle, m_graphicsTimeline.getNextValue());
+            }
+
+            /**
+             * @brief Replaces the scene drawn every frame. The instance data is
+             * uploaded on the transfer queue, frames in flight keep drawing the
+             * previous scene, whose buffers are released once they are done.
+             * Called from the render thread once the renderer is initialized.
+             *
+             * @param meshes Buffers of uploadMeshFile(), owned by the renderer from now on
+             * @param instances Instances of the meshes, meshIndex indexes meshes.draws
+             * @return false if the instances can't be uploaded
+             */
+            bool setScene(const MeshBuffers& meshes, const vector<GpuInstance>& instances);
+
+            // Camera the scene is drawn from, the projection follows the aspect ratio of the swapchain
+            inline void setCamera(const Vec3& position, const Vec3& target)
+            {
+                m_cameraPosition = position;
+                m_cameraTarget = target;
+            }
+
+            // Loads a mesh file in init() and draws instanceCount instances of
+            // its meshes on a grid, has to be called before run()
+            inline void setSceneFile(const std::string& path, uint32_t instanceCount)
+            {
+                m_sceneFile = path;
+                m_sceneInstanceCount = std::max(instanceCount, 1u);
+            }
+
+            // Prints cold and warm pipeline creation times during init, has to be called before run()
+            inline void setPipelineBenchmarkEnabled(bool enable)
+            {
+                m_isPipelineBenchmarkEnabled = enable;
+            }
+
+            // Selects how the scene is culled and drawn, has to be called before run()
+            inline void setDrawPath(DrawPath path)
+            {
+                m_drawPath = path;
+            }
+
+            inline void setGpuTraceFile(const std::string& path)
+            {
+                m_gpuTraceFile = path;
+            }
         };
     }
 }
@@ -1,11 +1,36 @@
 #include <vulkan/vulkan.hpp>
 #include "window.h"
+#include "core/profiler.h"
 
 void engine::Window::setWindowCloseListener(std::function<void()> callback)
 {
     m_onWindowClosed = callback;
 }
 
+void engine::Window::setWindowResizeListener(std::function<void(int, int)> callback)
+{
+    m_onWindowResized = callback;
+}
+
+void engine::Window::onFramebufferResized(GLFWwindow* window, int width, int height)
+{
+    Window* current = static_cast<Window*>(glfwGetWindowUserPointer(window));
+    if (current && current->m_onWindowResized)
+        current->m_onWindowResized(width, height);
+}
+
+void engine::Window::setKeyPressListener(std::function<void(int)> callback)
+{
+    m_onKeyPressed = callback;
+}
+
+void engine::Window::onKey(GLFWwindow* window, int key, int scancode, int action, int mods)
+{
+    Window* current = static_cast<Window*>(glfwGetWindowUserPointer(window));
+    if (action == GLFW_PRESS && current && current->m_onKeyPressed)
+        current->m_onKeyPressed(key);
+}
+
 void engine::Window::setWindowType(WindowType type)
 {
     m_type = type;
@@ -14,6 +39,9 @@ void engine::Window::setWindowType(WindowType type)
 // Utility functions
 std::array<int, 2> engine::Window::getWindowResolution() const
 {
+    if (m_isHeadless)
+        return std::array<int, 2>{this->width, this->height};
+
     int width = 0, height = 0;
     glfwGetFramebufferSize(m_current, &width, &height);
     return std::array<int, 2>{width, height};
@@ -28,6 +56,10 @@ std::vector<const char*> engine::Window::vkGetRequiredInstanceExtensions() const
         return {};
     }
 
+    // No presentation in headless mode, so no surface extensions are needed
+    if (m_isHeadless)
+        return {};
+
     uint32_t count = 0;
     const char** exts = glfwGetRequiredInstanceExtensions(&count);
     std::vector<const char*> reqExtensions(exts, exts + count);
@@ -44,6 +76,12 @@ VkResult engine::Window::vkGetWindowSurface(VkInstance instance,
         return {};
     }
 
+    if (m_isHeadless)
+    {
+        std::cerr << "Window Error: Headless window does not have a surface" << std::endl;
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+
     return glfwCreateWindowSurface(instance, m_current, allocator, surface);
 }
 
@@ -55,6 +93,9 @@ bool engine::Window::init()
         return false;
     }
 
+    if (m_isHeadless)
+        return true;
+
     if (!glfwInit())
     {
         cerr << "Window.init error: Failed to initialize glfw" << endl;
@@ -85,22 +126,43 @@ bool engine::Window::init()
         return false;
     }
 
+    glfwSetWindowUserPointer(m_current, this);
+    glfwSetFramebufferSizeCallback(m_current, &Window::onFramebufferResized);
+    glfwSetKeyCallback(m_current, &Window::onKey);
+
     return true;
 }
 
 void engine::Window::update()
 {
+    if (m_isHeadless)
+        return;
+
     if (glfwWindowShouldClose(m_current))
     {
         m_onWindowClosed();
         return;
     }
+
+    PROFILE_ZONE("PollEvents");
     glfwPollEvents();
 }
 
+void engine::Window::waitEvents()
+{
+    if (m_isHeadless)
+        return;
+
+    PROFILE_ZONE("WaitEvents");
+    glfwWaitEvents();
+}
+
 bool engine::Window::clean()
 {
     m_onWindowClosed = nullptr;
-    glfwTerminate();
+    m_onWindowResized = nullptr;
+    m_onKeyPressed = nullptr;
+    if (!m_isHeadless)
+        glfwTerminate();
     return true;
 }
\ No newline at end of file
@@ -36,21 +36,32 @@ namespace engine
     private:
         WindowType m_type = WindowType::None;
         GLFWwindow* m_current;
+        // Headless windows do not create a GLFW window or need a display.
+        // The renderer draws into offscreen images of width x height instead.
+        bool m_isHeadless = false;
 
         std::function<void()> m_onWindowClosed;
+        std::function<void(int, int)> m_onWindowResized;
+        std::function<void(int)> m_onKeyPressed;
+
+        static void onFramebufferResized(GLFWwindow* window, int width, int height);
+        static void onKey(GLFWwindow* window, int key, int scancode, int action, int mods);
 
     public:
         string name = "Window";
         int width = 1280;
         int height = 720;
 
-        Window(string name = "Window", int width = 1280, int height = 720)
-            : m_type{ WindowType::None }, name{ name }, width{ width }, height{ height } {}
+        Window(string name = "Window", int width = 1280, int height = 720, bool headless = false)
+            : m_type{ WindowType::None }, m_isHeadless{ headless }, name{ name }, width{ width }, height{ height } {}
 
         Window(const Window& window)
         {
             m_current = window.m_current;
+            m_isHeadless = window.m_isHeadless;
             m_onWindowClosed = window.m_onWindowClosed;
+            m_onWindowResized = window.m_onWindowResized;
+            m_onKeyPressed = window.m_onKeyPressed;
             name = window.name;
             width = window.height;
             height = window.height;
@@ -59,7 +70,10 @@ namespace engine
         Window& operator=(const Window& window)
         {
             m_current = window.m_current;
+            m_isHeadless = window.m_isHeadless;
             m_onWindowClosed = window.m_onWindowClosed;
+            m_onWindowResized = window.m_onWindowResized;
+            m_onKeyPressed = window.m_onKeyPressed;
             name = window.name;
             width = window.height;
             height = window.height;
@@ -72,11 +86,20 @@ namespace engine
         // }
 
         void setWindowCloseListener(std::function<void()> callback);
+        // Called with the new framebuffer resolution whenever it changes
+        void setWindowResizeListener(std::function<void(int, int)> callback);
+        // Called with the GLFW key code (Eg: GLFW_KEY_F12) when a key is pressed
+        void setKeyPressListener(std::function<void(int)> callback);
         void setWindowType(WindowType type);
 
         // Utility functions
         std::array<int, 2> getWindowResolution() const;
 
+        inline bool isHeadless() const
+        {
+            return m_isHeadless;
+        }
+
         // Vulkan API related functions
         std::vector<const char*> vkGetRequiredInstanceExtensions() const;
 
@@ -84,6 +107,8 @@ namespace engine
 
         bool init();
         void update();
+        // Blocks until an event is received (Eg: while minimized), returns immediately in headless mode
+        void waitEvents();
         bool clean();
     };
 }
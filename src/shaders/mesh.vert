@@ -0,0 +1,73 @@
+#version 450
+
+// Pulls the vertices of an indexed draw from the vertex buffer and places
+// them with the instance the draw's firstInstance selects
+
+struct Instance
+{
+    // Rows of the 3x4 world transform
+    mat3x4 transform;
+    vec4 boundingSphere;
+    uint meshIndex;
+    uint materialIndex;
+    uint pad0;
+    uint pad1;
+};
+
+// MeshVertex (8 words) or QuantizedVertex (4 words)
+layout(std430, set = 0, binding = 0) readonly buffer Vertices
+{
+    uint vertexWords[];
+};
+
+layout(std430, set = 0, binding = 1) readonly buffer Instances
+{
+    Instance instances[];
+};
+
+layout(push_constant) uniform DrawData
+{
+    mat4 viewProjection;
+    uint vertexFormat;
+};
+
+layout(location = 0) out vec3 outNormal;
+
+vec3 decodeOctahedral(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0)
+        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(n);
+}
+
+void loadVertex(uint vertex, out vec3 position, out vec3 normal)
+{
+    if (vertexFormat == 0)
+    {
+        uint word = vertex * 8;
+        position = uintBitsToFloat(uvec3(vertexWords[word], vertexWords[word + 1], vertexWords[word + 2]));
+        normal = uintBitsToFloat(uvec3(vertexWords[word + 3], vertexWords[word + 4], vertexWords[word + 5]));
+    }
+    else
+    {
+        uint word = vertex * 4;
+        position = vec3(unpackHalf2x16(vertexWords[word]), unpackHalf2x16(vertexWords[word + 1]).x);
+        normal = decodeOctahedral(unpackSnorm2x16(vertexWords[word + 2]));
+    }
+}
+
+void main()
+{
+    // gl_VertexIndex already includes the draw's vertexOffset, and
+    // gl_InstanceIndex its firstInstance
+    Instance instance = instances[gl_InstanceIndex];
+    vec3 position;
+    vec3 normal;
+    loadVertex(uint(gl_VertexIndex), position, normal);
+
+    // The rows are the columns of the mat3x4, so a row vector product applies them
+    vec3 worldPosition = vec4(position, 1.0) * instance.transform;
+    gl_Position = viewProjection * vec4(worldPosition, 1.0);
+    outNormal = vec4(normal, 0.0) * instance.transform;
+}
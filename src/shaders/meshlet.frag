@@ -0,0 +1,13 @@
+#version 450
+
+// Shades meshes and meshlets with a fixed directional light
+
+layout(location = 0) in vec3 inNormal;
+layout(location = 0) out vec4 outColor;
+
+void main()
+{
+    const vec3 lightDirection = normalize(vec3(0.4, 1.0, 0.3));
+    float diffuse = max(dot(normalize(inNormal), lightDirection), 0.0);
+    outColor = vec4(vec3(0.1 + 0.9 * diffuse), 1.0);
+}
@@ -0,0 +1,641 @@
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <core/culling.h>
+#include <core/handle_pool.h>
+#include <core/job_system.h>
+#include <core/math.h>
+#include <core/profiler.h>
+#include <core/scene.h>
+#include <vulkan/vulkan_memory_block.h>
+
+// Micro benchmarks of the CPU side engine systems.
+// Usage: EngineBenchmark [section...], runs every section if none is given.
+
+using Clock = std::chrono::steady_clock;
+
+static double elapsedMs(Clock::time_point start)
+{
+  return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// Mixed buffer and image sized requests churning through one 256 MiB block
+static void benchmarkMemoryBlock()
+{
+  const uint64_t blockSize = 256ull << 20;
+  const uint32_t operationCount = 1000000;
+  engine::vulkan::TlsfBlock block(blockSize);
+  std::mt19937 random(7);
+
+  struct Allocation
+  {
+    uint64_t offset;
+    uint32_t handle;
+  };
+  std::vector<Allocation> allocations;
+  allocations.reserve(operationCount);
+  uint32_t failedCount = 0;
+
+  Clock::time_point start = Clock::now();
+  for (uint32_t i = 0; i < operationCount; i++)
+  {
+    if (!allocations.empty() && random() % 2 == 0)
+    {
+      size_t index = random() % allocations.size();
+      block.free(allocations[index].handle);
+      allocations[index] = allocations.back();
+      allocations.pop_back();
+      continue;
+    }
+
+    Allocation allocation;
+    const uint64_t size = 256ull << (random() % 12);
+    if (block.allocate(size, 256, allocation.offset, allocation.handle))
+      allocations.push_back(allocation);
+    else
+      failedCount++;
+  }
+  const double churnMs = elapsedMs(start);
+  const engine::vulkan::MemoryBlockStatistics stats = block.getStatistics();
+
+  // Whole block requests, the worst case for the size class search
+  start = Clock::now();
+  const uint32_t wholeBlockCount = 100000;
+  engine::vulkan::TlsfBlock dedicated(40ull << 20);
+  for (uint32_t i = 0; i < wholeBlockCount; i++)
+  {
+    Allocation allocation;
+    if (dedicated.allocate(40ull << 20, 256, allocation.offset, allocation.handle))
+      dedicated.free(allocation.handle);
+  }
+  const double wholeBlockMs = elapsedMs(start);
+
+  std::cout << "TLSF: " << operationCount << " allocations and frees in " << churnMs << " ms ("
+            << churnMs * 1e6 / operationCount << " ns each, " << failedCount << " failed, fragmentation "
+            << stats.getFragmentation() << "), whole block allocation " << wholeBlockMs * 1e6 / wholeBlockCount
+            << " ns" << std::endl;
+}
+
+static uint64_t fibSerial(uint32_t n)
+{
+  return n < 2 ? n : fibSerial(n - 1) + fibSerial(n - 2);
+}
+
+// Recursive fork and join, the shape which makes work stealing pay off: one
+// branch is queued for thieves while the other one runs on the current thread
+static uint64_t fibJobs(engine::JobSystem &jobSystem, uint32_t n, uint32_t cutoff)
+{
+  if (n <= cutoff)
+    return fibSerial(n);
+  uint64_t a = 0;
+  engine::JobCounter counter;
+  jobSystem.run([&jobSystem, &a, n, cutoff]()
+                { a = fibJobs(jobSystem, n - 1, cutoff); },
+                &counter);
+  const uint64_t b = fibJobs(jobSystem, n - 2, cutoff);
+  jobSystem.wait(counter);
+  return a + b;
+}
+
+// Fixed amount of arithmetic standing in for the work of one job
+static float doWork(uint32_t iterations, float seed)
+{
+  float value = seed;
+  for (uint32_t i = 0; i < iterations; i++)
+    value = std::sqrt(value * 1.0001f + 0.5f);
+  return value;
+}
+
+// Frame shaped dependency graph: animation, then culling, then draw recording
+// slices, with uploads and a particle chain running beside them. Stages are
+// chained with runAfter() so no thread blocks between them.
+static double runMockFrameGraph(engine::JobSystem &jobSystem, std::vector<float> &results)
+{
+  const uint32_t iterations = 2000;
+  auto stage = [&jobSystem, &results](engine::JobCounter *dependency, uint32_t first, uint32_t count, engine::JobCounter &counter)
+  {
+    for (uint32_t i = first; i < first + count; i++)
+    {
+      auto job = [&results, i]()
+      { results[i] = doWork(iterations, results[i]); };
+      if (dependency)
+        jobSystem.runAfter(*dependency, job, &counter);
+      else
+        jobSystem.run(job, &counter);
+    }
+  };
+
+  engine::JobCounter animation;
+  engine::JobCounter culling;
+  engine::JobCounter recording;
+  engine::JobCounter uploads;
+  engine::JobCounter particles[4];
+  stage(nullptr, 0, 64, animation);
+  stage(&animation, 64, 32, culling);
+  stage(&culling, 96, 16, recording);
+  stage(nullptr, 112, 8, uploads);
+  stage(nullptr, 120, 2, particles[0]);
+  for (uint32_t i = 1; i < 4; i++)
+    stage(&particles[i - 1], 120 + 2 * i, 2, particles[i]);
+
+  jobSystem.wait(recording);
+  jobSystem.wait(uploads);
+  jobSystem.wait(particles[3]);
+  return results[100];
+}
+
+// Scaling of the job system with the thread count on fork and join recursion
+// and on a dependent job graph, plus the overhead of scheduling empty jobs
+static void benchmarkJobSystem()
+{
+  const uint32_t maxThreads = std::max(std::thread::hardware_concurrency(), 1u);
+
+  const uint32_t fibN = 30;
+  const uint32_t fibCutoff = 16;
+  double singleThreadMs = 0.0;
+  // At least up to 4 threads, so the sweep also shows oversubscription on small machines
+  const uint32_t sweepThreads = std::max(maxThreads, 4u);
+  for (uint32_t threadCount = 1; threadCount <= sweepThreads; threadCount *= 2)
+  {
+    engine::JobSystem jobSystem(threadCount);
+    Clock::time_point start = Clock::now();
+    const uint64_t result = fibJobs(jobSystem, fibN, fibCutoff);
+    const double ms = elapsedMs(start);
+    if (threadCount == 1)
+      singleThreadMs = ms;
+    std::cout << "Jobs: fib(" << fibN << ") = " << result << " with jobs above " << fibCutoff << " on " << threadCount
+              << " threads took " << ms << " ms (speedup " << singleThreadMs / ms << ")" << std::endl;
+  }
+
+  const uint32_t frameCount = 200;
+  std::vector<float> results(128, 1.0f);
+  for (uint32_t threadCount = 1; threadCount <= sweepThreads; threadCount *= 2)
+  {
+    engine::JobSystem jobSystem(threadCount);
+    double checksum = 0.0;
+    Clock::time_point start = Clock::now();
+    for (uint32_t frame = 0; frame < frameCount; frame++)
+      checksum += runMockFrameGraph(jobSystem, results);
+    const double ms = elapsedMs(start) / frameCount;
+    if (threadCount == 1)
+      singleThreadMs = ms;
+    std::cout << "Jobs: frame graph of 128 dependent jobs on " << threadCount << " threads took " << ms
+              << " ms per frame (speedup " << singleThreadMs / ms << ", checksum " << static_cast<uint64_t>(checksum) % 1000
+              << ")" << std::endl;
+  }
+
+  const uint32_t itemCount = 1 << 22;
+  std::vector<float> values(itemCount, 1.0f);
+  for (uint32_t threadCount = 1; threadCount <= maxThreads; threadCount *= 2)
+  {
+    engine::JobSystem jobSystem(threadCount);
+    Clock::time_point start = Clock::now();
+    for (uint32_t repeat = 0; repeat < 10; repeat++)
+    {
+      jobSystem.parallelFor(itemCount, 4096, [&values](uint32_t begin, uint32_t end)
+                            {
+                              for (uint32_t i = begin; i < end; i++)
+                                values[i] = std::sqrt(values[i] * 1.0001f + 0.5f);
+                            });
+    }
+    const double ms = elapsedMs(start);
+    if (threadCount == 1)
+      singleThreadMs = ms;
+    std::cout << "Jobs: parallelFor over " << itemCount << " items x 10 on " << threadCount << " threads took "
+              << ms << " ms (speedup " << singleThreadMs / ms << ")" << std::endl;
+  }
+
+  // Overhead of scheduling, the jobs themselves do nothing
+  engine::JobSystem jobSystem;
+  const uint32_t jobCount = 1000000;
+  std::atomic<uint32_t> executed{0};
+  engine::JobCounter counter;
+  Clock::time_point start = Clock::now();
+  for (uint32_t i = 0; i < jobCount; i++)
+    jobSystem.run([&executed]()
+                  { executed.fetch_add(1, std::memory_order_relaxed); },
+                  &counter);
+  jobSystem.wait(counter);
+  const double ms = elapsedMs(start);
+  std::cout << "Jobs: " << jobCount << " empty jobs on " << jobSystem.getThreadCount() << " threads took " << ms
+            << " ms (" << ms * 1e6 / jobCount << " ns each)" << std::endl;
+}
+
+// Resource churn through a handle pool, against a hash map keyed by id as
+// raw handles would be tracked without it
+static void benchmarkHandlePool()
+{
+  struct Resource
+  {
+    uint64_t vkHandle;
+    uint64_t size;
+  };
+  using Pool = engine::HandlePool<Resource>;
+
+  const uint32_t liveCount = 10000;
+  const uint32_t frameCount = 1000;
+  const uint32_t churnPerFrame = 100;
+  std::mt19937 random(7);
+
+  Pool pool;
+  pool.reserve(liveCount);
+  std::vector<Pool::HandleType> handles;
+  for (uint32_t i = 0; i < liveCount; i++)
+    handles.push_back(pool.create(Resource{i, i}));
+
+  uint64_t checksum = 0;
+  Clock::time_point start = Clock::now();
+  for (uint32_t frame = 0; frame < frameCount; frame++)
+  {
+    for (uint32_t i = 0; i < churnPerFrame; i++)
+    {
+      const size_t index = random() % handles.size();
+      pool.remove(handles[index]);
+      handles[index] = pool.create(Resource{frame, i});
+    }
+    // Every resource is looked up once a frame, then all of them are iterated
+    for (const Pool::HandleType &handle : handles)
+      checksum += pool.get(handle)->vkHandle;
+    for (const Resource &resource : pool)
+      checksum += resource.size;
+  }
+  const double poolMs = elapsedMs(start);
+
+  std::unordered_map<uint64_t, Resource> map;
+  std::vector<uint64_t> ids;
+  uint64_t nextId = 0;
+  for (uint32_t i = 0; i < liveCount; i++)
+  {
+    map.emplace(nextId, Resource{i, i});
+    ids.push_back(nextId++);
+  }
+
+  random.seed(7);
+  start = Clock::now();
+  for (uint32_t frame = 0; frame < frameCount; frame++)
+  {
+    for (uint32_t i = 0; i < churnPerFrame; i++)
+    {
+      const size_t index = random() % ids.size();
+      map.erase(ids[index]);
+      map.emplace(nextId, Resource{frame, i});
+      ids[index] = nextId++;
+    }
+    for (uint64_t id : ids)
+      checksum += map.find(id)->second.vkHandle;
+    for (const std::pair<const uint64_t, Resource> &entry : map)
+      checksum += entry.second.size;
+  }
+  const double mapMs = elapsedMs(start);
+
+  std::cout << "Handles: " << frameCount << " frames of " << churnPerFrame << " replacements, " << liveCount
+            << " lookups and iteration took " << poolMs << " ms with the pool, " << mapMs
+            << " ms with a hash map (checksum " << checksum % 1000 << ")" << std::endl;
+}
+
+// Frustum culling of a million spheres and boxes with each kernel, on one core
+static void benchmarkCulling()
+{
+  const uint32_t objectCount = 1000000;
+  const uint32_t repeatCount = 20;
+  std::mt19937 random(7);
+  std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+  std::uniform_real_distribution<float> size(0.1f, 5.0f);
+  engine::SphereBounds spheres;
+  engine::AabbBounds boxes;
+  spheres.reserve(objectCount);
+  boxes.reserve(objectCount);
+  for (uint32_t i = 0; i < objectCount; i++)
+  {
+    const float x = position(random), y = position(random), z = position(random), r = size(random);
+    spheres.add(x, y, z, r);
+    const float min[3] = {x - r, y - r, z - r};
+    const float max[3] = {x + r, y + r, z + r};
+    boxes.add(min, max);
+  }
+
+  const engine::Mat4 viewProjection = engine::Mat4::perspective(1.0f, 16.0f / 9.0f, 0.1f, 1000.0f)
+      * engine::Mat4::lookAt(engine::Vec3(0.0f, 50.0f, 400.0f), engine::Vec3(0.0f, 0.0f, 0.0f), engine::Vec3(0.0f, 1.0f, 0.0f));
+  const engine::Frustum frustum = engine::Frustum::fromMatrix(viewProjection.data());
+
+  const engine::CullingPath paths[] = {engine::CullingPath::Scalar, engine::CullingPath::Sse, engine::CullingPath::Avx2};
+  const char *pathNames[] = {"scalar", "SSE", "AVX2"};
+  std::vector<uint32_t> visible;
+  for (uint32_t p = 0; p < 3; p++)
+  {
+    // Paths which weren't compiled in fall back to narrower ones
+    if (paths[p] == engine::CullingPath::Avx2 && engine::getBestCullingPath() != engine::CullingPath::Avx2)
+      continue;
+
+    uint32_t sphereCount = 0;
+    Clock::time_point start = Clock::now();
+    for (uint32_t i = 0; i < repeatCount; i++)
+      sphereCount = engine::cullSpheres(frustum, spheres, visible, 0, UINT32_MAX, paths[p]);
+    const double sphereMs = elapsedMs(start) / repeatCount;
+
+    uint32_t boxCount = 0;
+    start = Clock::now();
+    for (uint32_t i = 0; i < repeatCount; i++)
+      boxCount = engine::cullAabbs(frustum, boxes, visible, 0, UINT32_MAX, paths[p]);
+    const double boxMs = elapsedMs(start) / repeatCount;
+
+    std::cout << "Culling (" << pathNames[p] << "): " << objectCount / sphereMs / 1e6 << " M spheres/ms ("
+              << sphereCount << " visible), " << objectCount / boxMs / 1e6 << " M boxes/ms (" << boxCount
+              << " visible) on one core" << std::endl;
+  }
+}
+
+// Batched transforms against naive scalar loops over the same data
+static void benchmarkMath()
+{
+  const uint32_t count = 1000000;
+  std::mt19937 random(7);
+  std::uniform_real_distribution<float> value(-10.0f, 10.0f);
+  std::vector<engine::Vec3> points(count);
+  std::vector<engine::Vec3> translations(count);
+  std::vector<engine::Vec3> scales(count, engine::Vec3(1.0f, 2.0f, 0.5f));
+  std::vector<engine::Quat> rotations(count);
+  for (uint32_t i = 0; i < count; i++)
+  {
+    points[i] = engine::Vec3(value(random), value(random), value(random));
+    translations[i] = engine::Vec3(value(random), value(random), value(random));
+    rotations[i] = engine::Quat::fromAxisAngle(engine::normalize(engine::Vec3(value(random), value(random), value(random))), value(random));
+  }
+  std::vector<engine::Mat4> matrices(count);
+  engine::composeTrs(translations.data(), rotations.data(), scales.data(), matrices.data(), count);
+  const engine::Mat4 transform = matrices[0];
+
+  // Scalar baseline, a column major multiply written out element by element
+  std::vector<engine::Vec3> transformed(count);
+  Clock::time_point start = Clock::now();
+  const float *m = transform.data();
+  for (uint32_t i = 0; i < count; i++)
+  {
+    const engine::Vec3 &p = points[i];
+    transformed[i] = engine::Vec3(m[0] * p.x + m[4] * p.y + m[8] * p.z + m[12],
+                                  m[1] * p.x + m[5] * p.y + m[9] * p.z + m[13],
+                                  m[2] * p.x + m[6] * p.y + m[10] * p.z + m[14]);
+  }
+  const double scalarPointsMs = elapsedMs(start);
+  start = Clock::now();
+  engine::transformPoints(transform, points.data(), transformed.data(), count);
+  const double pointsMs = elapsedMs(start);
+
+  std::vector<engine::Mat4> products(count);
+  start = Clock::now();
+  for (uint32_t i = 0; i < count; i++)
+  {
+    const float *a = transform.data();
+    const float *b = matrices[i].data();
+    float *out = products[i].data();
+    for (uint32_t column = 0; column < 4; column++)
+    {
+      for (uint32_t row = 0; row < 4; row++)
+        out[column * 4 + row] = a[row] * b[column * 4] + a[4 + row] * b[column * 4 + 1] + a[8 + row] * b[column * 4 + 2]
+            + a[12 + row] * b[column * 4 + 3];
+    }
+  }
+  const double scalarMatricesMs = elapsedMs(start);
+  start = Clock::now();
+  engine::multiplyMatrices(transform, matrices.data(), products.data(), count);
+  const double matricesMs = elapsedMs(start);
+
+  start = Clock::now();
+  engine::composeTrs(translations.data(), rotations.data(), scales.data(), matrices.data(), count);
+  const double trsMs = elapsedMs(start);
+
+  std::cout << "Math: " << count << " point transforms " << pointsMs << " ms (scalar " << scalarPointsMs << " ms), "
+            << "matrix multiplies " << matricesMs << " ms (scalar " << scalarMatricesMs << " ms), TRS compositions "
+            << trsMs << " ms (checksum " << transformed[count / 2].x + products[count / 2].data()[5] << ")" << std::endl;
+}
+
+// Scene updates of a 1M node tree after changing 1% and 100% of the local
+// transforms, and after reparenting 1% of the nodes, serially and on the job system
+static void benchmarkScene()
+{
+  const uint32_t count = 1000000;
+  const uint32_t fewCount = count / 100;
+  std::mt19937 random(7);
+  engine::Scene scene;
+  scene.reserve(count);
+  std::vector<engine::NodeHandle> nodes;
+  nodes.reserve(count);
+  // Eight children per node, seven levels
+  for (uint32_t i = 0; i < count; i++)
+    nodes.push_back(scene.createNode(i == 0 ? engine::NodeHandle() : nodes[(i - 1) / 8]));
+  scene.update();
+
+  engine::JobSystem jobSystem;
+  for (engine::JobSystem *jobs : {static_cast<engine::JobSystem *>(nullptr), &jobSystem})
+  {
+    // Leaves only, so 1% of the transforms changes 1% of the world matrices
+    const uint32_t firstLeaf = count - count * 7 / 8;
+    for (uint32_t i = 0; i < fewCount; i++)
+      scene.setTranslation(nodes[firstLeaf + random() % (count - firstLeaf)], engine::Vec3(1.0f, 0.0f, 0.0f));
+    Clock::time_point start = Clock::now();
+    const uint32_t fewUpdated = scene.update(jobs);
+    const double fewMs = elapsedMs(start);
+
+    for (uint32_t i = 0; i < count; i++)
+      scene.setTranslation(nodes[i], engine::Vec3(0.0f, 1.0f, 0.0f));
+    start = Clock::now();
+    const uint32_t allUpdated = scene.update(jobs);
+    const double allMs = elapsedMs(start);
+
+    // Moves leaves under other nodes a level up, which reorders the levels
+    uint32_t movedCount = 0;
+    for (uint32_t i = 0; i < fewCount; i++)
+    {
+      const uint32_t leaf = firstLeaf + random() % (count - firstLeaf);
+      if (scene.setParent(nodes[leaf], nodes[random() % 1000]))
+        movedCount++;
+    }
+    start = Clock::now();
+    const uint32_t movedUpdated = scene.update(jobs);
+    const double movedMs = elapsedMs(start);
+
+    std::cout << "Scene (" << (jobs ? "job system" : "serial") << "): " << count << " nodes, 1% changed " << fewMs
+              << " ms (" << fewUpdated << " updated), 100% changed " << allMs << " ms (" << allUpdated << " updated), "
+              << movedCount << " reparented " << movedMs << " ms (" << movedUpdated << " updated)" << std::endl;
+  }
+}
+
+// CPU side of recording 100k draws with the slicing of ParallelCommandRecorder:
+// one contiguous slice of the draw list per thread, each written into its own
+// command stream which is reset every frame like the per slice command pools.
+// The streams stand in for secondary command buffers, so this measures the
+// scaling of the slicing and the draw list walk without a GPU.
+static void benchmarkRecording()
+{
+  struct MeshDraw
+  {
+    uint32_t indexCount;
+    uint32_t firstIndex;
+    int32_t vertexOffset;
+  };
+  // Same layout as VkDrawIndexedIndirectCommand
+  struct DrawCommand
+  {
+    uint32_t indexCount;
+    uint32_t instanceCount;
+    uint32_t firstIndex;
+    int32_t vertexOffset;
+    uint32_t firstInstance;
+  };
+
+  const uint32_t drawCount = 100000;
+  const uint32_t meshCount = 64;
+  const uint32_t frameCount = 50;
+  std::mt19937 random(21);
+  std::vector<MeshDraw> meshes(meshCount);
+  for (uint32_t i = 0; i < meshCount; i++)
+    meshes[i] = {3 * (100 + static_cast<uint32_t>(random() % 5000)), i * 30000, static_cast<int32_t>(i * 10000)};
+  // Visible instances of a larger scene, in instance order like the output of cullSpheres()
+  std::vector<uint32_t> meshIndices(drawCount * 2);
+  for (uint32_t &meshIndex : meshIndices)
+    meshIndex = random() % meshCount;
+  std::vector<uint32_t> drawList;
+  for (uint32_t i = 0; i < meshIndices.size() && drawList.size() < drawCount; i++)
+  {
+    if (random() % 4 != 0)
+      drawList.push_back(i);
+  }
+
+  const uint32_t maxThreads = std::max(std::thread::hardware_concurrency(), 1u);
+  double singleThreadMs = 0.0;
+  for (uint32_t threadCount = 1; threadCount <= std::max(maxThreads, 4u); threadCount *= 2)
+  {
+    engine::JobSystem jobSystem(threadCount);
+    const uint32_t sliceCount = jobSystem.getThreadCount();
+    std::vector<std::vector<DrawCommand>> streams(sliceCount);
+    const uint32_t itemCount = static_cast<uint32_t>(drawList.size());
+    uint64_t checksum = 0;
+
+    Clock::time_point start = Clock::now();
+    for (uint32_t frame = 0; frame < frameCount; frame++)
+    {
+      jobSystem.parallelFor(sliceCount, 1, [&](uint32_t begin, uint32_t end)
+                            {
+                              for (uint32_t slice = begin; slice < end; slice++)
+                              {
+                                const uint32_t sliceSize = itemCount / sliceCount;
+                                const uint32_t remainder = itemCount % sliceCount;
+                                const uint32_t first = slice * sliceSize + std::min(slice, remainder);
+                                const uint32_t count = sliceSize + (slice < remainder ? 1 : 0);
+                                std::vector<DrawCommand> &stream = streams[slice];
+                                stream.clear();
+                                for (uint32_t i = first; i < first + count; i++)
+                                {
+                                  const uint32_t instance = drawList[i];
+                                  const MeshDraw &draw = meshes[meshIndices[instance]];
+                                  stream.push_back({draw.indexCount, 1, draw.firstIndex, draw.vertexOffset, instance});
+                                }
+                              }
+                            });
+      for (const std::vector<DrawCommand> &stream : streams)
+        checksum += stream.empty() ? 0 : stream.back().firstInstance;
+    }
+    const double ms = elapsedMs(start) / frameCount;
+    if (threadCount == 1)
+      singleThreadMs = ms;
+    std::cout << "Recording: " << itemCount << " draws on " << threadCount << " threads took " << ms
+              << " ms per frame (speedup " << singleThreadMs / ms << ", checksum " << checksum % 1000 << ")" << std::endl;
+  }
+}
+
+// Cost of a profiler zone on one thread and on several threads at once, and
+// of exporting full rings. Uses ProfileZone directly, so it doesn't depend on
+// ENGINE_ENABLE_PROFILER.
+static void benchmarkProfiler()
+{
+  const uint32_t zoneCount = 1 << 22;
+
+  // Two clock reads, the part of a zone which isn't the ring write
+  Clock::time_point start = Clock::now();
+  uint64_t checksum = 0;
+  for (uint32_t i = 0; i < zoneCount; i++)
+    checksum += engine::Profiler::now() ^ engine::Profiler::now();
+  const double clockMs = elapsedMs(start);
+
+  start = Clock::now();
+  for (uint32_t i = 0; i < zoneCount; i++)
+    engine::ProfileZone zone("BenchmarkZone");
+  const double zoneMs = elapsedMs(start);
+  std::cout << "Profiler: " << zoneCount << " zones took " << zoneMs << " ms (" << zoneMs * 1e6 / zoneCount
+            << " ns per zone, " << clockMs * 1e6 / zoneCount << " ns of it reading the clock twice, checksum "
+            << checksum % 1000 << ")" << std::endl;
+
+  // Every thread writes its own ring, so the cost per zone shouldn't grow with the thread count
+  const uint32_t maxThreads = std::max(std::thread::hardware_concurrency(), 1u);
+  for (uint32_t threadCount = 2; threadCount <= std::max(maxThreads, 4u); threadCount *= 2)
+  {
+    std::vector<std::thread> threads;
+    start = Clock::now();
+    for (uint32_t t = 0; t < threadCount; t++)
+    {
+      threads.emplace_back([zoneCount]()
+                           {
+                             for (uint32_t i = 0; i < zoneCount; i++)
+                               engine::ProfileZone zone("BenchmarkZone");
+                           });
+    }
+    for (std::thread &thread : threads)
+      thread.join();
+    const double ms = elapsedMs(start);
+    std::cout << "Profiler: " << zoneCount << " zones on each of " << threadCount << " threads took " << ms << " ms ("
+              << ms * 1e6 / zoneCount << " ns per zone and thread)" << std::endl;
+  }
+
+  // Export of the full rings of every thread above
+  engine::Profiler::markFrame(0);
+  for (uint32_t i = 0; i < zoneCount; i++)
+    engine::ProfileZone zone("BenchmarkZone");
+  const std::filesystem::path path = std::filesystem::temp_directory_path() / "engine_benchmark_trace.json";
+  start = Clock::now();
+  const bool isWritten = engine::Profiler::writeChromeTrace(path.string(), 1);
+  const double exportMs = elapsedMs(start);
+  std::cout << "Profiler: exporting the rings " << (isWritten ? "took " : "failed after ") << exportMs << " ms ("
+            << (isWritten ? std::filesystem::file_size(path) >> 10 : 0) << " KiB)" << std::endl;
+  std::filesystem::remove(path);
+}
+
+int main(int argc, char **argv)
+{
+  auto isSelected = [argc, argv](const char *section)
+  {
+    if (argc < 2)
+      return true;
+    for (int i = 1; i < argc; i++)
+    {
+      if (strcmp(argv[i], section) == 0)
+        return true;
+    }
+    return false;
+  };
+
+  if (isSelected("memory"))
+    benchmarkMemoryBlock();
+  if (isSelected("jobs"))
+    benchmarkJobSystem();
+  if (isSelected("handles"))
+    benchmarkHandlePool();
+  if (isSelected("culling"))
+    benchmarkCulling();
+  if (isSelected("math"))
+    benchmarkMath();
+  if (isSelected("scene"))
+    benchmarkScene();
+  if (isSelected("recording"))
+    benchmarkRecording();
+  if (isSelected("profiler"))
+    benchmarkProfiler();
+  return 0;
+}
@@ -0,0 +1,396 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <core/job_system.h>
+#include <core/lod.h>
+#include <core/mapped_file.h>
+#include <core/math.h>
+#include <core/mesh_file.h>
+#include <core/mesh_optimizer.h>
+#include <core/obj_loader.h>
+#include <gltf_importer.h>
+
+using engine::MeshData;
+
+static bool endsWith(const std::string &text, const std::string &suffix)
+{
+  return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// Culls the meshlets of every mesh from cameras circling the meshes and prints the share of triangles culled
+static void benchmarkMeshletCulling(const engine::MeshFile &file)
+{
+  using Clock = std::chrono::steady_clock;
+  const engine::MeshFileEntry *entries = file.getMeshes();
+  engine::Vec3 center;
+  for (uint32_t i = 0; i < file.getMeshCount(); i++)
+    center = center + engine::Vec3(entries[i].boundsCenter[0], entries[i].boundsCenter[1], entries[i].boundsCenter[2]) * (1.0f / file.getMeshCount());
+  float radius = 0.0f;
+  for (uint32_t i = 0; i < file.getMeshCount(); i++)
+  {
+    const engine::Vec3 meshCenter(entries[i].boundsCenter[0], entries[i].boundsCenter[1], entries[i].boundsCenter[2]);
+    radius = std::max(radius, engine::length(meshCenter - center) + entries[i].boundsRadius);
+  }
+
+  // Views from all around and above, close enough that part of the meshes is off screen
+  const uint32_t viewCount = 16;
+  const engine::Mat4 projection = engine::Mat4::perspective(1.0f, 16.0f / 9.0f, radius * 0.01f, radius * 10.0f);
+  const engine::Mat4 transform = engine::Mat4::identity();
+  engine::MeshletCullStats stats;
+  std::vector<uint32_t> visible;
+  uint64_t visibleTriangles = 0;
+  double cullMs = 0.0;
+  for (uint32_t v = 0; v < viewCount; v++)
+  {
+    const float angle = 6.2831853f * v / viewCount;
+    const engine::Vec3 eye = center + engine::normalize(engine::Vec3(std::cos(angle), 0.5f, std::sin(angle))) * (radius * 1.5f);
+    const engine::Mat4 viewProjection = projection * engine::Mat4::lookAt(eye, center, engine::Vec3(0.0f, 1.0f, 0.0f));
+    const engine::Frustum frustum = engine::Frustum::fromMatrix(viewProjection.data());
+
+    Clock::time_point start = Clock::now();
+    for (uint32_t i = 0; i < file.getMeshCount(); i++)
+    {
+      const engine::Meshlet *meshlets = file.getMeshlets() + entries[i].firstMeshlet;
+      engine::cullMeshlets(frustum, eye, transform, meshlets, entries[i].meshletCount, visible, &stats);
+      for (uint32_t index : visible)
+        visibleTriangles += meshlets[index].triangleCount;
+    }
+    cullMs += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+  }
+
+  const double triangles = static_cast<double>(file.getIndexCount() / 3) * viewCount;
+  std::cout << file.getMeshletCount() << " meshlets, " << double(file.getMeshletVertexCount()) / file.getMeshletCount()
+            << " vertices and " << double(file.getIndexCount() / 3) / file.getMeshletCount() << " triangles on average" << std::endl;
+  std::cout << "Meshlet culling over " << viewCount << " views: " << 100.0 * stats.frustumCulledTriangles / triangles
+            << "% of triangles outside the frustum, " << 100.0 * stats.backfaceCulledTriangles / triangles
+            << "% backfacing, " << 100.0 * visibleTriangles / triangles << "% drawn, "
+            << cullMs / viewCount << " ms per view" << std::endl;
+}
+
+// Flies a camera over a generated field of instances of the meshes with levels, selects their
+// levels every frame and prints the triangles saved, the selection time of each instruction set
+// and how often levels change with and without hysteresis
+static void benchmarkLodSelection(const engine::MeshFile &file)
+{
+  using Clock = std::chrono::steady_clock;
+  const engine::MeshFileEntry *entries = file.getMeshes();
+  const engine::MeshFileLod *lods = file.getLods();
+  std::vector<uint32_t> meshIndices;
+  float spacing = 0.0f;
+  for (uint32_t i = 0; i < file.getMeshCount(); i++)
+  {
+    if (entries[i].lodCount > 1)
+    {
+      meshIndices.push_back(i);
+      spacing = std::max(spacing, entries[i].boundsRadius * 4.0f);
+    }
+  }
+  if (meshIndices.empty() || spacing <= 0.0f)
+    return;
+
+  // Grid of instances with scales from 0.5 to 1.5, the same every run
+  const uint32_t side = 256;
+  engine::SphereBounds bounds;
+  engine::LodInstances instances;
+  std::vector<uint32_t> instanceMeshes;
+  bounds.reserve(side * side);
+  instances.reserve(side * side);
+  uint32_t random = 12345;
+  float levelErrors[engine::MAX_LOD_COUNT];
+  for (uint32_t z = 0; z < side; z++)
+  {
+    for (uint32_t x = 0; x < side; x++)
+    {
+      random = random * 1664525u + 1013904223u;
+      const float scale = 0.5f + (random >> 8) / float(1u << 24);
+      const uint32_t mesh = meshIndices[(x + z * side) % meshIndices.size()];
+      const engine::MeshFileEntry &entry = entries[mesh];
+      const engine::Vec3 center = engine::Vec3(x * spacing, 0.0f, z * spacing)
+        + engine::Vec3(entry.boundsCenter[0], entry.boundsCenter[1], entry.boundsCenter[2]) * scale;
+      for (uint32_t level = 0; level < entry.lodCount; level++)
+        levelErrors[level] = lods[entry.firstLod + level].error;
+      bounds.add(center.x, center.y, center.z, entry.boundsRadius * scale);
+      instances.add(center, entry.boundsRadius * scale, levelErrors, entry.lodCount, scale);
+      instanceMeshes.push_back(mesh);
+    }
+  }
+
+  const engine::CullingPath paths[] = { engine::CullingPath::Scalar, engine::CullingPath::Sse, engine::CullingPath::Avx2 };
+  const char *pathNames[] = { "scalar", "SSE", "AVX2" };
+  engine::LodInstances pathInstances[3] = { instances, instances, instances };
+  engine::LodInstances noHysteresis = instances;
+  double pathMs[3] = { 0.0, 0.0, 0.0 };
+  bool isMatching = true;
+
+  // 1080p camera moving slowly along the diagonal of the field and shaking back and forth
+  // every frame, which keeps instances sitting at a switch distance crossing it
+  const uint32_t frameCount = 240;
+  const float fovY = 1.0f;
+  engine::LodSettings settings;
+  settings.pixelsPerUnit = engine::getPixelsPerUnit(fovY, 1080.0f);
+  settings.maxPixelError = 1.0f;
+  engine::LodSettings noHysteresisSettings = settings;
+  noHysteresisSettings.hysteresis = 0.0f;
+  const engine::Mat4 projection = engine::Mat4::perspective(fovY, 16.0f / 9.0f, spacing * 0.01f, spacing * 64.0f);
+  const engine::Vec3 forward = engine::normalize(engine::Vec3(1.0f, 0.0f, 1.0f));
+  std::vector<uint32_t> visible;
+
+  // Every instance starts at the level of the first camera position, so instances coming into
+  // view aren't counted as changes
+  std::vector<uint32_t> allInstances(instances.size());
+  for (uint32_t i = 0; i < instances.size(); i++)
+    allInstances[i] = i;
+  settings.cameraPosition = engine::Vec3(0.0f, spacing * 0.5f, 0.0f);
+  for (engine::LodInstances &pathInstance : pathInstances)
+    engine::selectLods(settings, pathInstance, allInstances.data(), instances.size());
+  noHysteresisSettings.cameraPosition = settings.cameraPosition;
+  engine::selectLods(noHysteresisSettings, noHysteresis, allInstances.data(), instances.size());
+
+  uint64_t visibleCount = 0;
+  uint64_t fullTriangles = 0;
+  uint64_t lodTriangles = 0;
+  uint64_t changes = 0;
+  uint64_t noHysteresisChanges = 0;
+  uint64_t levelInstances[engine::MAX_LOD_COUNT] = {};
+  for (uint32_t frame = 0; frame < frameCount; frame++)
+  {
+    const float travel = spacing * 16.0f * frame / frameCount + spacing * ((frame & 1) ? 0.25f : -0.25f);
+    const engine::Vec3 eye = engine::Vec3(0.0f, spacing * 0.5f, 0.0f) + forward * travel;
+    const engine::Mat4 viewProjection = projection * engine::Mat4::lookAt(eye, eye + forward + engine::Vec3(0.0f, -0.2f, 0.0f), engine::Vec3(0.0f, 1.0f, 0.0f));
+    const uint32_t count = engine::cullSpheres(engine::Frustum::fromMatrix(viewProjection.data()), bounds, visible);
+    settings.cameraPosition = eye;
+    noHysteresisSettings.cameraPosition = eye;
+
+    for (uint32_t p = 0; p < 3; p++)
+    {
+      Clock::time_point start = Clock::now();
+      const uint32_t changed = engine::selectLods(settings, pathInstances[p], visible.data(), count, paths[p]);
+      pathMs[p] += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+      if (p == 0)
+        changes += changed;
+      isMatching &= pathInstances[p].lods == pathInstances[0].lods;
+    }
+    noHysteresisChanges += engine::selectLods(noHysteresisSettings, noHysteresis, visible.data(), count);
+
+    visibleCount += count;
+    for (uint32_t index : visible)
+    {
+      const engine::MeshFileEntry &entry = entries[instanceMeshes[index]];
+      fullTriangles += entry.indexCount / 3;
+      lodTriangles += lods[entry.firstLod + pathInstances[0].lods[index]].indexCount / 3;
+      levelInstances[pathInstances[0].lods[index]]++;
+    }
+  }
+
+  std::cout << "LOD selection over " << frameCount << " frames of " << instances.size() << " instances, "
+            << double(visibleCount) / frameCount << " visible per frame" << std::endl;
+  std::cout << "Visible instances per level:";
+  for (uint32_t level = 0; level < engine::MAX_LOD_COUNT; level++)
+    std::cout << " " << double(levelInstances[level]) / frameCount;
+  std::cout << std::endl;
+  std::cout << "Triangles per frame: " << double(fullTriangles) / frameCount / 1e6 << " M at full detail, "
+            << double(lodTriangles) / frameCount / 1e6 << " M with levels ("
+            << 100.0 * (1.0 - double(lodTriangles) / std::max<uint64_t>(fullTriangles, 1)) << "% fewer)" << std::endl;
+  std::cout << "Selection per frame:";
+  for (uint32_t p = 0; p < 3; p++)
+    std::cout << " " << pathNames[p] << " " << pathMs[p] / frameCount << " ms";
+  std::cout << (isMatching ? "" : " (paths disagree)") << std::endl;
+  std::cout << "Level changes per frame: " << double(changes) / frameCount << " with hysteresis, "
+            << double(noHysteresisChanges) / frameCount << " without" << std::endl;
+}
+
+// Converts source meshes (.obj, .gltf or .glb) to the packed mesh files the engine maps at runtime.
+// glTF primitives become one mesh each, in file order.
+// Usage: MeshConverter <input> <output.mesh> [--optimize] [--quantize] [--meshlets] [--lods] [--benchmark]
+// --optimize reorders triangles and vertices for the vertex cache, overdraw and vertex fetch,
+//   and prints the simulated cache miss ratios before and after.
+// --quantize stores QuantizedVertex (half float positions and uvs, octahedral normals).
+// --meshlets splits the meshes into meshlets for cluster culling and mesh shaders.
+// --lods adds simplified levels of detail, each with about half the triangles of the previous one.
+// --benchmark maps the written file back, checks it and compares its load time with parsing the source.
+//   With --meshlets it also culls the meshlets from a ring of cameras,
+//   with --lods it selects levels for a generated field of instances.
+int main(int argc, char **argv)
+{
+  if (argc < 3)
+  {
+    std::cerr << "Usage: " << argv[0] << " <input.obj|input.gltf|input.glb> <output.mesh> [--optimize] [--quantize] [--meshlets] [--lods] [--benchmark]" << std::endl;
+    return 1;
+  }
+  const std::string inputPath = argv[1];
+  const std::string outputPath = argv[2];
+  bool optimize = false;
+  bool withMeshlets = false;
+  bool withLods = false;
+  bool benchmark = false;
+  engine::MeshVertexFormat vertexFormat = engine::MeshVertexFormat::Float;
+  for (int i = 3; i < argc; i++)
+  {
+    if (strcmp(argv[i], "--optimize") == 0)
+      optimize = true;
+    else if (strcmp(argv[i], "--quantize") == 0)
+      vertexFormat = engine::MeshVertexFormat::Quantized;
+    else if (strcmp(argv[i], "--meshlets") == 0)
+      withMeshlets = true;
+    else if (strcmp(argv[i], "--lods") == 0)
+      withLods = true;
+    else if (strcmp(argv[i], "--benchmark") == 0)
+      benchmark = true;
+  }
+
+  using Clock = std::chrono::steady_clock;
+  auto elapsedMs = [](Clock::time_point start)
+  {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+  };
+
+  engine::JobSystem jobSystem;
+  Clock::time_point parseStart = Clock::now();
+  std::vector<MeshData> meshes;
+  if (endsWith(inputPath, ".gltf") || endsWith(inputPath, ".glb"))
+  {
+    engine::gltf::GltfScene scene;
+    if (!engine::gltf::importGltf(inputPath, scene, &jobSystem))
+      return 1;
+    meshes = std::move(scene.primitives);
+  }
+  else if (!engine::loadObj(inputPath, meshes))
+    return 1;
+  const double parseMs = elapsedMs(parseStart);
+
+  // Totals over every mesh, with the FIFO cache size the optimizations target
+  auto printCacheStats = [&meshes](const char *label)
+  {
+    uint64_t misses = 0;
+    uint64_t triangles = 0;
+    uint64_t vertices = 0;
+    for (const MeshData &mesh : meshes)
+    {
+      misses += engine::analyzeVertexCache(mesh.indices.data(), mesh.indices.size(), static_cast<uint32_t>(mesh.vertices.size())).misses;
+      triangles += mesh.indices.size() / 3;
+      vertices += mesh.vertices.size();
+    }
+    std::cout << label << ": ACMR " << (triangles ? double(misses) / triangles : 0.0)
+              << ", ATVR " << (vertices ? double(misses) / vertices : 0.0) << std::endl;
+  };
+
+  if (optimize)
+  {
+    printCacheStats("Before optimization");
+    Clock::time_point optimizeStart = Clock::now();
+    jobSystem.parallelFor(static_cast<uint32_t>(meshes.size()), 1, [&meshes](uint32_t begin, uint32_t end)
+                          {
+                            for (uint32_t i = begin; i < end; i++)
+                              engine::optimizeMesh(meshes[i]);
+                          });
+    const double optimizeMs = elapsedMs(optimizeStart);
+    printCacheStats("After optimization");
+    std::cout << "Optimization took " << optimizeMs << " ms" << std::endl;
+  }
+
+  // Levels are simplified from the optimized meshes, then get their own vertex cache order
+  std::vector<std::vector<engine::MeshLod>> lods(withLods ? meshes.size() : 0);
+  if (withLods)
+  {
+    Clock::time_point lodStart = Clock::now();
+    jobSystem.parallelFor(static_cast<uint32_t>(meshes.size()), 1, [&meshes, &lods, optimize](uint32_t begin, uint32_t end)
+                          {
+                            for (uint32_t i = begin; i < end; i++)
+                            {
+                              engine::buildLods(meshes[i], lods[i]);
+                              if (!optimize)
+                                continue;
+                              for (engine::MeshLod &lod : lods[i])
+                                engine::optimizeVertexCache(lod.indices, static_cast<uint32_t>(meshes[i].vertices.size()));
+                            }
+                          });
+    const double lodMs = elapsedMs(lodStart);
+
+    // Totals per level, meshes with fewer levels count their coarsest one
+    uint64_t triangles[engine::MAX_LOD_COUNT] = {};
+    float errors[engine::MAX_LOD_COUNT] = {};
+    size_t levelCount = 1;
+    for (size_t i = 0; i < meshes.size(); i++)
+    {
+      levelCount = std::max(levelCount, lods[i].size() + 1);
+      for (uint32_t level = 0; level < engine::MAX_LOD_COUNT; level++)
+      {
+        const size_t coarsest = std::min<size_t>(level, lods[i].size());
+        triangles[level] += (coarsest == 0 ? meshes[i].indices.size() : lods[i][coarsest - 1].indices.size()) / 3;
+        errors[level] = std::max(errors[level], coarsest == 0 ? 0.0f : lods[i][coarsest - 1].error);
+      }
+    }
+    for (size_t level = 0; level < levelCount; level++)
+      std::cout << "Level " << level << ": " << triangles[level] << " triangles ("
+                << 100.0 * triangles[level] / std::max<uint64_t>(triangles[0], 1) << "%), error " << errors[level] << std::endl;
+    std::cout << "Building levels took " << lodMs << " ms" << std::endl;
+  }
+
+  // Meshlets reorder the triangles, so they are built after the optimizations
+  std::vector<engine::MeshletData> meshlets(withMeshlets ? meshes.size() : 0);
+  if (withMeshlets)
+  {
+    Clock::time_point meshletStart = Clock::now();
+    jobSystem.parallelFor(static_cast<uint32_t>(meshes.size()), 1, [&meshes, &meshlets](uint32_t begin, uint32_t end)
+                          {
+                            for (uint32_t i = begin; i < end; i++)
+                              engine::buildMeshlets(meshes[i], meshlets[i]);
+                          });
+    const double meshletMs = elapsedMs(meshletStart);
+    if (optimize)
+      printCacheStats("In meshlet order");
+    std::cout << "Building meshlets took " << meshletMs << " ms" << std::endl;
+  }
+
+  size_t vertexCount = 0;
+  size_t indexCount = 0;
+  for (const MeshData &mesh : meshes)
+  {
+    vertexCount += mesh.vertices.size();
+    indexCount += mesh.indices.size();
+  }
+
+  if (!engine::writeMeshFile(outputPath, meshes, vertexFormat, withMeshlets ? &meshlets : nullptr, withLods ? &lods : nullptr))
+    return 1;
+  std::cout << "Wrote " << meshes.size() << " meshes, " << vertexCount << " vertices ("
+            << vertexCount * engine::getVertexStride(vertexFormat) << " bytes) and "
+            << indexCount << " indices to " << outputPath << std::endl;
+
+  if (benchmark)
+  {
+    // Touches every byte, like the upload into the staging ring does
+    Clock::time_point loadStart = Clock::now();
+    engine::MeshFile file;
+    if (!file.open(outputPath))
+      return 1;
+    uint64_t checksum = 0;
+    const uint32_t *words = static_cast<const uint32_t *>(file.getVertexData());
+    for (uint64_t i = 0; i < file.getVertexCount() * file.getVertexStride() / 4; i++)
+      checksum += words[i];
+    for (uint64_t i = 0; i < file.getIndexCount(); i++)
+      checksum += file.getIndices()[i];
+    const double loadMs = elapsedMs(loadStart);
+
+    if (file.getMeshCount() != meshes.size() || file.getVertexCount() != vertexCount || file.getIndexCount() != indexCount)
+    {
+      std::cerr << "Mesh file " << outputPath << " does not match the source" << std::endl;
+      return 1;
+    }
+    // Throughput over the source file only, external glTF buffers aren't counted
+    engine::MappedFile source;
+    const double sourceMb = source.open(inputPath) ? source.size() / (1024.0 * 1024.0) : 0.0;
+    std::cout << "Parsing the source took " << parseMs << " ms (" << sourceMb * 1000.0 / parseMs
+              << " MB/s), mapping the mesh file took " << loadMs << " ms (checksum " << checksum << ")" << std::endl;
+    if (file.getMeshletCount() > 0)
+      benchmarkMeshletCulling(file);
+    if (file.getLodCount() > 0)
+      benchmarkLodSelection(file);
+  }
+  return 0;
+}
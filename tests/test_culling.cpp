@@ -0,0 +1,214 @@
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include <core/culling.h>
+#include <core/math.h>
+
+#include "test_utils.h"
+
+using namespace engine;
+
+static const CullingPath PATHS[] = {CullingPath::Scalar, CullingPath::Sse, CullingPath::Avx2, CullingPath::Best};
+
+static Frustum createFrustum()
+{
+  const Mat4 viewProjection = Mat4::perspective(1.0f, 16.0f / 9.0f, 0.5f, 80.0f)
+      * Mat4::lookAt(Vec3(5.0f, 8.0f, 40.0f), Vec3(0.0f, 0.0f, 0.0f), Vec3(0.0f, 1.0f, 0.0f));
+  return Frustum::fromMatrix(viewProjection.data());
+}
+
+static float getPlaneDistance(const Frustum &frustum, uint32_t plane, const float point[3])
+{
+  const float *p = frustum.planes[plane];
+  return p[0] * point[0] + p[1] * point[1] + p[2] * point[2] + p[3];
+}
+
+// Spheres and boxes around the frustum, none of them within a small margin of
+// a plane. The SIMD kernels use FMA and a different summation order, so
+// results right at a plane may differ in the last bit between paths.
+static void createBounds(const Frustum &frustum, uint32_t count, SphereBounds &spheres, AabbBounds &boxes)
+{
+  std::mt19937 random(11);
+  std::uniform_real_distribution<float> position(-60.0f, 60.0f);
+  std::uniform_real_distribution<float> size(0.05f, 3.0f);
+  while (spheres.size() < count)
+  {
+    const float center[3] = {position(random), position(random), position(random)};
+    const float r = size(random);
+    bool isNearPlane = false;
+    for (uint32_t p = 0; p < Frustum::Count; p++)
+      isNearPlane = isNearPlane || std::fabs(getPlaneDistance(frustum, p, center) + r) < 1e-3f;
+    if (!isNearPlane)
+      spheres.add(center[0], center[1], center[2], r);
+  }
+  while (boxes.size() < count)
+  {
+    const float center[3] = {position(random), position(random), position(random)};
+    const float extent[3] = {size(random), size(random), size(random)};
+    bool isNearPlane = false;
+    for (uint32_t p = 0; p < Frustum::Count; p++)
+    {
+      const float *n = frustum.planes[p];
+      const float r = std::fabs(n[0]) * extent[0] + std::fabs(n[1]) * extent[1] + std::fabs(n[2]) * extent[2];
+      isNearPlane = isNearPlane || std::fabs(getPlaneDistance(frustum, p, center) + r) < 1e-3f;
+    }
+    if (isNearPlane)
+      continue;
+    const float min[3] = {center[0] - extent[0], center[1] - extent[1], center[2] - extent[2]};
+    const float max[3] = {center[0] + extent[0], center[1] + extent[1], center[2] + extent[2]};
+    boxes.add(min, max);
+  }
+}
+
+// Objects in front of the camera are visible, behind or beyond the far plane they aren't
+static void testKnownObjects()
+{
+  const Frustum frustum = createFrustum();
+  SphereBounds spheres;
+  spheres.add(0.0f, 0.0f, 0.0f, 1.0f);
+  spheres.add(0.0f, 0.0f, 80.0f, 1.0f);
+  spheres.add(0.0f, 0.0f, -200.0f, 1.0f);
+  // Huge sphere behind the camera which still reaches into the frustum
+  spheres.add(0.0f, 0.0f, 60.0f, 30.0f);
+  AabbBounds boxes;
+  const float boxMin[4][3] = {{-1.0f, -1.0f, -1.0f}, {-1.0f, -1.0f, 79.0f}, {-1.0f, -1.0f, -201.0f}, {-30.0f, -30.0f, 30.0f}};
+  const float boxMax[4][3] = {{1.0f, 1.0f, 1.0f}, {1.0f, 1.0f, 81.0f}, {1.0f, 1.0f, -199.0f}, {30.0f, 30.0f, 90.0f}};
+  for (uint32_t i = 0; i < 4; i++)
+    boxes.add(boxMin[i], boxMax[i]);
+
+  const std::vector<uint32_t> expected{0, 3};
+  for (CullingPath path : PATHS)
+  {
+    std::vector<uint32_t> visible;
+    CHECK(cullSpheres(frustum, spheres, visible, 0, UINT32_MAX, path) == 2);
+    CHECK(visible == expected);
+    CHECK(cullAabbs(frustum, boxes, visible, 0, UINT32_MAX, path) == 2);
+    CHECK(visible == expected);
+  }
+}
+
+// Every path returns the same list as the scalar one, for ranges which don't
+// start or end on a SIMD width
+static void testPathsMatchScalar()
+{
+  const Frustum frustum = createFrustum();
+  SphereBounds spheres;
+  AabbBounds boxes;
+  createBounds(frustum, 10007, spheres, boxes);
+
+  const uint32_t ranges[][2] = {{0, UINT32_MAX}, {0, 5}, {3, 1001}, {9000, 2000}, {10006, 1}, {10007, 10}};
+  for (const uint32_t *range : ranges)
+  {
+    std::vector<uint32_t> expectedSpheres;
+    std::vector<uint32_t> expectedBoxes;
+    cullSpheres(frustum, spheres, expectedSpheres, range[0], range[1], CullingPath::Scalar);
+    cullAabbs(frustum, boxes, expectedBoxes, range[0], range[1], CullingPath::Scalar);
+
+    // The scalar reference is in range and ascending
+    bool isSorted = true;
+    for (size_t i = 0; i < expectedSpheres.size(); i++)
+      isSorted = isSorted && expectedSpheres[i] >= range[0] && (i == 0 || expectedSpheres[i - 1] < expectedSpheres[i]);
+    CHECK(isSorted);
+
+    for (CullingPath path : PATHS)
+    {
+      std::vector<uint32_t> visible;
+      CHECK(cullSpheres(frustum, spheres, visible, range[0], range[1], path) == expectedSpheres.size());
+      CHECK(visible == expectedSpheres);
+      CHECK(cullAabbs(frustum, boxes, visible, range[0], range[1], path) == expectedBoxes.size());
+      CHECK(visible == expectedBoxes);
+    }
+  }
+
+  // A meaningful mix of visible and culled objects
+  std::vector<uint32_t> visible;
+  const uint32_t visibleCount = cullSpheres(frustum, spheres, visible);
+  CHECK(visibleCount > 100 && visibleCount < spheres.size() - 100);
+}
+
+// Draws of the known objects, the way cull_instances.comp writes them with and without compaction
+static void testKnownDraws()
+{
+  const Frustum frustum = createFrustum();
+  SphereBounds spheres;
+  spheres.add(0.0f, 0.0f, 0.0f, 1.0f);
+  spheres.add(0.0f, 0.0f, -200.0f, 1.0f);
+  spheres.add(0.0f, 0.0f, 60.0f, 30.0f);
+  spheres.add(0.0f, 0.0f, 80.0f, 1.0f);
+  const uint32_t meshIndices[] = {1, 0, 0, 1};
+  const std::vector<MeshRange> meshes{{36, 0, 0}, {300, 36, 24}};
+
+  std::vector<IndirectDraw> draws;
+  CHECK(writeIndirectDraws(frustum, spheres, meshIndices, meshes, true, draws) == 2);
+  CHECK(draws.size() == 2);
+  if (draws.size() == 2)
+  {
+    CHECK(draws[0].indexCount == 300 && draws[0].instanceCount == 1 && draws[0].firstIndex == 36);
+    CHECK(draws[0].vertexOffset == 24 && draws[0].firstInstance == 0);
+    CHECK(draws[1].indexCount == 36 && draws[1].instanceCount == 1 && draws[1].firstIndex == 0);
+    CHECK(draws[1].vertexOffset == 0 && draws[1].firstInstance == 2);
+  }
+
+  CHECK(writeIndirectDraws(frustum, spheres, meshIndices, meshes, false, draws) == 2);
+  CHECK(draws.size() == 4);
+  bool areInPlace = true;
+  for (uint32_t i = 0; i < draws.size(); i++)
+  {
+    const MeshRange &mesh = meshes[meshIndices[i]];
+    areInPlace = areInPlace && draws[i].firstInstance == i && draws[i].indexCount == mesh.indexCount
+        && draws[i].firstIndex == mesh.firstIndex && draws[i].vertexOffset == mesh.vertexOffset;
+  }
+  CHECK(areInPlace);
+  if (draws.size() == 4)
+    CHECK(draws[0].instanceCount == 1 && draws[1].instanceCount == 0 && draws[2].instanceCount == 1 && draws[3].instanceCount == 0);
+}
+
+// Compacted draws are the in place draws with instances, in order, for every path
+static void testCompaction()
+{
+  const Frustum frustum = createFrustum();
+  SphereBounds spheres;
+  AabbBounds boxes;
+  createBounds(frustum, 10007, spheres, boxes);
+  std::vector<uint32_t> meshIndices(spheres.size());
+  for (uint32_t i = 0; i < meshIndices.size(); i++)
+    meshIndices[i] = i % 3;
+  const std::vector<MeshRange> meshes{{36, 0, 0}, {300, 36, 24}, {9, 336, 224}};
+
+  std::vector<uint32_t> visible;
+  cullSpheres(frustum, spheres, visible, 0, UINT32_MAX, CullingPath::Scalar);
+  for (CullingPath path : PATHS)
+  {
+    std::vector<IndirectDraw> inPlace;
+    std::vector<IndirectDraw> compacted;
+    CHECK(writeIndirectDraws(frustum, spheres, meshIndices.data(), meshes, false, inPlace, path) == visible.size());
+    CHECK(writeIndirectDraws(frustum, spheres, meshIndices.data(), meshes, true, compacted, path) == visible.size());
+    CHECK(inPlace.size() == spheres.size());
+    CHECK(compacted.size() == visible.size());
+
+    bool isPacked = true;
+    uint32_t drawn = 0;
+    for (const IndirectDraw &draw : inPlace)
+    {
+      if (draw.instanceCount == 0)
+        continue;
+      const IndirectDraw *packed = drawn < compacted.size() ? &compacted[drawn] : nullptr;
+      isPacked = isPacked && packed && packed->firstInstance == draw.firstInstance && packed->indexCount == draw.indexCount
+          && packed->instanceCount == 1 && packed->firstIndex == draw.firstIndex && packed->vertexOffset == draw.vertexOffset
+          && draw.firstInstance == visible[drawn];
+      drawn++;
+    }
+    CHECK(isPacked);
+    CHECK(drawn == visible.size());
+  }
+}
+
+int main()
+{
+  testKnownObjects();
+  testPathsMatchScalar();
+  testKnownDraws();
+  testCompaction();
+  return TEST_RESULT();
+}
@@ -0,0 +1,307 @@
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <core/job_system.h>
+#include <gltf_importer.h>
+
+#include "test_utils.h"
+
+using engine::gltf::GltfScene;
+
+// Component types of the glTF specification
+static const uint32_t BYTE = 5120;
+static const uint32_t UNSIGNED_SHORT = 5123;
+static const uint32_t UNSIGNED_INT = 5125;
+static const uint32_t FLOAT = 5126;
+
+// Interleaved vertex of the generated scene: float position, normalized
+// byte normal padded to 4 bytes and normalized ushort uv
+static const uint32_t VERTEX_STRIDE = 20;
+static const uint32_t SPARSE_COUNT = 100;
+
+// Values the decoded vertices are checked against
+static void getPosition(uint32_t mesh, uint32_t x, uint32_t y, float position[3])
+{
+  position[0] = x * 0.1f;
+  position[1] = y * 0.1f;
+  position[2] = static_cast<float>(mesh);
+}
+
+static int8_t getNormalComponent(uint32_t vertex, uint32_t component)
+{
+  return static_cast<int8_t>(static_cast<int32_t>((vertex * 7 + component * 31) % 256) - 128);
+}
+
+static uint16_t getUvComponent(uint32_t gridSize, uint32_t coordinate)
+{
+  return static_cast<uint16_t>(coordinate * 65535u / (gridSize - 1));
+}
+
+// Sparse values replace every 37th position of the first mesh
+static uint32_t getSparseVertex(uint32_t i)
+{
+  return i * 37;
+}
+
+template <typename T>
+static void append(std::vector<uint8_t> &buffer, const T &value)
+{
+  const uint8_t *bytes = reinterpret_cast<const uint8_t *>(&value);
+  buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+}
+
+static void alignTo4(std::vector<uint8_t> &buffer)
+{
+  buffer.resize((buffer.size() + 3) & ~size_t(3), 0);
+}
+
+/**
+ * Writes a scene of meshCount grids with gridSize x gridSize vertices each, as
+ * .gltf with an external .bin, or as .glb. Even meshes use 16 bit indices, odd
+ * ones 32 bit indices, and the first mesh has sparse positions.
+ * @return Size of the files written in bytes
+ */
+static size_t writeScene(const std::string &path, uint32_t meshCount, uint32_t gridSize, bool isBinary)
+{
+  const uint32_t vertexCount = gridSize * gridSize;
+  const uint32_t indexCount = (gridSize - 1) * (gridSize - 1) * 6;
+  std::vector<uint8_t> buffer;
+  std::ostringstream views;
+  std::ostringstream accessors;
+  std::ostringstream meshes;
+  std::ostringstream nodes;
+  uint32_t viewCount = 0;
+  auto addView = [&](size_t offset, uint32_t stride)
+  {
+    views << (viewCount > 0 ? "," : "") << "{\"buffer\":0,\"byteOffset\":" << offset << ",\"byteLength\":" << buffer.size() - offset;
+    if (stride > 0)
+      views << ",\"byteStride\":" << stride;
+    views << "}";
+    return viewCount++;
+  };
+
+  nodes << "{\"name\":\"root\",\"translation\":[0,0,-5],\"children\":[";
+  for (uint32_t mesh = 0; mesh < meshCount; mesh++)
+    nodes << (mesh > 0 ? "," : "") << mesh + 1;
+  nodes << "]}";
+
+  for (uint32_t mesh = 0; mesh < meshCount; mesh++)
+  {
+    size_t offset = buffer.size();
+    for (uint32_t y = 0; y < gridSize; y++)
+    {
+      for (uint32_t x = 0; x < gridSize; x++)
+      {
+        const uint32_t vertex = y * gridSize + x;
+        float position[3];
+        getPosition(mesh, x, y, position);
+        for (float p : position)
+          append(buffer, p);
+        for (uint32_t c = 0; c < 3; c++)
+          append(buffer, getNormalComponent(vertex, c));
+        append(buffer, int8_t(0));
+        append(buffer, getUvComponent(gridSize, x));
+        append(buffer, getUvComponent(gridSize, y));
+      }
+    }
+    const uint32_t vertexView = addView(offset, VERTEX_STRIDE);
+
+    offset = buffer.size();
+    const bool isShort = mesh % 2 == 0;
+    for (uint32_t y = 0; y + 1 < gridSize; y++)
+    {
+      for (uint32_t x = 0; x + 1 < gridSize; x++)
+      {
+        const uint32_t v = y * gridSize + x;
+        const uint32_t quad[6] = {v, v + 1, v + gridSize, v + 1, v + gridSize + 1, v + gridSize};
+        for (uint32_t index : quad)
+        {
+          if (isShort)
+            append(buffer, static_cast<uint16_t>(index));
+          else
+            append(buffer, index);
+        }
+      }
+    }
+    alignTo4(buffer);
+    const uint32_t indexView = addView(offset, 0);
+
+    const uint32_t firstAccessor = mesh * 4;
+    if (mesh > 0)
+      accessors << ",";
+    accessors << "{\"bufferView\":" << vertexView << ",\"componentType\":" << FLOAT << ",\"count\":" << vertexCount
+              << ",\"type\":\"VEC3\"";
+    if (mesh == 0)
+      accessors << ",\"sparse\":{\"count\":" << SPARSE_COUNT << ",\"indices\":{\"bufferView\":" << viewCount
+                << ",\"componentType\":" << UNSIGNED_SHORT << "},\"values\":{\"bufferView\":" << viewCount + 1 << "}}";
+    accessors << "},{\"bufferView\":" << vertexView << ",\"byteOffset\":12,\"componentType\":" << BYTE
+              << ",\"normalized\":true,\"count\":" << vertexCount << ",\"type\":\"VEC3\"}"
+              << ",{\"bufferView\":" << vertexView << ",\"byteOffset\":16,\"componentType\":" << UNSIGNED_SHORT
+              << ",\"normalized\":true,\"count\":" << vertexCount << ",\"type\":\"VEC2\"}"
+              << ",{\"bufferView\":" << indexView << ",\"componentType\":" << (isShort ? UNSIGNED_SHORT : UNSIGNED_INT)
+              << ",\"count\":" << indexCount << ",\"type\":\"SCALAR\"}";
+    meshes << (mesh > 0 ? "," : "") << "{\"name\":\"grid" << mesh << "\",\"primitives\":[{\"attributes\":{\"POSITION\":"
+           << firstAccessor << ",\"NORMAL\":" << firstAccessor + 1 << ",\"TEXCOORD_0\":" << firstAccessor + 2
+           << "},\"indices\":" << firstAccessor + 3 << ",\"mode\":4}]}";
+    nodes << ",{\"name\":\"node" << mesh << "\",\"mesh\":" << mesh << ",\"translation\":[" << mesh << ",0,0]}";
+
+    // Sparse indices and values of the first mesh
+    if (mesh == 0)
+    {
+      offset = buffer.size();
+      for (uint32_t i = 0; i < SPARSE_COUNT; i++)
+        append(buffer, static_cast<uint16_t>(getSparseVertex(i)));
+      alignTo4(buffer);
+      addView(offset, 0);
+      offset = buffer.size();
+      for (uint32_t i = 0; i < SPARSE_COUNT; i++)
+      {
+        append(buffer, 1000.0f + i);
+        append(buffer, -1.0f);
+        append(buffer, 0.5f);
+      }
+      addView(offset, 0);
+    }
+  }
+
+  const std::string binPath = path.substr(0, path.find_last_of('.')) + ".bin";
+  const std::string binName = std::filesystem::path(binPath).filename().string();
+  std::ostringstream json;
+  json << "{\"asset\":{\"version\":\"2.0\"},\"scene\":0,\"scenes\":[{\"nodes\":[0]}],\"nodes\":[" << nodes.str()
+       << "],\"meshes\":[" << meshes.str() << "],\"accessors\":[" << accessors.str() << "],\"bufferViews\":["
+       << views.str() << "],\"buffers\":[{" << (isBinary ? "" : "\"uri\":\"" + binName + "\",")
+       << "\"byteLength\":" << buffer.size() << "}]}";
+  std::string text = json.str();
+
+  std::ofstream file(path, std::ios::binary);
+  if (isBinary)
+  {
+    // 12 byte header, then the JSON chunk padded with spaces and the binary chunk
+    text.resize((text.size() + 3) & ~size_t(3), ' ');
+    const uint32_t header[3] = {0x46546C67, 2, static_cast<uint32_t>(12 + 8 + text.size() + 8 + buffer.size())};
+    const uint32_t jsonChunk[2] = {static_cast<uint32_t>(text.size()), 0x4E4F534A};
+    const uint32_t binChunk[2] = {static_cast<uint32_t>(buffer.size()), 0x004E4942};
+    file.write(reinterpret_cast<const char *>(header), sizeof(header));
+    file.write(reinterpret_cast<const char *>(jsonChunk), sizeof(jsonChunk));
+    file.write(text.data(), text.size());
+    file.write(reinterpret_cast<const char *>(binChunk), sizeof(binChunk));
+    file.write(reinterpret_cast<const char *>(buffer.data()), buffer.size());
+    return header[2];
+  }
+
+  file.write(text.data(), text.size());
+  std::ofstream(binPath, std::ios::binary).write(reinterpret_cast<const char *>(buffer.data()), buffer.size());
+  return text.size() + buffer.size();
+}
+
+// Every decoded attribute, index and node matches what writeScene() wrote
+static bool isSceneValid(const GltfScene &scene, uint32_t meshCount, uint32_t gridSize)
+{
+  if (scene.primitives.size() != meshCount || scene.meshes.size() != meshCount || scene.nodes.size() != meshCount + 1)
+    return false;
+
+  bool isValid = scene.nodes[0].parent == engine::gltf::NO_INDEX && scene.nodes[0].translation[2] == -5.0f;
+  for (uint32_t mesh = 0; mesh < meshCount; mesh++)
+  {
+    const engine::gltf::GltfNode &node = scene.nodes[mesh + 1];
+    isValid = isValid && node.parent == 0 && node.mesh == mesh && node.translation[0] == static_cast<float>(mesh);
+
+    const engine::MeshData &data = scene.primitives[mesh];
+    isValid = isValid && scene.meshes[mesh].firstPrimitive == mesh && data.name == "grid" + std::to_string(mesh);
+    isValid = isValid && data.vertices.size() == gridSize * gridSize && data.indices.size() == (gridSize - 1) * (gridSize - 1) * 6;
+    if (!isValid)
+      return false;
+
+    uint32_t nextSparse = 0;
+    for (uint32_t vertex = 0; vertex < data.vertices.size(); vertex++)
+    {
+      const engine::MeshVertex &v = data.vertices[vertex];
+      float position[3];
+      getPosition(mesh, vertex % gridSize, vertex / gridSize, position);
+      if (mesh == 0 && nextSparse < SPARSE_COUNT && vertex == getSparseVertex(nextSparse))
+      {
+        position[0] = 1000.0f + nextSparse++;
+        position[1] = -1.0f;
+        position[2] = 0.5f;
+      }
+      for (uint32_t c = 0; c < 3; c++)
+      {
+        const float normal = std::fmax(getNormalComponent(vertex, c) / 127.0f, -1.0f);
+        isValid = isValid && v.position[c] == position[c] && std::fabs(v.normal[c] - normal) < 1e-6f;
+      }
+      isValid = isValid && std::fabs(v.uv[0] - getUvComponent(gridSize, vertex % gridSize) / 65535.0f) < 1e-6f;
+      isValid = isValid && std::fabs(v.uv[1] - getUvComponent(gridSize, vertex / gridSize) / 65535.0f) < 1e-6f;
+    }
+
+    // The last quad of the grid
+    const uint32_t last = (gridSize - 2) * gridSize + gridSize - 2;
+    const uint32_t *quad = &data.indices[data.indices.size() - 6];
+    isValid = isValid && quad[0] == last && quad[4] == last + gridSize + 1;
+  }
+  return isValid;
+}
+
+// Small scenes in both containers decode exactly
+static void testDecoding(const std::filesystem::path &directory)
+{
+  for (bool isBinary : {false, true})
+  {
+    const std::string path = (directory / (isBinary ? "small.glb" : "small.gltf")).string();
+    writeScene(path, 3, 17, isBinary);
+    GltfScene scene;
+    CHECK(engine::gltf::importGltf(path, scene));
+    CHECK(isSceneValid(scene, 3, 17));
+  }
+}
+
+// Missing and truncated files fail without leaving partial results
+static void testInvalidFiles(const std::filesystem::path &directory)
+{
+  GltfScene scene;
+  CHECK(!engine::gltf::importGltf((directory / "missing.gltf").string(), scene));
+
+  const std::string path = (directory / "truncated.gltf").string();
+  writeScene(path, 2, 9, false);
+  std::filesystem::resize_file(directory / "truncated.bin", 100);
+  CHECK(!engine::gltf::importGltf(path, scene));
+  CHECK(scene.primitives.empty() && scene.nodes.empty());
+}
+
+// Import throughput of a large generated scene, serially and on the job system
+static void testThroughput(const std::filesystem::path &directory)
+{
+  const uint32_t meshCount = 24;
+  const uint32_t gridSize = 256;
+  const std::string path = (directory / "large.glb").string();
+  const size_t fileSize = writeScene(path, meshCount, gridSize, true);
+
+  engine::JobSystem jobSystem;
+  for (engine::JobSystem *jobs : {static_cast<engine::JobSystem *>(nullptr), &jobSystem})
+  {
+    GltfScene scene;
+    const auto start = std::chrono::steady_clock::now();
+    CHECK(engine::gltf::importGltf(path, scene, jobs));
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    CHECK(isSceneValid(scene, meshCount, gridSize));
+    std::cout << "Imported " << fileSize / (1024.0 * 1024.0) << " MB (" << meshCount * gridSize * gridSize << " vertices) "
+              << (jobs ? "on the job system" : "serially") << " in " << seconds * 1000.0 << " ms, "
+              << fileSize / (1024.0 * 1024.0) / seconds << " MB/s" << std::endl;
+  }
+}
+
+int main()
+{
+  const std::filesystem::path directory = std::filesystem::temp_directory_path() / "test_gltf_import";
+  std::filesystem::create_directories(directory);
+  testDecoding(directory);
+  testInvalidFiles(directory);
+  testThroughput(directory);
+  std::filesystem::remove_all(directory);
+  return TEST_RESULT();
+}
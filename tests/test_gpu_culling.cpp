@@ -0,0 +1,280 @@
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include <core/culling.h>
+#include <core/math.h>
+#include <vulkan/vulkan_deletion_queue.h>
+#include <vulkan/vulkan_functions.h>
+#include <vulkan/vulkan_gpu_culling.h>
+
+#include "test_utils.h"
+
+using namespace engine;
+using namespace engine::vulkan;
+
+// Exit code ctest reports as a skipped test, when there is no device to run on
+static const int SKIPPED = 77;
+
+// Everything the culling pass needs, created on the first device found
+// (Eg: lavapipe on CI machines without a GPU)
+struct TestDevice
+{
+  vk::Instance instance;
+  vk::DebugUtilsMessengerEXT messenger;
+  vk::PhysicalDevice gpu;
+  vk::Device device;
+  QueueFamilyIndices queueFamilyIndices;
+  vk::Queue queue;
+  MemoryAllocator allocator;
+  UploadService uploadService;
+  DeletionQueue deletionQueue;
+  ResourceRegistry resources;
+  DescriptorLayoutCache layoutCache;
+  DescriptorAllocator descriptorAllocator;
+  CommandData commandData;
+
+  bool init()
+  {
+    vk::ApplicationInfo appInfo("test_gpu_culling", 1, ENGINE_NAME, 1, VK_API_VERSION_1_2);
+    InstanceCreateData data{appInfo, false, {}, {}};
+    if (!createInstance(data, instance, messenger))
+      return false;
+    gpu = selectPhysicalDevice(instance, nullptr, HEADLESS_DEVICE_EXTENSIONS);
+    if (!gpu)
+      return false;
+    queueFamilyIndices = getQueueFamilyIndices(gpu, nullptr);
+    device = getLogicalDevice(gpu, queueFamilyIndices, {}, HEADLESS_DEVICE_EXTENSIONS);
+    if (!device)
+      return false;
+    queue = device.getQueue(queueFamilyIndices.graphics, 0);
+    commandData = createCommandData(device, queueFamilyIndices);
+    return allocator.init(gpu, device)
+        && uploadService.init(device, queueFamilyIndices, allocator)
+        && resources.init(device, allocator, deletionQueue)
+        && layoutCache.init(device)
+        && descriptorAllocator.init(device, 1)
+        && commandData.pool;
+  }
+
+  void destroy()
+  {
+    if (device)
+    {
+      device.waitIdle();
+      deletionQueue.flush();
+      commandData.destroy(device);
+      descriptorAllocator.destroy();
+      layoutCache.destroy();
+      resources.destroy();
+      uploadService.destroy();
+      allocator.destroy();
+      device.destroy();
+    }
+    if (instance)
+      instance.destroy();
+  }
+};
+
+// Random spheres, none of them closer than a small margin to a frustum plane,
+// so the float differences of the CPU and GPU plane tests can't flip a result
+static std::vector<GpuInstance> createInstances(const Frustum &frustum, uint32_t count, uint32_t meshCount)
+{
+  std::mt19937 random(3);
+  std::uniform_real_distribution<float> position(-60.0f, 60.0f);
+  std::uniform_real_distribution<float> radius(0.1f, 4.0f);
+  std::vector<GpuInstance> instances;
+  while (instances.size() < count)
+  {
+    const float center[3] = {position(random), position(random), position(random)};
+    const float r = radius(random);
+    bool isNearPlane = false;
+    for (uint32_t p = 0; p < Frustum::Count; p++)
+    {
+      const float *plane = frustum.planes[p];
+      const float distance = plane[0] * center[0] + plane[1] * center[1] + plane[2] * center[2] + plane[3];
+      isNearPlane = isNearPlane || std::fabs(distance + r) < 1e-2f;
+    }
+    if (isNearPlane)
+      continue;
+
+    GpuInstance instance;
+    const float transform[12] = {1.0f, 0.0f, 0.0f, center[0], 0.0f, 1.0f, 0.0f, center[1], 0.0f, 0.0f, 1.0f, center[2]};
+    std::copy(transform, transform + 12, instance.transform);
+    std::copy(center, center + 3, instance.boundingSphere);
+    instance.boundingSphere[3] = r;
+    instance.meshIndex = static_cast<uint32_t>(instances.size()) % meshCount;
+    instances.push_back(instance);
+  }
+  return instances;
+}
+
+// Culls the instances on the device and reads back the draws it wrote
+static bool runCulling(TestDevice &test,
+                       GpuCulling &culling,
+                       std::vector<vk::DrawIndexedIndirectCommand> &draws,
+                       uint32_t &drawCount)
+{
+  const uint32_t instanceCount = culling.getInstanceCount();
+  const vk::DeviceSize drawSize = instanceCount * sizeof(vk::DrawIndexedIndirectCommand);
+  const vk::MemoryPropertyFlags hostMemory = vk::MemoryPropertyFlagBits::eHostVisible
+      | vk::MemoryPropertyFlagBits::eHostCoherent;
+  const BufferHandle drawReadback = test.resources.createBuffer(drawSize, vk::BufferUsageFlagBits::eTransferDst, hostMemory);
+  const BufferHandle countReadback = test.resources.createBuffer(sizeof(uint32_t), vk::BufferUsageFlagBits::eTransferDst, hostMemory);
+  const BufferResource *drawDst = test.resources.get(drawReadback);
+  const BufferResource *countDst = test.resources.get(countReadback);
+  const BufferResource *drawSrc = test.resources.get(culling.getDrawBuffer());
+  const BufferResource *countSrc = test.resources.get(culling.getCountBuffer());
+  if (!drawDst || !countDst || !drawSrc || !countSrc || !drawDst->allocation.mapped || !countDst->allocation.mapped)
+    return false;
+
+  test.uploadService.flush();
+  const vk::CommandBuffer &cmdBuffer = test.commandData.buffers[0];
+  cmdBuffer.begin(vk::CommandBufferBeginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+  const uint64_t uploadValue = test.uploadService.recordAcquireBarriers(cmdBuffer);
+  culling.cull(cmdBuffer);
+  cmdBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,
+                            vk::PipelineStageFlagBits::eTransfer,
+                            vk::DependencyFlags(),
+                            vk::MemoryBarrier(vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eTransferRead),
+                            {},
+                            {});
+  cmdBuffer.copyBuffer(drawSrc->buffer, drawDst->buffer, vk::BufferCopy(0, 0, drawSize));
+  cmdBuffer.copyBuffer(countSrc->buffer, countDst->buffer, vk::BufferCopy(0, 0, sizeof(uint32_t)));
+  cmdBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+                            vk::PipelineStageFlagBits::eHost,
+                            vk::DependencyFlags(),
+                            vk::MemoryBarrier(vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eHostRead),
+                            {},
+                            {});
+  cmdBuffer.end();
+
+  const vk::PipelineStageFlags waitStage = vk::PipelineStageFlagBits::eAllCommands;
+  vk::TimelineSemaphoreSubmitInfo timelineInfo;
+  timelineInfo.setWaitSemaphoreValues(uploadValue);
+  vk::SubmitInfo submitInfo;
+  submitInfo.setCommandBuffers(cmdBuffer);
+  if (uploadValue > 0)
+  {
+    submitInfo.setWaitSemaphores(test.uploadService.getSemaphore())
+        .setWaitDstStageMask(waitStage)
+        .setPNext(&timelineInfo);
+  }
+  test.queue.submit(submitInfo, nullptr);
+  test.queue.waitIdle();
+
+  draws.resize(instanceCount);
+  std::copy(static_cast<const vk::DrawIndexedIndirectCommand *>(drawDst->allocation.mapped),
+            static_cast<const vk::DrawIndexedIndirectCommand *>(drawDst->allocation.mapped) + instanceCount,
+            draws.begin());
+  drawCount = *static_cast<const uint32_t *>(countDst->allocation.mapped);
+  test.resources.release(drawReadback, 0);
+  test.resources.release(countReadback, 0);
+  return true;
+}
+
+// The GPU writes the same draws as writeIndirectDraws(), compacted ones in any order
+static void testCullingMatchesCpu(TestDevice &test, GpuCulling &culling)
+{
+  const Mat4 viewProjection = Mat4::perspective(1.0f, 16.0f / 9.0f, 0.1f, 100.0f)
+      * Mat4::lookAt(Vec3(0.0f, 10.0f, 70.0f), Vec3(0.0f, 0.0f, 0.0f), Vec3(0.0f, 1.0f, 0.0f));
+  const Frustum frustum = Frustum::fromMatrix(viewProjection.data());
+
+  const std::vector<GpuMeshDraw> meshes{{36, 0, 0, 0}, {300, 36, 24, 0}, {9, 336, 224, 0}};
+  const std::vector<GpuInstance> instances = createInstances(frustum, 10000, static_cast<uint32_t>(meshes.size()));
+  CHECK(culling.setMeshes(meshes, 0));
+  CHECK(culling.setInstances(instances, 0));
+
+  FrustumPlanes planes;
+  for (uint32_t i = 0; i < Frustum::Count; i++)
+    std::copy(frustum.planes[i], frustum.planes[i] + 4, planes[i].begin());
+  culling.setFrustum(planes);
+
+  SphereBounds bounds;
+  std::vector<uint32_t> meshIndices;
+  for (const GpuInstance &instance : instances)
+  {
+    bounds.add(instance.boundingSphere[0], instance.boundingSphere[1], instance.boundingSphere[2], instance.boundingSphere[3]);
+    meshIndices.push_back(instance.meshIndex);
+  }
+  std::vector<MeshRange> ranges;
+  for (const GpuMeshDraw &mesh : meshes)
+    ranges.push_back({mesh.indexCount, mesh.firstIndex, mesh.vertexOffset});
+  std::vector<IndirectDraw> expected;
+  const uint32_t visibleCount = writeIndirectDraws(frustum, bounds, meshIndices.data(), ranges, culling.isCompacted(), expected, CullingPath::Scalar);
+  // Some instances are culled and some are not, or the test proves nothing
+  CHECK(visibleCount > 0 && visibleCount < instances.size());
+
+  std::vector<vk::DrawIndexedIndirectCommand> draws;
+  uint32_t drawCount = 0;
+  CHECK(runCulling(test, culling, draws, drawCount));
+  if (culling.isCompacted())
+  {
+    CHECK(drawCount == visibleCount);
+    draws.resize(std::min(drawCount, static_cast<uint32_t>(draws.size())));
+    std::sort(draws.begin(), draws.end(), [](const vk::DrawIndexedIndirectCommand &a, const vk::DrawIndexedIndirectCommand &b)
+    {
+      return a.firstInstance < b.firstInstance;
+    });
+  }
+  CHECK(draws.size() == expected.size());
+  if (draws.size() != expected.size())
+    return;
+
+  bool areDrawsEqual = true;
+  for (uint32_t i = 0; i < draws.size(); i++)
+  {
+    const vk::DrawIndexedIndirectCommand &draw = draws[i];
+    areDrawsEqual = areDrawsEqual && draw.indexCount == expected[i].indexCount && draw.instanceCount == expected[i].instanceCount
+        && draw.firstIndex == expected[i].firstIndex && draw.vertexOffset == expected[i].vertexOffset
+        && draw.firstInstance == expected[i].firstInstance;
+  }
+  CHECK(areDrawsEqual);
+}
+
+int main()
+{
+  // Shaders are compiled next to the executable, only if glslc was found
+  if (!std::ifstream(std::string(SHADER_DIR) + "cull_instances.comp.spv").good())
+  {
+    std::cout << "cull_instances.comp.spv not found, skipping" << std::endl;
+    return SKIPPED;
+  }
+
+  TestDevice test;
+  if (!test.init())
+  {
+    std::cout << "No Vulkan 1.2 device, skipping" << std::endl;
+    test.destroy();
+    return SKIPPED;
+  }
+
+  GpuCulling culling;
+  CHECK(culling.init(test.gpu,
+                     test.device,
+                     vk::PipelineCache(),
+                     test.resources,
+                     test.layoutCache,
+                     test.descriptorAllocator,
+                     test.uploadService));
+  if (culling.isValid() && !culling.isDrawSupported())
+  {
+    std::cout << "No drawIndirectFirstInstance support, skipping" << std::endl;
+    culling.destroy();
+    test.destroy();
+    return SKIPPED;
+  }
+
+  if (culling.isValid())
+  {
+    test.descriptorAllocator.beginFrame(0);
+    testCullingMatchesCpu(test, culling);
+  }
+
+  culling.destroy();
+  test.destroy();
+  return TEST_RESULT();
+}
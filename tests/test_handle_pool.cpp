@@ -0,0 +1,154 @@
+#include <cstdint>
+#include <vector>
+
+#include <core/handle_pool.h>
+
+#include "test_utils.h"
+
+struct Object
+{
+  uint32_t value = 0;
+};
+
+using Pool = engine::HandlePool<Object>;
+using ObjectHandle = Pool::HandleType;
+
+// Lookups through live handles find their own object, whatever was removed before
+static void testCreateAndGet()
+{
+  Pool pool;
+  CHECK(pool.empty());
+  CHECK(!ObjectHandle().isValid());
+  CHECK(!pool.isValid(ObjectHandle()));
+
+  std::vector<ObjectHandle> handles;
+  for (uint32_t i = 0; i < 100; i++)
+    handles.push_back(pool.create(Object{i}));
+  CHECK(pool.size() == 100);
+
+  // Removing from the middle moves the last object into the hole
+  for (uint32_t i = 0; i < 100; i += 3)
+    CHECK(pool.remove(handles[i]));
+  for (uint32_t i = 0; i < 100; i++)
+  {
+    const Object *object = pool.get(handles[i]);
+    if (i % 3 == 0)
+      CHECK(object == nullptr);
+    else
+      CHECK(object && object->value == i);
+  }
+  CHECK(pool.size() == 66);
+
+  // Dense indices map back to the handle of the object stored there
+  bool isDenseConsistent = true;
+  for (uint32_t i = 0; i < pool.size(); i++)
+  {
+    const ObjectHandle handle = pool.getHandle(i);
+    isDenseConsistent = isDenseConsistent && pool.get(handle) == &*(pool.begin() + i);
+  }
+  CHECK(isDenseConsistent);
+}
+
+// Handles of removed objects stay stale after their slot is reused
+static void testStaleHandles()
+{
+  Pool pool;
+  const ObjectHandle first = pool.create(Object{1});
+  Object removed;
+  CHECK(pool.remove(first, &removed));
+  CHECK(removed.value == 1);
+  CHECK(!pool.isValid(first));
+  CHECK(pool.get(first) == nullptr);
+  CHECK(!pool.remove(first));
+
+  const ObjectHandle second = pool.create(Object{2});
+  CHECK(second.index == first.index);
+  CHECK(second.generation != first.generation);
+  CHECK(second != first);
+  CHECK(pool.get(first) == nullptr);
+  CHECK(pool.get(second) && pool.get(second)->value == 2);
+
+  // Out of range indices are stale too
+  ObjectHandle outOfRange = second;
+  outOfRange.index = 1000;
+  CHECK(!pool.isValid(outOfRange));
+
+  // clear() makes every handle stale
+  const ObjectHandle third = pool.create(Object{3});
+  pool.clear();
+  CHECK(pool.empty());
+  CHECK(!pool.isValid(second));
+  CHECK(!pool.isValid(third));
+}
+
+// Generations skip 0 on wrap around, so handles of a wrapped slot stay valid
+static void testGenerationWrap()
+{
+  CHECK(Pool::getNextGeneration(1) == 2);
+  CHECK(Pool::getNextGeneration(UINT32_MAX - 1) == UINT32_MAX);
+  CHECK(Pool::getNextGeneration(UINT32_MAX) == 1);
+
+  // Reusing a slot always hands out its next generation
+  Pool pool;
+  ObjectHandle handle = pool.create(Object{0});
+  for (uint32_t i = 0; i < 1000; i++)
+  {
+    const ObjectHandle previous = handle;
+    pool.remove(handle);
+    handle = pool.create(Object{i});
+    CHECK(handle.index == previous.index);
+    CHECK(handle.generation == Pool::getNextGeneration(previous.generation));
+  }
+  CHECK(handle.isValid());
+}
+
+// Random churn against a reference of which handles are alive
+static void testChurn()
+{
+  Pool pool;
+  std::vector<ObjectHandle> alive;
+  std::vector<ObjectHandle> dead;
+  uint32_t seed = 12345;
+  auto next = [&seed]()
+  {
+    seed = seed * 1664525u + 1013904223u;
+    return seed >> 8;
+  };
+
+  bool isConsistent = true;
+  for (uint32_t i = 0; i < 100000; i++)
+  {
+    if (!alive.empty() && next() % 3 == 0)
+    {
+      const size_t index = next() % alive.size();
+      isConsistent = isConsistent && pool.remove(alive[index]);
+      dead.push_back(alive[index]);
+      alive[index] = alive.back();
+      alive.pop_back();
+    }
+    else
+    {
+      alive.push_back(pool.create(Object{i}));
+    }
+  }
+  CHECK(isConsistent);
+  CHECK(pool.size() == alive.size());
+
+  bool areAliveValid = true;
+  for (const ObjectHandle &handle : alive)
+    areAliveValid = areAliveValid && pool.isValid(handle);
+  CHECK(areAliveValid);
+  bool areDeadStale = true;
+  for (const ObjectHandle &handle : dead)
+    areDeadStale = areDeadStale && !pool.isValid(handle);
+  CHECK(areDeadStale);
+}
+
+int main()
+{
+  testCreateAndGet();
+  testStaleHandles();
+  testGenerationWrap();
+  testChurn();
+  return TEST_RESULT();
+}
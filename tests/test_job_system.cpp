@@ -0,0 +1,125 @@
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <core/job_system.h>
+
+#include "test_utils.h"
+
+using engine::JobCounter;
+using engine::JobSystem;
+
+// Every item is visited exactly once, whatever the batch size
+static void testParallelForCoverage(JobSystem &jobSystem)
+{
+  const uint32_t counts[] = {1, 7, 64, 1000, 100003};
+  const uint32_t batchSizes[] = {0, 1, 3, 64, 1 << 20};
+  for (uint32_t count : counts)
+  {
+    for (uint32_t batchSize : batchSizes)
+    {
+      std::vector<std::atomic<uint32_t>> visits(count);
+      jobSystem.parallelFor(count, batchSize, [&visits](uint32_t begin, uint32_t end)
+                            {
+                              for (uint32_t i = begin; i < end; i++)
+                                visits[i].fetch_add(1, std::memory_order_relaxed);
+                            });
+      bool isCovered = true;
+      for (const std::atomic<uint32_t> &v : visits)
+        isCovered = isCovered && v.load() == 1;
+      CHECK(isCovered);
+    }
+  }
+}
+
+// Jobs queued with runAfter() only start once the whole dependency group finished
+static void testDependencies(JobSystem &jobSystem)
+{
+  for (uint32_t round = 0; round < 100; round++)
+  {
+    JobCounter first;
+    JobCounter second;
+    std::atomic<uint32_t> firstDone{0};
+    std::atomic<uint32_t> violations{0};
+    for (uint32_t i = 0; i < 32; i++)
+      jobSystem.run([&firstDone]()
+                    { firstDone.fetch_add(1); },
+                    &first);
+    for (uint32_t i = 0; i < 8; i++)
+      jobSystem.runAfter(first, [&firstDone, &violations]()
+                         {
+                           if (firstDone.load() != 32)
+                             violations.fetch_add(1);
+                         },
+                         &second);
+    jobSystem.wait(second);
+    CHECK(first.isDone());
+    CHECK(violations.load() == 0);
+  }
+}
+
+// Threads outside of the job system queue jobs while the workers steal them.
+// The queued job count must never wrap around, or idle workers spin forever.
+static void testExternalProducers(JobSystem &jobSystem)
+{
+  const uint32_t producerCount = 4;
+  const uint32_t jobsPerProducer = 20000;
+  std::atomic<uint32_t> executed{0};
+  std::vector<JobCounter> counters(producerCount);
+  std::vector<std::thread> producers;
+  for (uint32_t p = 0; p < producerCount; p++)
+  {
+    producers.emplace_back([&jobSystem, &executed, &counters, p]()
+                           {
+                             for (uint32_t i = 0; i < jobsPerProducer; i++)
+                               jobSystem.run([&executed]()
+                                             { executed.fetch_add(1, std::memory_order_relaxed); },
+                                             &counters[p]);
+                           });
+  }
+  for (std::thread &producer : producers)
+    producer.join();
+  for (JobCounter &counter : counters)
+    jobSystem.wait(counter);
+  CHECK(executed.load() == producerCount * jobsPerProducer);
+}
+
+// Jobs queuing more jobs, like a recursive split
+static void testNestedJobs(JobSystem &jobSystem)
+{
+  std::atomic<uint32_t> leaves{0};
+  JobCounter counter;
+  std::function<void(uint32_t)> split = [&](uint32_t depth)
+  {
+    if (depth == 0)
+    {
+      leaves.fetch_add(1);
+      return;
+    }
+    jobSystem.run([&split, depth]()
+                  { split(depth - 1); },
+                  &counter);
+    jobSystem.run([&split, depth]()
+                  { split(depth - 1); },
+                  &counter);
+  };
+  jobSystem.run([&split]()
+                { split(12); },
+                &counter);
+  jobSystem.wait(counter);
+  CHECK(leaves.load() == 1u << 12);
+}
+
+int main()
+{
+  const uint32_t threadCounts[] = {1, 2, 0};
+  for (uint32_t threadCount : threadCounts)
+  {
+    JobSystem jobSystem(threadCount);
+    testParallelForCoverage(jobSystem);
+    testDependencies(jobSystem);
+    testExternalProducers(jobSystem);
+    testNestedJobs(jobSystem);
+  }
+  return TEST_RESULT();
+}
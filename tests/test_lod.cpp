@@ -0,0 +1,155 @@
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include <core/lod.h>
+
+#include "test_utils.h"
+
+using namespace engine;
+
+static const CullingPath PATHS[] = {CullingPath::Scalar, CullingPath::Sse, CullingPath::Avx2, CullingPath::Best};
+
+// Instances with 1 to MAX_LOD_COUNT levels of growing error, none of them
+// within a small margin of a threshold. The AVX2 kernel uses FMA, so errors
+// right at a threshold may select differently in the last bit between paths.
+static LodInstances createInstances(const std::vector<LodSettings> &cameras, uint32_t count)
+{
+  std::mt19937 random(5);
+  std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+  std::uniform_real_distribution<float> size(0.1f, 4.0f);
+  LodInstances instances;
+  while (instances.size() < count)
+  {
+    const Vec3 center(position(random), position(random), position(random));
+    const float radius = size(random);
+    const uint32_t levelCount = 1 + random() % MAX_LOD_COUNT;
+    float errors[MAX_LOD_COUNT] = {};
+    for (uint32_t level = 1; level < levelCount; level++)
+      errors[level] = errors[level - 1] + size(random) * 0.05f;
+
+    bool isNearThreshold = false;
+    for (const LodSettings &camera : cameras)
+    {
+      const float distance = std::max(length(center - camera.cameraPosition) - radius, 0.0f);
+      const float errorScale = camera.maxPixelError / camera.pixelsPerUnit;
+      for (float threshold : {distance * errorScale * (1.0f - camera.hysteresis), distance * errorScale * (1.0f + camera.hysteresis)})
+      {
+        for (uint32_t level = 1; level < levelCount; level++)
+          isNearThreshold = isNearThreshold || std::fabs(errors[level] - threshold) < 1e-3f * std::max(threshold, 1.0f);
+      }
+    }
+    if (!isNearThreshold)
+      instances.add(center, radius, errors, levelCount);
+  }
+  return instances;
+}
+
+// Every path selects the same levels and counts the same changes, frame after frame
+static void testPathsMatch()
+{
+  std::vector<LodSettings> cameras;
+  for (const Vec3 &position : {Vec3(0.0f, 0.0f, 0.0f), Vec3(80.0f, 10.0f, -30.0f), Vec3(-150.0f, 0.0f, 20.0f), Vec3(0.0f, 0.0f, 0.0f)})
+  {
+    LodSettings camera;
+    camera.cameraPosition = position;
+    camera.pixelsPerUnit = getPixelsPerUnit(1.0f, 1080.0f);
+    cameras.push_back(camera);
+  }
+  // Not a multiple of 8, so the narrower kernels finish the tail
+  const LodInstances initial = createInstances(cameras, 1003);
+
+  // A shuffled subset, like the visible list of cullSpheres()
+  std::vector<uint32_t> indices;
+  for (uint32_t i = 0; i < initial.size(); i++)
+  {
+    if (i % 7 != 3)
+      indices.push_back(i);
+  }
+  std::shuffle(indices.begin(), indices.end(), std::mt19937(8));
+
+  LodInstances reference = initial;
+  std::vector<uint32_t> referenceChanges;
+  for (const LodSettings &camera : cameras)
+    referenceChanges.push_back(selectLods(camera, reference, indices.data(), static_cast<uint32_t>(indices.size()), CullingPath::Scalar));
+  // Hidden instances keep their level, and the cameras move enough to change some
+  bool areHiddenKept = true;
+  for (uint32_t i = 3; i < initial.size(); i += 7)
+    areHiddenKept = areHiddenKept && reference.lods[i] == 0;
+  CHECK(areHiddenKept);
+  CHECK(referenceChanges[0] > 0 && referenceChanges[1] > 0);
+  CHECK(std::count(reference.lods.begin(), reference.lods.end(), 0u) < static_cast<long>(reference.size()));
+
+  for (CullingPath path : PATHS)
+  {
+    LodInstances instances = initial;
+    bool areChangesEqual = true;
+    for (uint32_t frame = 0; frame < cameras.size(); frame++)
+    {
+      const uint32_t changes = selectLods(cameras[frame], instances, indices.data(), static_cast<uint32_t>(indices.size()), path);
+      areChangesEqual = areChangesEqual && changes == referenceChanges[frame];
+    }
+    CHECK(areChangesEqual);
+    CHECK(instances.lods == reference.lods);
+  }
+}
+
+// An instance sitting at a switch distance keeps its level while the camera
+// moves back and forth across it, and switches once it leaves the band
+static void testHysteresis()
+{
+  // Level n has an error of n, so with one pixel per unit the level 1 switch
+  // is at distance 1. 9 copies run through the 8 wide kernel and the scalar tail.
+  const float errors[4] = {0.0f, 1.0f, 2.0f, 3.0f};
+  const std::vector<uint32_t> indices = {0, 1, 2, 3, 4, 5, 6, 7, 8};
+  for (CullingPath path : PATHS)
+  {
+    LodInstances instances;
+    for (uint32_t i = 0; i < indices.size(); i++)
+      instances.add(Vec3(0.0f, 0.0f, 0.0f), 0.0f, errors, 4);
+
+    LodSettings settings;
+    settings.hysteresis = 0.25f;
+    auto select = [&](float distance)
+    {
+      settings.cameraPosition = Vec3(distance, 0.0f, 0.0f);
+      return selectLods(settings, instances, indices.data(), static_cast<uint32_t>(indices.size()), path);
+    };
+    auto isAtLevel = [&](uint32_t level)
+    {
+      return std::all_of(instances.lods.begin(), instances.lods.end(), [level](uint32_t lod) { return lod == level; });
+    };
+
+    CHECK(select(1.0f) == 0 && isAtLevel(0));
+    // Coarser only below maxPixelError * (1 - hysteresis), distance 1 / 0.75
+    CHECK(select(1.3f) == 0 && isAtLevel(0));
+    CHECK(select(1.5f) == indices.size() && isAtLevel(1));
+
+    uint32_t flips = 0;
+    for (uint32_t frame = 0; frame < 20; frame++)
+      flips += select(frame % 2 == 0 ? 0.95f : 1.05f);
+    CHECK(flips == 0 && isAtLevel(1));
+
+    // Finer only above maxPixelError * (1 + hysteresis), distance 1 / 1.25
+    CHECK(select(0.85f) == 0 && isAtLevel(1));
+    CHECK(select(0.7f) == indices.size() && isAtLevel(0));
+    CHECK(select(10.0f) == indices.size() && isAtLevel(3));
+
+    // Without the band the same camera motion switches every frame
+    settings.hysteresis = 0.0f;
+    select(0.95f);
+    flips = 0;
+    for (uint32_t frame = 0; frame < 20; frame++)
+      flips += select(frame % 2 == 0 ? 1.05f : 0.95f);
+    CHECK(flips == 20 * indices.size());
+  }
+}
+
+int main()
+{
+  testPathsMatch();
+  testHysteresis();
+  return TEST_RESULT();
+}
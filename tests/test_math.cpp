@@ -0,0 +1,207 @@
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include <core/math.h>
+
+#include "test_utils.h"
+
+using namespace engine;
+
+// Plain scalar versions of the operations, the reference the SSE paths are compared with
+
+static float getElement(const Mat4 &m, uint32_t row, uint32_t column)
+{
+  return m.data()[column * 4 + row];
+}
+
+static Mat4 multiplyScalar(const Mat4 &a, const Mat4 &b)
+{
+  Mat4 result;
+  for (uint32_t column = 0; column < 4; column++)
+  {
+    for (uint32_t row = 0; row < 4; row++)
+    {
+      float sum = 0.0f;
+      for (uint32_t k = 0; k < 4; k++)
+        sum += getElement(a, row, k) * getElement(b, k, column);
+      result.data()[column * 4 + row] = sum;
+    }
+  }
+  return result;
+}
+
+static Vec3 transformPointScalar(const Mat4 &m, const Vec3 &p)
+{
+  const float in[4] = {p.x, p.y, p.z, 1.0f};
+  float out[3];
+  for (uint32_t row = 0; row < 3; row++)
+    out[row] = getElement(m, row, 0) * in[0] + getElement(m, row, 1) * in[1] + getElement(m, row, 2) * in[2] + getElement(m, row, 3) * in[3];
+  return Vec3(out[0], out[1], out[2]);
+}
+
+// Rotation matrix of a unit quaternion, from the textbook formula
+static Mat4 fromTrsScalar(const Vec3 &t, const Quat &q, const Vec3 &s)
+{
+  const float r[3][3] = {
+      {1.0f - 2.0f * (q.y * q.y + q.z * q.z), 2.0f * (q.x * q.y - q.z * q.w), 2.0f * (q.x * q.z + q.y * q.w)},
+      {2.0f * (q.x * q.y + q.z * q.w), 1.0f - 2.0f * (q.x * q.x + q.z * q.z), 2.0f * (q.y * q.z - q.x * q.w)},
+      {2.0f * (q.x * q.z - q.y * q.w), 2.0f * (q.y * q.z + q.x * q.w), 1.0f - 2.0f * (q.x * q.x + q.y * q.y)}};
+  const float scale[3] = {s.x, s.y, s.z};
+  const float translation[3] = {t.x, t.y, t.z};
+  Mat4 result = Mat4::identity();
+  for (uint32_t column = 0; column < 3; column++)
+  {
+    for (uint32_t row = 0; row < 3; row++)
+      result.data()[column * 4 + row] = r[row][column] * scale[column];
+  }
+  for (uint32_t row = 0; row < 3; row++)
+    result.data()[12 + row] = translation[row];
+  return result;
+}
+
+static bool isNear(float a, float b, float tolerance = 1e-4f)
+{
+  return std::fabs(a - b) <= tolerance * std::max(1.0f, std::max(std::fabs(a), std::fabs(b)));
+}
+
+static bool isNear(const Vec3 &a, const Vec3 &b)
+{
+  return isNear(a.x, b.x) && isNear(a.y, b.y) && isNear(a.z, b.z);
+}
+
+static bool isNear(const Mat4 &a, const Mat4 &b)
+{
+  bool near = true;
+  for (uint32_t i = 0; i < 16; i++)
+    near = near && isNear(a.data()[i], b.data()[i]);
+  return near;
+}
+
+struct RandomTransforms
+{
+  std::vector<Vec3> translations;
+  std::vector<Quat> rotations;
+  std::vector<Vec3> scales;
+  std::vector<Mat4> matrices;
+};
+
+static RandomTransforms createTransforms(uint32_t count)
+{
+  std::mt19937 random(5);
+  std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+  std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+  std::uniform_real_distribution<float> scale(0.1f, 4.0f);
+  RandomTransforms transforms;
+  for (uint32_t i = 0; i < count; i++)
+  {
+    transforms.translations.emplace_back(position(random), position(random), position(random));
+    transforms.rotations.push_back(normalize(Quat(unit(random), unit(random), unit(random), unit(random))));
+    transforms.scales.emplace_back(scale(random), scale(random), scale(random));
+    transforms.matrices.push_back(fromTrsScalar(transforms.translations[i], transforms.rotations[i], transforms.scales[i]));
+  }
+  return transforms;
+}
+
+// Single value operations match the scalar reference
+static void testMatrixOperations()
+{
+  const RandomTransforms transforms = createTransforms(64);
+  bool areProductsNear = true;
+  bool arePointsNear = true;
+  bool areTrsNear = true;
+  bool areInversesNear = true;
+  bool areRotationsNear = true;
+  for (uint32_t i = 0; i + 1 < 64; i++)
+  {
+    const Mat4 &a = transforms.matrices[i];
+    const Mat4 &b = transforms.matrices[i + 1];
+    areProductsNear = areProductsNear && isNear(a * b, multiplyScalar(a, b));
+    arePointsNear = arePointsNear && isNear(a.transformPoint(transforms.translations[i + 1]), transformPointScalar(a, transforms.translations[i + 1]));
+    areTrsNear = areTrsNear && isNear(Mat4::fromTrs(transforms.translations[i], transforms.rotations[i], transforms.scales[i]), a);
+    areInversesNear = areInversesNear && isNear(a.inverseAffine() * a, Mat4::identity());
+    const Vec3 direction(1.0f, 2.0f, 3.0f);
+    areRotationsNear = areRotationsNear && isNear(transforms.rotations[i].rotate(direction), Mat4::rotation(transforms.rotations[i]).transformVector(direction));
+  }
+  CHECK(areProductsNear);
+  CHECK(arePointsNear);
+  CHECK(areTrsNear);
+  CHECK(areInversesNear);
+  CHECK(areRotationsNear);
+
+  // Quaternion products apply the right hand side first
+  const Quat first = Quat::fromAxisAngle(Vec3(0.0f, 1.0f, 0.0f), 0.5f);
+  const Quat second = Quat::fromAxisAngle(Vec3(1.0f, 0.0f, 0.0f), 1.2f);
+  const Vec3 v(0.3f, -2.0f, 5.0f);
+  CHECK(isNear((second * first).rotate(v), second.rotate(first.rotate(v))));
+}
+
+// Camera matrices follow the Vulkan conventions
+static void testCamera()
+{
+  const Mat4 view = Mat4::lookAt(Vec3(0.0f, 0.0f, 10.0f), Vec3(0.0f, 0.0f, 0.0f), Vec3(0.0f, 1.0f, 0.0f));
+  CHECK(isNear(view.transformPoint(Vec3(0.0f, 0.0f, 0.0f)), Vec3(0.0f, 0.0f, -10.0f)));
+
+  // Depth goes from 0 at the near plane to 1 at the far plane, y points down
+  const Mat4 projection = Mat4::perspective(1.0f, 1.0f, 0.5f, 100.0f);
+  const Vec4 nearPoint = projection * Vec4(0.0f, 0.0f, -0.5f, 1.0f);
+  const Vec4 farPoint = projection * Vec4(0.0f, 0.0f, -100.0f, 1.0f);
+  const Vec4 upPoint = projection * Vec4(0.0f, 1.0f, -10.0f, 1.0f);
+  CHECK(isNear(nearPoint.z / nearPoint.w, 0.0f));
+  CHECK(isNear(farPoint.z / farPoint.w, 1.0f));
+  CHECK(upPoint.y < 0.0f);
+}
+
+// Batched operations match the single value ones, including the tails which
+// don't fill a SIMD register and in place updates
+static void testBatchedOperations()
+{
+  const uint32_t count = 1003;
+  const RandomTransforms transforms = createTransforms(count);
+
+  std::vector<Vec3> points(count);
+  transformPoints(transforms.matrices[7], transforms.translations.data(), points.data(), count);
+  bool arePointsNear = true;
+  for (uint32_t i = 0; i < count; i++)
+    arePointsNear = arePointsNear && isNear(points[i], transformPointScalar(transforms.matrices[7], transforms.translations[i]));
+  CHECK(arePointsNear);
+
+  std::vector<Mat4> composed(count);
+  composeTrs(transforms.translations.data(), transforms.rotations.data(), transforms.scales.data(), composed.data(), count);
+  bool areComposedNear = true;
+  for (uint32_t i = 0; i < count; i++)
+    areComposedNear = areComposedNear && isNear(composed[i], transforms.matrices[i]);
+  CHECK(areComposedNear);
+
+  std::vector<Mat4> products(count);
+  std::vector<Mat4> reversed(transforms.matrices.rbegin(), transforms.matrices.rend());
+  multiplyMatrices(transforms.matrices.data(), reversed.data(), products.data(), count);
+  bool areProductsNear = true;
+  for (uint32_t i = 0; i < count; i++)
+    areProductsNear = areProductsNear && isNear(products[i], multiplyScalar(transforms.matrices[i], reversed[i]));
+  CHECK(areProductsNear);
+
+  // out may be one of the inputs
+  std::vector<Mat4> inPlace = transforms.matrices;
+  multiplyMatrices(inPlace.data(), reversed.data(), inPlace.data(), count);
+  bool areInPlaceNear = true;
+  for (uint32_t i = 0; i < count; i++)
+    areInPlaceNear = areInPlaceNear && isNear(inPlace[i], products[i]);
+  CHECK(areInPlaceNear);
+
+  inPlace = transforms.matrices;
+  multiplyMatrices(transforms.matrices[3], inPlace.data(), inPlace.data(), count);
+  bool areParentNear = true;
+  for (uint32_t i = 0; i < count; i++)
+    areParentNear = areParentNear && isNear(inPlace[i], multiplyScalar(transforms.matrices[3], transforms.matrices[i]));
+  CHECK(areParentNear);
+}
+
+int main()
+{
+  testMatrixOperations();
+  testCamera();
+  testBatchedOperations();
+  return TEST_RESULT();
+}
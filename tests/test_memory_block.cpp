@@ -0,0 +1,146 @@
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include <vulkan/vulkan_memory_block.h>
+
+#include "test_utils.h"
+
+using engine::vulkan::LinearBlock;
+using engine::vulkan::MemoryBlockStatistics;
+using engine::vulkan::TlsfBlock;
+
+// Dedicated device memory blocks are created with the exact size of the resource
+static void testWholeBlockAllocation()
+{
+  struct Request
+  {
+    uint64_t size;
+    uint64_t alignment;
+  };
+  const Request requests[] = {{40ull << 20, 256}, {1000000, 1}, {4096, 256}, {33, 1}, {7, 4}};
+  for (const Request &request : requests)
+  {
+    TlsfBlock block(request.size);
+    uint64_t offset = ~0ull;
+    uint32_t handle = engine::vulkan::INVALID_BLOCK_HANDLE;
+    CHECK(block.allocate(request.size, request.alignment, offset, handle));
+    CHECK(offset == 0);
+    CHECK(block.getStatistics().usedSize == request.size);
+    CHECK(block.getStatistics().freeRegionCount == 0);
+
+    // Nothing is left, and freeing makes the whole block available again
+    uint64_t other = 0;
+    uint32_t otherHandle = 0;
+    CHECK(!block.allocate(1, 1, other, otherHandle));
+    block.free(handle);
+    CHECK(block.isEmpty());
+    CHECK(block.allocate(request.size, request.alignment, offset, handle));
+    CHECK(offset == 0);
+  }
+}
+
+// Free ranges which are already aligned must not need room for padding
+static void testAlignedRangeWithoutPadding()
+{
+  TlsfBlock block(8192);
+  uint64_t first = 0, second = 0;
+  uint32_t firstHandle = 0, secondHandle = 0;
+  CHECK(block.allocate(4096, 256, first, firstHandle));
+  CHECK(block.allocate(4096, 256, second, secondHandle));
+  CHECK(first == 0 && second == 4096);
+
+  // The 4096 byte range left at an aligned offset fits an aligned request of the same size
+  block.free(firstHandle);
+  CHECK(block.allocate(4096, 4096, first, firstHandle));
+  CHECK(first == 0);
+}
+
+static void testAlignment()
+{
+  TlsfBlock block(1 << 20);
+  uint64_t offset = 0;
+  uint32_t handle = 0;
+  CHECK(block.allocate(100, 1, offset, handle));
+  CHECK(block.allocate(1000, 256, offset, handle));
+  CHECK(offset % 256 == 0);
+  CHECK(block.allocate(3, 65536, offset, handle));
+  CHECK(offset % 65536 == 0);
+}
+
+// Random allocations and frees never overlap and merge back into one range
+static void testRandomAllocations()
+{
+  const uint64_t blockSize = 16 << 20;
+  TlsfBlock block(blockSize);
+  std::mt19937 random(42);
+
+  struct Allocation
+  {
+    uint64_t offset;
+    uint64_t size;
+    uint32_t handle;
+  };
+  std::vector<Allocation> allocations;
+  std::vector<uint8_t> used(blockSize / 16, 0);
+  for (uint32_t i = 0; i < 20000; i++)
+  {
+    if (!allocations.empty() && random() % 3 == 0)
+    {
+      size_t index = random() % allocations.size();
+      const Allocation allocation = allocations[index];
+      for (uint64_t j = allocation.offset / 16; j < (allocation.offset + allocation.size) / 16; j++)
+        used[j] = 0;
+      block.free(allocation.handle);
+      allocations[index] = allocations.back();
+      allocations.pop_back();
+      continue;
+    }
+
+    Allocation allocation;
+    allocation.size = 16 * (1 + random() % 4096);
+    const uint64_t alignment = 16ull << (random() % 5);
+    if (!block.allocate(allocation.size, alignment, allocation.offset, allocation.handle))
+      continue;
+    CHECK(allocation.offset % alignment == 0);
+    CHECK(allocation.offset + allocation.size <= blockSize);
+    bool isOverlapping = false;
+    for (uint64_t j = allocation.offset / 16; j < (allocation.offset + allocation.size) / 16; j++)
+    {
+      isOverlapping = isOverlapping || used[j];
+      used[j] = 1;
+    }
+    CHECK(!isOverlapping);
+    allocations.push_back(allocation);
+  }
+
+  for (const Allocation &allocation : allocations)
+    block.free(allocation.handle);
+  const MemoryBlockStatistics stats = block.getStatistics();
+  CHECK(block.isEmpty());
+  CHECK(stats.usedSize == 0);
+  CHECK(stats.freeRegionCount == 1);
+  CHECK(stats.largestFreeRegion == blockSize);
+}
+
+static void testLinearWrapAround()
+{
+  LinearBlock block(1024);
+  uint64_t offset = 0;
+  CHECK(block.allocate(600, 1, offset) && offset == 0);
+  const uint64_t marker = block.getMarker();
+  CHECK(!block.allocate(600, 1, offset));
+  block.release(marker);
+  // The head is at 600, the request doesn't fit before the end and starts over at 0
+  CHECK(block.allocate(600, 1, offset) && offset == 0);
+}
+
+int main()
+{
+  testWholeBlockAllocation();
+  testAlignedRangeWithoutPadding();
+  testAlignment();
+  testRandomAllocations();
+  testLinearWrapAround();
+  return TEST_RESULT();
+}
@@ -0,0 +1,329 @@
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <vector>
+
+#include <core/mesh_file.h>
+
+#include "test_utils.h"
+
+using namespace engine;
+
+// Grid of size x size vertices in the xz plane, shifted so meshes differ
+static MeshData createGrid(uint32_t size, float offset)
+{
+  MeshData mesh;
+  for (uint32_t z = 0; z < size; z++)
+  {
+    for (uint32_t x = 0; x < size; x++)
+    {
+      MeshVertex vertex;
+      vertex.position[0] = static_cast<float>(x) + offset;
+      vertex.position[1] = 0.25f * static_cast<float>((x * 7 + z * 3) % 5);
+      vertex.position[2] = static_cast<float>(z);
+      vertex.normal[1] = 1.0f;
+      vertex.uv[0] = static_cast<float>(x) / (size - 1);
+      vertex.uv[1] = static_cast<float>(z) / (size - 1);
+      mesh.vertices.push_back(vertex);
+    }
+  }
+  for (uint32_t z = 0; z + 1 < size; z++)
+  {
+    for (uint32_t x = 0; x + 1 < size; x++)
+    {
+      const uint32_t v = z * size + x;
+      mesh.indices.insert(mesh.indices.end(), {v, v + size, v + 1, v + 1, v + size, v + size + 1});
+    }
+  }
+  return mesh;
+}
+
+static std::vector<char> readBytes(const std::filesystem::path &path)
+{
+  std::ifstream file(path, std::ios::binary);
+  return std::vector<char>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+static void writeBytes(const std::filesystem::path &path, const std::vector<char> &bytes)
+{
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  file.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+}
+
+// Meshes, levels and bounds read back through the mapping match what was written
+static void testRoundTrip(const std::filesystem::path &directory)
+{
+  const std::vector<MeshData> meshes = {createGrid(5, 0.0f), createGrid(16, 20.0f)};
+  std::vector<std::vector<MeshLod>> lods(meshes.size());
+  buildLods(meshes[1], lods[1]);
+  CHECK(!lods[1].empty());
+
+  const std::string path = (directory / "round_trip.mesh").string();
+  CHECK(writeMeshFile(path, meshes, MeshVertexFormat::Float, nullptr, &lods));
+  MeshFile file;
+  CHECK(file.open(path));
+  CHECK(file.isOpen());
+  CHECK(file.getMeshCount() == meshes.size());
+  CHECK(file.getVertexFormat() == MeshVertexFormat::Float);
+  CHECK(file.getVertexStride() == sizeof(MeshVertex));
+  CHECK(file.getVertexCount() == meshes[0].vertices.size() + meshes[1].vertices.size());
+  CHECK(file.getIndexCount() == meshes[0].indices.size() + meshes[1].indices.size());
+  CHECK(file.getMeshletCount() == 0 && file.getMeshlets() == nullptr);
+
+  bool areMeshesEqual = true;
+  for (uint32_t i = 0; i < meshes.size(); i++)
+  {
+    const MeshFileEntry &entry = file.getMeshes()[i];
+    const MeshData &mesh = meshes[i];
+    areMeshesEqual = areMeshesEqual && entry.vertexCount == mesh.vertices.size() && entry.indexCount == mesh.indices.size();
+    areMeshesEqual = areMeshesEqual
+        && std::memcmp(file.getVertices() + entry.firstVertex, mesh.vertices.data(), mesh.vertices.size() * sizeof(MeshVertex)) == 0;
+    areMeshesEqual = areMeshesEqual
+        && std::equal(mesh.indices.begin(), mesh.indices.end(), file.getIndices() + entry.firstIndex);
+
+    // Every vertex is inside the bounding sphere
+    for (const MeshVertex &vertex : mesh.vertices)
+    {
+      float distance2 = 0.0f;
+      for (uint32_t c = 0; c < 3; c++)
+        distance2 += (vertex.position[c] - entry.boundsCenter[c]) * (vertex.position[c] - entry.boundsCenter[c]);
+      areMeshesEqual = areMeshesEqual && distance2 <= entry.boundsRadius * entry.boundsRadius * 1.0001f;
+    }
+  }
+  CHECK(areMeshesEqual);
+
+  // The first mesh has no levels, level 0 of the second is the mesh itself
+  const MeshFileEntry &withLods = file.getMeshes()[1];
+  CHECK(file.getMeshes()[0].lodCount == 0);
+  CHECK(withLods.lodCount == lods[1].size() + 1);
+  CHECK(file.getLodCount() == withLods.lodCount);
+  const MeshFileLod *fileLods = file.getLods() + withLods.firstLod;
+  CHECK(fileLods[0].firstIndex == withLods.firstIndex && fileLods[0].indexCount == withLods.indexCount);
+  bool areLodsEqual = true;
+  for (uint32_t level = 1; level < withLods.lodCount; level++)
+  {
+    const MeshLod &lod = lods[1][level - 1];
+    areLodsEqual = areLodsEqual && fileLods[level].indexCount == lod.indices.size() && fileLods[level].error == lod.error;
+    areLodsEqual = areLodsEqual && fileLods[level].firstIndex >= file.getIndexCount();
+    areLodsEqual = areLodsEqual && std::equal(lod.indices.begin(), lod.indices.end(), file.getIndices() + fileLods[level].firstIndex);
+  }
+  CHECK(areLodsEqual);
+  file.close();
+  CHECK(!file.isOpen());
+  CHECK(file.getMeshCount() == 0);
+
+  // Quantized vertices are stored as quantizeVertex() makes them
+  CHECK(writeMeshFile(path, meshes, MeshVertexFormat::Quantized));
+  CHECK(file.open(path));
+  CHECK(file.getVertexFormat() == MeshVertexFormat::Quantized);
+  CHECK(file.getVertexStride() == sizeof(QuantizedVertex));
+  CHECK(file.getVertices() == nullptr);
+  bool areQuantizedEqual = true;
+  const QuantizedVertex *quantized = static_cast<const QuantizedVertex *>(file.getVertexData());
+  for (const MeshData &mesh : meshes)
+  {
+    for (const MeshVertex &vertex : mesh.vertices)
+    {
+      const QuantizedVertex expected = quantizeVertex(vertex);
+      areQuantizedEqual = areQuantizedEqual && std::memcmp(quantized++, &expected, sizeof(QuantizedVertex)) == 0;
+    }
+  }
+  CHECK(areQuantizedEqual);
+  CHECK(file.getLodCount() == 0 && file.getLods() == nullptr);
+}
+
+// Truncated files, corrupt headers and entries pointing out of the file are refused
+static void testCorruptFiles(const std::filesystem::path &directory)
+{
+  const std::vector<MeshData> meshes = {createGrid(4, 0.0f), createGrid(16, 10.0f)};
+  std::vector<std::vector<MeshLod>> lods(meshes.size());
+  buildLods(meshes[1], lods[1]);
+  const std::filesystem::path validPath = directory / "valid.mesh";
+  CHECK(writeMeshFile(validPath.string(), meshes, MeshVertexFormat::Float, nullptr, &lods));
+  const std::vector<char> valid = readBytes(validPath);
+  MeshFileHeader header;
+  std::memcpy(&header, valid.data(), sizeof(header));
+  MeshFile file;
+
+  const std::filesystem::path path = directory / "corrupt.mesh";
+  auto isRefused = [&](const std::function<void(std::vector<char> &)> &corrupt)
+  {
+    std::vector<char> bytes = valid;
+    corrupt(bytes);
+    writeBytes(path, bytes);
+    return !file.open(path.string()) && !file.isOpen() && file.getMeshes() == nullptr;
+  };
+  auto setHeader = [](std::vector<char> &bytes, const MeshFileHeader &corrupt)
+  {
+    std::memcpy(bytes.data(), &corrupt, sizeof(corrupt));
+  };
+  auto setEntry = [&header](std::vector<char> &bytes, uint32_t index, const std::function<void(MeshFileEntry &)> &corrupt)
+  {
+    MeshFileEntry entry;
+    char *data = bytes.data() + header.tocOffset + index * sizeof(MeshFileEntry);
+    std::memcpy(&entry, data, sizeof(entry));
+    corrupt(entry);
+    std::memcpy(data, &entry, sizeof(entry));
+  };
+
+  // The unmodified copy opens, so each refusal below comes from its corruption
+  CHECK(!isRefused([](std::vector<char> &) {}));
+  file.close();
+  CHECK(!file.open((directory / "missing.mesh").string()));
+
+  // Truncated anywhere, down to an empty file
+  for (size_t size : {static_cast<size_t>(0), sizeof(MeshFileHeader) - 1, static_cast<size_t>(header.vertexOffset + 8),
+                      static_cast<size_t>(header.indexOffset), valid.size() - 4})
+    CHECK(isRefused([size](std::vector<char> &bytes) { bytes.resize(size); }));
+
+  // Header fields
+  auto withHeader = [&](const std::function<void(MeshFileHeader &)> &corrupt)
+  {
+    return isRefused([&](std::vector<char> &bytes)
+                     {
+                       MeshFileHeader corrupted = header;
+                       corrupt(corrupted);
+                       setHeader(bytes, corrupted);
+                     });
+  };
+  CHECK(withHeader([](MeshFileHeader &h) { h.magic = 0x12345678; }));
+  CHECK(withHeader([](MeshFileHeader &h) { h.version = MESH_FILE_VERSION + 1; }));
+  CHECK(withHeader([](MeshFileHeader &h) { h.vertexFormat = static_cast<MeshVertexFormat>(7); }));
+  CHECK(withHeader([](MeshFileHeader &h) { h.vertexStride = sizeof(QuantizedVertex); }));
+  CHECK(withHeader([](MeshFileHeader &h) { h.meshCount = 1u << 30; }));
+  CHECK(withHeader([&valid](MeshFileHeader &h) { h.vertexCount = valid.size(); }));
+  CHECK(withHeader([](MeshFileHeader &h) { h.indexOffset += 4; }));
+  CHECK(withHeader([&valid](MeshFileHeader &h) { h.tocOffset = valid.size() + MESH_FILE_ALIGNMENT; }));
+  // Counts large enough to wrap offset + count * stride around
+  CHECK(withHeader([](MeshFileHeader &h) { h.indexCount = UINT64_MAX / 2; }));
+  CHECK(withHeader([](MeshFileHeader &h) { h.lodCount += 1; }));
+  CHECK(withHeader([](MeshFileHeader &h) { h.lodOffset = h.indexOffset + 4; }));
+
+  // Entries pointing past the ranges of the header
+  CHECK(isRefused([&](std::vector<char> &bytes)
+                  { setEntry(bytes, 1, [&](MeshFileEntry &e) { e.firstVertex = static_cast<uint32_t>(header.vertexCount); }); }));
+  CHECK(isRefused([&](std::vector<char> &bytes)
+                  { setEntry(bytes, 0, [](MeshFileEntry &e) { e.indexCount = UINT32_MAX; }); }));
+  CHECK(isRefused([&](std::vector<char> &bytes)
+                  { setEntry(bytes, 1, [](MeshFileEntry &e) { e.meshletCount = 1; }); }));
+  CHECK(isRefused([&](std::vector<char> &bytes)
+                  { setEntry(bytes, 1, [](MeshFileEntry &e) { e.lodCount = MAX_LOD_COUNT + 1; }); }));
+
+  // A level whose index range leaves the index blob
+  CHECK(isRefused([&](std::vector<char> &bytes)
+                  {
+                    MeshFileLod lod;
+                    char *data = bytes.data() + header.lodOffset + sizeof(MeshFileLod);
+                    std::memcpy(&lod, data, sizeof(lod));
+                    lod.firstIndex = static_cast<uint32_t>(header.indexCount + header.lodIndexCount) - 2;
+                    std::memcpy(data, &lod, sizeof(lod));
+                  }));
+}
+
+// Meshlets respect the limits of meshlet.mesh, cover the mesh's triangles,
+// load back unchanged, and files breaking the limits are refused
+static void testMeshlets(const std::filesystem::path &directory)
+{
+  std::vector<MeshData> meshes = {createGrid(40, 0.0f), createGrid(9, 50.0f)};
+  const std::vector<MeshData> sources = meshes;
+  std::vector<MeshletData> meshlets(meshes.size());
+  buildMeshlets(meshes[0], meshlets[0]);
+  // Limits above the shader ones are clamped
+  buildMeshlets(meshes[1], meshlets[1], 256, 1000);
+
+  bool areWithinLimits = true;
+  bool areTrianglesCovered = true;
+  for (uint32_t i = 0; i < meshes.size(); i++)
+  {
+    const MeshletData &data = meshlets[i];
+    uint32_t triangleCount = 0;
+    for (const Meshlet &meshlet : data.meshlets)
+    {
+      areWithinLimits = areWithinLimits && meshlet.vertexCount <= MAX_MESHLET_VERTICES && meshlet.triangleCount <= MAX_MESHLET_TRIANGLES;
+      areWithinLimits = areWithinLimits && meshlet.vertexCount >= 3 && meshlet.triangleCount > 0;
+      // Consecutive triangles, whose local indices resolve to the mesh's indices
+      areTrianglesCovered = areTrianglesCovered && meshlet.triangleOffset == triangleCount;
+      for (uint32_t t = meshlet.triangleOffset; t < meshlet.triangleOffset + meshlet.triangleCount; t++)
+      {
+        for (uint32_t c = 0; c < 3; c++)
+        {
+          const uint32_t local = (data.triangles[t] >> (8 * c)) & 0xFF;
+          areWithinLimits = areWithinLimits && local < meshlet.vertexCount;
+          areTrianglesCovered = areTrianglesCovered && data.vertices[meshlet.vertexOffset + local] == meshes[i].indices[t * 3 + c];
+        }
+      }
+      triangleCount += meshlet.triangleCount;
+    }
+    areTrianglesCovered = areTrianglesCovered && triangleCount * 3 == sources[i].indices.size();
+  }
+  CHECK(areWithinLimits);
+  CHECK(areTrianglesCovered);
+  CHECK(meshlets[0].meshlets.size() > 10);
+
+  const std::filesystem::path path = directory / "meshlets.mesh";
+  CHECK(writeMeshFile(path.string(), meshes, MeshVertexFormat::Quantized, &meshlets));
+  MeshFile file;
+  CHECK(file.open(path.string()));
+  CHECK(file.getMeshletCount() == meshlets[0].meshlets.size() + meshlets[1].meshlets.size());
+  CHECK(file.getMeshletVertexCount() == meshlets[0].vertices.size() + meshlets[1].vertices.size());
+  bool areMeshletsEqual = true;
+  for (uint32_t i = 0; i < meshes.size(); i++)
+  {
+    const MeshFileEntry &entry = file.getMeshes()[i];
+    areMeshletsEqual = areMeshletsEqual && entry.meshletCount == meshlets[i].meshlets.size();
+    areMeshletsEqual = areMeshletsEqual
+        && std::equal(meshes[i].indices.begin(), meshes[i].indices.end(), file.getIndices() + entry.firstIndex);
+    for (uint32_t m = 0; m < entry.meshletCount; m++)
+    {
+      // Offsets become file wide, the rest is stored as built
+      const Meshlet &source = meshlets[i].meshlets[m];
+      const Meshlet &loaded = file.getMeshlets()[entry.firstMeshlet + m];
+      areMeshletsEqual = areMeshletsEqual && loaded.vertexCount == source.vertexCount && loaded.triangleCount == source.triangleCount;
+      areMeshletsEqual = areMeshletsEqual && loaded.triangleOffset == source.triangleOffset + entry.firstIndex / 3;
+      areMeshletsEqual = areMeshletsEqual && std::memcmp(loaded.center, source.center, sizeof(float) * 8) == 0;
+      areMeshletsEqual = areMeshletsEqual
+          && std::equal(file.getMeshletVertices() + loaded.vertexOffset,
+                        file.getMeshletVertices() + loaded.vertexOffset + loaded.vertexCount,
+                        meshlets[i].vertices.begin() + source.vertexOffset);
+      areMeshletsEqual = areMeshletsEqual
+          && std::equal(file.getMeshletTriangles() + loaded.triangleOffset,
+                        file.getMeshletTriangles() + loaded.triangleOffset + loaded.triangleCount,
+                        meshlets[i].triangles.begin() + source.triangleOffset);
+    }
+  }
+  CHECK(areMeshletsEqual);
+  file.close();
+
+  // One vertex or triangle more than the mesh shader outputs, still within the file's ranges
+  const std::vector<char> valid = readBytes(path);
+  MeshFileHeader header;
+  std::memcpy(&header, valid.data(), sizeof(header));
+  auto isRefused = [&](const std::function<void(Meshlet &)> &corrupt)
+  {
+    std::vector<char> bytes = valid;
+    Meshlet meshlet;
+    std::memcpy(&meshlet, bytes.data() + header.meshletOffset, sizeof(meshlet));
+    corrupt(meshlet);
+    std::memcpy(bytes.data() + header.meshletOffset, &meshlet, sizeof(meshlet));
+    writeBytes(path, bytes);
+    return !file.open(path.string());
+  };
+  CHECK(!isRefused([](Meshlet &) {}));
+  file.close();
+  CHECK(isRefused([](Meshlet &m) { m.vertexCount = MAX_MESHLET_VERTICES + 1; }));
+  CHECK(isRefused([](Meshlet &m) { m.triangleCount = MAX_MESHLET_TRIANGLES + 1; }));
+}
+
+int main()
+{
+  const std::filesystem::path directory = std::filesystem::temp_directory_path() / "test_mesh_file";
+  std::filesystem::create_directories(directory);
+  testRoundTrip(directory);
+  testCorruptFiles(directory);
+  testMeshlets(directory);
+  std::filesystem::remove_all(directory);
+  return TEST_RESULT();
+}
@@ -0,0 +1,279 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <deque>
+#include <random>
+#include <vector>
+
+#include <core/mesh.h>
+#include <core/mesh_optimizer.h>
+
+#include "test_utils.h"
+
+using namespace engine;
+
+// Plain FIFO cache with a queue, the reference analyzeVertexCache() is compared with
+static uint32_t countMissesReference(const std::vector<uint32_t> &indices, uint32_t cacheSize)
+{
+  std::deque<uint32_t> cache;
+  uint32_t misses = 0;
+  for (uint32_t index : indices)
+  {
+    if (std::find(cache.begin(), cache.end(), index) != cache.end())
+      continue;
+    misses++;
+    cache.push_back(index);
+    if (cache.size() > cacheSize)
+      cache.pop_front();
+  }
+  return misses;
+}
+
+// Grid of size x size vertices with its triangles in random order
+static MeshData createShuffledGrid(uint32_t size)
+{
+  MeshData mesh;
+  for (uint32_t y = 0; y < size; y++)
+  {
+    for (uint32_t x = 0; x < size; x++)
+    {
+      MeshVertex vertex;
+      vertex.position[0] = static_cast<float>(x);
+      vertex.position[1] = static_cast<float>(y);
+      vertex.normal[2] = 1.0f;
+      mesh.vertices.push_back(vertex);
+    }
+  }
+
+  std::vector<std::array<uint32_t, 3>> triangles;
+  for (uint32_t y = 0; y + 1 < size; y++)
+  {
+    for (uint32_t x = 0; x + 1 < size; x++)
+    {
+      const uint32_t v = y * size + x;
+      triangles.push_back({v, v + 1, v + size});
+      triangles.push_back({v + 1, v + size + 1, v + size});
+    }
+  }
+  std::shuffle(triangles.begin(), triangles.end(), std::mt19937(17));
+  for (const std::array<uint32_t, 3> &triangle : triangles)
+    mesh.indices.insert(mesh.indices.end(), triangle.begin(), triangle.end());
+  return mesh;
+}
+
+// Triangles as grid positions, rotated to start at the smallest one and sorted,
+// so meshes can be compared whatever the triangle and vertex order
+static std::vector<std::array<uint32_t, 3>> getTriangles(const MeshData &mesh, uint32_t size)
+{
+  std::vector<std::array<uint32_t, 3>> triangles;
+  for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+  {
+    std::array<uint32_t, 3> triangle;
+    for (uint32_t c = 0; c < 3; c++)
+    {
+      const MeshVertex &vertex = mesh.vertices[mesh.indices[i + c]];
+      triangle[c] = static_cast<uint32_t>(vertex.position[1]) * size + static_cast<uint32_t>(vertex.position[0]);
+    }
+    std::rotate(triangle.begin(), std::min_element(triangle.begin(), triangle.end()), triangle.end());
+    triangles.push_back(triangle);
+  }
+  std::sort(triangles.begin(), triangles.end());
+  return triangles;
+}
+
+// The cache simulator counts the same misses as a queue based FIFO
+static void testCacheSimulator()
+{
+  const uint32_t triangle[3] = {0, 1, 2};
+  const VertexCacheStats single = analyzeVertexCache(triangle, 3, 3);
+  CHECK(single.misses == 3);
+  CHECK(single.acmr == 3.0f);
+  CHECK(single.atvr == 1.0f);
+  CHECK(analyzeVertexCache(triangle, 0, 3).misses == 0);
+
+  std::mt19937 random(3);
+  bool areMissesEqual = true;
+  for (uint32_t cacheSize : {3u, 8u, 16u, 32u})
+  {
+    for (uint32_t vertexCount : {4u, 40u, 1000u})
+    {
+      // Random walk, so some indices hit and some miss
+      std::vector<uint32_t> indices(3000);
+      uint32_t vertex = 0;
+      for (uint32_t &index : indices)
+      {
+        vertex = (vertex + random() % 24) % vertexCount;
+        index = vertex;
+      }
+      const VertexCacheStats stats = analyzeVertexCache(indices.data(), indices.size(), vertexCount, cacheSize);
+      areMissesEqual = areMissesEqual && stats.misses == countMissesReference(indices, cacheSize);
+    }
+  }
+  CHECK(areMissesEqual);
+}
+
+// optimizeMesh() improves ACMR and ATVR on a shuffled grid and keeps its triangles
+static void testOptimizeMesh()
+{
+  const uint32_t size = 100;
+  MeshData mesh = createShuffledGrid(size);
+  const std::vector<std::array<uint32_t, 3>> triangles = getTriangles(mesh, size);
+  const VertexCacheStats before = analyzeVertexCache(mesh.indices.data(), mesh.indices.size(), static_cast<uint32_t>(mesh.vertices.size()));
+
+  optimizeMesh(mesh);
+  const VertexCacheStats after = analyzeVertexCache(mesh.indices.data(), mesh.indices.size(), static_cast<uint32_t>(mesh.vertices.size()));
+  // Random order misses nearly every vertex, a good order gets close to 0.5 per triangle
+  CHECK(before.acmr > 2.0f);
+  CHECK(after.acmr < before.acmr);
+  CHECK(after.acmr < 0.8f);
+  CHECK(after.atvr < before.atvr);
+  CHECK(after.atvr < 1.6f);
+  CHECK(getTriangles(mesh, size) == triangles);
+
+  // Vertices are stored in the order the triangles first use them
+  uint32_t nextVertex = 0;
+  bool isFetchOrdered = true;
+  for (uint32_t index : mesh.indices)
+  {
+    isFetchOrdered = isFetchOrdered && index <= nextVertex;
+    if (index == nextVertex)
+      nextVertex++;
+  }
+  CHECK(isFetchOrdered);
+  CHECK(nextVertex == mesh.vertices.size());
+}
+
+// Each pass keeps the triangles, and the cache order survives the overdraw pass within its threshold
+static void testOptimizationPasses()
+{
+  const uint32_t size = 64;
+  MeshData mesh = createShuffledGrid(size);
+  const std::vector<std::array<uint32_t, 3>> triangles = getTriangles(mesh, size);
+  const uint32_t vertexCount = static_cast<uint32_t>(mesh.vertices.size());
+
+  std::vector<uint32_t> clusters;
+  optimizeVertexCache(mesh.indices, vertexCount, DEFAULT_VERTEX_CACHE_SIZE, &clusters);
+  CHECK(getTriangles(mesh, size) == triangles);
+  CHECK(!clusters.empty() && clusters[0] == 0);
+  CHECK(std::is_sorted(clusters.begin(), clusters.end()));
+  const uint32_t cacheMisses = analyzeVertexCache(mesh.indices.data(), mesh.indices.size(), vertexCount).misses;
+
+  const float threshold = 1.05f;
+  optimizeOverdraw(mesh.indices, mesh.vertices, clusters, DEFAULT_VERTEX_CACHE_SIZE, threshold);
+  CHECK(getTriangles(mesh, size) == triangles);
+  const uint32_t overdrawMisses = analyzeVertexCache(mesh.indices.data(), mesh.indices.size(), vertexCount).misses;
+  CHECK(overdrawMisses <= cacheMisses * threshold);
+
+  optimizeVertexFetch(mesh);
+  CHECK(getTriangles(mesh, size) == triangles);
+  CHECK(analyzeVertexCache(mesh.indices.data(), mesh.indices.size(), vertexCount).misses == overdrawMisses);
+}
+
+// Half floats keep +-0 and +-1 exactly, round normal values within half a unit
+// in the last place, and saturate to infinity past the largest half
+static void testHalfRoundTrip()
+{
+  auto getBits = [](float value)
+  {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+  };
+  for (float value : {0.0f, -0.0f, 1.0f, -1.0f, 0.5f, 2.0f, 65504.0f, -65504.0f})
+    CHECK(getBits(dequantizeHalf(quantizeHalf(value))) == getBits(value));
+  CHECK(quantizeHalf(-0.0f) == 0x8000);
+  CHECK(quantizeHalf(1.0f) == 0x3C00);
+  CHECK(std::isinf(dequantizeHalf(quantizeHalf(65520.0f))));
+  CHECK(std::isinf(dequantizeHalf(quantizeHalf(-1e6f))) && dequantizeHalf(quantizeHalf(-1e6f)) < 0.0f);
+  CHECK(std::isnan(dequantizeHalf(quantizeHalf(std::nanf("")))));
+
+  std::mt19937 random(21);
+  std::uniform_real_distribution<float> exponent(-14.0f, 15.9f);
+  std::uniform_real_distribution<float> small(-6.1e-5f, 6.1e-5f);
+  bool isNormalNear = true;
+  bool isDenormalNear = true;
+  for (uint32_t i = 0; i < 100000; i++)
+  {
+    // Relative error of at most 2^-11 in the normal range
+    const float value = std::exp2(exponent(random)) * (i % 2 == 0 ? 1.0f : -1.0f);
+    isNormalNear = isNormalNear && std::fabs(dequantizeHalf(quantizeHalf(value)) - value) <= std::ldexp(std::fabs(value), -11);
+    // Absolute error of at most half the smallest denormal below it
+    const float denormal = small(random);
+    isDenormalNear = isDenormalNear && std::fabs(dequantizeHalf(quantizeHalf(denormal)) - denormal) <= std::ldexp(1.0f, -25);
+  }
+  CHECK(isNormalNear);
+  CHECK(isDenormalNear);
+}
+
+// Octahedral normals decode the axes exactly and stay within a small angle of any unit normal
+static void testOctahedralRoundTrip()
+{
+  auto roundTrip = [](const float normal[3], float decoded[3])
+  {
+    int16_t encoded[2];
+    encodeOctahedral(normal, encoded);
+    decodeOctahedral(encoded, decoded);
+  };
+
+  bool areAxesExact = true;
+  for (uint32_t axis = 0; axis < 3; axis++)
+  {
+    for (float sign : {1.0f, -1.0f})
+    {
+      float normal[3] = {};
+      normal[axis] = sign;
+      float decoded[3];
+      roundTrip(normal, decoded);
+      for (uint32_t k = 0; k < 3; k++)
+        areAxesExact = areAxesExact && decoded[k] == normal[k];
+    }
+  }
+  CHECK(areAxesExact);
+
+  // A zero normal decodes to a unit vector instead of NaN
+  const float zero[3] = {};
+  float decodedZero[3];
+  roundTrip(zero, decodedZero);
+  CHECK(decodedZero[2] == 1.0f);
+
+  std::mt19937 random(22);
+  std::normal_distribution<float> component;
+  float maxAngle = 0.0f;
+  float maxLengthError = 0.0f;
+  for (uint32_t i = 0; i < 100000; i++)
+  {
+    // Every fourth normal lies on the fold at z = 0 and every fourth on an axis plane
+    float normal[3] = {component(random), component(random), component(random)};
+    if (i % 4 == 1)
+      normal[2] = 0.0f;
+    else if (i % 4 == 2)
+      normal[i % 3 == 0 ? 0 : 1] = 0.0f;
+    const float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+    for (float &value : normal)
+      value /= length;
+
+    float decoded[3];
+    roundTrip(normal, decoded);
+    const float cross[3] = {normal[1] * decoded[2] - normal[2] * decoded[1],
+                            normal[2] * decoded[0] - normal[0] * decoded[2],
+                            normal[0] * decoded[1] - normal[1] * decoded[0]};
+    const float dot = normal[0] * decoded[0] + normal[1] * decoded[1] + normal[2] * decoded[2];
+    const float sine = std::sqrt(cross[0] * cross[0] + cross[1] * cross[1] + cross[2] * cross[2]);
+    maxAngle = std::max(maxAngle, std::atan2(sine, dot));
+    maxLengthError = std::max(maxLengthError, std::fabs(std::sqrt(decoded[0] * decoded[0] + decoded[1] * decoded[1] + decoded[2] * decoded[2]) - 1.0f));
+  }
+  // 16 bit components give steps of 1 / 32767, a few 1e-5 radians on the sphere
+  CHECK(maxAngle < 1e-4f);
+  CHECK(maxLengthError < 1e-6f);
+}
+
+int main()
+{
+  testCacheSimulator();
+  testOptimizeMesh();
+  testOptimizationPasses();
+  testHalfRoundTrip();
+  testOctahedralRoundTrip();
+  return TEST_RESULT();
+}
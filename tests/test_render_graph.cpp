@@ -0,0 +1,134 @@
+#include <vulkan/vulkan_render_graph.h>
+
+#include "test_utils.h"
+
+using namespace engine::vulkan;
+
+static RenderResourceDesc imageDesc(vk::Format format, uint32_t width = 1920, uint32_t height = 1080)
+{
+  RenderResourceDesc desc;
+  desc.format = format;
+  desc.extent = vk::Extent2D(width, height);
+  desc.imageUsage = vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eSampled;
+  return desc;
+}
+
+// Schedule of a deferred style frame, compile() never touches the device
+static void testDeferredFrameSchedule()
+{
+  RenderGraph graph;
+  const RenderResourceId albedo = graph.createResource("Albedo", imageDesc(vk::Format::eR8G8B8A8Unorm));
+  const RenderResourceId depth = graph.createResource("Depth", imageDesc(vk::Format::eD32Sfloat, 960, 540));
+  const RenderResourceId lighting = graph.createResource("Lighting", imageDesc(vk::Format::eR16G16B16A16Sfloat));
+  const RenderResourceId unused = graph.createResource("Debug", imageDesc(vk::Format::eR8G8B8A8Unorm));
+  const RenderResourceId blurred = graph.createResource("Blurred", imageDesc(vk::Format::eR8G8B8A8Unorm));
+  const RenderResourceId swapchain = graph.importResource("Swapchain",
+      imageDesc(vk::Format::eB8G8R8A8Srgb),
+      vk::ImageLayout::eUndefined,
+      vk::ImageLayout::ePresentSrcKHR);
+
+  auto noop = [](const vk::CommandBuffer &, const RenderGraph &) {};
+  graph.addPass("GBuffer", {{albedo, RenderResourceUsage::ColorAttachment}, {depth, RenderResourceUsage::DepthAttachment}}, noop);
+  graph.addPass("Lighting", {{albedo, RenderResourceUsage::Sampled}, {depth, RenderResourceUsage::DepthRead}, {lighting, RenderResourceUsage::ColorAttachment}}, noop);
+  const uint32_t debugPass = graph.addPass("Debug", {{unused, RenderResourceUsage::ColorAttachment}}, noop);
+  graph.addPass("Blur", {{lighting, RenderResourceUsage::Sampled}, {blurred, RenderResourceUsage::ColorAttachment}}, noop);
+  graph.addPass("Composite", {{blurred, RenderResourceUsage::Sampled}, {swapchain, RenderResourceUsage::ColorAttachment}}, noop);
+  CHECK(graph.compile());
+
+  const RenderGraphSchedule &schedule = graph.getSchedule();
+  // Nothing reads the debug output, so its pass is dropped
+  CHECK(schedule.isPassCulled[debugPass]);
+  CHECK(schedule.passOrder == std::vector<uint32_t>({0, 1, 3, 4}));
+
+  // One transition per first use and per write to read switch, plus the
+  // final transition of the swapchain image to present
+  CHECK(schedule.getBarrierCount() == 10);
+  CHECK(schedule.finalBarriers.size() == 1);
+  CHECK(schedule.finalBarriers[0].newLayout == vk::ImageLayout::ePresentSrcKHR);
+
+  // Blurred starts after albedo is last read, so it reuses its memory, and
+  // its first barrier waits for the passes which used that memory. Sizes are
+  // estimated from the formats: albedo and blurred 4, lighting 8 and the
+  // quarter sized depth 1 byte per full resolution pixel.
+  const vk::DeviceSize imageSize = 1920ull * 1080 * 4;
+  CHECK(schedule.unaliasedMemorySize == imageSize * 4 + imageSize / 4);
+  CHECK(schedule.transientMemorySize == imageSize * 3 + imageSize / 4);
+  CHECK(schedule.memoryOffsets[blurred] == schedule.memoryOffsets[albedo]);
+  CHECK(schedule.memoryOffsets[unused] == std::numeric_limits<vk::DeviceSize>::max());
+  bool hasAliasingBarrier = false;
+  for (const RenderBarrier &barrier : schedule.passBarriers[2])
+  {
+    if (barrier.resource == blurred)
+      hasAliasingBarrier = barrier.srcStage ? true : false;
+  }
+  CHECK(hasAliasingBarrier);
+}
+
+// Buffers only get memory dependencies, reads after a read need no barrier
+static void testBufferBarriers()
+{
+  RenderGraph graph;
+  RenderResourceDesc desc;
+  desc.isBuffer = true;
+  desc.size = 1 << 20;
+  desc.bufferUsage = vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer;
+  const RenderResourceId draws = graph.createResource("Draws", desc);
+
+  auto noop = [](const vk::CommandBuffer &, const RenderGraph &) {};
+  graph.addPass("Cull", {{draws, RenderResourceUsage::StorageWrite}}, noop);
+  graph.addPass("Draw", {{draws, RenderResourceUsage::IndirectRead}}, noop, true);
+  graph.addPass("DrawAgain", {{draws, RenderResourceUsage::IndirectRead}}, noop, true);
+  CHECK(graph.compile());
+
+  const RenderGraphSchedule &schedule = graph.getSchedule();
+  CHECK(schedule.getBarrierCount() == 1);
+  CHECK(schedule.passBarriers[1].size() == 1);
+  CHECK(schedule.passBarriers[1][0].srcAccess == vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite);
+  CHECK(schedule.passBarriers[1][0].dstAccess == vk::AccessFlags(vk::AccessFlagBits::eIndirectCommandRead));
+  CHECK(schedule.transientMemorySize == desc.size);
+}
+
+// A storage write reads what the pass before it wrote (Eg: atomicAdd into a
+// cleared counter), so the clear is kept even though no later pass reads the counter
+static void testReadModifyWrite()
+{
+  RenderGraph graph;
+  RenderResourceDesc desc;
+  desc.isBuffer = true;
+  desc.size = 256;
+  desc.bufferUsage = vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst;
+  const RenderResourceId counters = graph.createResource("Counters", desc);
+  const RenderResourceId output = graph.importResource("Output", desc);
+  const RenderResourceId scratch = graph.createResource("Scratch", desc);
+
+  auto noop = [](const vk::CommandBuffer &, const RenderGraph &) {};
+  const uint32_t clearPass = graph.addPass("ClearCounters", {{counters, RenderResourceUsage::TransferDst}}, noop);
+  // Nothing reads the scratch buffer, so a storage write alone doesn't keep its pass
+  const uint32_t scratchPass = graph.addPass("FillScratch", {{scratch, RenderResourceUsage::StorageWrite}}, noop);
+  const uint32_t countPass = graph.addPass("Count",
+      {{counters, RenderResourceUsage::StorageWrite}, {output, RenderResourceUsage::StorageWrite}},
+      noop);
+  CHECK(graph.compile());
+
+  const RenderGraphSchedule &schedule = graph.getSchedule();
+  CHECK(!schedule.isPassCulled[clearPass]);
+  CHECK(!schedule.isPassCulled[countPass]);
+  CHECK(schedule.isPassCulled[scratchPass]);
+  CHECK(schedule.passOrder == std::vector<uint32_t>({clearPass, countPass}));
+  // The atomics wait for the clear
+  bool hasClearBarrier = false;
+  for (const RenderBarrier &barrier : schedule.passBarriers[1])
+  {
+    if (barrier.resource == counters)
+      hasClearBarrier = barrier.srcAccess == vk::AccessFlags(vk::AccessFlagBits::eTransferWrite);
+  }
+  CHECK(hasClearBarrier);
+}
+
+int main()
+{
+  testDeferredFrameSchedule();
+  testBufferBarriers();
+  testReadModifyWrite();
+  return TEST_RESULT();
+}
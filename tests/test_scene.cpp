@@ -0,0 +1,171 @@
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include <core/job_system.h>
+#include <core/scene.h>
+
+#include "test_utils.h"
+
+using engine::JobSystem;
+using engine::Mat4;
+using engine::NodeHandle;
+using engine::Quat;
+using engine::Scene;
+using engine::Vec3;
+
+static bool isNear(const Mat4 &a, const Mat4 &b)
+{
+  bool near = true;
+  for (uint32_t i = 0; i < 16; i++)
+    near = near && std::fabs(a.data()[i] - b.data()[i]) <= 1e-3f * std::max(1.0f, std::fabs(b.data()[i]));
+  return near;
+}
+
+// World matrix computed from the local transforms up to the root, without update()
+static Mat4 getReferenceWorld(const Scene &scene, NodeHandle node)
+{
+  const Mat4 local = Mat4::fromTrs(*scene.getTranslation(node), *scene.getRotation(node), *scene.getScale(node));
+  const NodeHandle parent = scene.getParent(node);
+  return parent.isValid() ? getReferenceWorld(scene, parent) * local : local;
+}
+
+// Every live node's world matrix matches the reference, and parents come before children
+static bool isSceneConsistent(const Scene &scene)
+{
+  bool isConsistent = true;
+  for (uint32_t i = 0; i < scene.size(); i++)
+  {
+    const NodeHandle node = scene.getHandle(i);
+    const NodeHandle parent = scene.getParent(node);
+    isConsistent = isConsistent && scene.getIndex(node) == i;
+    isConsistent = isConsistent && (!parent.isValid() || scene.getIndex(parent) < i);
+    isConsistent = isConsistent && isNear(*scene.getWorldMatrix(node), getReferenceWorld(scene, node));
+  }
+  return isConsistent;
+}
+
+// Only changed subtrees are recomputed
+static void testIncrementalUpdate()
+{
+  Scene scene;
+  const NodeHandle root = scene.createNode();
+  const NodeHandle child = scene.createNode(root);
+  const NodeHandle leaf = scene.createNode(child);
+  const NodeHandle other = scene.createNode();
+  CHECK(scene.update() == 4);
+  CHECK(scene.update() == 0);
+
+  CHECK(scene.setTranslation(leaf, Vec3(0.0f, 1.0f, 0.0f)));
+  CHECK(scene.update() == 1);
+  CHECK(scene.setTranslation(root, Vec3(5.0f, 0.0f, 0.0f)));
+  CHECK(scene.update() == 3);
+  CHECK(scene.wasChanged(scene.getIndex(leaf)));
+  CHECK(!scene.wasChanged(scene.getIndex(other)));
+  CHECK(isNear(*scene.getWorldMatrix(leaf), Mat4::translation(Vec3(5.0f, 1.0f, 0.0f))));
+}
+
+// Moved subtrees follow their new parent and no longer follow the old one
+static void testReparenting()
+{
+  Scene scene;
+  const NodeHandle a = scene.createNode();
+  const NodeHandle b = scene.createNode();
+  const NodeHandle child = scene.createNode(a);
+  const NodeHandle grandChild = scene.createNode(child);
+  scene.setTranslation(a, Vec3(10.0f, 0.0f, 0.0f));
+  scene.setTranslation(b, Vec3(0.0f, 20.0f, 0.0f));
+  scene.setScale(b, Vec3(2.0f, 2.0f, 2.0f));
+  scene.setTranslation(child, Vec3(1.0f, 0.0f, 0.0f));
+  scene.setTranslation(grandChild, Vec3(0.0f, 0.0f, 1.0f));
+  scene.update();
+  CHECK(isNear(*scene.getWorldMatrix(grandChild), Mat4::translation(Vec3(11.0f, 0.0f, 1.0f))));
+
+  // Same depth under the other root
+  CHECK(scene.setParent(child, b));
+  CHECK(scene.getParent(child) == b);
+  CHECK(scene.update() == 2);
+  CHECK(isNear(*scene.getWorldMatrix(grandChild), getReferenceWorld(scene, grandChild)));
+  CHECK(isNear(*scene.getWorldMatrix(grandChild), Mat4::fromTrs(Vec3(2.0f, 20.0f, 2.0f), Quat(), Vec3(2.0f, 2.0f, 2.0f))));
+  scene.setTranslation(a, Vec3(-10.0f, 0.0f, 0.0f));
+  CHECK(scene.update() == 1);
+  CHECK(isNear(*scene.getWorldMatrix(grandChild), getReferenceWorld(scene, grandChild)));
+
+  // Deeper, which reorders the nodes, and back to a root
+  CHECK(scene.setParent(b, a));
+  scene.update();
+  CHECK(isSceneConsistent(scene));
+  CHECK(scene.getLevelCount() == 4);
+  CHECK(scene.setParent(child, NodeHandle()));
+  scene.update();
+  CHECK(isSceneConsistent(scene));
+  CHECK(isNear(*scene.getWorldMatrix(grandChild), Mat4::translation(Vec3(1.0f, 0.0f, 1.0f))));
+
+  // Cycles and stale handles are refused
+  CHECK(!scene.setParent(child, grandChild));
+  CHECK(!scene.setParent(child, child));
+  CHECK(scene.removeNode(child));
+  CHECK(!scene.isValid(grandChild));
+  CHECK(!scene.setParent(grandChild, a));
+  CHECK(!scene.setParent(b, child));
+  CHECK(scene.size() == 2);
+}
+
+// Random edits and reparenting, updated serially and on the job system
+static void testRandomEdits(JobSystem *jobSystem)
+{
+  std::mt19937 random(9);
+  std::uniform_real_distribution<float> value(-2.0f, 2.0f);
+  Scene scene;
+  std::vector<NodeHandle> nodes;
+  // Large enough for update() to split the wide levels across jobs
+  for (uint32_t i = 0; i < 20000; i++)
+  {
+    const NodeHandle parent = nodes.empty() || random() % 8 == 0 ? NodeHandle() : nodes[random() % nodes.size()];
+    const NodeHandle node = scene.createNode(parent);
+    scene.setLocalTransform(node,
+                            Vec3(value(random), value(random), value(random)),
+                            engine::normalize(Quat(value(random), value(random), value(random), value(random))),
+                            Vec3(1.0f, 1.0f, 1.0f));
+    nodes.push_back(node);
+  }
+  scene.update(jobSystem);
+  CHECK(isSceneConsistent(scene));
+
+  for (uint32_t round = 0; round < 5; round++)
+  {
+    uint32_t refusedCount = 0;
+    for (uint32_t i = 0; i < 200; i++)
+    {
+      const NodeHandle node = nodes[random() % nodes.size()];
+      const NodeHandle parent = random() % 4 == 0 ? NodeHandle() : nodes[random() % nodes.size()];
+      if (!scene.setParent(node, parent))
+        refusedCount++;
+      scene.setTranslation(nodes[random() % nodes.size()], Vec3(value(random), value(random), value(random)));
+    }
+    scene.update(jobSystem);
+    CHECK(isSceneConsistent(scene));
+    CHECK(refusedCount < 200);
+  }
+
+  // World bounds follow the world matrices
+  bool areBoundsNear = true;
+  const engine::SphereBounds &bounds = scene.getWorldBounds();
+  for (uint32_t i = 0; i < scene.size(); i++)
+  {
+    const Mat4 &world = scene.getWorldMatrices()[i];
+    areBoundsNear = areBoundsNear && std::fabs(bounds.centerX[i] - world.columns[3].x) < 1e-3f;
+  }
+  CHECK(areBoundsNear);
+}
+
+int main()
+{
+  testIncrementalUpdate();
+  testReparenting();
+  testRandomEdits(nullptr);
+  JobSystem jobSystem(2);
+  testRandomEdits(&jobSystem);
+  return TEST_RESULT();
+}
@@ -0,0 +1,33 @@
+#ifndef TEST_UTILS_H
+#define TEST_UTILS_H
+
+#include <iostream>
+
+// Minimal checks for the CPU tests, a failed check is reported and the test
+// keeps going so that one run shows every failure
+namespace engine
+{
+    namespace test
+    {
+        inline int& getFailureCount()
+        {
+            static int failureCount = 0;
+            return failureCount;
+        }
+    }
+}
+
+#define CHECK(condition)                                                                         \
+    do                                                                                           \
+    {                                                                                            \
+        if (!(condition))                                                                        \
+        {                                                                                        \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #condition ") failed" << std::endl; \
+            engine::test::getFailureCount()++;                                                   \
+        }                                                                                        \
+    } while (0)
+
+// Exit code of the test executable, non zero if any check failed
+#define TEST_RESULT() (engine::test::getFailureCount() == 0 ? 0 : 1)
+
+#endif